@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class StackSymbolizer;
+
+// Platform independent part of the allocation profiler. Allocating threads push events into AllocEventBuffer and a
+// single consumer folds them into AllocProfile, which keeps per-callsite totals, live blocks and block lifetimes.
+
+constexpr int alloc_callsite_depth = 4;
+// Lifetimes in frames: 0, 1, 2-3, 4-7, ..., 1024+
+constexpr int num_alloc_lifetime_buckets = 12;
+
+struct AllocCallsite
+{
+    // Innermost caller first, unused entries are 0
+    uintptr_t frames[alloc_callsite_depth] = {};
+
+    bool operator==(const AllocCallsite& other) const;
+};
+
+enum class AllocEventType : uint8_t
+{
+    alloc,
+    free,
+};
+
+struct AllocEvent
+{
+    AllocEventType type = AllocEventType::alloc;
+    uint32_t size = 0;
+    uint32_t frame = 0;
+    uintptr_t ptr = 0;
+    // Set for alloc events only
+    AllocCallsite callsite;
+};
+
+// Bounded multi-producer single-consumer queue. Push never blocks and never allocates, events that do not fit are
+// dropped and counted. Events are consumed in the order their pushes were started, so a free pushed before the block
+// is actually freed always comes before an alloc that gets the same address.
+class AllocEventBuffer
+{
+public:
+    explicit AllocEventBuffer(size_t capacity = 65536);
+
+    bool push(const AllocEvent& event);
+
+    // Passes every complete event to callback in order. Only one thread may consume events.
+    template<typename F>
+    size_t drain(F&& callback)
+    {
+        size_t count = 0;
+        while (true) {
+            auto& cell = m_cells[m_read_pos & m_mask];
+            if (cell.sequence.load(std::memory_order_acquire) != m_read_pos + 1) {
+                break;
+            }
+            callback(static_cast<const AllocEvent&>(cell.event));
+            cell.sequence.store(m_read_pos + m_mask + 1, std::memory_order_release);
+            ++m_read_pos;
+            ++count;
+        }
+        return count;
+    }
+
+    [[nodiscard]] uint64_t num_dropped() const
+    {
+        return m_num_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{0};
+        AllocEvent event;
+    };
+
+    size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    std::atomic<size_t> m_write_pos{0};
+    size_t m_read_pos = 0;
+    std::atomic<uint64_t> m_num_dropped{0};
+};
+
+struct AllocCallsiteStats
+{
+    AllocCallsite callsite;
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+    uint64_t live_blocks = 0;
+    uint64_t live_bytes = 0;
+    uint64_t lifetimes[num_alloc_lifetime_buckets] = {};
+};
+
+enum class AllocSortKey
+{
+    count,
+    bytes,
+    live,
+};
+
+class AllocProfile
+{
+public:
+    // Forgets everything. Blocks allocated before are ignored when freed.
+    void reset(uint32_t frame);
+
+    void add(const AllocEvent& event);
+
+    // Returns the n callsites with the highest value of key
+    [[nodiscard]] std::vector<AllocCallsiteStats> top(size_t n, AllocSortKey key) const;
+
+    // Summary line followed by one line per callsite from top()
+    [[nodiscard]] std::vector<std::string> format_report(
+        const StackSymbolizer& symbolizer, size_t n, AllocSortKey key, uint32_t current_frame) const;
+
+    // Frees of blocks that are not tracked plus frees that were lost, seen as an alloc at a live address
+    [[nodiscard]] uint64_t num_untracked_frees() const
+    {
+        return m_num_untracked_frees;
+    }
+
+    static int lifetime_bucket(uint32_t frames);
+
+private:
+    struct CallsiteHash
+    {
+        size_t operator()(const AllocCallsite& callsite) const;
+    };
+
+    struct LiveBlock
+    {
+        uint32_t callsite_index;
+        uint32_t size;
+        uint32_t frame;
+    };
+
+    std::vector<AllocCallsiteStats> m_callsites;
+    std::unordered_map<AllocCallsite, uint32_t, CallsiteHash> m_callsite_indices;
+    std::unordered_map<uintptr_t, LiveBlock> m_live_blocks;
+    uint32_t m_start_frame = 0;
+    uint64_t m_num_untracked_frees = 0;
+};
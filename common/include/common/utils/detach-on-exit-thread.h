@@ -0,0 +1,44 @@
+#pragma once
+
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// std::thread for a background thread owned by a static object. If the thread is still running when the object is
+// destroyed it is detached. Static destructors run at process exit when the thread may already be gone, so joining it
+// could hang and destroying a joinable std::thread would terminate the process.
+class DetachOnExitThread
+{
+public:
+    DetachOnExitThread() = default;
+
+    template<typename F, typename... Args>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, DetachOnExitThread>)
+    explicit DetachOnExitThread(F&& fun, Args&&... args) :
+        m_thread(std::forward<F>(fun), std::forward<Args>(args)...)
+    {}
+
+    DetachOnExitThread(DetachOnExitThread&& other) noexcept = default;
+    // Like std::thread it must not replace a joinable thread
+    DetachOnExitThread& operator=(DetachOnExitThread&& other) noexcept = default;
+
+    ~DetachOnExitThread()
+    {
+        if (m_thread.joinable()) {
+            m_thread.detach();
+        }
+    }
+
+    [[nodiscard]] bool joinable() const
+    {
+        return m_thread.joinable();
+    }
+
+    void join()
+    {
+        m_thread.join();
+    }
+
+private:
+    std::thread m_thread;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Linear allocator for short-lived data. Allocation bumps an offset in one buffer and reset() frees everything at
+// once. If a frame needs more than the buffer holds the rest comes from the heap and the buffer grows on the next
+// reset, so a steady workload stops touching the heap after the first frames. Not thread-safe.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t initial_capacity = 64 * 1024) : m_capacity(initial_capacity)
+    {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Only the most recent allocation is actually released, which lets a growing container reuse its space
+    void deallocate(void* ptr, size_t size);
+
+    // Invalidates all memory allocated since the last reset
+    void reset();
+
+    [[nodiscard]] size_t used() const
+    {
+        return m_offset + m_overflow_bytes;
+    }
+
+    [[nodiscard]] size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    // Highest used() value seen at a reset
+    [[nodiscard]] size_t peak() const
+    {
+        return m_peak;
+    }
+
+    // Number of allocations since the last reset that did not fit in the buffer
+    [[nodiscard]] size_t num_overflows() const
+    {
+        return m_overflow.size();
+    }
+
+private:
+    std::unique_ptr<std::byte[]> m_buffer;
+    size_t m_capacity;
+    size_t m_offset = 0;
+    size_t m_peak = 0;
+    size_t m_overflow_bytes = 0;
+    std::vector<std::unique_ptr<std::byte[]>> m_overflow;
+};
+
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator(FrameArena& arena) : m_arena(&arena)
+    {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena())
+    {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        m_arena->deallocate(ptr, n * sizeof(T));
+    }
+
+    [[nodiscard]] FrameArena* arena() const
+    {
+        return m_arena;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return m_arena == other.arena();
+    }
+
+private:
+    FrameArena* m_arena;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+inline ArenaString make_arena_string(FrameArena& arena, std::string_view value = {})
+{
+    return ArenaString{value, ArenaAllocator<char>{arena}};
+}
+
+template <typename T>
+ArenaVector<T> make_arena_vector(FrameArena& arena, size_t reserve = 0)
+{
+    ArenaVector<T> vec{ArenaAllocator<T>{arena}};
+    vec.reserve(reserve);
+    return vec;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <common/utils/stack-sampling.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Platform independent part of the hitch detector. The main thread beats once per frame and marks the phases of each
+// frame without taking locks. A monitor thread polls the detector, adds stacks of the main thread captured while the
+// stall lasts and formats a report when the stalled frame finally ends.
+// Times are microseconds of any monotonic clock. 0 is reserved for "no frame yet".
+
+class HitchDetector
+{
+public:
+    static constexpr int max_samples = 8;
+    static constexpr int phase_ring_size = 64;
+    static constexpr int max_report_phases = 24;
+
+    enum class PollResult
+    {
+        idle,
+        stall_started,
+        stalled,
+        stall_ended,
+    };
+
+    explicit HitchDetector(uint64_t threshold_us = 0) : m_threshold_us(threshold_us)
+    {}
+
+    // 0 disables detection
+    void set_threshold_us(uint64_t threshold_us)
+    {
+        m_threshold_us.store(threshold_us, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t threshold_us() const
+    {
+        return m_threshold_us.load(std::memory_order_relaxed);
+    }
+
+    // Main thread only
+    void beat(uint64_t now_us);
+
+    // Main thread only. Name must point to a string literal. The phase lasts until the next mark or beat.
+    void mark_phase(const char* name, uint64_t now_us);
+
+    // Monitor thread only
+    PollResult poll(uint64_t now_us);
+
+    // Monitor thread only. Forgets the stall in progress, e.g. when monitoring resumes after a pause.
+    void cancel_stall()
+    {
+        m_stall_begin_us = 0;
+        m_num_samples = 0;
+    }
+
+    // Monitor thread only, while stalled. Returns false if no more samples fit.
+    bool add_sample(const uintptr_t* frames, int depth);
+
+    [[nodiscard]] int num_samples() const
+    {
+        return m_num_samples;
+    }
+
+    // Duration of the last stalled frame (valid after stall_ended)
+    [[nodiscard]] uint64_t stall_us() const
+    {
+        return m_stall_us;
+    }
+
+    // Describes the last stalled frame (valid after stall_ended)
+    [[nodiscard]] std::vector<std::string> format_report(const StackSymbolizer& symbolizer, int max_frames = 8) const;
+
+private:
+    struct PhaseMark
+    {
+        // nullptr marks a frame boundary
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> time_us{0};
+    };
+
+    struct Phase
+    {
+        const char* name;
+        uint64_t begin_us;
+        uint64_t end_us;
+    };
+
+    struct Sample
+    {
+        int depth;
+        uintptr_t frames[max_sampled_stack_depth];
+    };
+
+    void push_mark(const char* name, uint64_t now_us);
+    void snapshot_phases(uint64_t end_us);
+
+    std::atomic<uint64_t> m_threshold_us;
+
+    // Written by the main thread
+    std::atomic<uint64_t> m_heartbeat_us{0};
+    std::atomic<uint32_t> m_num_marks{0};
+    std::array<PhaseMark, phase_ring_size> m_marks;
+
+    // Used by the monitor thread only
+    uint64_t m_stall_begin_us = 0;
+    uint64_t m_stall_us = 0;
+    int m_num_samples = 0;
+    std::array<Sample, max_samples> m_samples{};
+    int m_num_phases = 0;
+    std::array<Phase, max_report_phases> m_phases{};
+};
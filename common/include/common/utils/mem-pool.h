@@ -1,12 +1,52 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace detail
+{
+    // alloc() without arguments default-initializes, so trivial types are not zeroed on every allocation
+    template <typename T, typename... Args>
+    T* mem_pool_construct(void* storage, Args&&... args)
+    {
+        if constexpr (sizeof...(Args) == 0) {
+            return ::new (storage) T;
+        }
+        else {
+            return ::new (storage) T(std::forward<Args>(args)...);
+        }
+    }
+}
+
+struct MemPoolStats
+{
+    // Number of slots in allocated pages
+    size_t capacity = 0;
+    size_t in_use = 0;
+    // Highest in_use value seen since construction
+    size_t high_water = 0;
+    uint64_t total_allocs = 0;
+};
 
+// Fixed size object pool for a single thread. Free slots are linked through their own storage so tracking them needs
+// no extra memory. Pages of N slots are added on demand and kept until the pool is destroyed.
+// Pointers must come from alloc() of the same pool. Ownership is not checked, a foreign pointer corrupts the free list.
 template <typename T, size_t N>
 class MemPool
 {
-    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    union Slot
+    {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
 
     class Delete
     {
@@ -21,8 +61,11 @@ class MemPool
         }
     };
 
-    std::vector<Slot*> free_slots;
+    Slot* free_head = nullptr;
     std::vector<std::unique_ptr<Slot[]>> pages;
+    size_t in_use = 0;
+    size_t high_water = 0;
+    uint64_t total_allocs = 0;
 
 public:
     using Pointer = std::unique_ptr<T, Delete>;
@@ -31,9 +74,15 @@ public:
     MemPool(const MemPool&) = delete;
     MemPool& operator=(const MemPool&) = delete;
 
-    Pointer alloc()
+    template <typename... Args>
+    Pointer alloc(Args&&... args)
+    {
+        return {acquire(std::forward<Args>(args)...), {this}};
+    }
+
+    [[nodiscard]] MemPoolStats stats() const
     {
-        return {acquire(), {this}};
+        return {pages.size() * N, in_use, high_water, total_allocs};
     }
 
 private:
@@ -41,26 +90,199 @@ private:
     {
         pages.push_back(std::make_unique<Slot[]>(N));
         auto& page = pages.back();
-        free_slots.reserve(free_slots.size() + N);
-        for (std::size_t i = 0; i < N; ++i) {
-            Slot& slot = page[i];
-            free_slots.push_back(&slot);
+        // Link in reverse so slots are handed out in address order
+        for (size_t i = N; i-- > 0;) {
+            page[i].next = free_head;
+            free_head = &page[i];
         }
     }
 
-    T* acquire()
+    template <typename... Args>
+    T* acquire(Args&&... args)
     {
-        if (free_slots.empty()) {
+        if (!free_head) {
             alloc_page();
         }
-        Slot* p = free_slots.back();
-        free_slots.pop_back();
-        return ::new (p) T;
+        Slot* slot = free_head;
+        free_head = slot->next;
+        T* p = detail::mem_pool_construct<T>(slot->storage, std::forward<Args>(args)...);
+        ++total_allocs;
+        high_water = std::max(high_water, ++in_use);
+        return p;
+    }
+
+    void release(T* p)
+    {
+        p->~T();
+        auto* slot = std::launder(reinterpret_cast<Slot*>(p));
+        slot->next = free_head;
+        free_head = slot;
+        --in_use;
+    }
+};
+
+// Fixed size object pool that any thread can allocate from and free to, including frees of objects allocated by other
+// threads. The free list is a lock-free Treiber stack of slot indices tagged with a version counter against ABA,
+// packed into a 64-bit word. Only adding a page takes a lock. At most MaxPages pages of N slots are allocated, after
+// that alloc() returns an empty pointer.
+template <typename T, size_t N, size_t MaxPages = 64>
+class ConcurrentMemPool
+{
+    static_assert(N * MaxPages < UINT32_MAX, "slot indices must fit in 32 bits");
+
+    union Slot
+    {
+        // Index + 1 of the next free slot, 0 ends the list
+        std::atomic<uint32_t> next;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        Slot() : next(0) {}
+    };
+
+    class Delete
+    {
+        ConcurrentMemPool* pool;
+
+    public:
+        Delete(ConcurrentMemPool* pool) : pool(pool) {}
+
+        void operator()(T* ptr) const
+        {
+            pool->release(ptr);
+        }
+    };
+
+    // Low half is the index + 1 of the first free slot, high half is the version tag
+    std::atomic<uint64_t> free_head{0};
+    std::array<std::atomic<Slot*>, MaxPages> pages{};
+    std::atomic<uint32_t> num_pages{0};
+    std::mutex grow_mutex;
+    std::atomic<size_t> in_use{0};
+    std::atomic<size_t> high_water{0};
+    std::atomic<uint64_t> total_allocs{0};
+
+public:
+    using Pointer = std::unique_ptr<T, Delete>;
+
+    ConcurrentMemPool() = default;
+    ConcurrentMemPool(const ConcurrentMemPool&) = delete;
+    ConcurrentMemPool& operator=(const ConcurrentMemPool&) = delete;
+
+    ~ConcurrentMemPool()
+    {
+        for (auto& page : pages) {
+            delete[] page.load(std::memory_order_relaxed);
+        }
+    }
+
+    template <typename... Args>
+    Pointer alloc(Args&&... args)
+    {
+        Slot* slot = pop();
+        if (!slot) {
+            return {nullptr, {this}};
+        }
+        T* p = detail::mem_pool_construct<T>(slot->storage, std::forward<Args>(args)...);
+        total_allocs.fetch_add(1, std::memory_order_relaxed);
+        size_t count = in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = high_water.load(std::memory_order_relaxed);
+        while (count > peak && !high_water.compare_exchange_weak(peak, count, std::memory_order_relaxed)) {
+        }
+        return {p, {this}};
+    }
+
+    [[nodiscard]] MemPoolStats stats() const
+    {
+        return {
+            num_pages.load(std::memory_order_relaxed) * N,
+            in_use.load(std::memory_order_relaxed),
+            high_water.load(std::memory_order_relaxed),
+            total_allocs.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    Slot& slot_at(uint32_t index) const
+    {
+        assert(index / N < num_pages.load(std::memory_order_relaxed));
+        return pages[index / N].load(std::memory_order_acquire)[index % N];
+    }
+
+    uint32_t index_of(const Slot* slot) const
+    {
+        uint32_t count = num_pages.load(std::memory_order_acquire);
+        for (uint32_t page_index = 0; page_index < count; ++page_index) {
+            const Slot* page = pages[page_index].load(std::memory_order_relaxed);
+            if (slot >= page && slot < page + N) {
+                return static_cast<uint32_t>(page_index * N + (slot - page));
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    // Links slots [first, last] (already chained together) in front of the free list
+    void push_chain(uint32_t first, uint32_t last)
+    {
+        uint64_t head = free_head.load(std::memory_order_relaxed);
+        uint64_t new_head;
+        do {
+            slot_at(last).next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            new_head = ((head >> 32) + 1) << 32 | (first + 1);
+        } while (!free_head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Slot* pop()
+    {
+        while (true) {
+            uint64_t head = free_head.load(std::memory_order_acquire);
+            while (static_cast<uint32_t>(head)) {
+                Slot& slot = slot_at(static_cast<uint32_t>(head) - 1);
+                // The slot may be taken and reused concurrently, then the tag check makes the exchange fail
+                uint32_t next = slot.next.load(std::memory_order_relaxed);
+                uint64_t new_head = ((head >> 32) + 1) << 32 | next;
+                if (free_head.compare_exchange_weak(head, new_head, std::memory_order_acquire)) {
+                    return &slot;
+                }
+            }
+            if (!grow()) {
+                return nullptr;
+            }
+        }
+    }
+
+    bool grow()
+    {
+        std::lock_guard lock{grow_mutex};
+        // Another thread may have added a page while this one waited for the lock
+        if (static_cast<uint32_t>(free_head.load(std::memory_order_acquire))) {
+            return true;
+        }
+        uint32_t page_index = num_pages.load(std::memory_order_relaxed);
+        if (page_index == MaxPages) {
+            return false;
+        }
+        auto* page = new Slot[N];
+        auto first = static_cast<uint32_t>(page_index * N);
+        for (uint32_t i = 0; i + 1 < N; ++i) {
+            page[i].next.store(first + i + 2, std::memory_order_relaxed);
+        }
+        pages[page_index].store(page, std::memory_order_release);
+        num_pages.store(page_index + 1, std::memory_order_release);
+        push_chain(first, static_cast<uint32_t>(first + N - 1));
+        return true;
     }
 
     void release(T* p)
     {
+        // Finding the slot index checks ownership anyway, so a foreign pointer is left alone in release builds too
+        uint32_t index = index_of(std::launder(reinterpret_cast<Slot*>(p)));
+        assert(index != UINT32_MAX);
+        if (index == UINT32_MAX) {
+            return;
+        }
         p->~T();
-        free_slots.push_back(std::launder(reinterpret_cast<Slot*>(p)));
+        ::new (&slot_at(index).next) std::atomic<uint32_t>{0};
+        push_chain(index, index);
+        in_use.fetch_sub(1, std::memory_order_relaxed);
     }
 };
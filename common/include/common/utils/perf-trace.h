@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Records profiler zones and frames as Chrome trace events (viewable in Perfetto or chrome://tracing).
+// Every thread writes into its own lock-free ring buffer taken from a pool allocated on the first start, so recording
+// never allocates. A background thread drains the rings and writes JSON to the output file.
+
+struct PerfTraceResult
+{
+    uint64_t events_written = 0;
+    uint64_t events_dropped = 0;
+};
+
+bool perf_trace_start(const std::string& path);
+
+// Returns false if no trace was running
+bool perf_trace_stop(PerfTraceResult* result = nullptr);
+
+[[nodiscard]] bool perf_trace_is_active();
+
+// Name must point to a string literal (it is written out later by another thread)
+void perf_trace_record(const char* name, uint64_t begin_tsc, uint64_t end_tsc);
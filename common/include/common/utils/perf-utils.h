@@ -1,68 +1,117 @@
 #pragma once
 
-#include <memory>
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
-struct PerfAggregator
-{
-    std::string name_;
-    unsigned num_calls_ = 0;
-    unsigned total_duration_us_ = 0;
-    static std::vector<std::unique_ptr<PerfAggregator>> instances_;
+// Scoped zone profiler. Instrumenting a block takes one line:
+//
+//     PERF_ZONE("render_hud");
+//
+// Time is measured with the TSC and calibrated against QPC when a report is made. Every thread records into its own
+// counters without locks. perf_end_frame() folds them into per-frame and total statistics.
 
-    PerfAggregator(std::string&& name) : name_(name)
-    {}
+enum class PerfZoneCategory
+{
+    generic,
+    hook,
+};
 
+class PerfZone
+{
 public:
-    static PerfAggregator& create(std::string&& name)
-    {
-        instances_.push_back(std::make_unique<PerfAggregator>(std::move(name)));
-        return *instances_.back().get();
-    }
+    static constexpr int max_zones = 128;
 
-    [[nodiscard]] static const std::vector<std::unique_ptr<PerfAggregator>>& get_instances()
-    {
-        return instances_;
-    }
+    explicit PerfZone(const char* name, PerfZoneCategory category = PerfZoneCategory::generic);
 
-    void add_call(unsigned duration)
+    [[nodiscard]] int id() const
     {
-        num_calls_++;
-        total_duration_us_ += duration;
+        return m_id;
     }
 
-    [[nodiscard]] const std::string& get_name() const
+    [[nodiscard]] const char* name() const
     {
-        return name_;
+        return m_name;
     }
 
-    [[nodiscard]] unsigned get_calls() const
-    {
-        return num_calls_;
-    }
+private:
+    int m_id;
+    const char* m_name;
+};
 
-    [[nodiscard]] unsigned get_total_duration_us() const
-    {
-        return total_duration_us_;
-    }
+void perf_record(const PerfZone& zone, uint64_t begin_tsc, uint64_t end_tsc);
 
-    [[nodiscard]] unsigned get_avg_duration_us() const
+class ScopedPerfZone
+{
+public:
+    explicit ScopedPerfZone(const PerfZone& zone) :
+        m_zone(zone), m_start(__rdtsc())
+    {}
+
+    ScopedPerfZone(const ScopedPerfZone& other) = delete;
+    ScopedPerfZone& operator=(const ScopedPerfZone& other) = delete;
+
+    ~ScopedPerfZone()
     {
-        return total_duration_us_ / num_calls_;
+        perf_record(m_zone, m_start, __rdtsc());
     }
+
+private:
+    const PerfZone& m_zone;
+    uint64_t m_start;
 };
 
-class ScopedPerfMonitor
+#define PERF_ZONE_CONCAT_INNER(a, b) a##b
+#define PERF_ZONE_CONCAT(a, b) PERF_ZONE_CONCAT_INNER(a, b)
+#define PERF_ZONE(name) \
+    static const PerfZone PERF_ZONE_CONCAT(perf_zone_, __LINE__){name}; \
+    const ScopedPerfZone PERF_ZONE_CONCAT(perf_zone_scope_, __LINE__){PERF_ZONE_CONCAT(perf_zone_, __LINE__)}
+
+// Bucket i counts calls that took [perf_histogram_bucket_min(i), perf_histogram_bucket_min(i + 1)) cycles
+constexpr int perf_histogram_buckets = 24;
+constexpr int perf_histogram_first_bucket_bits = 7;
+
+constexpr uint64_t perf_histogram_bucket_min(int bucket)
 {
-    PerfAggregator& agg_;
-    unsigned start_ = rf::timer_get(1000000);
+    return bucket == 0 ? 0 : uint64_t{1} << (bucket + perf_histogram_first_bucket_bits - 1);
+}
 
-public:
-    ScopedPerfMonitor(PerfAggregator& agg) : agg_(agg) {}
+struct PerfZoneStats
+{
+    const char* name;
+    PerfZoneCategory category;
+    uint64_t calls = 0;
+    uint64_t cycles = 0;
+    // Both are 0 if there were no calls
+    uint64_t min_cycles = 0;
+    uint64_t max_cycles = 0;
+    std::array<uint64_t, perf_histogram_buckets> histogram{};
+};
 
-    ~ScopedPerfMonitor()
-    {
-        agg_.add_call(rf::timer_get(1000000) - start_);
-    }
+struct PerfReport
+{
+    uint64_t frames = 0;
+    uint64_t frame_cycles = 0;
+    // 0 if not calibrated yet
+    double cycles_per_us = 0.0;
+    std::vector<PerfZoneStats> zones;
 };
+
+// Ends the current frame. Call it once per frame from the thread that presents frames.
+void perf_end_frame();
+
+// Returns statistics accumulated since the last reset
+PerfReport perf_get_report();
+
+// Returns statistics of the last completed frame
+PerfReport perf_get_last_frame_report();
+
+void perf_reset();
+
+bool perf_write_csv(const PerfReport& report, const std::string& path);
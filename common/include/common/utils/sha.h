@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// SHA-1 and SHA-256. Blocks are processed with the x86 SHA extensions when the CPU has them (checked once at
+// runtime) and with portable code otherwise, the results are the same.
+
+enum class ShaAlgorithm
+{
+    sha1,
+    sha256,
+};
+
+class ShaHasher
+{
+public:
+    explicit ShaHasher(ShaAlgorithm algorithm, bool allow_cpu_extensions = true);
+
+    void update(const void* data, size_t size);
+
+    // Pads the message and returns the digest (20 bytes for SHA-1, 32 for SHA-256). Call reset() before reusing the
+    // hasher.
+    [[nodiscard]] std::vector<uint8_t> finish();
+
+    void reset();
+
+    [[nodiscard]] size_t digest_size() const
+    {
+        return m_algorithm == ShaAlgorithm::sha1 ? 20 : 32;
+    }
+
+    [[nodiscard]] bool uses_cpu_extensions() const
+    {
+        return m_uses_cpu_extensions;
+    }
+
+private:
+    using ProcessBlocksFn = void (*)(uint32_t* state, const uint8_t* data, size_t num_blocks);
+
+    static constexpr size_t block_size = 64;
+
+    ShaAlgorithm m_algorithm;
+    bool m_uses_cpu_extensions;
+    ProcessBlocksFn m_process_blocks;
+    uint32_t m_state[8] = {};
+    uint8_t m_block[block_size] = {};
+    size_t m_block_used = 0;
+    uint64_t m_total_size = 0;
+};
+
+// True if the CPU supports the SHA extensions (and the SSSE3/SSE4.1 instructions used around them)
+bool sha_cpu_extensions_supported();
+
+std::string sha_digest_to_hex(const std::vector<uint8_t>& digest);
+
+// Hashes a file by mapping it into memory a window at a time, so big files do not need a large block of address
+// space. Returns the digest as lowercase hex or nullopt if the file cannot be opened or mapped.
+std::optional<std::string> sha_hash_file_hex(const std::string& path, ShaAlgorithm algorithm);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// General purpose allocator for small blocks. Sizes up to max_small_size are rounded up to one of num_classes size
+// classes. Every 64 KiB span of memory taken from the OS holds blocks of a single class and a byte map indexed by
+// span address tells the class of any pointer, so blocks carry no headers and foreign pointers are recognized. The
+// end of every span holds a table with the size requested for each of its blocks (16 bits per block).
+// Each thread allocates from and frees to its own cache of free blocks. Full or empty caches exchange batches with a
+// per-class central free list that is protected by a lock. Larger sizes are left to the caller (allocate() returns
+// nullptr), which is expected to forward them to the OS heap.
+// Memory of spans is never returned to the OS while the allocator lives. Blocks cached by threads that exit are not
+// reclaimed, but a cache is reused by a later thread that gets the same thread id.
+
+struct SizeClassStats
+{
+    size_t block_size = 0;
+    // Both wrap around on 32-bit platforms in long sessions but their difference (live blocks) stays exact
+    size_t allocs = 0;
+    size_t frees = 0;
+    size_t spans = 0;
+};
+
+class SizeClassAllocator
+{
+public:
+    static constexpr size_t max_small_size = 8192;
+    static constexpr int num_classes = 32;
+    static constexpr size_t span_size = 64 * 1024;
+
+    struct Stats
+    {
+        std::array<SizeClassStats, num_classes> classes;
+        // Memory taken from the OS for spans
+        size_t span_bytes = 0;
+        size_t num_thread_caches = 0;
+    };
+
+    SizeClassAllocator();
+    // Returns all memory to the OS. Blocks that were not freed become invalid.
+    ~SizeClassAllocator();
+
+    SizeClassAllocator(const SizeClassAllocator&) = delete;
+    SizeClassAllocator& operator=(const SizeClassAllocator&) = delete;
+
+    // Returns nullptr for sizes above max_small_size or if the OS is out of memory
+    void* allocate(size_t size);
+
+    // Ptr must be owned by this allocator
+    void deallocate(void* ptr);
+
+    [[nodiscard]] bool owns(const void* ptr) const;
+
+    // Ptr must be owned by this allocator
+    [[nodiscard]] size_t usable_size(const void* ptr) const;
+
+    // Size passed to allocate() or resize_in_place() for the block. Ptr must be owned by this allocator.
+    [[nodiscard]] size_t requested_size(const void* ptr) const;
+
+    // Returns false if the block's size class does not match size. Ptr must be owned by this allocator.
+    bool resize_in_place(void* ptr, size_t size);
+
+    [[nodiscard]] Stats stats() const;
+
+    // Returns -1 for sizes above max_small_size
+    static int size_class_of(size_t size);
+    static size_t class_size(int size_class);
+    static size_t blocks_per_span(int size_class);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct ThreadCache;
+
+    struct CentralList
+    {
+        mutable std::mutex mutex;
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+        size_t spans = 0;
+    };
+
+    ThreadCache* get_thread_cache();
+    ThreadCache* create_thread_cache();
+    void refill(ThreadCache& cache, int size_class);
+    void flush(ThreadCache& cache, int size_class, uint32_t keep);
+    bool add_span(CentralList& central, int size_class);
+    [[nodiscard]] int class_of_ptr(const void* ptr) const;
+    static uint16_t* requested_size_slot(const void* ptr, int size_class);
+    std::atomic<uint8_t>* get_span_map_page(uint64_t span_index, bool create);
+
+    std::array<CentralList, num_classes> m_central;
+    // Singly linked through ThreadCache::next, only ever prepended to
+    std::atomic<ThreadCache*> m_thread_caches{nullptr};
+    // Two level map from span index (address / span_size) to size class + 1, 0 for memory not owned
+    std::atomic<std::atomic<uint8_t>*>* m_span_map = nullptr;
+    // Protects creation of span map pages and metadata allocations
+    std::mutex m_meta_mutex;
+    uint8_t* m_meta_span = nullptr;
+    size_t m_meta_offset = 0;
+    std::atomic<size_t> m_span_bytes{0};
+    unsigned m_instance_id;
+
+    static thread_local ThreadCache* t_cache;
+    static thread_local unsigned t_cache_instance_id;
+};
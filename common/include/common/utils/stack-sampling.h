@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Platform independent part of the sampling profiler: frame pointer walking, sample aggregation, symbolization and
+// folded stack output (input format of flamegraph.pl and speedscope).
+
+constexpr int max_sampled_stack_depth = 32;
+
+// Walks a chain of [saved ebp, return address] records starting at frame_ptr. out[0] is set to pc. Frames must lie in
+// [stack_low, stack_high) and go up the stack, otherwise the walk stops. Returns the number of stored addresses.
+int walk_frame_pointer_chain(
+    uintptr_t pc, uintptr_t frame_ptr, uintptr_t stack_low, uintptr_t stack_high, uintptr_t* out, int max_depth);
+
+// Fallback for code built without frame pointers: collects words of the stack range [stack_ptr, stack_high) that point
+// into [code_begin, code_end) right after a call instruction, scanning at most max_scan_words words. Stale return
+// addresses left behind by earlier calls can show up as well. Returns the number of stored addresses.
+int scan_stack_for_return_addresses(
+    uintptr_t stack_ptr,
+    uintptr_t stack_high,
+    uintptr_t code_begin,
+    uintptr_t code_end,
+    uintptr_t* out,
+    int max_depth,
+    size_t max_scan_words = 256);
+
+// Hash table of unique stacks and their sample counts. It has a fixed capacity and never allocates after construction.
+// One thread adds samples while any number of threads can read the table concurrently.
+class StackSampleTable
+{
+public:
+    explicit StackSampleTable(size_t capacity = 4096);
+
+    // Returns false if the table is full
+    bool add(const uintptr_t* frames, int depth);
+
+    template<typename F>
+    void for_each(F&& callback) const
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            const auto& entry = m_entries[i];
+            if (entry.hash.load(std::memory_order_acquire) != 0) {
+                callback(entry.frames, static_cast<int>(entry.depth), entry.count.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    [[nodiscard]] uint64_t num_samples() const
+    {
+        return m_num_samples.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t num_dropped() const
+    {
+        return m_num_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry
+    {
+        // 0 marks an empty slot. It is stored last so readers never see a partially written stack.
+        std::atomic<uint32_t> hash{0};
+        std::atomic<uint32_t> count{0};
+        uint32_t depth = 0;
+        uintptr_t frames[max_sampled_stack_depth] = {};
+    };
+
+    size_t m_capacity;
+    std::unique_ptr<Entry[]> m_entries;
+    std::atomic<uint64_t> m_num_samples{0};
+    std::atomic<uint64_t> m_num_dropped{0};
+};
+
+struct ModuleInfo
+{
+    std::string name;
+    uintptr_t base;
+    size_t size;
+};
+
+// Function names of a single module indexed by RVA
+class SymbolMap
+{
+public:
+    // Reads lines in "<rva> <name> [<size>]" format (hex numbers, with or without 0x). Empty lines and lines starting
+    // with # are skipped. Returns the number of loaded symbols.
+    size_t load(std::istream& stream);
+
+    // Size 0 means unknown
+    void add(uint32_t rva, std::string name, uint32_t size = 0);
+
+    // Symbols without a size end at the next symbol or at the end of the section containing them
+    void add_section(uint32_t rva, uint32_t size);
+
+    // Returns the name of the function containing rva or nullptr. Without a size the closest symbol at or below rva is
+    // taken, as long as both lie in the same section. If no sections were added nothing bounds such a symbol.
+    [[nodiscard]] const std::string* find(uint32_t rva) const;
+
+    [[nodiscard]] bool empty() const
+    {
+        return m_symbols.empty();
+    }
+
+private:
+    struct Symbol
+    {
+        uint32_t rva;
+        uint32_t size;
+        std::string name;
+    };
+
+    struct Section
+    {
+        uint32_t rva;
+        uint32_t size;
+    };
+
+    [[nodiscard]] const Section* find_section(uint32_t rva) const;
+
+    // Sorted by RVA
+    std::vector<Symbol> m_symbols;
+    std::vector<Section> m_sections;
+};
+
+class StackSymbolizer
+{
+public:
+    StackSymbolizer(std::vector<ModuleInfo> modules, std::string symbol_module = {}, SymbolMap symbols = {}) :
+        m_modules(std::move(modules)), m_symbol_module(std::move(symbol_module)), m_symbols(std::move(symbols))
+    {}
+
+    // Returns "name" if a symbol is known, "module+0xrva" for other module addresses and "0xaddr" otherwise
+    [[nodiscard]] std::string describe(uintptr_t addr) const;
+
+private:
+    std::vector<ModuleInfo> m_modules;
+    std::string m_symbol_module;
+    SymbolMap m_symbols;
+};
+
+// Writes one "root;...;leaf count" line per unique symbolized stack, most frequent first
+void write_folded_stacks(const StackSampleTable& table, const StackSymbolizer& symbolizer, std::ostream& out);
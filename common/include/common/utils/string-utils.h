@@ -5,6 +5,8 @@
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <optional>
+#include <charconv>
 #include <cctype>
 
 #ifdef __GNUC__
@@ -125,6 +127,38 @@ inline bool string_icontains(std::string_view str, std::string_view infix)
     return it != str.end();
 }
 
+// Returns arguments of a console command line if it starts with the given command name (case insensitive)
+inline std::optional<std::string_view> string_match_command(std::string_view line, std::string_view name)
+{
+    line = trim(line);
+    if (!string_istarts_with(line, name))
+        return std::nullopt;
+    const std::string_view rest = line.substr(name.size());
+    if (!rest.empty() && !std::isspace(static_cast<unsigned char>(rest.front())))
+        return std::nullopt;
+    return trim(rest);
+}
+
+// Parses the whole string as a decimal integer
+inline std::optional<long> string_to_long(std::string_view str)
+{
+    long value = 0;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{} || ptr != str.data() + str.size())
+        return std::nullopt;
+    return value;
+}
+
+// Parses the whole string as a decimal floating point number
+inline std::optional<float> string_to_float(std::string_view str)
+{
+    float value = 0.0f;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{} || ptr != str.data() + str.size())
+        return std::nullopt;
+    return value;
+}
+
 inline std::string string_replace(const std::string_view& str, const std::string_view& search, const std::string_view& replacement)
 {
     std::size_t pos = 0;
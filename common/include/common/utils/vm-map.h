@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Virtual address space analysis. Regions come from VirtualQuery on Windows and /proc/self/maps elsewhere, the
+// summary and its formatting do not depend on the platform.
+
+enum class VmRegionState
+{
+    free,
+    reserved,
+    committed,
+};
+
+enum class VmRegionType
+{
+    none,
+    image,
+    mapped,
+    priv,
+};
+
+struct VmRegion
+{
+    uintptr_t base = 0;
+    size_t size = 0;
+    VmRegionState state = VmRegionState::free;
+    VmRegionType type = VmRegionType::none;
+};
+
+constexpr int vm_num_largest_free_blocks = 4;
+
+struct VmSummary
+{
+    size_t num_regions = 0;
+    size_t num_free_regions = 0;
+    size_t total_free = 0;
+    // Sorted from the largest
+    size_t largest_free[vm_num_largest_free_blocks] = {};
+    size_t reserved = 0;
+    size_t committed = 0;
+    // Committed private memory, which is what counts towards the commit charge
+    size_t committed_private = 0;
+    size_t image = 0;
+    size_t mapped = 0;
+    // Free blocks big enough for a 64 KiB allocation, smaller gaps cannot be used by VirtualAlloc
+    size_t num_usable_free_blocks = 0;
+};
+
+// Fills out_regions with all regions of the current process address space in ascending order, free ranges included.
+// Returns false on failure.
+bool query_vm_regions(std::vector<VmRegion>& out_regions);
+
+// Parses /proc/<pid>/maps lines. Gaps between mappings (and below the first one, starting at min_address) are added as
+// free regions. Returns false if a line cannot be parsed.
+bool parse_proc_maps(std::istream& stream, std::vector<VmRegion>& out_regions, uintptr_t min_address = 0x10000);
+
+VmSummary summarize_vm_regions(const std::vector<VmRegion>& regions);
+
+// Multi-line human readable summary
+std::vector<std::string> format_vm_summary(const VmSummary& summary);
@@ -0,0 +1,210 @@
+#include <common/utils/alloc-profiler.h>
+#include <common/utils/stack-sampling.h>
+#include <algorithm>
+#include <cstdio>
+
+bool AllocCallsite::operator==(const AllocCallsite& other) const
+{
+    return std::equal(std::begin(frames), std::end(frames), std::begin(other.frames));
+}
+
+size_t AllocProfile::CallsiteHash::operator()(const AllocCallsite& callsite) const
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (uintptr_t frame : callsite.frames) {
+        hash = (hash ^ static_cast<uint32_t>(frame)) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t round_up_to_pow2(size_t value)
+{
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AllocEventBuffer::AllocEventBuffer(size_t capacity) :
+    m_mask(round_up_to_pow2(capacity) - 1), m_cells(std::make_unique<Cell[]>(m_mask + 1))
+{
+    for (size_t i = 0; i <= m_mask; ++i) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool AllocEventBuffer::push(const AllocEvent& event)
+{
+    // A cell is free for position pos when its sequence equals pos and holds an event when it equals pos + 1
+    size_t pos = m_write_pos.load(std::memory_order_relaxed);
+    while (true) {
+        auto& cell = m_cells[pos & m_mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<ptrdiff_t>(sequence - pos);
+        if (diff == 0) {
+            if (m_write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.event = event;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            pos = m_write_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+int AllocProfile::lifetime_bucket(uint32_t frames)
+{
+    int bucket = 0;
+    while (frames && bucket < num_alloc_lifetime_buckets - 1) {
+        frames >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void AllocProfile::reset(uint32_t frame)
+{
+    m_callsites.clear();
+    m_callsite_indices.clear();
+    m_live_blocks.clear();
+    m_start_frame = frame;
+    m_num_untracked_frees = 0;
+}
+
+void AllocProfile::add(const AllocEvent& event)
+{
+    if (event.type == AllocEventType::alloc) {
+        auto [it, inserted] = m_callsite_indices.try_emplace(event.callsite, static_cast<uint32_t>(m_callsites.size()));
+        if (inserted) {
+            m_callsites.emplace_back().callsite = event.callsite;
+        }
+        auto& stats = m_callsites[it->second];
+        ++stats.allocs;
+        stats.bytes += event.size;
+        ++stats.live_blocks;
+        stats.live_bytes += event.size;
+        LiveBlock block{it->second, event.size, event.frame};
+        auto [block_it, new_block] = m_live_blocks.try_emplace(event.ptr, block);
+        if (!new_block) {
+            // The free of the previous block at this address was dropped, so that block is not live anymore
+            auto& old_block = block_it->second;
+            auto& old_stats = m_callsites[old_block.callsite_index];
+            --old_stats.live_blocks;
+            old_stats.live_bytes -= old_block.size;
+            ++m_num_untracked_frees;
+            old_block = block;
+        }
+        return;
+    }
+
+    auto it = m_live_blocks.find(event.ptr);
+    if (it == m_live_blocks.end()) {
+        ++m_num_untracked_frees;
+        return;
+    }
+    const auto& block = it->second;
+    auto& stats = m_callsites[block.callsite_index];
+    ++stats.frees;
+    --stats.live_blocks;
+    stats.live_bytes -= block.size;
+    ++stats.lifetimes[lifetime_bucket(event.frame - block.frame)];
+    m_live_blocks.erase(it);
+}
+
+std::vector<AllocCallsiteStats> AllocProfile::top(size_t n, AllocSortKey key) const
+{
+    auto value_of = [key](const AllocCallsiteStats& stats) {
+        switch (key) {
+        case AllocSortKey::bytes:
+            return stats.bytes;
+        case AllocSortKey::live:
+            return stats.live_bytes;
+        case AllocSortKey::count:
+        default:
+            return stats.allocs;
+        }
+    };
+    std::vector<AllocCallsiteStats> result = m_callsites;
+    n = std::min(n, result.size());
+    std::partial_sort(result.begin(), result.begin() + n, result.end(), [&](const auto& a, const auto& b) {
+        return value_of(a) > value_of(b);
+    });
+    result.resize(n);
+    return result;
+}
+
+std::vector<std::string> AllocProfile::format_report(
+    const StackSymbolizer& symbolizer, size_t n, AllocSortKey key, uint32_t current_frame) const
+{
+    std::vector<std::string> lines;
+    uint64_t total_allocs = 0;
+    uint64_t total_bytes = 0;
+    uint64_t total_live_bytes = 0;
+    for (const auto& stats : m_callsites) {
+        total_allocs += stats.allocs;
+        total_bytes += stats.bytes;
+        total_live_bytes += stats.live_bytes;
+    }
+    double num_frames = std::max<uint32_t>(current_frame - m_start_frame, 1);
+
+    char buf[256];
+    std::snprintf(
+        buf,
+        sizeof(buf),
+        "%u frames, %.1f allocs/frame, %.1f KiB/frame, %u live blocks (%.2f MiB), %u callsites, %u untracked frees",
+        static_cast<unsigned>(num_frames),
+        total_allocs / num_frames,
+        total_bytes / num_frames / 1024.0,
+        static_cast<unsigned>(m_live_blocks.size()),
+        total_live_bytes / (1024.0 * 1024.0),
+        static_cast<unsigned>(m_callsites.size()),
+        static_cast<unsigned>(m_num_untracked_frees));
+    lines.emplace_back(buf);
+
+    for (const auto& stats : top(n, key)) {
+        std::snprintf(
+            buf,
+            sizeof(buf),
+            "%8.1f/f %8.1f KiB/f  live %6u (%8.1f KiB)  life:",
+            stats.allocs / num_frames,
+            stats.bytes / num_frames / 1024.0,
+            static_cast<unsigned>(stats.live_blocks),
+            stats.live_bytes / 1024.0);
+        std::string line = buf;
+        // Share of freed blocks per lifetime bucket, labelled with the bucket's lower bound in frames
+        for (int i = 0; i < num_alloc_lifetime_buckets; ++i) {
+            if (!stats.lifetimes[i]) {
+                continue;
+            }
+            unsigned lower_bound = i ? 1u << (i - 1) : 0;
+            std::snprintf(
+                buf,
+                sizeof(buf),
+                " %u%s %.0f%%",
+                lower_bound,
+                i == num_alloc_lifetime_buckets - 1 ? "+" : "",
+                100.0 * stats.lifetimes[i] / stats.frees);
+            line += buf;
+        }
+        if (!stats.frees) {
+            line += " -";
+        }
+        line += "  ";
+        for (int i = 0; i < alloc_callsite_depth && stats.callsite.frames[i]; ++i) {
+            if (i) {
+                line += " <- ";
+            }
+            line += symbolizer.describe(stats.callsite.frames[i]);
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
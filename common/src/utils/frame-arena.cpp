@@ -0,0 +1,53 @@
+#include <common/utils/frame-arena.h>
+#include <algorithm>
+#include <cstdint>
+
+static size_t round_up_to_pow2(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    if (!m_buffer) {
+        m_buffer = std::make_unique<std::byte[]>(m_capacity);
+    }
+    auto base = reinterpret_cast<uintptr_t>(m_buffer.get());
+    uintptr_t begin = (base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    if (begin + size <= base + m_capacity) {
+        m_offset = begin + size - base;
+        return reinterpret_cast<void*>(begin);
+    }
+    // Over-allocate so the block can be aligned
+    m_overflow.push_back(std::make_unique<std::byte[]>(size + alignment));
+    m_overflow_bytes += size + alignment;
+    auto block = reinterpret_cast<uintptr_t>(m_overflow.back().get());
+    return reinterpret_cast<void*>((block + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1));
+}
+
+void FrameArena::deallocate(void* ptr, size_t size)
+{
+    auto addr = reinterpret_cast<uintptr_t>(ptr);
+    auto base = reinterpret_cast<uintptr_t>(m_buffer.get());
+    if (m_buffer && addr + size == base + m_offset) {
+        m_offset = addr - base;
+    }
+}
+
+void FrameArena::reset()
+{
+    size_t used_bytes = used();
+    m_peak = std::max(m_peak, used_bytes);
+    if (!m_overflow.empty()) {
+        // Make room for a frame like this one, with some slack for alignment and growth
+        m_overflow.clear();
+        m_capacity = round_up_to_pow2(used_bytes + used_bytes / 2);
+        m_buffer.reset();
+    }
+    m_offset = 0;
+    m_overflow_bytes = 0;
+}
@@ -0,0 +1,178 @@
+#include <common/utils/hitch-detector.h>
+#include <algorithm>
+#include <cstdio>
+
+void HitchDetector::push_mark(const char* name, uint64_t now_us)
+{
+    // Single writer so the slot is published by bumping the count after it is filled
+    uint32_t index = m_num_marks.load(std::memory_order_relaxed);
+    auto& mark = m_marks[index % phase_ring_size];
+    mark.name.store(name, std::memory_order_relaxed);
+    mark.time_us.store(now_us, std::memory_order_relaxed);
+    m_num_marks.store(index + 1, std::memory_order_release);
+}
+
+void HitchDetector::beat(uint64_t now_us)
+{
+    push_mark(nullptr, now_us);
+    m_heartbeat_us.store(now_us, std::memory_order_release);
+}
+
+void HitchDetector::mark_phase(const char* name, uint64_t now_us)
+{
+    push_mark(name, now_us);
+}
+
+HitchDetector::PollResult HitchDetector::poll(uint64_t now_us)
+{
+    uint64_t heartbeat_us = m_heartbeat_us.load(std::memory_order_acquire);
+    if (m_stall_begin_us) {
+        if (heartbeat_us == m_stall_begin_us) {
+            return PollResult::stalled;
+        }
+        m_stall_us = heartbeat_us - m_stall_begin_us;
+        snapshot_phases(heartbeat_us);
+        m_stall_begin_us = 0;
+        return PollResult::stall_ended;
+    }
+    uint64_t threshold_us = m_threshold_us.load(std::memory_order_relaxed);
+    if (!heartbeat_us || !threshold_us || now_us < heartbeat_us || now_us - heartbeat_us < threshold_us) {
+        return PollResult::idle;
+    }
+    m_stall_begin_us = heartbeat_us;
+    m_num_samples = 0;
+    return PollResult::stall_started;
+}
+
+bool HitchDetector::add_sample(const uintptr_t* frames, int depth)
+{
+    if (m_num_samples >= max_samples) {
+        return false;
+    }
+    auto& sample = m_samples[m_num_samples++];
+    sample.depth = std::clamp(depth, 0, max_sampled_stack_depth);
+    std::copy_n(frames, sample.depth, sample.frames);
+    return true;
+}
+
+void HitchDetector::snapshot_phases(uint64_t end_us)
+{
+    // The main thread keeps running, so walk back from the newest mark and skip everything after the stalled frame.
+    // Stop after the boundary of the frame preceding the stalled one.
+    std::array<Phase, max_report_phases> reversed{};
+    std::array<uint32_t, max_report_phases> indices{};
+    int count = 0;
+    int boundaries = 0;
+    uint64_t next_begin_us = end_us;
+    // The slot of index num_marks - phase_ring_size is the one the main thread fills next, so it is never read
+    uint32_t num_marks = m_num_marks.load(std::memory_order_acquire);
+    uint32_t oldest = num_marks >= phase_ring_size ? num_marks - phase_ring_size + 1 : 0;
+    for (uint32_t index = num_marks; index > oldest && count < max_report_phases && boundaries < 2; --index) {
+        const auto& mark = m_marks[(index - 1) % phase_ring_size];
+        const char* name = mark.name.load(std::memory_order_relaxed);
+        uint64_t time_us = mark.time_us.load(std::memory_order_relaxed);
+        if (time_us >= end_us || time_us > next_begin_us) {
+            continue;
+        }
+        indices[count] = index - 1;
+        reversed[count++] = {name, time_us, next_begin_us};
+        next_begin_us = time_us;
+        if (!name) {
+            ++boundaries;
+        }
+    }
+    // Drop marks that the main thread may have overwritten while they were copied
+    num_marks = m_num_marks.load(std::memory_order_acquire);
+    oldest = num_marks >= phase_ring_size ? num_marks - phase_ring_size + 1 : 0;
+    while (count > 0 && indices[count - 1] < oldest) {
+        --count;
+    }
+    m_num_phases = count;
+    std::reverse_copy(reversed.begin(), reversed.begin() + count, m_phases.begin());
+}
+
+std::vector<std::string> HitchDetector::format_report(const StackSymbolizer& symbolizer, int max_frames) const
+{
+    std::vector<std::string> lines;
+    char buf[256];
+
+    // Longest phase of the stalled frame
+    uint64_t stall_begin_us = m_num_phases ? m_phases[m_num_phases - 1].end_us - m_stall_us : 0;
+    const Phase* longest = nullptr;
+    for (int i = 0; i < m_num_phases; ++i) {
+        const auto& phase = m_phases[i];
+        if (phase.name && phase.begin_us >= stall_begin_us
+            && (!longest || phase.end_us - phase.begin_us > longest->end_us - longest->begin_us)) {
+            longest = &phase;
+        }
+    }
+    int len = std::snprintf(buf, sizeof(buf), "Hitch: frame took %.1f ms (threshold %.1f ms)",
+        static_cast<double>(m_stall_us) / 1000.0, static_cast<double>(threshold_us()) / 1000.0);
+    if (longest && len > 0 && static_cast<size_t>(len) < sizeof(buf)) {
+        std::snprintf(buf + len, sizeof(buf) - len, ", %.1f ms in %s",
+            static_cast<double>(longest->end_us - longest->begin_us) / 1000.0, longest->name);
+    }
+    lines.emplace_back(buf);
+
+    if (m_num_phases > 0) {
+        std::string phases = "Phases (ms):";
+        bool first_in_frame = true;
+        for (int i = 0; i < m_num_phases; ++i) {
+            const auto& phase = m_phases[i];
+            if (!phase.name) {
+                // The oldest boundary opens the previous frame and needs no separator
+                if (i > 0) {
+                    phases += " |";
+                }
+                first_in_frame = true;
+                continue;
+            }
+            std::snprintf(buf, sizeof(buf), "%s %s %.1f", first_in_frame ? "" : ",", phase.name,
+                static_cast<double>(phase.end_us - phase.begin_us) / 1000.0);
+            phases += buf;
+            first_in_frame = false;
+        }
+        lines.push_back(std::move(phases));
+    }
+
+    // Group identical stacks, most frequent first
+    struct UniqueStack
+    {
+        const Sample* sample;
+        int count;
+    };
+    std::vector<UniqueStack> stacks;
+    for (int i = 0; i < m_num_samples; ++i) {
+        const auto& sample = m_samples[i];
+        auto it = std::find_if(stacks.begin(), stacks.end(), [&](const UniqueStack& stack) {
+            return stack.sample->depth == sample.depth
+                && std::equal(sample.frames, sample.frames + sample.depth, stack.sample->frames);
+        });
+        if (it != stacks.end()) {
+            ++it->count;
+        }
+        else {
+            stacks.push_back({&sample, 1});
+        }
+    }
+    std::stable_sort(stacks.begin(), stacks.end(), [](const auto& a, const auto& b) {
+        return a.count > b.count;
+    });
+    for (const auto& stack : stacks) {
+        std::snprintf(buf, sizeof(buf), "Stack %d/%d:", stack.count, m_num_samples);
+        std::string line = buf;
+        int depth = std::min(stack.sample->depth, max_frames);
+        for (int i = 0; i < depth; ++i) {
+            line += i == 0 ? " " : " <- ";
+            line += symbolizer.describe(stack.sample->frames[i]);
+        }
+        if (depth < stack.sample->depth) {
+            line += " <- ...";
+        }
+        lines.push_back(std::move(line));
+    }
+    if (stacks.empty()) {
+        lines.emplace_back("No stack samples");
+    }
+    return lines;
+}
@@ -0,0 +1,259 @@
+#include <common/utils/detach-on-exit-thread.h>
+#include <common/utils/perf-trace.h>
+#include <xlog/xlog.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t ring_capacity = 1 << 14;
+    constexpr int max_rings = 16;
+    constexpr auto drain_interval = std::chrono::milliseconds{10};
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t begin_tsc;
+        uint64_t end_tsc;
+    };
+
+    // Single producer (owning thread), single consumer (writer thread)
+    struct TraceRing
+    {
+        std::atomic<unsigned> session{0};
+        std::atomic<uint32_t> thread_id{0};
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        std::array<TraceEvent, ring_capacity> events;
+    };
+
+    // Allocated on the first start and never freed so a thread that is still recording when the trace stops cannot
+    // touch freed memory
+    std::unique_ptr<TraceRing[]> g_rings;
+    std::atomic<bool> g_active{false};
+    std::atomic<unsigned> g_session{0};
+    std::atomic<uint64_t> g_unclaimed_dropped{0};
+
+    thread_local TraceRing* t_ring = nullptr;
+    thread_local unsigned t_session = 0;
+
+    // Used by perf_trace_start/perf_trace_stop only
+    std::mutex g_control_mutex;
+    DetachOnExitThread g_writer_thread;
+    std::mutex g_writer_mutex;
+    std::condition_variable g_writer_cv;
+    bool g_stop_requested = false;
+
+    // Used by the writer thread only while it is running
+    FILE* g_file = nullptr;
+    bool g_first_event = true;
+    uint64_t g_events_written = 0;
+    uint64_t g_start_tsc = 0;
+    std::chrono::steady_clock::time_point g_start_time;
+    double g_cycles_per_us = 0.0;
+    uint32_t g_pid = 0;
+
+    uint32_t get_current_thread_id()
+    {
+#ifdef _WIN32
+        return GetCurrentThreadId();
+#else
+        return static_cast<uint32_t>(gettid());
+#endif
+    }
+
+    uint32_t get_current_process_id()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    TraceRing* claim_ring(unsigned session)
+    {
+        for (int i = 0; i < max_rings; ++i) {
+            auto& ring = g_rings[i];
+            unsigned ring_session = ring.session.load(std::memory_order_relaxed);
+            if (ring_session != session
+                && ring.session.compare_exchange_strong(ring_session, session, std::memory_order_acq_rel)) {
+                ring.thread_id.store(get_current_thread_id(), std::memory_order_relaxed);
+                return &ring;
+            }
+        }
+        return nullptr;
+    }
+
+    void calibrate()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - g_start_time;
+        if (elapsed.count() <= 0) {
+            return;
+        }
+        auto elapsed_us = std::chrono::duration<double, std::micro>(elapsed).count();
+        g_cycles_per_us = static_cast<double>(__rdtsc() - g_start_tsc) / elapsed_us;
+    }
+
+    void write_event(const TraceEvent& event, uint32_t thread_id)
+    {
+        double ts = static_cast<double>(static_cast<int64_t>(event.begin_tsc - g_start_tsc)) / g_cycles_per_us;
+        double dur = static_cast<double>(event.end_tsc - event.begin_tsc) / g_cycles_per_us;
+        std::fprintf(g_file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+            g_first_event ? "" : ",", event.name, static_cast<unsigned long>(g_pid),
+            static_cast<unsigned long>(thread_id), ts, dur);
+        g_first_event = false;
+        ++g_events_written;
+    }
+
+    void drain_rings(unsigned session)
+    {
+        if (g_cycles_per_us <= 0.0) {
+            // Calibrate once so all events use the same scale
+            calibrate();
+            if (g_cycles_per_us <= 0.0) {
+                return;
+            }
+        }
+        for (int i = 0; i < max_rings; ++i) {
+            auto& ring = g_rings[i];
+            if (ring.session.load(std::memory_order_acquire) != session) {
+                continue;
+            }
+            size_t tail = ring.tail.load(std::memory_order_relaxed);
+            size_t head = ring.head.load(std::memory_order_acquire);
+            uint32_t thread_id = ring.thread_id.load(std::memory_order_relaxed);
+            for (; tail != head; ++tail) {
+                write_event(ring.events[tail % ring_capacity], thread_id);
+            }
+            ring.tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    void writer_thread_proc(unsigned session)
+    {
+        std::unique_lock lock{g_writer_mutex};
+        while (!g_stop_requested) {
+            g_writer_cv.wait_for(lock, drain_interval, [] { return g_stop_requested; });
+            lock.unlock();
+            drain_rings(session);
+            lock.lock();
+        }
+    }
+}
+
+bool perf_trace_start(const std::string& path)
+{
+    std::lock_guard control_lock{g_control_mutex};
+    if (g_active.load(std::memory_order_relaxed)) {
+        xlog::warn("Trace is already running");
+        return false;
+    }
+    g_file = std::fopen(path.c_str(), "w");
+    if (!g_file) {
+        xlog::error("Failed to open {} for writing", path);
+        return false;
+    }
+    std::fputs("{\"traceEvents\":[", g_file);
+
+    if (!g_rings) {
+        g_rings = std::make_unique<TraceRing[]>(max_rings);
+    }
+    unsigned session = g_session.load(std::memory_order_relaxed) + 1;
+    for (int i = 0; i < max_rings; ++i) {
+        g_rings[i].head.store(0, std::memory_order_relaxed);
+        g_rings[i].tail.store(0, std::memory_order_relaxed);
+        g_rings[i].dropped.store(0, std::memory_order_relaxed);
+    }
+    g_unclaimed_dropped.store(0, std::memory_order_relaxed);
+    g_first_event = true;
+    g_events_written = 0;
+    g_cycles_per_us = 0.0;
+    g_pid = get_current_process_id();
+    g_start_tsc = __rdtsc();
+    g_start_time = std::chrono::steady_clock::now();
+    g_stop_requested = false;
+
+    g_session.store(session, std::memory_order_relaxed);
+    g_active.store(true, std::memory_order_release);
+    g_writer_thread = DetachOnExitThread{writer_thread_proc, session};
+    xlog::info("Started trace {}", path);
+    return true;
+}
+
+bool perf_trace_stop(PerfTraceResult* result)
+{
+    std::lock_guard control_lock{g_control_mutex};
+    if (!g_active.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    g_active.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard lock{g_writer_mutex};
+        g_stop_requested = true;
+    }
+    g_writer_cv.notify_one();
+    g_writer_thread.join();
+    // Pick up events recorded after the last periodic drain
+    drain_rings(g_session.load(std::memory_order_relaxed));
+
+    std::fprintf(g_file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    std::fclose(g_file);
+    g_file = nullptr;
+
+    uint64_t dropped = g_unclaimed_dropped.load(std::memory_order_relaxed);
+    for (int i = 0; i < max_rings; ++i) {
+        dropped += g_rings[i].dropped.load(std::memory_order_relaxed);
+    }
+    xlog::info("Stopped trace ({} events written, {} dropped)", g_events_written, dropped);
+    if (result) {
+        result->events_written = g_events_written;
+        result->events_dropped = dropped;
+    }
+    return true;
+}
+
+bool perf_trace_is_active()
+{
+    return g_active.load(std::memory_order_relaxed);
+}
+
+void perf_trace_record(const char* name, uint64_t begin_tsc, uint64_t end_tsc)
+{
+    if (!g_active.load(std::memory_order_acquire)) {
+        return;
+    }
+    unsigned session = g_session.load(std::memory_order_relaxed);
+    if (t_session != session) {
+        t_session = session;
+        t_ring = claim_ring(session);
+    }
+    if (!t_ring) {
+        g_unclaimed_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& ring = *t_ring;
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring_capacity) {
+        ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    ring.events[head % ring_capacity] = {name, begin_tsc, end_tsc};
+    ring.head.store(head + 1, std::memory_order_release);
+}
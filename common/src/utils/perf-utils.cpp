@@ -0,0 +1,289 @@
+#include <common/utils/perf-utils.h>
+#include <common/utils/perf-trace.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    constexpr int max_zones = PerfZone::max_zones;
+
+    // Written only by the owning thread. Aggregation reads them from another thread, hence the relaxed atomics.
+    struct ZoneCounters
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> cycles{0};
+        std::array<std::atomic<uint64_t>, perf_histogram_buckets> histogram{};
+        // Reset by the owner when it sees a new frame epoch
+        std::atomic<uint64_t> min_cycles{UINT64_MAX};
+        std::atomic<uint64_t> max_cycles{0};
+    };
+
+    struct ThreadCounters
+    {
+        std::array<ZoneCounters, max_zones> zones;
+        std::atomic<unsigned> epoch{0};
+    };
+
+    // Counter values seen by the previous aggregation
+    struct ZoneSnapshot
+    {
+        uint64_t calls = 0;
+        uint64_t cycles = 0;
+        std::array<uint64_t, perf_histogram_buckets> histogram{};
+    };
+
+    struct ThreadEntry
+    {
+        // Blocks are never freed so aggregation does not race with thread exit
+        ThreadCounters* counters;
+        std::array<ZoneSnapshot, max_zones> snapshots{};
+    };
+
+    std::atomic<int> g_num_zones{0};
+    // Name is stored last with release order and publishes the category
+    std::array<std::atomic<const char*>, max_zones> g_zone_names{};
+    std::array<PerfZoneCategory, max_zones> g_zone_categories{};
+    std::atomic<unsigned> g_epoch{1};
+
+    // Protects everything below
+    std::mutex g_mutex;
+    std::vector<std::unique_ptr<ThreadEntry>> g_threads;
+    std::array<PerfZoneStats, max_zones> g_totals{};
+    std::array<PerfZoneStats, max_zones> g_last_frame{};
+    uint64_t g_frames = 0;
+    uint64_t g_frame_cycles = 0;
+    uint64_t g_last_frame_cycles = 0;
+    uint64_t g_last_frame_tsc = 0;
+    uint64_t g_calibration_tsc = 0;
+    std::chrono::steady_clock::time_point g_calibration_time;
+
+    thread_local ThreadCounters* t_counters = nullptr;
+
+    ThreadCounters& register_thread()
+    {
+        auto entry = std::make_unique<ThreadEntry>();
+        entry->counters = new ThreadCounters;
+        std::lock_guard lock{g_mutex};
+        t_counters = entry->counters;
+        g_threads.push_back(std::move(entry));
+        return *t_counters;
+    }
+
+    void add_relaxed(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        // Single writer so a plain load and store is enough and avoids a locked instruction
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    int get_histogram_bucket(uint64_t cycles)
+    {
+        int bits = static_cast<int>(std::bit_width(cycles));
+        return std::clamp(bits - perf_histogram_first_bucket_bits, 0, perf_histogram_buckets - 1);
+    }
+
+    void reset_calibration()
+    {
+        g_calibration_tsc = __rdtsc();
+        g_calibration_time = std::chrono::steady_clock::now();
+    }
+
+    void merge_min_max(PerfZoneStats& stats, uint64_t min_cycles, uint64_t max_cycles)
+    {
+        if (min_cycles > max_cycles) {
+            // No calls
+            return;
+        }
+        stats.min_cycles = stats.min_cycles ? std::min(stats.min_cycles, min_cycles) : min_cycles;
+        stats.max_cycles = std::max(stats.max_cycles, max_cycles);
+    }
+
+    int get_num_zones()
+    {
+        return std::min(g_num_zones.load(std::memory_order_acquire), max_zones);
+    }
+
+    PerfReport make_report(const std::array<PerfZoneStats, max_zones>& zones, uint64_t frames, uint64_t frame_cycles)
+    {
+        PerfReport report;
+        report.frames = frames;
+        report.frame_cycles = frame_cycles;
+
+        auto elapsed = std::chrono::steady_clock::now() - g_calibration_time;
+        if (g_calibration_tsc && elapsed.count() > 0) {
+            auto elapsed_us = std::chrono::duration<double, std::micro>(elapsed).count();
+            report.cycles_per_us = static_cast<double>(__rdtsc() - g_calibration_tsc) / elapsed_us;
+        }
+
+        int num_zones = get_num_zones();
+        for (int i = 0; i < num_zones; ++i) {
+            const char* name = g_zone_names[i].load(std::memory_order_acquire);
+            if (!name) {
+                // Zone is being registered by another thread
+                continue;
+            }
+            PerfZoneStats stats = zones[i];
+            stats.name = name;
+            stats.category = g_zone_categories[i];
+            report.zones.push_back(stats);
+        }
+        return report;
+    }
+}
+
+PerfZone::PerfZone(const char* name, PerfZoneCategory category) :
+    m_name(name)
+{
+    m_id = g_num_zones.fetch_add(1);
+    if (m_id >= max_zones) {
+        xlog::warn("Too many profiler zones, ignoring {}", name);
+        m_id = -1;
+        return;
+    }
+    g_zone_categories[m_id] = category;
+    g_zone_names[m_id].store(name, std::memory_order_release);
+}
+
+void perf_record(const PerfZone& zone_info, uint64_t begin_tsc, uint64_t end_tsc)
+{
+    perf_trace_record(zone_info.name(), begin_tsc, end_tsc);
+    int zone_id = zone_info.id();
+    if (zone_id < 0) {
+        return;
+    }
+    uint64_t cycles = end_tsc - begin_tsc;
+    ThreadCounters& counters = t_counters ? *t_counters : register_thread();
+    unsigned epoch = g_epoch.load(std::memory_order_relaxed);
+    if (counters.epoch.load(std::memory_order_relaxed) != epoch) {
+        for (auto& zone : counters.zones) {
+            zone.min_cycles.store(UINT64_MAX, std::memory_order_relaxed);
+            zone.max_cycles.store(0, std::memory_order_relaxed);
+        }
+        counters.epoch.store(epoch, std::memory_order_relaxed);
+    }
+    auto& zone = counters.zones[zone_id];
+    add_relaxed(zone.calls, 1);
+    add_relaxed(zone.cycles, cycles);
+    add_relaxed(zone.histogram[get_histogram_bucket(cycles)], 1);
+    if (cycles < zone.min_cycles.load(std::memory_order_relaxed)) {
+        zone.min_cycles.store(cycles, std::memory_order_relaxed);
+    }
+    if (cycles > zone.max_cycles.load(std::memory_order_relaxed)) {
+        zone.max_cycles.store(cycles, std::memory_order_relaxed);
+    }
+}
+
+void perf_end_frame()
+{
+    uint64_t now = __rdtsc();
+    std::lock_guard lock{g_mutex};
+    if (!g_calibration_tsc) {
+        reset_calibration();
+    }
+    g_last_frame_cycles = g_last_frame_tsc ? now - g_last_frame_tsc : 0;
+    if (g_last_frame_tsc) {
+        perf_trace_record("frame", g_last_frame_tsc, now);
+        ++g_frames;
+        g_frame_cycles += g_last_frame_cycles;
+    }
+    g_last_frame_tsc = now;
+
+    unsigned epoch = g_epoch.load(std::memory_order_relaxed);
+    int num_zones = get_num_zones();
+    g_last_frame = {};
+    for (auto& thread : g_threads) {
+        bool same_epoch = thread->counters->epoch.load(std::memory_order_relaxed) == epoch;
+        for (int i = 0; i < num_zones; ++i) {
+            const auto& zone = thread->counters->zones[i];
+            auto& snapshot = thread->snapshots[i];
+            auto& frame = g_last_frame[i];
+            uint64_t calls = zone.calls.load(std::memory_order_relaxed);
+            uint64_t cycles = zone.cycles.load(std::memory_order_relaxed);
+            frame.calls += calls - snapshot.calls;
+            frame.cycles += cycles - snapshot.cycles;
+            snapshot.calls = calls;
+            snapshot.cycles = cycles;
+            for (int bucket = 0; bucket < perf_histogram_buckets; ++bucket) {
+                uint64_t count = zone.histogram[bucket].load(std::memory_order_relaxed);
+                frame.histogram[bucket] += count - snapshot.histogram[bucket];
+                snapshot.histogram[bucket] = count;
+            }
+            if (same_epoch) {
+                merge_min_max(frame, zone.min_cycles.load(std::memory_order_relaxed),
+                    zone.max_cycles.load(std::memory_order_relaxed));
+            }
+        }
+    }
+    for (int i = 0; i < num_zones; ++i) {
+        const auto& frame = g_last_frame[i];
+        auto& total = g_totals[i];
+        total.calls += frame.calls;
+        total.cycles += frame.cycles;
+        for (int bucket = 0; bucket < perf_histogram_buckets; ++bucket) {
+            total.histogram[bucket] += frame.histogram[bucket];
+        }
+        if (frame.calls) {
+            merge_min_max(total, frame.min_cycles, frame.max_cycles);
+        }
+    }
+    // Threads reset their min/max on the next record
+    g_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+PerfReport perf_get_report()
+{
+    std::lock_guard lock{g_mutex};
+    return make_report(g_totals, g_frames, g_frame_cycles);
+}
+
+PerfReport perf_get_last_frame_report()
+{
+    std::lock_guard lock{g_mutex};
+    return make_report(g_last_frame, g_last_frame_cycles ? 1 : 0, g_last_frame_cycles);
+}
+
+void perf_reset()
+{
+    std::lock_guard lock{g_mutex};
+    g_totals = {};
+    g_frames = 0;
+    g_frame_cycles = 0;
+    reset_calibration();
+}
+
+bool perf_write_csv(const PerfReport& report, const std::string& path)
+{
+    std::ofstream file{path};
+    if (!file) {
+        xlog::error("Failed to open {} for writing", path);
+        return false;
+    }
+    double us_per_cycle = report.cycles_per_us > 0.0 ? 1.0 / report.cycles_per_us : 0.0;
+    file << "zone,category,calls,calls_per_frame,total_us,mean_us,min_us,max_us,frame_percent";
+    for (int bucket = 0; bucket < perf_histogram_buckets; ++bucket) {
+        file << ",hist_ge_" << perf_histogram_bucket_min(bucket);
+    }
+    file << '\n';
+    for (const auto& zone : report.zones) {
+        double frames = report.frames ? static_cast<double>(report.frames) : 1.0;
+        double mean_cycles = zone.calls ? static_cast<double>(zone.cycles) / static_cast<double>(zone.calls) : 0.0;
+        double frame_share = report.frame_cycles
+            ? 100.0 * static_cast<double>(zone.cycles) / static_cast<double>(report.frame_cycles)
+            : 0.0;
+        file << zone.name << ',' << (zone.category == PerfZoneCategory::hook ? "hook" : "zone") << ','
+             << zone.calls << ',' << static_cast<double>(zone.calls) / frames << ','
+             << static_cast<double>(zone.cycles) * us_per_cycle << ',' << mean_cycles * us_per_cycle << ','
+             << static_cast<double>(zone.min_cycles) * us_per_cycle << ','
+             << static_cast<double>(zone.max_cycles) * us_per_cycle << ',' << frame_share;
+        for (auto count : zone.histogram) {
+            file << ',' << count;
+        }
+        file << '\n';
+    }
+    return static_cast<bool>(file);
+}
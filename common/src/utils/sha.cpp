@@ -0,0 +1,538 @@
+#include <common/utils/sha.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SHA_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define SHA_X86 0
+#endif
+
+#ifdef __GNUC__
+#define SHA_ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define SHA_ALWAYS_INLINE
+#endif
+
+#if SHA_X86 && defined(__GNUC__)
+// GCC and Clang only emit these instructions in functions that are marked for them
+#define SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#define SHA_NI_TARGET
+#endif
+
+// Views are mapped in windows of this size (a multiple of the allocation granularity on every platform)
+static constexpr size_t file_map_window_size = 32 * 1024 * 1024;
+
+static constexpr uint32_t sha1_initial_state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+static constexpr uint32_t sha256_initial_state[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+alignas(16) static constexpr uint32_t sha256_round_constants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static inline uint32_t rotl(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static inline uint32_t rotr(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+        | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+// Rounds are templates so they are fully unrolled. Instead of moving the working variables after every round, round i
+// reads them rotated by i positions.
+
+template<int i>
+SHA_ALWAYS_INLINE static inline void sha1_round(uint32_t* v, uint32_t* w, const uint8_t* data)
+{
+    // a is v[(80 - i) % 5], b the next one and so on
+    uint32_t& a = v[(80 - i) % 5];
+    uint32_t& b = v[(81 - i) % 5];
+    uint32_t& c = v[(82 - i) % 5];
+    uint32_t& d = v[(83 - i) % 5];
+    uint32_t& e = v[(84 - i) % 5];
+    // Only the last 16 words of the schedule are needed at any time
+    if constexpr (i < 16) {
+        w[i] = load_be32(data + i * 4);
+    }
+    else {
+        w[i & 15] = rotl(w[(i - 3) & 15] ^ w[(i - 8) & 15] ^ w[(i - 14) & 15] ^ w[i & 15], 1);
+    }
+    uint32_t f;
+    uint32_t k;
+    if constexpr (i < 20) {
+        f = d ^ (b & (c ^ d));
+        k = 0x5A827999;
+    }
+    else if constexpr (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+    }
+    else if constexpr (i < 60) {
+        f = (b & c) | (d & (b | c));
+        k = 0x8F1BBCDC;
+    }
+    else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+    }
+    // e becomes the new a
+    e += rotl(a, 5) + f + k + w[i & 15];
+    b = rotl(b, 30);
+}
+
+template<int... I>
+SHA_ALWAYS_INLINE static inline void sha1_rounds(
+    uint32_t* v, uint32_t* w, const uint8_t* data, std::integer_sequence<int, I...>)
+{
+    (sha1_round<I>(v, w, data), ...);
+}
+
+static void sha1_process_blocks_portable(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+    for (; num_blocks; --num_blocks, data += 64) {
+        uint32_t w[16];
+        uint32_t v[5];
+        std::memcpy(v, state, sizeof(v));
+        sha1_rounds(v, w, data, std::make_integer_sequence<int, 80>{});
+        for (int i = 0; i < 5; ++i) {
+            state[i] += v[i];
+        }
+    }
+}
+
+template<int i>
+SHA_ALWAYS_INLINE static inline void sha256_round(uint32_t* v, uint32_t* w, const uint8_t* data)
+{
+    // a is v[(64 - i) % 8], b the next one and so on
+    uint32_t& a = v[(64 - i) % 8];
+    uint32_t& b = v[(65 - i) % 8];
+    uint32_t& c = v[(66 - i) % 8];
+    uint32_t& d = v[(67 - i) % 8];
+    uint32_t& e = v[(68 - i) % 8];
+    uint32_t& f = v[(69 - i) % 8];
+    uint32_t& g = v[(70 - i) % 8];
+    uint32_t& h = v[(71 - i) % 8];
+    if constexpr (i < 16) {
+        w[i] = load_be32(data + i * 4);
+    }
+    else {
+        uint32_t w15 = w[(i - 15) & 15];
+        uint32_t w2 = w[(i - 2) & 15];
+        uint32_t s0 = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+        uint32_t s1 = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+        w[i & 15] += s0 + w[(i - 7) & 15] + s1;
+    }
+    uint32_t temp1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + (g ^ (e & (f ^ g))) + sha256_round_constants[i]
+        + w[i & 15];
+    uint32_t temp2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+    // h becomes the new a and d the new e
+    d += temp1;
+    h = temp1 + temp2;
+}
+
+template<int... I>
+SHA_ALWAYS_INLINE static inline void sha256_rounds(
+    uint32_t* v, uint32_t* w, const uint8_t* data, std::integer_sequence<int, I...>)
+{
+    (sha256_round<I>(v, w, data), ...);
+}
+
+static void sha256_process_blocks_portable(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+    for (; num_blocks; --num_blocks, data += 64) {
+        uint32_t w[16];
+        uint32_t v[8];
+        std::memcpy(v, state, sizeof(v));
+        sha256_rounds(v, w, data, std::make_integer_sequence<int, 64>{});
+        for (int i = 0; i < 8; ++i) {
+            state[i] += v[i];
+        }
+    }
+}
+
+#if SHA_X86
+
+// The message schedule is kept in four registers of four words each. Group i covers rounds 4 * i to 4 * i + 3 (SHA-1
+// has 20 groups, SHA-256 16); the register of group i is reused for group i + 4 once its words have been consumed.
+// The groups are templates so the round constants and register choices are fixed at compile time.
+
+struct Sha1NiBlock
+{
+    __m128i abcd;
+    __m128i e0;
+    // A before the previous group, which the next E is derived from
+    __m128i e1;
+    __m128i msgs[4];
+};
+
+template<int i>
+SHA_NI_TARGET SHA_ALWAYS_INLINE static inline void sha1_ni_group(
+    Sha1NiBlock& b, const uint8_t* data, __m128i byte_swap_mask)
+{
+    __m128i& msg = b.msgs[i % 4];
+    if constexpr (i < 4) {
+        msg = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byte_swap_mask);
+    }
+    __m128i e = i == 0 ? _mm_add_epi32(b.e0, msg) : _mm_sha1nexte_epu32(b.e1, msg);
+    b.e1 = b.abcd;
+    if constexpr (i >= 3 && i < 19) {
+        b.msgs[(i + 1) % 4] = _mm_sha1msg2_epu32(b.msgs[(i + 1) % 4], msg);
+    }
+    b.abcd = _mm_sha1rnds4_epu32(b.abcd, e, i / 5);
+    if constexpr (i >= 1 && i < 17) {
+        b.msgs[(i + 3) % 4] = _mm_sha1msg1_epu32(b.msgs[(i + 3) % 4], msg);
+    }
+    if constexpr (i >= 2 && i < 18) {
+        b.msgs[(i + 2) % 4] = _mm_xor_si128(b.msgs[(i + 2) % 4], msg);
+    }
+}
+
+template<int... I>
+SHA_NI_TARGET SHA_ALWAYS_INLINE static inline void sha1_ni_groups(
+    Sha1NiBlock& b, const uint8_t* data, __m128i byte_swap_mask, std::integer_sequence<int, I...>)
+{
+    (sha1_ni_group<I>(b, data, byte_swap_mask), ...);
+}
+
+SHA_NI_TARGET static void sha1_process_blocks_sha_ni(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+    const __m128i byte_swap_mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090A0B0C0D0E0FLL);
+    Sha1NiBlock b;
+    b.abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+    b.e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+    for (; num_blocks; --num_blocks, data += 64) {
+        const __m128i abcd_save = b.abcd;
+        const __m128i e0_save = b.e0;
+        sha1_ni_groups(b, data, byte_swap_mask, std::make_integer_sequence<int, 20>{});
+        b.e0 = _mm_sha1nexte_epu32(b.e1, e0_save);
+        b.abcd = _mm_add_epi32(b.abcd, abcd_save);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(b.abcd, 0x1B));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(b.e0, 3));
+}
+
+struct Sha256NiBlock
+{
+    // The round instructions want the state as ABEF and CDGH
+    __m128i abef;
+    __m128i cdgh;
+    __m128i msgs[4];
+};
+
+template<int i>
+SHA_NI_TARGET SHA_ALWAYS_INLINE static inline void sha256_ni_group(
+    Sha256NiBlock& b, const uint8_t* data, __m128i byte_swap_mask)
+{
+    __m128i& msg = b.msgs[i % 4];
+    if constexpr (i < 4) {
+        msg = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byte_swap_mask);
+    }
+    __m128i round_input =
+        _mm_add_epi32(msg, _mm_load_si128(reinterpret_cast<const __m128i*>(sha256_round_constants + i * 4)));
+    b.cdgh = _mm_sha256rnds2_epu32(b.cdgh, b.abef, round_input);
+    if constexpr (i >= 3 && i < 15) {
+        __m128i& next = b.msgs[(i + 1) % 4];
+        next = _mm_add_epi32(next, _mm_alignr_epi8(msg, b.msgs[(i + 3) % 4], 4));
+        next = _mm_sha256msg2_epu32(next, msg);
+    }
+    b.abef = _mm_sha256rnds2_epu32(b.abef, b.cdgh, _mm_shuffle_epi32(round_input, 0x0E));
+    if constexpr (i >= 1 && i < 13) {
+        b.msgs[(i + 3) % 4] = _mm_sha256msg1_epu32(b.msgs[(i + 3) % 4], msg);
+    }
+}
+
+template<int... I>
+SHA_NI_TARGET SHA_ALWAYS_INLINE static inline void sha256_ni_groups(
+    Sha256NiBlock& b, const uint8_t* data, __m128i byte_swap_mask, std::integer_sequence<int, I...>)
+{
+    (sha256_ni_group<I>(b, data, byte_swap_mask), ...);
+}
+
+SHA_NI_TARGET static void sha256_process_blocks_sha_ni(uint32_t* state, const uint8_t* data, size_t num_blocks)
+{
+    const __m128i byte_swap_mask = _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+    __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    Sha256NiBlock b;
+    b.abef = _mm_alignr_epi8(dcba, hgfe, 8);
+    b.cdgh = _mm_blend_epi16(hgfe, dcba, 0xF0);
+
+    for (; num_blocks; --num_blocks, data += 64) {
+        const __m128i abef_save = b.abef;
+        const __m128i cdgh_save = b.cdgh;
+        sha256_ni_groups(b, data, byte_swap_mask, std::make_integer_sequence<int, 16>{});
+        b.abef = _mm_add_epi32(b.abef, abef_save);
+        b.cdgh = _mm_add_epi32(b.cdgh, cdgh_save);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(b.abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(b.cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+static bool detect_sha_cpu_extensions()
+{
+    // Leaf 1: ECX bit 9 = SSSE3, bit 19 = SSE4.1. Leaf 7: EBX bit 29 = SHA.
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return false;
+    }
+    __cpuid(regs, 1);
+    unsigned ecx1 = static_cast<unsigned>(regs[2]);
+    __cpuidex(regs, 7, 0);
+    unsigned ebx7 = static_cast<unsigned>(regs[1]);
+#else
+    unsigned eax = 0;
+    unsigned ebx = 0;
+    unsigned ecx = 0;
+    unsigned edx = 0;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    unsigned ecx1 = ecx;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    unsigned ebx7 = ebx;
+#endif
+    return (ecx1 & (1u << 9)) && (ecx1 & (1u << 19)) && (ebx7 & (1u << 29));
+}
+
+#endif // SHA_X86
+
+bool sha_cpu_extensions_supported()
+{
+#if SHA_X86
+    static const bool supported = detect_sha_cpu_extensions();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+ShaHasher::ShaHasher(ShaAlgorithm algorithm, bool allow_cpu_extensions) :
+    m_algorithm(algorithm), m_uses_cpu_extensions(allow_cpu_extensions && sha_cpu_extensions_supported())
+{
+    bool sha1 = algorithm == ShaAlgorithm::sha1;
+    m_process_blocks = sha1 ? sha1_process_blocks_portable : sha256_process_blocks_portable;
+#if SHA_X86
+    if (m_uses_cpu_extensions) {
+        m_process_blocks = sha1 ? sha1_process_blocks_sha_ni : sha256_process_blocks_sha_ni;
+    }
+#endif
+    reset();
+}
+
+void ShaHasher::reset()
+{
+    if (m_algorithm == ShaAlgorithm::sha1) {
+        std::memcpy(m_state, sha1_initial_state, sizeof(sha1_initial_state));
+    }
+    else {
+        std::memcpy(m_state, sha256_initial_state, sizeof(sha256_initial_state));
+    }
+    m_block_used = 0;
+    m_total_size = 0;
+}
+
+void ShaHasher::update(const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    m_total_size += size;
+    if (m_block_used) {
+        size_t n = std::min(size, block_size - m_block_used);
+        std::memcpy(m_block + m_block_used, bytes, n);
+        m_block_used += n;
+        bytes += n;
+        size -= n;
+        if (m_block_used < block_size) {
+            return;
+        }
+        m_process_blocks(m_state, m_block, 1);
+        m_block_used = 0;
+    }
+    // Whole blocks are hashed straight from the caller's memory
+    if (size >= block_size) {
+        size_t num_blocks = size / block_size;
+        m_process_blocks(m_state, bytes, num_blocks);
+        bytes += num_blocks * block_size;
+        size -= num_blocks * block_size;
+    }
+    std::memcpy(m_block, bytes, size);
+    m_block_used = size;
+}
+
+std::vector<uint8_t> ShaHasher::finish()
+{
+    uint64_t total_bits = m_total_size * 8;
+    m_block[m_block_used++] = 0x80;
+    if (m_block_used > block_size - 8) {
+        std::memset(m_block + m_block_used, 0, block_size - m_block_used);
+        m_process_blocks(m_state, m_block, 1);
+        m_block_used = 0;
+    }
+    std::memset(m_block + m_block_used, 0, block_size - 8 - m_block_used);
+    store_be32(m_block + block_size - 8, static_cast<uint32_t>(total_bits >> 32));
+    store_be32(m_block + block_size - 4, static_cast<uint32_t>(total_bits));
+    m_process_blocks(m_state, m_block, 1);
+    m_block_used = 0;
+
+    std::vector<uint8_t> digest(digest_size());
+    for (size_t i = 0; i < digest.size() / 4; ++i) {
+        store_be32(digest.data() + i * 4, m_state[i]);
+    }
+    return digest;
+}
+
+std::string sha_digest_to_hex(const std::vector<uint8_t>& digest)
+{
+    static constexpr char hex_digits[] = "0123456789abcdef";
+    std::string hex(digest.size() * 2, '\0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        hex[i * 2] = hex_digits[digest[i] >> 4];
+        hex[i * 2 + 1] = hex_digits[digest[i] & 0x0F];
+    }
+    return hex;
+}
+
+#ifdef _WIN32
+
+std::optional<std::string> sha_hash_file_hex(const std::string& path, ShaAlgorithm algorithm)
+{
+    HANDLE file = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+
+    ShaHasher hasher{algorithm};
+    // Empty files cannot be mapped
+    if (file_size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return std::nullopt;
+        }
+        auto remaining = static_cast<uint64_t>(file_size.QuadPart);
+        uint64_t offset = 0;
+        while (remaining) {
+            size_t view_size = static_cast<size_t>(std::min<uint64_t>(remaining, file_map_window_size));
+            void* view = MapViewOfFile(
+                mapping,
+                FILE_MAP_READ,
+                static_cast<DWORD>(offset >> 32),
+                static_cast<DWORD>(offset),
+                view_size);
+            if (!view) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return std::nullopt;
+            }
+            hasher.update(view, view_size);
+            UnmapViewOfFile(view);
+            offset += view_size;
+            remaining -= view_size;
+        }
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return sha_digest_to_hex(hasher.finish());
+}
+
+#else
+
+std::optional<std::string> sha_hash_file_hex(const std::string& path, ShaAlgorithm algorithm)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return std::nullopt;
+    }
+
+#ifdef MAP_POPULATE
+    // Faulting the window in at once is faster than taking a page fault every 4 KiB
+    constexpr int map_flags = MAP_PRIVATE | MAP_POPULATE;
+#else
+    constexpr int map_flags = MAP_PRIVATE;
+#endif
+    ShaHasher hasher{algorithm};
+    auto remaining = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = 0;
+    while (remaining) {
+        size_t view_size = static_cast<size_t>(std::min<uint64_t>(remaining, file_map_window_size));
+        void* view = mmap(nullptr, view_size, PROT_READ, map_flags, fd, static_cast<off_t>(offset));
+        if (view == MAP_FAILED) {
+            close(fd);
+            return std::nullopt;
+        }
+        hasher.update(view, view_size);
+        munmap(view, view_size);
+        offset += view_size;
+        remaining -= view_size;
+    }
+    close(fd);
+    return sha_digest_to_hex(hasher.finish());
+}
+
+#endif
@@ -0,0 +1,443 @@
+#include <common/utils/size-class-allocator.h>
+#include <algorithm>
+#include <new>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    constexpr unsigned span_map_page_bits = 16;
+    constexpr uint64_t span_map_page_size = uint64_t{1} << span_map_page_bits;
+    // Span indices of a 32-bit address space fit in one page. 64-bit builds (tests) support 48-bit addresses.
+    constexpr uint64_t span_map_num_pages = sizeof(void*) == 4 ? 1 : uint64_t{1} << 16;
+    constexpr size_t min_cached_blocks = 8;
+    constexpr size_t max_cached_blocks = 256;
+    static_assert(SizeClassAllocator::max_small_size <= UINT16_MAX, "requested sizes are stored in 16 bits");
+
+    std::atomic<unsigned> g_next_instance_id{1};
+
+    // Returns memory aligned to SizeClassAllocator::span_size
+    void* os_alloc(size_t size)
+    {
+#ifdef _WIN32
+        // Allocation granularity of VirtualAlloc is 64 KiB which equals span_size
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        constexpr size_t alignment = SizeClassAllocator::span_size;
+        size_t padded_size = size + alignment;
+        void* ptr = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        uintptr_t aligned = (addr + alignment - 1) & ~(alignment - 1);
+        if (aligned > addr) {
+            munmap(ptr, aligned - addr);
+        }
+        size_t tail = addr + padded_size - (aligned + size);
+        if (tail) {
+            munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+        return reinterpret_cast<void*>(aligned);
+#endif
+    }
+
+    void os_free(void* ptr, [[maybe_unused]] size_t size)
+    {
+#ifdef _WIN32
+        VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+        munmap(ptr, size);
+#endif
+    }
+
+    size_t round_up_to_span(size_t size)
+    {
+        return (size + SizeClassAllocator::span_size - 1) & ~(SizeClassAllocator::span_size - 1);
+    }
+
+    constexpr size_t compute_class_size(int size_class)
+    {
+        if (size_class < 8) {
+            return 16 * static_cast<size_t>(size_class + 1);
+        }
+        int step = size_class - 8;
+        int k = 7 + step / 4;
+        return (size_t{1} << k) + static_cast<size_t>(step % 4 + 1) * (size_t{1} << (k - 2));
+    }
+
+    struct ClassInfo
+    {
+        uint32_t size;
+        // Number of blocks followed by their requested size table
+        uint32_t blocks_per_span;
+        // Offsets in a span are below 2^16, so (offset * reciprocal) >> 32 is offset / size without a division
+        uint32_t reciprocal;
+    };
+
+    constexpr auto g_class_info = [] {
+        std::array<ClassInfo, SizeClassAllocator::num_classes> info{};
+        for (int i = 0; i < SizeClassAllocator::num_classes; ++i) {
+            size_t size = compute_class_size(i);
+            info[i].size = static_cast<uint32_t>(size);
+            info[i].blocks_per_span = static_cast<uint32_t>(SizeClassAllocator::span_size / (size + sizeof(uint16_t)));
+            info[i].reciprocal = static_cast<uint32_t>((uint64_t{1} << 32) / size + 1);
+        }
+        return info;
+    }();
+
+    uint32_t max_cached(int size_class)
+    {
+        size_t count = 32 * 1024 / SizeClassAllocator::class_size(size_class);
+        return static_cast<uint32_t>(std::clamp(count, min_cached_blocks, max_cached_blocks));
+    }
+}
+
+struct SizeClassAllocator::ThreadCache
+{
+    struct Bin
+    {
+        FreeBlock* head = nullptr;
+        uint32_t count = 0;
+    };
+
+    ThreadCache* next = nullptr;
+    std::thread::id thread_id;
+    std::array<Bin, num_classes> bins{};
+    // Written by the owning thread only
+    std::array<std::atomic<size_t>, num_classes> allocs{};
+    std::array<std::atomic<size_t>, num_classes> frees{};
+};
+
+thread_local SizeClassAllocator::ThreadCache* SizeClassAllocator::t_cache = nullptr;
+thread_local unsigned SizeClassAllocator::t_cache_instance_id = 0;
+
+int SizeClassAllocator::size_class_of(size_t size)
+{
+    if (size <= 128) {
+        // 16 byte steps
+        return size ? static_cast<int>((size - 1) / 16) : 0;
+    }
+    if (size > max_small_size) {
+        return -1;
+    }
+    // Four classes between consecutive powers of two
+    int k = 0;
+    while ((size_t{1} << (k + 1)) < size) {
+        ++k;
+    }
+    return 8 + (k - 7) * 4 + static_cast<int>((size - 1 - (size_t{1} << k)) >> (k - 2));
+}
+
+size_t SizeClassAllocator::class_size(int size_class)
+{
+    return g_class_info[size_class].size;
+}
+
+size_t SizeClassAllocator::blocks_per_span(int size_class)
+{
+    return g_class_info[size_class].blocks_per_span;
+}
+
+uint16_t* SizeClassAllocator::requested_size_slot(const void* ptr, int size_class)
+{
+    auto addr = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t span = addr & ~(span_size - 1);
+    const auto& info = g_class_info[size_class];
+    auto index = static_cast<uint32_t>((uint64_t{addr - span} * info.reciprocal) >> 32);
+    auto* table = reinterpret_cast<uint16_t*>(span + span_size) - info.blocks_per_span;
+    return table + index;
+}
+
+SizeClassAllocator::SizeClassAllocator() :
+    m_instance_id(g_next_instance_id.fetch_add(1, std::memory_order_relaxed))
+{
+    size_t map_bytes = round_up_to_span(span_map_num_pages * sizeof(m_span_map[0]));
+    void* map = os_alloc(map_bytes);
+    if (map) {
+        // OS memory is zeroed so all pages start out missing
+        m_span_map = static_cast<std::atomic<std::atomic<uint8_t>*>*>(map);
+    }
+}
+
+SizeClassAllocator::~SizeClassAllocator()
+{
+    if (m_span_map) {
+        for (uint64_t page_index = 0; page_index < span_map_num_pages; ++page_index) {
+            auto* page = m_span_map[page_index].load(std::memory_order_relaxed);
+            if (!page) {
+                continue;
+            }
+            for (uint64_t entry = 0; entry < span_map_page_size; ++entry) {
+                if (page[entry].load(std::memory_order_relaxed)) {
+                    uint64_t span_index = (page_index << span_map_page_bits) | entry;
+                    os_free(reinterpret_cast<void*>(static_cast<uintptr_t>(span_index * span_size)), span_size);
+                }
+            }
+            os_free(page, round_up_to_span(span_map_page_size));
+        }
+        os_free(m_span_map, round_up_to_span(span_map_num_pages * sizeof(m_span_map[0])));
+    }
+    // Metadata spans are chained through their first bytes
+    while (m_meta_span) {
+        uint8_t* prev = *reinterpret_cast<uint8_t**>(m_meta_span);
+        os_free(m_meta_span, span_size);
+        m_meta_span = prev;
+    }
+}
+
+std::atomic<uint8_t>* SizeClassAllocator::get_span_map_page(uint64_t span_index, bool create)
+{
+    uint64_t page_index = span_index >> span_map_page_bits;
+    if (!m_span_map || page_index >= span_map_num_pages) {
+        return nullptr;
+    }
+    auto* page = m_span_map[page_index].load(std::memory_order_acquire);
+    if (page || !create) {
+        return page;
+    }
+    std::lock_guard lock{m_meta_mutex};
+    page = m_span_map[page_index].load(std::memory_order_relaxed);
+    if (!page) {
+        void* mem = os_alloc(round_up_to_span(span_map_page_size));
+        if (!mem) {
+            return nullptr;
+        }
+        page = static_cast<std::atomic<uint8_t>*>(mem);
+        for (uint64_t i = 0; i < span_map_page_size; ++i) {
+            ::new (&page[i]) std::atomic<uint8_t>{0};
+        }
+        m_span_map[page_index].store(page, std::memory_order_release);
+    }
+    return page;
+}
+
+int SizeClassAllocator::class_of_ptr(const void* ptr) const
+{
+    uint64_t span_index = reinterpret_cast<uintptr_t>(ptr) / span_size;
+    uint64_t page_index = span_index >> span_map_page_bits;
+    if (!m_span_map || page_index >= span_map_num_pages) {
+        return -1;
+    }
+    const auto* page = m_span_map[page_index].load(std::memory_order_acquire);
+    if (!page) {
+        return -1;
+    }
+    return page[span_index & (span_map_page_size - 1)].load(std::memory_order_acquire) - 1;
+}
+
+bool SizeClassAllocator::owns(const void* ptr) const
+{
+    return class_of_ptr(ptr) >= 0;
+}
+
+size_t SizeClassAllocator::usable_size(const void* ptr) const
+{
+    return class_size(class_of_ptr(ptr));
+}
+
+size_t SizeClassAllocator::requested_size(const void* ptr) const
+{
+    return *requested_size_slot(ptr, class_of_ptr(ptr));
+}
+
+bool SizeClassAllocator::resize_in_place(void* ptr, size_t size)
+{
+    int size_class = class_of_ptr(ptr);
+    if (size_class_of(size) != size_class) {
+        return false;
+    }
+    *requested_size_slot(ptr, size_class) = static_cast<uint16_t>(size);
+    return true;
+}
+
+SizeClassAllocator::ThreadCache* SizeClassAllocator::get_thread_cache()
+{
+    if (t_cache_instance_id == m_instance_id) {
+        return t_cache;
+    }
+    ThreadCache* cache = nullptr;
+    auto thread_id = std::this_thread::get_id();
+    for (auto* it = m_thread_caches.load(std::memory_order_acquire); it; it = it->next) {
+        // Ids are unique among running threads so a match was left behind by a thread that already exited
+        if (it->thread_id == thread_id) {
+            cache = it;
+            break;
+        }
+    }
+    if (!cache) {
+        cache = create_thread_cache();
+    }
+    if (cache) {
+        t_cache = cache;
+        t_cache_instance_id = m_instance_id;
+    }
+    return cache;
+}
+
+SizeClassAllocator::ThreadCache* SizeClassAllocator::create_thread_cache()
+{
+    std::lock_guard lock{m_meta_mutex};
+    // Metadata comes from the OS because the allocator may be what serves the CRT heap
+    constexpr size_t header_size = alignof(ThreadCache) > sizeof(void*) ? alignof(ThreadCache) : sizeof(void*);
+    size_t offset = (m_meta_offset + alignof(ThreadCache) - 1) & ~(alignof(ThreadCache) - 1);
+    if (!m_meta_span || offset + sizeof(ThreadCache) > span_size) {
+        auto* span = static_cast<uint8_t*>(os_alloc(span_size));
+        if (!span) {
+            return nullptr;
+        }
+        *reinterpret_cast<uint8_t**>(span) = m_meta_span;
+        m_meta_span = span;
+        offset = header_size;
+    }
+    auto* cache = ::new (m_meta_span + offset) ThreadCache{};
+    m_meta_offset = offset + sizeof(ThreadCache);
+    cache->thread_id = std::this_thread::get_id();
+    cache->next = m_thread_caches.load(std::memory_order_relaxed);
+    m_thread_caches.store(cache, std::memory_order_release);
+    return cache;
+}
+
+bool SizeClassAllocator::add_span(CentralList& central, int size_class)
+{
+    auto* span = static_cast<uint8_t*>(os_alloc(span_size));
+    if (!span) {
+        return false;
+    }
+    uint64_t span_index = reinterpret_cast<uintptr_t>(span) / span_size;
+    auto* page = get_span_map_page(span_index, true);
+    if (!page) {
+        os_free(span, span_size);
+        return false;
+    }
+    page[span_index & (span_map_page_size - 1)].store(static_cast<uint8_t>(size_class + 1), std::memory_order_release);
+
+    size_t block_size = class_size(size_class);
+    // Requested size table follows the blocks
+    size_t num_blocks = blocks_per_span(size_class);
+    // Link in reverse so blocks are handed out in address order
+    for (size_t i = num_blocks; i-- > 0;) {
+        auto* block = reinterpret_cast<FreeBlock*>(span + i * block_size);
+        block->next = central.head;
+        central.head = block;
+    }
+    central.count += num_blocks;
+    ++central.spans;
+    m_span_bytes.fetch_add(span_size, std::memory_order_relaxed);
+    return true;
+}
+
+void SizeClassAllocator::refill(ThreadCache& cache, int size_class)
+{
+    auto& central = m_central[size_class];
+    auto& bin = cache.bins[size_class];
+    uint32_t batch = max_cached(size_class) / 2;
+    std::lock_guard lock{central.mutex};
+    if (!central.count && !add_span(central, size_class)) {
+        return;
+    }
+    uint32_t moved = 0;
+    while (central.head && moved < batch) {
+        FreeBlock* block = central.head;
+        central.head = block->next;
+        block->next = bin.head;
+        bin.head = block;
+        ++moved;
+    }
+    central.count -= moved;
+    bin.count += moved;
+}
+
+void SizeClassAllocator::flush(ThreadCache& cache, int size_class, uint32_t keep)
+{
+    auto& bin = cache.bins[size_class];
+    if (bin.count <= keep) {
+        return;
+    }
+    // Detach the first count - keep blocks as a chain
+    uint32_t num_flushed = bin.count - keep;
+    FreeBlock* first = bin.head;
+    FreeBlock* last = first;
+    for (uint32_t i = 1; i < num_flushed; ++i) {
+        last = last->next;
+    }
+    bin.head = last->next;
+    bin.count = keep;
+
+    auto& central = m_central[size_class];
+    std::lock_guard lock{central.mutex};
+    last->next = central.head;
+    central.head = first;
+    central.count += num_flushed;
+}
+
+void* SizeClassAllocator::allocate(size_t size)
+{
+    int size_class = size_class_of(size);
+    if (size_class < 0) {
+        return nullptr;
+    }
+    ThreadCache* cache = get_thread_cache();
+    if (!cache) {
+        return nullptr;
+    }
+    auto& bin = cache->bins[size_class];
+    if (!bin.head) {
+        refill(*cache, size_class);
+        if (!bin.head) {
+            return nullptr;
+        }
+    }
+    FreeBlock* block = bin.head;
+    bin.head = block->next;
+    --bin.count;
+    *requested_size_slot(block, size_class) = static_cast<uint16_t>(size);
+    auto& allocs = cache->allocs[size_class];
+    allocs.store(allocs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return block;
+}
+
+void SizeClassAllocator::deallocate(void* ptr)
+{
+    int size_class = class_of_ptr(ptr);
+    ThreadCache* cache = get_thread_cache();
+    if (size_class < 0 || !cache) {
+        return;
+    }
+    auto& bin = cache->bins[size_class];
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next = bin.head;
+    bin.head = block;
+    ++bin.count;
+    auto& frees = cache->frees[size_class];
+    frees.store(frees.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    uint32_t limit = max_cached(size_class);
+    if (bin.count > limit) {
+        flush(*cache, size_class, limit / 2);
+    }
+}
+
+SizeClassAllocator::Stats SizeClassAllocator::stats() const
+{
+    Stats result;
+    for (int i = 0; i < num_classes; ++i) {
+        result.classes[i].block_size = class_size(i);
+    }
+    for (auto* cache = m_thread_caches.load(std::memory_order_acquire); cache; cache = cache->next) {
+        for (int i = 0; i < num_classes; ++i) {
+            result.classes[i].allocs += cache->allocs[i].load(std::memory_order_relaxed);
+            result.classes[i].frees += cache->frees[i].load(std::memory_order_relaxed);
+        }
+        ++result.num_thread_caches;
+    }
+    for (int i = 0; i < num_classes; ++i) {
+        std::lock_guard lock{m_central[i].mutex};
+        result.classes[i].spans = m_central[i].spans;
+    }
+    result.span_bytes = m_span_bytes.load(std::memory_order_relaxed);
+    return result;
+}
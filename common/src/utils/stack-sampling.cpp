@@ -0,0 +1,262 @@
+#include <common/utils/stack-sampling.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+int walk_frame_pointer_chain(
+    uintptr_t pc, uintptr_t frame_ptr, uintptr_t stack_low, uintptr_t stack_high, uintptr_t* out, int max_depth)
+{
+    if (max_depth <= 0) {
+        return 0;
+    }
+    int depth = 0;
+    out[depth++] = pc;
+    uintptr_t fp = frame_ptr;
+    while (depth < max_depth) {
+        if (fp < stack_low || fp % sizeof(uintptr_t) != 0 || stack_high - fp < 2 * sizeof(uintptr_t)
+            || fp >= stack_high) {
+            break;
+        }
+        const auto* record = reinterpret_cast<const uintptr_t*>(fp);
+        uintptr_t next_fp = record[0];
+        uintptr_t ret_addr = record[1];
+        if (!ret_addr) {
+            break;
+        }
+        out[depth++] = ret_addr;
+        // Frames of callers are always higher on the stack. Anything else means a function without a frame pointer.
+        if (next_fp <= fp) {
+            break;
+        }
+        fp = next_fp;
+    }
+    return depth;
+}
+
+static bool follows_call_instruction(uintptr_t addr, uintptr_t code_begin)
+{
+    auto byte_at = [&](uintptr_t back) {
+        return *reinterpret_cast<const uint8_t*>(addr - back);
+    };
+    auto fits = [&](uintptr_t back) {
+        return addr - code_begin >= back;
+    };
+    // call rel32
+    if (fits(5) && byte_at(5) == 0xE8) {
+        return true;
+    }
+    // call [disp32] and call [reg+disp32]
+    if (fits(6) && byte_at(6) == 0xFF && (byte_at(5) == 0x15 || (byte_at(5) & 0xF8) == 0x90)) {
+        return true;
+    }
+    // call [reg+disp8]
+    if (fits(3) && byte_at(3) == 0xFF && (byte_at(2) & 0xF8) == 0x50) {
+        return true;
+    }
+    // call reg and call [reg]
+    return fits(2) && byte_at(2) == 0xFF && ((byte_at(1) & 0xF8) == 0xD0 || (byte_at(1) & 0xF8) == 0x10);
+}
+
+int scan_stack_for_return_addresses(
+    uintptr_t stack_ptr,
+    uintptr_t stack_high,
+    uintptr_t code_begin,
+    uintptr_t code_end,
+    uintptr_t* out,
+    int max_depth,
+    size_t max_scan_words)
+{
+    int depth = 0;
+    uintptr_t addr = (stack_ptr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+    for (size_t i = 0; i < max_scan_words && depth < max_depth && addr < stack_high; ++i, addr += sizeof(uintptr_t)) {
+        uintptr_t value = *reinterpret_cast<const uintptr_t*>(addr);
+        if (value > code_begin && value < code_end && follows_call_instruction(value, code_begin)) {
+            out[depth++] = value;
+        }
+    }
+    return depth;
+}
+
+static uint32_t hash_stack(const uintptr_t* frames, int depth)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < depth; ++i) {
+        hash = (hash ^ static_cast<uint32_t>(frames[i])) * 16777619u;
+    }
+    // 0 marks empty slots
+    return hash ? hash : 1;
+}
+
+static size_t round_up_to_pow2(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+StackSampleTable::StackSampleTable(size_t capacity) :
+    m_capacity(round_up_to_pow2(capacity)), m_entries(std::make_unique<Entry[]>(m_capacity))
+{}
+
+bool StackSampleTable::add(const uintptr_t* frames, int depth)
+{
+    depth = std::clamp(depth, 0, max_sampled_stack_depth);
+    // Single writer so plain load and store pairs are enough
+    m_num_samples.store(m_num_samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    uint32_t hash = hash_stack(frames, depth);
+    size_t mask = m_capacity - 1;
+    for (size_t probe = 0; probe < m_capacity; ++probe) {
+        auto& entry = m_entries[(hash + probe) & mask];
+        uint32_t entry_hash = entry.hash.load(std::memory_order_relaxed);
+        if (entry_hash == 0) {
+            entry.depth = static_cast<uint32_t>(depth);
+            std::copy_n(frames, depth, entry.frames);
+            entry.count.store(1, std::memory_order_relaxed);
+            entry.hash.store(hash, std::memory_order_release);
+            return true;
+        }
+        if (entry_hash == hash && entry.depth == static_cast<uint32_t>(depth)
+            && std::equal(frames, frames + depth, entry.frames)) {
+            entry.count.store(entry.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_num_dropped.store(m_num_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return false;
+}
+
+static bool parse_hex(const std::string& str, uint32_t& out_value)
+{
+    char* end = nullptr;
+    unsigned long value = std::strtoul(str.c_str(), &end, 16);
+    if (str.empty() || !end || *end != '\0') {
+        return false;
+    }
+    out_value = static_cast<uint32_t>(value);
+    return true;
+}
+
+size_t SymbolMap::load(std::istream& stream)
+{
+    size_t num_loaded = 0;
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream line_stream{line};
+        std::string rva_str, name, size_str;
+        if (!(line_stream >> rva_str >> name) || rva_str[0] == '#') {
+            continue;
+        }
+        uint32_t rva = 0;
+        uint32_t size = 0;
+        if (!parse_hex(rva_str, rva) || (line_stream >> size_str && !parse_hex(size_str, size))) {
+            continue;
+        }
+        m_symbols.push_back({rva, size, std::move(name)});
+        ++num_loaded;
+    }
+    std::stable_sort(m_symbols.begin(), m_symbols.end(), [](const Symbol& a, const Symbol& b) {
+        return a.rva < b.rva;
+    });
+    return num_loaded;
+}
+
+void SymbolMap::add(uint32_t rva, std::string name, uint32_t size)
+{
+    auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), rva, [](uint32_t value, const Symbol& symbol) {
+        return value < symbol.rva;
+    });
+    m_symbols.insert(it, {rva, size, std::move(name)});
+}
+
+void SymbolMap::add_section(uint32_t rva, uint32_t size)
+{
+    m_sections.push_back({rva, size});
+}
+
+const SymbolMap::Section* SymbolMap::find_section(uint32_t rva) const
+{
+    for (const auto& section : m_sections) {
+        if (rva - section.rva < section.size) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+const std::string* SymbolMap::find(uint32_t rva) const
+{
+    auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), rva, [](uint32_t value, const Symbol& symbol) {
+        return value < symbol.rva;
+    });
+    if (it == m_symbols.begin()) {
+        return nullptr;
+    }
+    const Symbol& symbol = *std::prev(it);
+    if (symbol.size) {
+        return rva - symbol.rva < symbol.size ? &symbol.name : nullptr;
+    }
+    if (!m_sections.empty()) {
+        const Section* section = find_section(rva);
+        if (!section || find_section(symbol.rva) != section) {
+            return nullptr;
+        }
+    }
+    return &symbol.name;
+}
+
+static bool equals_case_insensitive(const std::string& a, const std::string& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](unsigned char x, unsigned char y) {
+        return std::tolower(x) == std::tolower(y);
+    });
+}
+
+std::string StackSymbolizer::describe(uintptr_t addr) const
+{
+    char buf[64];
+    for (const auto& module : m_modules) {
+        if (addr < module.base || addr - module.base >= module.size) {
+            continue;
+        }
+        auto rva = static_cast<uint32_t>(addr - module.base);
+        if (!m_symbols.empty() && equals_case_insensitive(module.name, m_symbol_module)) {
+            if (const auto* name = m_symbols.find(rva)) {
+                return *name;
+            }
+        }
+        std::snprintf(buf, sizeof(buf), "+0x%X", static_cast<unsigned>(rva));
+        return module.name + buf;
+    }
+    std::snprintf(buf, sizeof(buf), "0x%llX", static_cast<unsigned long long>(addr));
+    return buf;
+}
+
+void write_folded_stacks(const StackSampleTable& table, const StackSymbolizer& symbolizer, std::ostream& out)
+{
+    // Different return addresses in one function fold into the same symbolized stack
+    std::map<std::string, uint64_t> folded;
+    table.for_each([&](const uintptr_t* frames, int depth, uint32_t count) {
+        std::string stack;
+        for (int i = depth - 1; i >= 0; --i) {
+            if (!stack.empty()) {
+                stack += ';';
+            }
+            stack += symbolizer.describe(frames[i]);
+        }
+        folded[stack] += count;
+    });
+
+    std::vector<std::pair<std::string, uint64_t>> sorted{folded.begin(), folded.end()};
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+    for (const auto& [stack, count] : sorted) {
+        out << stack << ' ' << count << '\n';
+    }
+}
@@ -0,0 +1,194 @@
+#include <common/utils/vm-map.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fstream>
+#endif
+
+static constexpr size_t min_usable_free_block = 64 * 1024;
+
+static void add_free_region(std::vector<VmRegion>& regions, uintptr_t base, size_t size)
+{
+    if (!size) {
+        return;
+    }
+    if (!regions.empty() && regions.back().state == VmRegionState::free
+        && regions.back().base + regions.back().size == base) {
+        regions.back().size += size;
+        return;
+    }
+    regions.push_back({base, size, VmRegionState::free, VmRegionType::none});
+}
+
+bool parse_proc_maps(std::istream& stream, std::vector<VmRegion>& out_regions, uintptr_t min_address)
+{
+    out_regions.clear();
+    uintptr_t prev_end = min_address;
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        // start-end perms offset dev inode [pathname]
+        char* end = nullptr;
+        auto start = static_cast<uintptr_t>(std::strtoull(line.c_str(), &end, 16));
+        if (*end != '-') {
+            return false;
+        }
+        auto stop = static_cast<uintptr_t>(std::strtoull(end + 1, &end, 16));
+        if (stop <= start) {
+            return false;
+        }
+        std::istringstream fields{end};
+        std::string perms, offset, dev, inode, path;
+        if (!(fields >> perms >> offset >> dev >> inode)) {
+            return false;
+        }
+        fields >> path;
+
+        if (start > prev_end) {
+            add_free_region(out_regions, prev_end, start - prev_end);
+        }
+        VmRegion region;
+        region.base = start;
+        region.size = stop - start;
+        // Linux has no separate reservations, PROT_NONE mappings are the closest equivalent
+        region.state = perms.rfind("---", 0) == 0 ? VmRegionState::reserved : VmRegionState::committed;
+        if (path.empty() || path[0] == '[') {
+            region.type = VmRegionType::priv;
+        }
+        else {
+            region.type = perms.find('x') != std::string::npos ? VmRegionType::image : VmRegionType::mapped;
+        }
+        out_regions.push_back(region);
+        prev_end = std::max(prev_end, stop);
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool query_vm_regions(std::vector<VmRegion>& out_regions)
+{
+    out_regions.clear();
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    auto addr = reinterpret_cast<uintptr_t>(system_info.lpMinimumApplicationAddress);
+    auto max_addr = reinterpret_cast<uintptr_t>(system_info.lpMaximumApplicationAddress);
+    MEMORY_BASIC_INFORMATION info;
+    while (addr < max_addr && VirtualQuery(reinterpret_cast<void*>(addr), &info, sizeof(info)) == sizeof(info)) {
+        VmRegion region;
+        region.base = reinterpret_cast<uintptr_t>(info.BaseAddress);
+        region.size = info.RegionSize;
+        if (info.State == MEM_FREE) {
+            add_free_region(out_regions, region.base, region.size);
+        }
+        else {
+            region.state = info.State == MEM_COMMIT ? VmRegionState::committed : VmRegionState::reserved;
+            region.type = info.Type == MEM_IMAGE    ? VmRegionType::image
+                        : info.Type == MEM_MAPPED ? VmRegionType::mapped
+                                                  : VmRegionType::priv;
+            out_regions.push_back(region);
+        }
+        if (region.base + region.size <= addr) {
+            break;
+        }
+        addr = region.base + region.size;
+    }
+    return !out_regions.empty();
+}
+
+#else
+
+bool query_vm_regions(std::vector<VmRegion>& out_regions)
+{
+    std::ifstream maps{"/proc/self/maps"};
+    return maps && parse_proc_maps(maps, out_regions);
+}
+
+#endif
+
+VmSummary summarize_vm_regions(const std::vector<VmRegion>& regions)
+{
+    VmSummary summary;
+    summary.num_regions = regions.size();
+    for (const auto& region : regions) {
+        switch (region.state) {
+        case VmRegionState::free: {
+            ++summary.num_free_regions;
+            summary.total_free += region.size;
+            if (region.size >= min_usable_free_block) {
+                ++summary.num_usable_free_blocks;
+            }
+            // Insert into the short sorted list of largest blocks
+            size_t size = region.size;
+            for (auto& largest : summary.largest_free) {
+                if (size > largest) {
+                    std::swap(size, largest);
+                }
+            }
+            break;
+        }
+        case VmRegionState::reserved:
+            summary.reserved += region.size;
+            break;
+        case VmRegionState::committed:
+            summary.committed += region.size;
+            if (region.type == VmRegionType::priv) {
+                summary.committed_private += region.size;
+            }
+            break;
+        }
+        if (region.type == VmRegionType::image) {
+            summary.image += region.size;
+        }
+        else if (region.type == VmRegionType::mapped) {
+            summary.mapped += region.size;
+        }
+    }
+    return summary;
+}
+
+static double to_mib(size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+std::vector<std::string> format_vm_summary(const VmSummary& summary)
+{
+    std::vector<std::string> lines;
+    char buf[192];
+    std::snprintf(
+        buf,
+        sizeof(buf),
+        "Free: %.1f MiB in %u blocks (%u usable), largest: %.1f / %.1f / %.1f / %.1f MiB",
+        to_mib(summary.total_free),
+        static_cast<unsigned>(summary.num_free_regions),
+        static_cast<unsigned>(summary.num_usable_free_blocks),
+        to_mib(summary.largest_free[0]),
+        to_mib(summary.largest_free[1]),
+        to_mib(summary.largest_free[2]),
+        to_mib(summary.largest_free[3]));
+    lines.emplace_back(buf);
+    std::snprintf(
+        buf,
+        sizeof(buf),
+        "Committed: %.1f MiB (%.1f MiB private), reserved: %.1f MiB, regions: %u",
+        to_mib(summary.committed),
+        to_mib(summary.committed_private),
+        to_mib(summary.reserved),
+        static_cast<unsigned>(summary.num_regions));
+    lines.emplace_back(buf);
+    std::snprintf(
+        buf,
+        sizeof(buf),
+        "Images: %.1f MiB, mapped files: %.1f MiB",
+        to_mib(summary.image),
+        to_mib(summary.mapped));
+    lines.emplace_back(buf);
+    return lines;
+}
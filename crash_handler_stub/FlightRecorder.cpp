@@ -0,0 +1,167 @@
+#include "crash_handler_stub/FlightRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    // Slots use a sequence lock: the sequence is 2 * index + 1 while record index is written and 2 * index + 2 once
+    // it is complete, so a reader can tell whether the record it copied is the one it expected and still intact.
+    struct LogSlot
+    {
+        std::atomic<uint32_t> sequence{0};
+        uint32_t len = 0;
+        char text[flight_recorder_max_log_record_len];
+    };
+
+    struct FrameSlot
+    {
+        std::atomic<uint32_t> sequence{0};
+        uint32_t frame = 0;
+        uint32_t duration_us = 0;
+        int64_t end_us = 0;
+    };
+
+    LogSlot g_log_slots[flight_recorder_num_log_records];
+    std::atomic<uint32_t> g_num_log_records{0};
+    FrameSlot g_frame_slots[flight_recorder_num_frames];
+    std::atomic<uint32_t> g_num_frames{0};
+    // Only used by the presenting thread
+    int64_t g_last_frame_end_us = 0;
+
+    int64_t now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t begin_write(std::atomic<uint32_t>& sequence, uint32_t index)
+    {
+        sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return 2 * index + 2;
+    }
+
+    // printf is not safe to use in signal handlers, lines are put together by hand
+    class LineWriter
+    {
+        char m_buf[320];
+        size_t m_len = 0;
+        FlightRecorderWriteFn m_write;
+        void* m_ctx;
+
+    public:
+        LineWriter(FlightRecorderWriteFn write, void* ctx) : m_write(write), m_ctx(ctx)
+        {}
+
+        LineWriter& str(std::string_view value)
+        {
+            size_t len = std::min(value.size(), sizeof(m_buf) - m_len);
+            std::memcpy(m_buf + m_len, value.data(), len);
+            m_len += len;
+            return *this;
+        }
+
+        LineWriter& num(uint64_t value, int min_digits = 1)
+        {
+            char digits[20];
+            int num_digits = 0;
+            do {
+                digits[num_digits++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value || num_digits < min_digits);
+            while (num_digits && m_len < sizeof(m_buf)) {
+                m_buf[m_len++] = digits[--num_digits];
+            }
+            return *this;
+        }
+
+        // Microseconds as milliseconds with two decimals
+        LineWriter& ms(uint64_t us)
+        {
+            return num(us / 1000).str(".").num(us % 1000 / 10, 2);
+        }
+
+        void end_line()
+        {
+            str("\r\n");
+            m_write(m_buf, m_len, m_ctx);
+            m_len = 0;
+        }
+    };
+}
+
+void FlightRecorderAddLogRecord(std::string_view text)
+{
+    uint32_t index = g_num_log_records.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = g_log_slots[index % flight_recorder_num_log_records];
+    uint32_t complete = begin_write(slot.sequence, index);
+    slot.len = static_cast<uint32_t>(std::min(text.size(), flight_recorder_max_log_record_len));
+    std::memcpy(slot.text, text.data(), slot.len);
+    slot.sequence.store(complete, std::memory_order_release);
+}
+
+void FlightRecorderAddFrame()
+{
+    int64_t now = now_us();
+    uint32_t index = g_num_frames.load(std::memory_order_relaxed);
+    auto& slot = g_frame_slots[index % flight_recorder_num_frames];
+    uint32_t complete = begin_write(slot.sequence, index);
+    slot.frame = index;
+    slot.duration_us = g_last_frame_end_us ? static_cast<uint32_t>(now - g_last_frame_end_us) : 0;
+    slot.end_us = now;
+    slot.sequence.store(complete, std::memory_order_release);
+    g_num_frames.store(index + 1, std::memory_order_release);
+    g_last_frame_end_us = now;
+}
+
+void FlightRecorderDump(FlightRecorderWriteFn write, void* ctx)
+{
+    LineWriter line{write, ctx};
+
+    uint32_t num_frames = g_num_frames.load(std::memory_order_acquire);
+    uint32_t first_frame = num_frames > flight_recorder_num_frames ? num_frames - flight_recorder_num_frames : 0;
+    int64_t crash_us = now_us();
+    line.str("Flight recorder: last ").num(num_frames - first_frame).str(" frames (frame, ms before dump, duration ms)");
+    line.end_line();
+    for (uint32_t i = first_frame; i < num_frames; ++i) {
+        const auto& slot = g_frame_slots[i % flight_recorder_num_frames];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        FrameSlot copy;
+        copy.frame = slot.frame;
+        copy.duration_us = slot.duration_us;
+        copy.end_us = slot.end_us;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != 2 * i + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        line.str("  ").num(copy.frame).str("  -").ms(static_cast<uint64_t>(std::max<int64_t>(crash_us - copy.end_us, 0)));
+        line.str("  ").ms(copy.duration_us);
+        line.end_line();
+    }
+
+    uint32_t num_records = g_num_log_records.load(std::memory_order_acquire);
+    uint32_t first_record =
+        num_records > flight_recorder_num_log_records ? num_records - flight_recorder_num_log_records : 0;
+    line.str("Flight recorder: last ").num(num_records - first_record).str(" log records");
+    line.end_line();
+    char text[flight_recorder_max_log_record_len];
+    for (uint32_t i = first_record; i < num_records; ++i) {
+        const auto& slot = g_log_slots[i % flight_recorder_num_log_records];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * i + 2) {
+            // Still being written or already overwritten
+            continue;
+        }
+        size_t len = std::min<size_t>(slot.len, sizeof(text));
+        std::memcpy(text, slot.text, len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        line.str("  ").str({text, len});
+        line.end_line();
+    }
+}
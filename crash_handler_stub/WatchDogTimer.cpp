@@ -15,7 +15,8 @@ class WatchDogTimer::Impl
     HANDLE m_observed_thread_handle;
     DWORD m_observed_thread_id;
     std::chrono::milliseconds m_timeout;
-    std::chrono::time_point<std::chrono::steady_clock> m_last_reset_time;
+    // Reset from the observed thread and read by the checker thread
+    std::atomic<std::chrono::steady_clock::rep> m_last_reset_time{0};
     std::thread m_checker_thread;
     std::condition_variable m_cond_var;
     std::mutex m_mutex;
@@ -39,7 +40,7 @@ public:
         }
         m_observed_thread_id = GetCurrentThreadId();
 
-        m_last_reset_time = std::chrono::steady_clock::now();
+        restart();
         m_exiting = false;
 
         m_checker_thread = std::thread{&WatchDogTimer::Impl::checker_thread_proc, this};
@@ -62,7 +63,7 @@ public:
 
     void restart()
     {
-        m_last_reset_time = std::chrono::steady_clock::now();
+        m_last_reset_time.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
     }
 
     [[nodiscard]] bool is_running() const
@@ -84,8 +85,9 @@ private:
 
     bool check_for_time_out()
     {
-        auto now = std::chrono::steady_clock::now();
-        auto duration = now - m_last_reset_time;
+        std::chrono::steady_clock::time_point last_reset_time{
+            std::chrono::steady_clock::duration{m_last_reset_time.load(std::memory_order_relaxed)}};
+        auto duration = std::chrono::steady_clock::now() - last_reset_time;
         return duration >= m_timeout;
     }
 
@@ -2,21 +2,47 @@
 
 #include "crash_handler_stub.h"
 #include "crash_handler_stub/custom_exceptions.h"
+#include "crash_handler_stub/FlightRecorder.h"
+#include <xlog/BinaryLog.h>
 #include <xlog/xlog.h>
 #include <windows.h>
 #include <csignal>
+#include <cstdio>
 #include <cwchar>
 
 static WCHAR g_module_path[MAX_PATH];
 static LPTOP_LEVEL_EXCEPTION_FILTER g_old_exception_filter;
 static CrashHandlerConfig g_config;
 
+static void WriteFlightRecorderDump()
+{
+    char path[MAX_PATH * 2];
+    std::snprintf(path, std::size(path), "%s\\%s-flight.log", g_config.output_dir, g_config.app_name);
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        xlog::errorf("Failed to create flight recorder dump %s - CreateFileA failed with error %lu", path, GetLastError());
+        return;
+    }
+    FlightRecorderDump([](const char* data, size_t size, void* ctx) {
+        DWORD written;
+        WriteFile(static_cast<HANDLE>(ctx), data, static_cast<DWORD>(size), &written, nullptr);
+    }, file);
+    CloseHandle(file);
+    xlog::infof("Flight recorder dumped to %s", path);
+}
+
 void CrashHandlerStubProcessException(PEXCEPTION_POINTERS exception_ptrs, DWORD thread_id)
 {
+    // Get the text log to disk before decoding XLOG_BIN records, which allocates and may fail with a corrupted heap.
+    // The records still end up before the exception details.
+    xlog::flush();
+    xlog::flush_bin_log();
     xlog::error("Unhandled exception: ExceptionAddress={} ExceptionCode=0x{:x}",
         exception_ptrs->ExceptionRecord->ExceptionAddress, exception_ptrs->ExceptionRecord->ExceptionCode);
     for (unsigned i = 0; i < exception_ptrs->ExceptionRecord->NumberParameters; ++i)
         xlog::error("ExceptionInformation[{}]=0x{:x}", i, exception_ptrs->ExceptionRecord->ExceptionInformation[i]);
+    // Written before the crash handler process starts so the dump sits next to its report
+    WriteFlightRecorderDump();
     xlog::flush();
 
     HANDLE process_handle = nullptr;
@@ -70,6 +96,8 @@ static void InvalidParameterHandler(const wchar_t* expression, const wchar_t* fu
     xlog::errorf("Invalid parameter detected in function %ls. File: %ls Line: %d", function, file, line);
     xlog::errorf("Expression: %ls", expression);
     xlog::flush();
+    xlog::flush_bin_log();
+    xlog::flush();
     RaiseException(custom_exceptions::invalid_parameter, EXCEPTION_NONCONTINUABLE_EXCEPTION, 0, nullptr);
     ExitProcess(0);
 }
@@ -78,6 +106,8 @@ static void SignalHandler(int signal_number)
 {
     xlog::error("Abort signal ({}) received!", signal_number);
     xlog::flush();
+    xlog::flush_bin_log();
+    xlog::flush();
     RaiseException(custom_exceptions::abort, EXCEPTION_NONCONTINUABLE_EXCEPTION, 0, nullptr);
     ExitProcess(0);
 }
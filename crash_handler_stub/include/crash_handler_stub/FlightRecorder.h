@@ -0,0 +1,36 @@
+#pragma once
+
+#include <xlog/Appender.h>
+#include <cstddef>
+#include <string_view>
+
+// Always-on record of the most recent log lines and frames in static memory, dumped when the process crashes so the
+// report has context even if file logging was disabled or had not been flushed yet.
+// Recording does not lock or allocate. Dumping does neither, so it can run in signal and exception handlers; records
+// that are being overwritten at that moment are skipped.
+
+constexpr size_t flight_recorder_num_log_records = 256;
+constexpr size_t flight_recorder_max_log_record_len = 248;
+constexpr size_t flight_recorder_num_frames = 512;
+
+// Stores one formatted log line, longer lines are truncated
+void FlightRecorderAddLogRecord(std::string_view text);
+
+// Stores the end time of a frame. Called once per frame by the thread that presents.
+void FlightRecorderAddFrame();
+
+using FlightRecorderWriteFn = void (*)(const char* data, size_t size, void* ctx);
+
+// Passes the recorded frames and log lines as text to write, oldest first
+void FlightRecorderDump(FlightRecorderWriteFn write, void* ctx);
+
+// Meant to be the tee of an AsyncAppender, so it stores the text formatted for the log file instead of formatting
+// every record a second time
+class FlightRecorderAppender : public xlog::Appender
+{
+protected:
+    void append([[maybe_unused]] xlog::Level level, std::string_view formatted_message) override
+    {
+        FlightRecorderAddLogRecord(formatted_message);
+    }
+};
@@ -0,0 +1,257 @@
+#include "alloc_profiler.h"
+#include "sampler.h"
+#include <common/utils/alloc-profiler.h>
+#include <common/utils/stack-sampling.h>
+#include <common/utils/string-utils.h>
+#include <patch_common/ImportHook.h>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Allocations of RF2 are recorded at its kernel32 heap imports (the same entry points the fast heap uses). The CRT
+// has no frame pointers so callers are found by scanning the stack for return addresses into rf2.exe. The innermost
+// ones usually belong to the CRT allocation functions, engine code follows them.
+
+namespace
+{
+
+constexpr size_t default_top_count = 15;
+constexpr size_t max_top_count = 100;
+
+std::unique_ptr<AllocEventBuffer> g_events;
+AllocProfile g_profile;
+std::atomic<bool> g_recording{false};
+std::atomic<uint32_t> g_frame{0};
+uintptr_t g_code_begin = 0;
+uintptr_t g_code_end = 0;
+
+LPVOID WINAPI heap_alloc_hook(HANDLE heap, DWORD flags, SIZE_T size);
+BOOL WINAPI heap_free_hook(HANDLE heap, DWORD flags, LPVOID mem);
+LPVOID WINAPI heap_realloc_hook(HANDLE heap, DWORD flags, LPVOID mem, SIZE_T size);
+
+ImportHook<LPVOID __stdcall(HANDLE, DWORD, SIZE_T)> heap_alloc_import{"kernel32.dll", "HeapAlloc", heap_alloc_hook};
+ImportHook<BOOL __stdcall(HANDLE, DWORD, LPVOID)> heap_free_import{"kernel32.dll", "HeapFree", heap_free_hook};
+ImportHook<LPVOID __stdcall(HANDLE, DWORD, LPVOID, SIZE_T)> heap_realloc_import{
+    "kernel32.dll",
+    "HeapReAlloc",
+    heap_realloc_hook,
+};
+
+// Inlined so the scan starts at the return address of the hook itself
+__forceinline void capture_callsite(AllocCallsite& callsite)
+{
+#ifdef _MSC_VER
+    auto stack_ptr = reinterpret_cast<uintptr_t>(_AddressOfReturnAddress());
+#else
+    auto stack_ptr = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+#endif
+    const auto* tib = reinterpret_cast<const NT_TIB*>(NtCurrentTeb());
+    scan_stack_for_return_addresses(
+        stack_ptr,
+        reinterpret_cast<uintptr_t>(tib->StackBase),
+        g_code_begin,
+        g_code_end,
+        callsite.frames,
+        alloc_callsite_depth);
+}
+
+void record_alloc(void* ptr, SIZE_T size, const AllocCallsite& callsite)
+{
+    AllocEvent event;
+    event.type = AllocEventType::alloc;
+    event.size = static_cast<uint32_t>(size);
+    event.frame = g_frame.load(std::memory_order_relaxed);
+    event.ptr = reinterpret_cast<uintptr_t>(ptr);
+    event.callsite = callsite;
+    g_events->push(event);
+}
+
+// Must be called before the block is freed so the event is ordered before any reuse of the address
+void record_free(void* ptr)
+{
+    AllocEvent event;
+    event.type = AllocEventType::free;
+    event.frame = g_frame.load(std::memory_order_relaxed);
+    event.ptr = reinterpret_cast<uintptr_t>(ptr);
+    g_events->push(event);
+}
+
+LPVOID WINAPI heap_alloc_hook(HANDLE heap, DWORD flags, SIZE_T size)
+{
+    void* ptr = heap_alloc_import.call_target(heap, flags, size);
+    if (ptr && g_recording.load(std::memory_order_relaxed)) {
+        AllocCallsite callsite;
+        capture_callsite(callsite);
+        record_alloc(ptr, size, callsite);
+    }
+    return ptr;
+}
+
+BOOL WINAPI heap_free_hook(HANDLE heap, DWORD flags, LPVOID mem)
+{
+    if (mem && g_recording.load(std::memory_order_relaxed)) {
+        record_free(mem);
+    }
+    return heap_free_import.call_target(heap, flags, mem);
+}
+
+// Note: if reallocation fails the old block is no longer tracked
+LPVOID WINAPI heap_realloc_hook(HANDLE heap, DWORD flags, LPVOID mem, SIZE_T size)
+{
+    bool recording = g_recording.load(std::memory_order_relaxed);
+    if (mem && recording) {
+        record_free(mem);
+    }
+    void* new_mem = heap_realloc_import.call_target(heap, flags, mem, size);
+    if (new_mem && recording) {
+        AllocCallsite callsite;
+        capture_callsite(callsite);
+        record_alloc(new_mem, size, callsite);
+    }
+    return new_mem;
+}
+
+bool install_hooks()
+{
+    if (heap_alloc_import.is_installed()) {
+        return true;
+    }
+    auto* dos_hdr = reinterpret_cast<const IMAGE_DOS_HEADER*>(GetModuleHandleA(nullptr));
+    auto* nt_hdr = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+        reinterpret_cast<uintptr_t>(dos_hdr) + dos_hdr->e_lfanew);
+    g_code_begin = reinterpret_cast<uintptr_t>(dos_hdr);
+    g_code_end = g_code_begin + nt_hdr->OptionalHeader.SizeOfImage;
+    g_events = std::make_unique<AllocEventBuffer>();
+
+    // Hooks are never removed, recording is switched off instead
+    heap_free_import.install();
+    heap_realloc_import.install();
+    heap_alloc_import.install();
+    if (!heap_free_import.is_installed() || !heap_realloc_import.is_installed() || !heap_alloc_import.is_installed()) {
+        xlog::error("Allocation profiler hooks not installed");
+        return false;
+    }
+    return true;
+}
+
+void drain_events()
+{
+    if (g_events) {
+        g_events->drain([](const AllocEvent& event) { g_profile.add(event); });
+    }
+}
+
+bool parse_sort_key(std::string_view name, AllocSortKey& out_key)
+{
+    if (string_iequals(name, "count")) {
+        out_key = AllocSortKey::count;
+    }
+    else if (string_iequals(name, "bytes")) {
+        out_key = AllocSortKey::bytes;
+    }
+    else if (string_iequals(name, "live")) {
+        out_key = AllocSortKey::live;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool handle_top_command(
+    std::string_view args,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    size_t count = default_top_count;
+    AllocSortKey key = AllocSortKey::count;
+    for (std::string_view token : string_split(args)) {
+        const auto value = string_to_long(token);
+        if (value && *value > 0 && *value <= static_cast<long>(max_top_count)) {
+            count = static_cast<size_t>(*value);
+        }
+        else if (!parse_sort_key(token, key)) {
+            out_output_lines.emplace_back("Usage: allocprof top [count 1-100] [count|bytes|live]");
+            out_status = "Invalid argument.";
+            return true;
+        }
+    }
+
+    drain_events();
+    const StackSymbolizer symbolizer = sampler_create_symbolizer();
+    out_output_lines = g_profile.format_report(symbolizer, count, key, g_frame.load(std::memory_order_relaxed));
+    if (g_events && g_events->num_dropped()) {
+        out_output_lines.emplace_back(
+            "Warning: " + std::to_string(g_events->num_dropped()) + " event(s) dropped (buffer full).");
+    }
+    out_status = "Printed allocation profile.";
+    out_success = true;
+    return true;
+}
+
+} // namespace
+
+void allocprof_on_frame()
+{
+    g_frame.fetch_add(1, std::memory_order_relaxed);
+    if (g_recording.load(std::memory_order_relaxed)) {
+        drain_events();
+    }
+}
+
+bool allocprof_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    const auto args = string_match_command(command, "allocprof");
+    if (!args) {
+        return false;
+    }
+
+    if (string_match_command(*args, "start")) {
+        if (!install_hooks()) {
+            out_status = "Failed to install allocation hooks.";
+            return true;
+        }
+        drain_events();
+        g_profile.reset(g_frame.load(std::memory_order_relaxed));
+        g_recording.store(true, std::memory_order_relaxed);
+        out_status = "Allocation profiling started.";
+        out_success = true;
+        return true;
+    }
+    if (string_match_command(*args, "stop")) {
+        g_recording.store(false, std::memory_order_relaxed);
+        drain_events();
+        out_status = "Allocation profiling stopped.";
+        out_success = true;
+        return true;
+    }
+    if (string_match_command(*args, "reset")) {
+        drain_events();
+        g_profile.reset(g_frame.load(std::memory_order_relaxed));
+        out_status = "Allocation profile reset.";
+        out_success = true;
+        return true;
+    }
+    if (auto top_args = string_match_command(*args, "top")) {
+        return handle_top_command(*top_args, out_success, out_status, out_output_lines);
+    }
+
+    out_output_lines.emplace_back("Usage: allocprof <start | stop | reset | top [count] [count|bytes|live]>");
+    out_status = args->empty() ? "Printed allocprof usage." : "Unknown allocprof subcommand.";
+    out_success = args->empty();
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Folds allocation events recorded since the last frame into the profile. Called once per frame from the Present hook.
+void allocprof_on_frame();
+
+bool allocprof_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
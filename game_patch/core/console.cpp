@@ -1,17 +1,29 @@
 #include "console.h"
+#include "alloc_profiler.h"
 #include "frame_limiter.h"
+#include "frame_memory.h"
+#include "heap.h"
+#include "high_fps.h"
+#include "hitch.h"
+#include "logging.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "vm_monitor.h"
 #include "../misc/misc.h"
 #include "../player/camera.h"
 #include "../rf2/os/console.h"
 #include "../rf2/os/input.h"
 #include "../rf2/rf2.h"
+#include <common/utils/perf-utils.h>
+#include <common/utils/string-utils.h>
 #include <patch_common/FunHook.h>
 #include <patch_common/MemUtils.h>
+#include <patch_common/StaticBufferResizePatch.h>
 #include <windows.h>
+#include <xlog/RateLimit.h>
 #include <xlog/xlog.h>
 #include <algorithm>
 #include <array>
-#include <cctype>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -23,6 +35,8 @@
 
 namespace
 {
+xlog::Logger g_logger{"console", xlog::Logger::root()};
+
 constexpr int console_open_height_px = 320;
 constexpr int console_anim_step_px = 48;
 constexpr COLORREF console_text_color = RGB(96, 255, 128);
@@ -59,13 +73,14 @@ uintptr_t find_pattern(const uint8_t* base, size_t size, const std::array<int, N
 using ExecuteConsoleCommandFn = int(__cdecl*)(char*);
 using WndProcFn = LRESULT(CALLBACK*)(HWND, UINT, WPARAM, LPARAM);
 
+// Points to command table strings of the game or to literals, both live for the whole process
 struct ConsoleCommandInfo
 {
-    std::string name;
-    std::string description;
+    std::string_view name;
+    std::string_view description;
 };
 
-void append_rf2patch_builtin_commands(std::vector<ConsoleCommandInfo>& commands)
+void append_rf2patch_builtin_commands(ArenaVector<ConsoleCommandInfo>& commands)
 {
     commands.push_back({"fov", "fov <num> (0 = auto-scale from 90 at 4:3)"});
     commands.push_back({"maxfps", "maxfps <num> (experimental; 0 = uncapped; render cap applied in Present)"});
@@ -74,12 +89,22 @@ void append_rf2patch_builtin_commands(std::vector<ConsoleCommandInfo>& commands)
     commands.push_back({"directinput", "directinput <0|1> (toggle DirectInput mouse for menus/gameplay)"});
     commands.push_back({"aimslow", "aimslow <0|1> (toggle target-on-enemy aim slowdown)"});
     commands.push_back({"enemycrosshair", "enemycrosshair <0|1> (toggle enemy crosshair variant image)"});
+    commands.push_back({"ftol", "ftol [list | <index|validated|all> <0|1>] (inspect/toggle rewritten __ftol call sites)"});
+    commands.push_back({"perf", "perf [frame | reset | csv [path]] (profiler zone timings)"});
+    commands.push_back({"trace_start", "trace_start [path] (record frames and profiler zones as a Chrome trace)"});
+    commands.push_back({"trace_stop", "trace_stop (finish the trace started by trace_start)"});
+    commands.push_back({"sample_start", "sample_start [rate_hz] (sample RF2 main thread call stacks)"});
+    commands.push_back({"sample_stop", "sample_stop [path] (write sampled stacks in folded flamegraph format)"});
+    commands.push_back({"hitch", "hitch [threshold_ms] (log frames slower than the threshold with main thread stacks; 0 = off)"});
+    commands.push_back({"allocprof", "allocprof <start | stop | reset | top [count] [count|bytes|live]> (RF2 heap allocations per callsite)"});
+    commands.push_back({"vmmap", "vmmap [monitor_interval_s] (address space summary; 0 = background monitor off)"});
+    commands.push_back({"heapstats", "heapstats (live blocks per size class of the fast heap)"});
+    commands.push_back({"log_level", "log_level [<subsystem> <error|warn|info|debug|trace|default>] (list or change log levels)"});
+    commands.push_back({"hookstats", "hookstats [reset] (per-hook calls and cost per frame, profiler builds only)"});
 }
 
 HWND g_console_hooked_game_window = nullptr;
 WndProcFn g_original_game_window_proc = nullptr;
-int g_console_command_log_count = 0;
-int g_console_print_log_count = 0;
 std::vector<std::string> g_console_output_lines{};
 constexpr size_t max_console_output_lines = 300;
 int g_console_refresh_suspension = 0;
@@ -95,7 +120,7 @@ HBRUSH g_console_bg_brush = nullptr;
 HBRUSH g_console_border_brush = nullptr;
 HFONT g_console_font = nullptr;
 std::string g_tab_completion_seed{};
-std::vector<std::string> g_tab_completion_matches{};
+std::vector<std::string_view> g_tab_completion_matches{};
 size_t g_tab_completion_index = 0;
 HWND g_known_game_window = nullptr;
 
@@ -108,6 +133,12 @@ FunHook<void __cdecl(const char*, int)> g_console_print_hook{
     console_print_hook,
 };
 
+// Room for more commands than the 0x190 entries of the RF2 table. RF2 stops registering at its own limit, which is an
+// immediate in its registration code and is not raised by this patch.
+constexpr int resized_max_commands = 0x400;
+StaticBufferResizePatch<rf2::os::console::CommandEntry*> g_command_table_resize_patch{
+    rf2::os::console::command_table_addr, rf2::os::console::max_commands, resized_max_commands};
+
 bool is_current_process_window(HWND window)
 {
     if (!window || !IsWindow(window)) {
@@ -188,52 +219,6 @@ HWND resolve_target_window(HWND window)
     return find_best_process_window();
 }
 
-std::string trim_ascii_copy(std::string value)
-{
-    auto not_space = [](unsigned char c) { return !std::isspace(c); };
-    value.erase(value.begin(), std::find_if(value.begin(), value.end(), not_space));
-    value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(), value.end());
-    return value;
-}
-
-std::string to_lower_ascii_copy(std::string value)
-{
-    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-    return value;
-}
-
-bool starts_with_case_insensitive(std::string_view value, std::string_view prefix)
-{
-    if (prefix.size() > value.size()) {
-        return false;
-    }
-    for (size_t i = 0; i < prefix.size(); ++i) {
-        unsigned char lc = static_cast<unsigned char>(value[i]);
-        unsigned char rc = static_cast<unsigned char>(prefix[i]);
-        if (std::tolower(lc) != std::tolower(rc)) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool equals_case_insensitive(std::string_view left, std::string_view right)
-{
-    return left.size() == right.size() && starts_with_case_insensitive(left, right);
-}
-
-bool contains_case_insensitive(std::string_view haystack, std::string_view needle)
-{
-    if (needle.empty()) {
-        return true;
-    }
-    const std::string haystack_lc = to_lower_ascii_copy(std::string{haystack});
-    const std::string needle_lc = to_lower_ascii_copy(std::string{needle});
-    return haystack_lc.find(needle_lc) != std::string::npos;
-}
-
 int get_control_profile_count()
 {
     const int count = rf2::os::input::control_profile_count;
@@ -468,19 +453,13 @@ void apply_runtime_mouse_sensitivity(float aim_x, float aim_y)
     rf2::os::input::mouse_set_sensitivity(arg0, arg1);
 }
 
-bool try_parse_positive_float(const std::string& text, float& out_value)
+bool try_parse_positive_float(std::string_view text, float& out_value)
 {
-    size_t parsed_len = 0;
-    try {
-        out_value = std::stof(text, &parsed_len);
-    }
-    catch (...) {
-        return false;
-    }
-
-    if (parsed_len != text.size() || !std::isfinite(out_value) || out_value < 0.0f) {
+    const auto value = string_to_float(text);
+    if (!value || !std::isfinite(*value) || *value < 0.0f) {
         return false;
     }
+    out_value = *value;
     return true;
 }
 
@@ -594,10 +573,14 @@ void scroll_console_output_by(WPARAM scroll_cmd)
 
 void append_console_output_line(std::string line)
 {
-    line = trim_ascii_copy(std::move(line));
-    if (line.empty()) {
+    const std::string_view trimmed = trim(line);
+    if (trimmed.empty()) {
         return;
     }
+    // Trimmed in place so the line is moved into the output without another copy
+    const size_t begin = static_cast<size_t>(trimmed.data() - line.data());
+    line.erase(begin + trimmed.size());
+    line.erase(0, begin);
 
     if (g_console_scroll_lines_from_bottom > 0) {
         ++g_console_scroll_lines_from_bottom;
@@ -638,13 +621,14 @@ void append_console_output_text(const char* text)
     resume_console_output_refresh();
 }
 
-bool collect_rf2_console_commands(std::vector<ConsoleCommandInfo>& out_commands)
+bool collect_rf2_console_commands(ArenaVector<ConsoleCommandInfo>& out_commands)
 {
     out_commands.clear();
 
+    const bool resized = g_command_table_resize_patch.is_installed();
     const int count_raw = rf2::os::console::command_count;
-    const int count = std::clamp(count_raw, 0, rf2::os::console::max_commands);
-    auto** table = rf2::os::console::command_table_entries();
+    const int count = std::clamp(count_raw, 0, resized ? resized_max_commands : rf2::os::console::max_commands);
+    auto** table = resized ? g_command_table_resize_patch.get_buffer() : rf2::os::console::command_table_entries();
     if (!table || count <= 0) {
         return false;
     }
@@ -658,7 +642,7 @@ bool collect_rf2_console_commands(std::vector<ConsoleCommandInfo>& out_commands)
 
         ConsoleCommandInfo info{};
         info.name = entry->name;
-        if (entry->description && entry->description[0] != '\0') {
+        if (entry->description) {
             info.description = entry->description;
         }
         out_commands.push_back(std::move(info));
@@ -666,42 +650,40 @@ bool collect_rf2_console_commands(std::vector<ConsoleCommandInfo>& out_commands)
     return !out_commands.empty();
 }
 
-bool collect_all_console_commands(std::vector<ConsoleCommandInfo>& out_commands)
+bool collect_all_console_commands(ArenaVector<ConsoleCommandInfo>& out_commands)
 {
-    std::vector<ConsoleCommandInfo> stock_commands;
-    collect_rf2_console_commands(stock_commands);
-    out_commands = std::move(stock_commands);
+    collect_rf2_console_commands(out_commands);
     append_rf2patch_builtin_commands(out_commands);
     return !out_commands.empty();
 }
 
-bool parse_search_command_request(const std::string& command, std::string& out_needle)
+bool parse_search_command_request(std::string_view command, std::string_view& out_needle)
 {
-    const std::string trimmed = trim_ascii_copy(command);
+    const std::string_view trimmed = trim(command);
     if (trimmed.empty() || trimmed.front() != '.') {
         return false;
     }
 
-    out_needle = trim_ascii_copy(trimmed.substr(1));
+    out_needle = trim(trimmed.substr(1));
     return true;
 }
 
-bool print_rf2_command_search(const std::string& needle)
+bool print_rf2_command_search(std::string_view needle)
 {
-    std::vector<ConsoleCommandInfo> commands;
+    auto commands = make_arena_vector<ConsoleCommandInfo>(frame_arena());
     if (!collect_all_console_commands(commands)) {
         append_console_output_line("No console commands are currently available.");
         return false;
     }
 
     suspend_console_output_refresh();
-    append_console_output_line("Command search for: " + needle);
+    append_console_output_line("Command search for: " + std::string{needle});
     int printed = 0;
     for (const auto& cmd : commands) {
-        if (!contains_case_insensitive(cmd.name, needle)) {
+        if (!string_icontains(cmd.name, needle)) {
             continue;
         }
-        std::string line = cmd.name;
+        std::string line{cmd.name};
         if (!cmd.description.empty()) {
             line += " - ";
             line += cmd.description;
@@ -712,7 +694,8 @@ bool print_rf2_command_search(const std::string& needle)
 
     char summary[120] = {};
     if (printed == 0) {
-        std::snprintf(summary, sizeof(summary), "No commands contain \"%s\".", needle.c_str());
+        std::snprintf(summary, sizeof(summary), "No commands contain \"%.*s\".", static_cast<int>(needle.size()),
+            needle.data());
         append_console_output_line(summary);
         resume_console_output_refresh();
         return false;
@@ -731,7 +714,7 @@ void reset_tab_completion_state()
     g_tab_completion_index = 0;
 }
 
-bool apply_console_edit_text(const std::string& text)
+bool apply_console_edit_text(std::string_view text)
 {
     g_console_input_text = text.substr(0, max_console_input_chars);
     return true;
@@ -739,13 +722,13 @@ bool apply_console_edit_text(const std::string& text)
 
 bool tab_complete_console_input()
 {
-    const std::string current = trim_ascii_copy(g_console_input_text);
+    const std::string_view current = trim(g_console_input_text);
     if (current.empty()) {
         set_console_status_text("Type part of a command, then press Tab.");
         reset_tab_completion_state();
         return false;
     }
-    if (current.find_first_of(" \t") != std::string::npos) {
+    if (current.find_first_of(" \t") != std::string_view::npos) {
         set_console_status_text("Tab completion only applies to the command name.");
         reset_tab_completion_state();
         return false;
@@ -754,7 +737,7 @@ bool tab_complete_console_input()
     bool current_is_match = false;
     size_t current_match_index = 0;
     for (size_t i = 0; i < g_tab_completion_matches.size(); ++i) {
-        if (equals_case_insensitive(g_tab_completion_matches[i], current)) {
+        if (string_iequals(g_tab_completion_matches[i], current)) {
             current_is_match = true;
             current_match_index = i;
             break;
@@ -763,13 +746,13 @@ bool tab_complete_console_input()
 
     bool rebuild_matches = g_tab_completion_matches.empty();
     if (!rebuild_matches) {
-        if (!equals_case_insensitive(current, g_tab_completion_seed) && !current_is_match) {
+        if (!string_iequals(current, g_tab_completion_seed) && !current_is_match) {
             rebuild_matches = true;
         }
     }
 
     if (rebuild_matches) {
-        std::vector<ConsoleCommandInfo> commands;
+        auto commands = make_arena_vector<ConsoleCommandInfo>(frame_arena());
         if (!collect_all_console_commands(commands)) {
             set_console_status_text("No console commands available.");
             reset_tab_completion_state();
@@ -778,7 +761,7 @@ bool tab_complete_console_input()
 
         g_tab_completion_matches.clear();
         for (const auto& cmd : commands) {
-            if (starts_with_case_insensitive(cmd.name, current)) {
+            if (string_istarts_with(cmd.name, current)) {
                 g_tab_completion_matches.push_back(cmd.name);
             }
         }
@@ -801,48 +784,41 @@ bool tab_complete_console_input()
         return false;
     }
 
-    const std::string& completion = g_tab_completion_matches[g_tab_completion_index];
+    const std::string_view completion = g_tab_completion_matches[g_tab_completion_index];
     apply_console_edit_text(completion);
 
     char status[120] = {};
     std::snprintf(
         status,
         sizeof(status),
-        "Tab completion %zu/%zu: %s",
+        "Tab completion %zu/%zu: %.*s",
         g_tab_completion_index + 1,
         g_tab_completion_matches.size(),
-        completion.c_str());
+        static_cast<int>(completion.size()),
+        completion.data());
     set_console_status_text(status);
     return true;
 }
 
-bool is_help_command_request(const std::string& command)
+bool is_help_command_request(std::string_view command)
 {
-    const std::string trimmed = trim_ascii_copy(command);
-    if (trimmed.empty()) {
-        return false;
-    }
-
-    const std::string lowered = to_lower_ascii_copy(trimmed);
-    if (lowered == "help" || lowered == "?" || lowered == "commands") {
-        return true;
-    }
-    return false;
+    const std::string_view trimmed = trim(command);
+    return string_iequals(trimmed, "help") || trimmed == "?" || string_iequals(trimmed, "commands");
 }
 
 bool print_rf2_command_help()
 {
-    std::vector<ConsoleCommandInfo> stock_commands;
+    auto stock_commands = make_arena_vector<ConsoleCommandInfo>(frame_arena());
     collect_rf2_console_commands(stock_commands);
 
-    std::vector<ConsoleCommandInfo> rf2patch_commands;
+    auto rf2patch_commands = make_arena_vector<ConsoleCommandInfo>(frame_arena());
     append_rf2patch_builtin_commands(rf2patch_commands);
 
     suspend_console_output_refresh();
     append_console_output_line("Stock RF2 commands:");
     int stock_printed = 0;
     for (const auto& cmd : stock_commands) {
-        std::string line = cmd.name;
+        std::string line{cmd.name};
         if (!cmd.description.empty()) {
             line += " - ";
             line += cmd.description;
@@ -857,7 +833,7 @@ bool print_rf2_command_help()
     append_console_output_line("SOPOT commands:");
     int rf2patch_printed = 0;
     for (const auto& cmd : rf2patch_commands) {
-        std::string line = cmd.name;
+        std::string line{cmd.name};
         if (!cmd.description.empty()) {
             line += " - ";
             line += cmd.description;
@@ -949,7 +925,7 @@ void install_console_print_hook()
 
     const uintptr_t print_addr = find_console_print_target();
     if (!print_addr) {
-        xlog::warn("Could not locate RF2 console print sink (nullsub_112)");
+        XLOG_WARN(g_logger, "Could not locate RF2 console print sink (nullsub_112)");
         installed = true;
         return;
     }
@@ -957,7 +933,7 @@ void install_console_print_hook()
     g_console_print_hook.set_addr(print_addr);
     g_console_print_hook.install();
     installed = true;
-    xlog::info("Installed RF2 console output hook at 0x{:X}", static_cast<unsigned>(print_addr));
+    XLOG_INFO(g_logger, "Installed RF2 console output hook at 0x{:X}", static_cast<unsigned>(print_addr));
 }
 
 bool rf2_console_command_api_available()
@@ -971,28 +947,25 @@ bool rf2_console_command_api_available()
     return fn_bytes[0] == 0x55 && fn_bytes[1] == 0x8B && fn_bytes[2] == 0xEC;
 }
 
-int execute_rf2_console_command(const std::string& raw_command)
+int execute_rf2_console_command(std::string_view raw_command)
 {
-    const std::string command = trim_ascii_copy(raw_command);
-    if (command.empty()) {
+    const std::string_view command = trim(raw_command);
+    if (command.empty() || command.size() > max_console_input_chars) {
         return -1;
     }
 
     if (!rf2_console_command_api_available()) {
-        xlog::warn("RF2 console command API signature mismatch; command execution unavailable");
+        XLOG_WARN(g_logger, "RF2 console command API signature mismatch; command execution unavailable");
         return -2;
     }
 
     auto execute_fn = rf2::os::console::execute_command_ptr();
 
-    std::vector<char> command_buf(command.begin(), command.end());
-    command_buf.push_back('\0');
+    std::array<char, max_console_input_chars + 1> command_buf{};
+    std::memcpy(command_buf.data(), command.data(), command.size());
     const int result = execute_fn(command_buf.data());
 
-    if (g_console_command_log_count < 32) {
-        ++g_console_command_log_count;
-        xlog::info("RF2 console command: \"{}\" -> {}", command, result);
-    }
+    XLOG_PER_INTERVAL(g_logger, xlog::Level::info, 8, 1000, "RF2 console command: \"{}\" -> {}", command, result);
     return result;
 }
 
@@ -1000,90 +973,84 @@ void __cdecl console_print_hook(const char* text, int channel)
 {
     (void)channel;
     append_console_output_text(text);
-    if (g_console_print_log_count < 48 && text && *text) {
-        ++g_console_print_log_count;
-        xlog::info("RF2 console output: {}", text);
+    if (text && *text) {
+        XLOG_PER_INTERVAL(g_logger, xlog::Level::info, 16, 1000, "RF2 console output: {}", text);
     }
     g_console_print_hook.call_target(text, channel);
 }
 
 void run_console_command_from_ui()
 {
-    const std::string command = trim_ascii_copy(g_console_input_text);
+    const std::string_view command = trim(g_console_input_text);
     if (command.empty()) {
         set_console_status_text("Enter a command.");
         return;
     }
 
     reset_tab_completion_state();
-    append_console_output_line("> " + command);
-
-    if (starts_with_case_insensitive(command, "ms")) {
-        const bool has_token_boundary =
-            (command.size() == 2)
-            || std::isspace(static_cast<unsigned char>(command[2])) != 0;
-        if (has_token_boundary) {
-            const std::string arg_text = trim_ascii_copy(command.substr(2));
-            if (arg_text.empty()) {
-                float aim_x = 0.0f;
-                float aim_y = 0.0f;
-                if (try_get_mouse_aim_sensitivity(aim_x, aim_y)) {
-                    char line[160] = {};
-                    if (std::fabs(aim_x - aim_y) < 0.0001f) {
-                        std::snprintf(line, sizeof(line), "mouse sensitivity = %.6g", aim_x);
-                    }
-                    else {
-                        std::snprintf(line, sizeof(line), "mouse sensitivity x=%.6g y=%.6g", aim_x, aim_y);
-                    }
-                    append_console_output_line(line);
-                    set_console_status_text("Printed current sensitivity.");
+    append_console_output_line("> " + std::string{command});
+
+    if (const auto ms_args = string_match_command(command, "ms")) {
+        const std::string_view arg_text = *ms_args;
+        if (arg_text.empty()) {
+            float aim_x = 0.0f;
+            float aim_y = 0.0f;
+            if (try_get_mouse_aim_sensitivity(aim_x, aim_y)) {
+                char line[160] = {};
+                if (std::fabs(aim_x - aim_y) < 0.0001f) {
+                    std::snprintf(line, sizeof(line), "mouse sensitivity = %.6g", aim_x);
                 }
                 else {
-                    append_console_output_line("Could not query gameplay mouse sensitivity.");
-                    set_console_status_text("Sensitivity query failed.");
+                    std::snprintf(line, sizeof(line), "mouse sensitivity x=%.6g y=%.6g", aim_x, aim_y);
                 }
-                g_console_input_text.clear();
-                return;
+                append_console_output_line(line);
+                set_console_status_text("Printed current sensitivity.");
             }
-
-            float value = 0.0f;
-            if (!try_parse_positive_float(arg_text, value)) {
-                append_console_output_line("Usage: ms <num>");
-                set_console_status_text("Invalid sensitivity value.");
-                g_console_input_text.clear();
-                return;
+            else {
+                append_console_output_line("Could not query gameplay mouse sensitivity.");
+                set_console_status_text("Sensitivity query failed.");
             }
+            g_console_input_text.clear();
+            return;
+        }
 
-            float raw_aim_x = 0.0f;
-            float raw_aim_y = 0.0f;
-            convert_uniform_to_raw_aim_sensitivity(value, raw_aim_x, raw_aim_y);
-            const bool updated_directinput_scale = misc_set_mouse_aim_sensitivity(value);
-            const bool updated_profile_table = apply_control_profile_look_sensitivity(raw_aim_x, raw_aim_y);
-            rf2::os::input::mouse_aim_sensitivity_x = raw_aim_x;
-            rf2::os::input::mouse_aim_sensitivity_y = raw_aim_y;
-            {
-                char line[128] = {};
-                std::snprintf(line, sizeof(line), "gameplay mouse sensitivity set to %.6g", value);
-                append_console_output_line(line);
-                if (updated_directinput_scale && rf2::os::input::mouse_system_initialized != 0) {
-                    set_console_status_text("Applied sensitivity.");
-                }
-                else if (updated_directinput_scale) {
-                    set_console_status_text("Applied gameplay sensitivity scale; runtime input not initialized.");
-                }
-                else if (updated_profile_table) {
-                    set_console_status_text("Applied gameplay sensitivity; DirectInput runtime not initialized.");
-                }
-                else if (rf2::os::input::mouse_system_initialized != 0) {
-                    set_console_status_text("Applied runtime sensitivity; gameplay profile table unavailable.");
-                }
-                else {
-                    set_console_status_text("Sensitivity saved; gameplay/runtime input not initialized yet.");
-                }
-            }
+        float value = 0.0f;
+        if (!try_parse_positive_float(arg_text, value)) {
+            append_console_output_line("Usage: ms <num>");
+            set_console_status_text("Invalid sensitivity value.");
             g_console_input_text.clear();
             return;
         }
+
+        float raw_aim_x = 0.0f;
+        float raw_aim_y = 0.0f;
+        convert_uniform_to_raw_aim_sensitivity(value, raw_aim_x, raw_aim_y);
+        const bool updated_directinput_scale = misc_set_mouse_aim_sensitivity(value);
+        const bool updated_profile_table = apply_control_profile_look_sensitivity(raw_aim_x, raw_aim_y);
+        rf2::os::input::mouse_aim_sensitivity_x = raw_aim_x;
+        rf2::os::input::mouse_aim_sensitivity_y = raw_aim_y;
+        {
+            char line[128] = {};
+            std::snprintf(line, sizeof(line), "gameplay mouse sensitivity set to %.6g", value);
+            append_console_output_line(line);
+            if (updated_directinput_scale && rf2::os::input::mouse_system_initialized != 0) {
+                set_console_status_text("Applied sensitivity.");
+            }
+            else if (updated_directinput_scale) {
+                set_console_status_text("Applied gameplay sensitivity scale; runtime input not initialized.");
+            }
+            else if (updated_profile_table) {
+                set_console_status_text("Applied gameplay sensitivity; DirectInput runtime not initialized.");
+            }
+            else if (rf2::os::input::mouse_system_initialized != 0) {
+                set_console_status_text("Applied runtime sensitivity; gameplay profile table unavailable.");
+            }
+            else {
+                set_console_status_text("Sensitivity saved; gameplay/runtime input not initialized yet.");
+            }
+        }
+        g_console_input_text.clear();
+        return;
     }
 
     std::string custom_status;
@@ -1091,7 +1058,15 @@ void run_console_command_from_ui()
     bool custom_success = false;
     if (frame_limiter_try_handle_console_command(command, custom_success, custom_status, custom_lines)
         || misc_try_handle_console_command(command, custom_success, custom_status, custom_lines)
-        || camera_try_handle_console_command(command, custom_success, custom_status, custom_lines)) {
+        || camera_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || high_fps_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || profiler_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || sampler_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || hitch_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || heap_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || allocprof_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || vm_monitor_try_handle_console_command(command, custom_success, custom_status, custom_lines)
+        || logging_try_handle_console_command(command, custom_success, custom_status, custom_lines)) {
         for (const auto& line : custom_lines) {
             append_console_output_line(line);
         }
@@ -1105,7 +1080,7 @@ void run_console_command_from_ui()
         return;
     }
 
-    std::string search_needle;
+    std::string_view search_needle;
     if (parse_search_command_request(command, search_needle)) {
         if (search_needle.empty()) {
             append_console_output_line("Usage: . <string>");
@@ -1135,10 +1110,11 @@ void run_console_command_from_ui()
     const int result = execute_rf2_console_command(command);
     char status[160] = {};
     if (result == 0) {
-        std::snprintf(status, sizeof(status), "Executed: %s", command.c_str());
+        std::snprintf(status, sizeof(status), "Executed: %.*s", static_cast<int>(command.size()), command.data());
     }
     else {
-        std::snprintf(status, sizeof(status), "Command failed (code %d): %s", result, command.c_str());
+        std::snprintf(status, sizeof(status), "Command failed (code %d): %.*s", result, static_cast<int>(command.size()),
+            command.data());
     }
     set_console_status_text(status);
     g_console_input_text.clear();
@@ -1371,7 +1347,8 @@ void draw_console_overlay(HWND target_window)
     }
 
     SetTextColor(dc, console_text_color);
-    std::string input_line = "> " + g_console_input_text;
+    ArenaString input_line = make_arena_string(frame_arena(), "> ");
+    input_line += g_console_input_text;
     if (g_console_is_open) {
         input_line.push_back('_');
     }
@@ -1526,6 +1503,7 @@ void install_game_window_proc_hook(HWND window)
 void console_install_output_hook()
 {
     install_console_print_hook();
+    g_command_table_resize_patch.install();
 }
 
 void console_attach_to_window(HWND window)
@@ -1541,6 +1519,7 @@ bool console_is_open()
 
 void console_on_present(HWND target_window)
 {
+    PERF_ZONE("console_render");
     HWND resolved = resolve_target_window(target_window ? target_window : g_console_hooked_game_window);
     if (!resolved || !IsWindow(resolved)) {
         return;
@@ -1,11 +1,13 @@
 #include "frame_limiter.h"
 #include "../rf2/gr/gr.h"
 #include "../rf2/os/timer.h"
+#include <common/utils/perf-utils.h>
+#include <common/utils/string-utils.h>
 #include <patch_common/FunHook.h>
 #include <windows.h>
+#include <xlog/RateLimit.h>
 #include <xlog/xlog.h>
 #include <algorithm>
-#include <cctype>
 #include <cstdint>
 #include <cmath>
 #include <cstdio>
@@ -14,6 +16,8 @@
 namespace
 {
 
+xlog::Logger g_logger{"frame_limiter", xlog::Logger::root()};
+
 constexpr float min_configurable_max_fps = 10.0f;
 constexpr float max_configurable_max_fps = 240.0f;
 constexpr float default_max_fps = 240.0f;
@@ -31,7 +35,6 @@ bool g_experimental_fps_stabilization_enabled = false;
 std::string g_settings_path{};
 bool g_logged_vsync_disable = false;
 bool g_hooks_installed = false;
-int g_frametime_reset_log_count = 0;
 LARGE_INTEGER g_qpc_frequency{};
 bool g_qpc_initialized = false;
 bool g_present_limiter_initialized = false;
@@ -49,47 +52,16 @@ FunHook<void __cdecl()> g_frametime_reset_hook{
     frametime_reset_hook,
 };
 
-std::string trim_ascii_copy(std::string value)
-{
-    auto not_space = [](unsigned char c) { return !std::isspace(c); };
-    value.erase(value.begin(), std::find_if(value.begin(), value.end(), not_space));
-    value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(), value.end());
-    return value;
-}
-
-bool starts_with_case_insensitive(std::string_view value, std::string_view prefix)
-{
-    if (prefix.size() > value.size()) {
-        return false;
-    }
-    for (size_t i = 0; i < prefix.size(); ++i) {
-        unsigned char lc = static_cast<unsigned char>(value[i]);
-        unsigned char rc = static_cast<unsigned char>(prefix[i]);
-        if (std::tolower(lc) != std::tolower(rc)) {
-            return false;
-        }
-    }
-    return true;
-}
-
 bool parse_bool_like(std::string_view value, bool& out_value)
 {
-    std::string trimmed = trim_ascii_copy(std::string{value});
-    if (trimmed.empty()) {
-        return false;
-    }
-
-    std::transform(trimmed.begin(), trimmed.end(), trimmed.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-
-    if (trimmed == "1" || trimmed == "true" || trimmed == "on" || trimmed == "yes")
+    value = trim(value);
+    if (value == "1" || string_iequals(value, "true") || string_iequals(value, "on") || string_iequals(value, "yes"))
     {
         out_value = true;
         return true;
     }
 
-    if (trimmed == "0" || trimmed == "false" || trimmed == "off" || trimmed == "no")
+    if (value == "0" || string_iequals(value, "false") || string_iequals(value, "off") || string_iequals(value, "no"))
     {
         out_value = false;
         return true;
@@ -120,7 +92,8 @@ void apply_frametime_limits(bool log)
     rf2::os::timer::frametime_max = default_frametime_max;
 
     if (log) {
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Applied RF2 frametime bounds: frametime_min={}, frametime_max={} (render cap handled in Present hook)",
             frametime_min,
             default_frametime_max);
@@ -161,7 +134,7 @@ void install_hooks_if_needed()
 
     g_frametime_reset_hook.install();
     g_hooks_installed = true;
-    xlog::info("Installed RF2 frametime reset hook");
+    XLOG_INFO(g_logger, "Installed RF2 frametime reset hook");
 }
 
 void __cdecl frametime_reset_hook()
@@ -169,14 +142,17 @@ void __cdecl frametime_reset_hook()
     g_frametime_reset_hook.call_target();
     apply_frametime_limits(false);
 
-    if (g_frametime_reset_log_count < 4) {
-        ++g_frametime_reset_log_count;
-        xlog::info("Reapplied RF2 frametime limits after frametime reset");
-    }
+    XLOG_BIN_PER_INTERVAL(
+        g_logger,
+        xlog::Level::info,
+        4,
+        10000,
+        "Reapplied RF2 frametime limits after frametime reset");
 }
 
 void enforce_present_fps_cap()
 {
+    PERF_ZONE("limiter_wait");
     const float max_fps = get_effective_max_fps();
     if (max_fps <= 0.0f || g_vsync_enabled) {
         return;
@@ -324,7 +300,8 @@ void save_showfps_to_settings()
             g_show_fps_overlay ? "1" : "0",
             g_settings_path.c_str()))
     {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "Failed to persist r_showfps={} to {}",
             g_show_fps_overlay ? 1 : 0,
             g_settings_path);
@@ -345,35 +322,23 @@ void save_max_fps_to_settings()
         std::snprintf(value, sizeof(value), "%.3f", g_max_fps);
     }
     if (!WritePrivateProfileStringA("sopot", "max_fps", value, g_settings_path.c_str())) {
-        xlog::warn("Failed to persist max_fps={} to {}", value, g_settings_path);
+        XLOG_WARN(g_logger, "Failed to persist max_fps={} to {}", value, g_settings_path);
     }
 }
 
-bool parse_max_fps_command_value(std::string_view command, float& out_value)
+bool parse_max_fps_command_value(std::string_view args, float& out_value)
 {
-    const std::string trimmed = trim_ascii_copy(std::string{command});
-    if (!starts_with_case_insensitive(trimmed, "maxfps")) {
-        return false;
-    }
-
-    if (trimmed.size() == 6) {
+    if (args.empty()) {
         out_value = g_max_fps;
         return true;
     }
 
-    std::string remainder = trim_ascii_copy(trimmed.substr(6));
-    if (remainder.empty()) {
-        out_value = g_max_fps;
-        return true;
-    }
-
-    try {
-        out_value = std::stof(remainder);
-        return std::isfinite(out_value);
-    }
-    catch (...) {
+    const auto value = string_to_float(args);
+    if (!value || !std::isfinite(*value)) {
         return false;
     }
+    out_value = *value;
+    return true;
 }
 
 } // namespace
@@ -384,7 +349,8 @@ void frame_limiter_apply_runtime_overrides()
     rf2::gr::always_block_for_vsync = g_vsync_enabled ? 1 : 0;
     if (!g_logged_vsync_disable) {
         g_logged_vsync_disable = true;
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Applied RF2 vsync state (cap_framerate_to_vsync={}, always_block_for_vsync={})",
             g_vsync_enabled ? 1 : 0,
             g_vsync_enabled ? 1 : 0);
@@ -405,10 +371,12 @@ void frame_limiter_apply_settings(const Rf2PatchSettings& settings)
     reset_present_limiter_state();
 
     if (!g_experimental_fps_stabilization_enabled) {
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Experimental FPS stabilization is disabled (experimental_fps_stabilization=0).");
         if (requested_max_fps > 0.0f) {
-            xlog::warn(
+            XLOG_WARN(
+                g_logger,
                 "max_fps={} configured but experimental FPS stabilization is disabled; render cap will not be enforced.",
                 requested_max_fps);
         }
@@ -418,20 +386,23 @@ void frame_limiter_apply_settings(const Rf2PatchSettings& settings)
     install_hooks_if_needed();
     apply_frametime_limits(true);
 
-    xlog::info(
+    XLOG_INFO(
+        g_logger,
         "Applied frame limiter settings (experimental): requested_max_fps={}, effective_max_fps={} (0=uncapped), vsync={}, r_showfps={} (render cap in Present)",
         requested_max_fps,
         get_effective_max_fps(),
         g_vsync_enabled ? 1 : 0,
         g_show_fps_overlay ? 1 : 0);
     if (requested_max_fps > max_configurable_max_fps) {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "Configured max_fps={} exceeds safety clamp; clamped to {}",
             requested_max_fps,
             max_configurable_max_fps);
     }
     if (requested_max_fps <= 0.0f) {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "max_fps=0 configured (uncapped). Some RF2 systems are frame-bound and may behave differently at very high FPS.");
     }
 }
@@ -517,7 +488,7 @@ void frame_limiter_draw_overlay(HWND target_window)
 }
 
 bool frame_limiter_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines)
@@ -526,19 +497,18 @@ bool frame_limiter_try_handle_console_command(
     out_status.clear();
     out_output_lines.clear();
 
-    const std::string trimmed = trim_ascii_copy(command);
-    const bool is_showfps_command = starts_with_case_insensitive(trimmed, "r_showfps");
-    const bool is_maxfps_command = starts_with_case_insensitive(trimmed, "maxfps");
+    const auto showfps_args = string_match_command(command, "r_showfps");
+    const auto maxfps_args = string_match_command(command, "maxfps");
 
-    if (!g_experimental_fps_stabilization_enabled && is_maxfps_command) {
+    if (!g_experimental_fps_stabilization_enabled && maxfps_args) {
         out_output_lines.emplace_back("Experimental FPS stabilization is disabled.");
         out_output_lines.emplace_back("Enable sopot_settings.ini option: experimental_fps_stabilization=1");
         out_status = "FPS stabilization command unavailable while experimental option is disabled.";
         return true;
     }
 
-    if (is_showfps_command) {
-        const std::string arg_text = trim_ascii_copy(trimmed.substr(9));
+    if (showfps_args) {
+        const std::string_view arg_text = *showfps_args;
         if (arg_text.empty()) {
             char line[96] = {};
             std::snprintf(line, sizeof(line), "r_showfps is %d.", g_show_fps_overlay ? 1 : 0);
@@ -565,12 +535,12 @@ bool frame_limiter_try_handle_console_command(
         return true;
     }
 
-    if (!is_maxfps_command) {
+    if (!maxfps_args) {
         return false;
     }
 
     float value = 0.0f;
-    if (!parse_max_fps_command_value(trimmed, value)) {
+    if (!parse_max_fps_command_value(*maxfps_args, value)) {
         out_output_lines.push_back("Usage: maxfps <num>");
         out_output_lines.push_back("Use maxfps 0 for uncapped.");
         out_output_lines.push_back("RF2 render cap is enforced in Present; very high values may expose frame-bound systems.");
@@ -578,7 +548,7 @@ bool frame_limiter_try_handle_console_command(
         return true;
     }
 
-    if (trimmed.size() == 6) {
+    if (maxfps_args->empty()) {
         char line[192] = {};
         if (g_max_fps <= 0.0f) {
             std::snprintf(line, sizeof(line), "maxfps is uncapped (requested=0).");
@@ -3,6 +3,7 @@
 #include "../misc/misc.h"
 #include <windows.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 void frame_limiter_apply_settings(const Rf2PatchSettings& settings);
@@ -14,7 +15,7 @@ bool frame_limiter_is_active();
 bool frame_limiter_is_vsync_enabled();
 
 bool frame_limiter_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines);
@@ -0,0 +1,90 @@
+#include "frame_memory.h"
+#ifdef SOPOT_COUNT_HEAP_ALLOCS
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace
+{
+
+FrameArena g_frame_arena;
+uint32_t g_heap_allocs_last_frame = 0;
+size_t g_arena_bytes_last_frame = 0;
+
+#ifdef SOPOT_COUNT_HEAP_ALLOCS
+
+uint32_t g_heap_allocs_at_frame_start = 0;
+
+// Counted per thread so allocations made by other threads do not show up in the frame count
+thread_local uint32_t t_heap_allocs = 0;
+
+void* counted_alloc(size_t size)
+{
+    ++t_heap_allocs;
+    // operator new must return a unique pointer even for 0 bytes
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc{};
+    }
+    return ptr;
+}
+
+#endif // SOPOT_COUNT_HEAP_ALLOCS
+
+} // namespace
+
+#ifdef SOPOT_COUNT_HEAP_ALLOCS
+
+// SOPOT's own operator new, used to count heap allocations. It does not affect the game's heap. Only in builds
+// configured with SOPOT_COUNT_HEAP_ALLOCS so release builds keep the CRT allocator.
+void* operator new(size_t size)
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size)
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#endif // SOPOT_COUNT_HEAP_ALLOCS
+
+FrameArena& frame_arena()
+{
+    return g_frame_arena;
+}
+
+void frame_memory_on_present()
+{
+#ifdef SOPOT_COUNT_HEAP_ALLOCS
+    g_heap_allocs_last_frame = t_heap_allocs - g_heap_allocs_at_frame_start;
+    g_heap_allocs_at_frame_start = t_heap_allocs;
+#endif
+    g_arena_bytes_last_frame = g_frame_arena.used();
+    g_frame_arena.reset();
+}
+
+FrameMemoryStats frame_memory_get_stats()
+{
+    return {g_heap_allocs_last_frame, g_arena_bytes_last_frame, g_frame_arena.capacity(), g_frame_arena.peak()};
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <common/utils/frame-arena.h>
+#include <cstdint>
+
+// Arena for temporaries of the thread that presents frames (overlay drawing, console and command handling).
+// Everything allocated from it is freed at the start of the next Present.
+FrameArena& frame_arena();
+
+// Resets the frame arena and closes the heap allocation count of the frame. Called at the start of the Present hook.
+void frame_memory_on_present();
+
+#ifdef SOPOT_COUNT_HEAP_ALLOCS
+constexpr bool heap_alloc_counting_enabled = true;
+#else
+constexpr bool heap_alloc_counting_enabled = false;
+#endif
+
+struct FrameMemoryStats
+{
+    // operator new calls made by SOPOT on the presenting thread during the last frame. Always 0 unless
+    // heap_alloc_counting_enabled.
+    uint32_t heap_allocs_last_frame = 0;
+    size_t arena_bytes_last_frame = 0;
+    size_t arena_capacity = 0;
+    size_t arena_peak = 0;
+};
+
+FrameMemoryStats frame_memory_get_stats();
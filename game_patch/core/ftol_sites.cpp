@@ -0,0 +1,128 @@
+#include "ftol_sites.h"
+#include <patch_common/AsmWriter.h>
+#include <patch_common/MemUtils.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+// Start of the MSVC runtime __ftol statically linked into RF2. It switches the FPU control word to truncation, runs
+// fistp and restores the control word, which stalls the FPU pipeline on every float to int conversion.
+constexpr std::array<int, 18> ftol_pattern{
+    0x55,                   // push ebp
+    0x8B, 0xEC,             // mov ebp, esp
+    0x83, 0xC4, 0xF4,       // add esp, -0Ch
+    0x9B,                   // wait
+    0xD9, 0x7D, 0xFE,       // fnstcw [ebp-2]
+    0x9B,                   // wait
+    0x66, 0x8B, 0x45, 0xFE, // mov ax, [ebp-2]
+    0x80, 0xCC, 0x0C,       // or ah, 0Ch
+};
+
+uintptr_t get_rel32_target(const uint8_t* code, uintptr_t code_addr, size_t offset)
+{
+    int32_t rel = 0;
+    std::memcpy(&rel, code + offset + 1, sizeof(rel));
+    return static_cast<uint32_t>(code_addr + offset + ftol_call_size + static_cast<uint32_t>(rel));
+}
+
+} // namespace
+
+const char* ftol_site_kind_name(FtolSiteKind kind)
+{
+    switch (kind) {
+        case FtolSiteKind::x87_result:
+            return "x87";
+        case FtolSiteKind::call_result:
+            return "call";
+        default:
+            return "unknown";
+    }
+}
+
+uintptr_t find_ftol(const uint8_t* code, size_t code_size, uintptr_t code_addr)
+{
+    if (code_size < ftol_pattern.size()) {
+        return 0;
+    }
+    for (size_t off = 0; off <= code_size - ftol_pattern.size(); ++off) {
+        bool matched = std::equal(ftol_pattern.begin(), ftol_pattern.end(), code + off, [](int expected, uint8_t actual) {
+            return expected < 0 || static_cast<uint8_t>(expected) == actual;
+        });
+        if (matched) {
+            return code_addr + off;
+        }
+    }
+    return 0;
+}
+
+FtolSiteKind classify_ftol_site(const uint8_t* code, uintptr_t code_addr, size_t call_offset, uintptr_t ftol_addr)
+{
+    // Call of a function returning float/double in ST(0)
+    if (call_offset >= ftol_call_size && code[call_offset - ftol_call_size] == 0xE8) {
+        uintptr_t prev_target = get_rel32_target(code, code_addr, call_offset - ftol_call_size);
+        if (prev_target != ftol_addr) {
+            return FtolSiteKind::call_result;
+        }
+    }
+
+    // x87 instruction (D8-DF escape opcodes) ending right before the call. Longest one is opcode + ModRM + SIB + disp32.
+    // Only bytes that look like x87 opcodes are passed to the length decoder so it does not log unknown opcodes.
+    for (size_t len = 2; len <= 7 && len <= call_offset; ++len) {
+        const uint8_t* insn = code + call_offset - len;
+        if (*insn < 0xD8 || *insn > 0xDF) {
+            continue;
+        }
+        if (get_instruction_len(const_cast<uint8_t*>(insn)) == len) {
+            return FtolSiteKind::x87_result;
+        }
+    }
+    return FtolSiteKind::unknown;
+}
+
+void find_ftol_sites(const uint8_t* code, size_t code_size, uintptr_t code_addr, uintptr_t ftol_addr,
+    std::vector<FtolSite>& out_sites)
+{
+    if (code_size < ftol_call_size) {
+        return;
+    }
+    for (size_t off = 0; off <= code_size - ftol_call_size; ++off) {
+        if (code[off] != 0xE8 || get_rel32_target(code, code_addr, off) != ftol_addr) {
+            continue;
+        }
+        out_sites.push_back({code_addr + off, classify_ftol_site(code, code_addr, off, ftol_addr)});
+    }
+}
+
+std::vector<size_t> find_ftol_sites_by_rva(const std::vector<FtolSite>& sites, uintptr_t image_base,
+    std::span<const uint32_t> rvas, std::vector<uint32_t>& out_missing_rvas)
+{
+    std::vector<size_t> indices;
+    for (uint32_t rva : rvas) {
+        auto it = std::find_if(sites.begin(), sites.end(), [=](const FtolSite& site) {
+            return site.addr == image_base + rva;
+        });
+        if (it == sites.end()) {
+            out_missing_rvas.push_back(rva);
+        }
+        else {
+            indices.push_back(static_cast<size_t>(it - sites.begin()));
+        }
+    }
+    return indices;
+}
+
+// fisttp always truncates so the FPU control word does not have to be switched. Like __ftol it pops ST(0) and returns
+// the 64-bit result in EDX:EAX.
+void emit_ftol_cave(AsmWriter& asm_writer, uintptr_t return_addr)
+{
+    using namespace asm_regs;
+    asm_writer
+        .sub(esp, 8)                // make place for the result
+        .fisttp<int64_t>(*esp)      // pop ST(0) converting it to int64 with truncation
+        .pop(eax)                   // low dword of the result
+        .pop(edx)                   // high dword of the result
+        .jmp(return_addr);          // continue after the original call
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class AsmWriter;
+
+// Platform independent part of the __ftol call site rewrite: finding the sites in a code buffer, classifying them and
+// generating their replacement code. Patching is done by high_fps.cpp.
+
+constexpr size_t ftol_call_size = 5;
+
+enum class FtolSiteKind
+{
+    // Instruction right before the call is an x87 instruction that leaves the converted value in ST(0)
+    x87_result,
+    // Instruction right before the call is a call of a function returning a float in ST(0)
+    call_result,
+    // Value comes from somewhere else (e.g. a jump target). The E8 byte may even be part of another instruction.
+    unknown,
+};
+
+struct FtolSite
+{
+    uintptr_t addr;
+    FtolSiteKind kind;
+    void* cave = nullptr;
+    bool enabled = false;
+    // Site is on the list of sites that were checked in gameplay
+    bool validated = false;
+};
+
+const char* ftol_site_kind_name(FtolSiteKind kind);
+
+// Returns address of the MSVC runtime __ftol in the code or 0 if it is not there
+uintptr_t find_ftol(const uint8_t* code, size_t code_size, uintptr_t code_addr);
+
+// Kind is a heuristic based on the bytes before the call. It says nothing about whether the rewrite is safe.
+FtolSiteKind classify_ftol_site(const uint8_t* code, uintptr_t code_addr, size_t call_offset, uintptr_t ftol_addr);
+
+// Appends every `call ftol_addr` found in the code
+void find_ftol_sites(const uint8_t* code, size_t code_size, uintptr_t code_addr, uintptr_t ftol_addr,
+    std::vector<FtolSite>& out_sites);
+
+// Returns indices of the sites at image_base + rva for each RVA. RVAs without a site are added to out_missing_rvas.
+std::vector<size_t> find_ftol_sites_by_rva(const std::vector<FtolSite>& sites, uintptr_t image_base,
+    std::span<const uint32_t> rvas, std::vector<uint32_t>& out_missing_rvas);
+
+// Replacement for `call __ftol` that continues at return_addr
+void emit_ftol_cave(AsmWriter& asm_writer, uintptr_t return_addr);
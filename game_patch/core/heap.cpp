@@ -0,0 +1,192 @@
+#include "heap.h"
+#include <common/utils/size-class-allocator.h>
+#include <common/utils/string-utils.h>
+#include <patch_common/ImportHook.h>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// RF2 allocates through its statically linked CRT which gets all memory from kernel32 heap functions. Hooking their
+// imports lets small blocks be served by SizeClassAllocator while large blocks and calls with unusual flags keep
+// going to the OS heap. Blocks allocated before the hooks were installed are recognized as foreign and are passed
+// to the original functions.
+
+namespace
+{
+
+constexpr DWORD supported_alloc_flags = HEAP_ZERO_MEMORY | HEAP_NO_SERIALIZE;
+
+SizeClassAllocator* g_allocator = nullptr;
+
+LPVOID WINAPI heap_alloc_hook(HANDLE heap, DWORD flags, SIZE_T size);
+BOOL WINAPI heap_free_hook(HANDLE heap, DWORD flags, LPVOID mem);
+LPVOID WINAPI heap_realloc_hook(HANDLE heap, DWORD flags, LPVOID mem, SIZE_T size);
+SIZE_T WINAPI heap_size_hook(HANDLE heap, DWORD flags, LPCVOID mem);
+
+ImportHook<LPVOID __stdcall(HANDLE, DWORD, SIZE_T)> heap_alloc_import{"kernel32.dll", "HeapAlloc", heap_alloc_hook};
+ImportHook<BOOL __stdcall(HANDLE, DWORD, LPVOID)> heap_free_import{"kernel32.dll", "HeapFree", heap_free_hook};
+ImportHook<LPVOID __stdcall(HANDLE, DWORD, LPVOID, SIZE_T)> heap_realloc_import{
+    "kernel32.dll",
+    "HeapReAlloc",
+    heap_realloc_hook,
+};
+ImportHook<SIZE_T __stdcall(HANDLE, DWORD, LPCVOID)> heap_size_import{"kernel32.dll", "HeapSize", heap_size_hook};
+
+bool is_small_alloc(DWORD flags, SIZE_T size)
+{
+    return (flags & ~supported_alloc_flags) == 0 && size <= SizeClassAllocator::max_small_size;
+}
+
+LPVOID WINAPI heap_alloc_hook(HANDLE heap, DWORD flags, SIZE_T size)
+{
+    if (is_small_alloc(flags, size)) {
+        void* ptr = g_allocator->allocate(size);
+        if (ptr) {
+            if (flags & HEAP_ZERO_MEMORY) {
+                std::memset(ptr, 0, size);
+            }
+            return ptr;
+        }
+    }
+    return heap_alloc_import.call_target(heap, flags, size);
+}
+
+BOOL WINAPI heap_free_hook(HANDLE heap, DWORD flags, LPVOID mem)
+{
+    if (mem && g_allocator->owns(mem)) {
+        g_allocator->deallocate(mem);
+        return TRUE;
+    }
+    return heap_free_import.call_target(heap, flags, mem);
+}
+
+LPVOID WINAPI heap_realloc_hook(HANDLE heap, DWORD flags, LPVOID mem, SIZE_T size)
+{
+    if (!mem || !g_allocator->owns(mem)) {
+        return heap_realloc_import.call_target(heap, flags, mem, size);
+    }
+
+    size_t old_size = g_allocator->requested_size(mem);
+    if (g_allocator->resize_in_place(mem, size)) {
+        if ((flags & HEAP_ZERO_MEMORY) && size > old_size) {
+            std::memset(static_cast<char*>(mem) + old_size, 0, size - old_size);
+        }
+        return mem;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return nullptr;
+    }
+
+    DWORD alloc_flags = flags & ~HEAP_ZERO_MEMORY;
+    void* new_mem = heap_alloc_hook(heap, alloc_flags, size);
+    if (!new_mem) {
+        return nullptr;
+    }
+    size_t copy_size = std::min<size_t>(old_size, size);
+    std::memcpy(new_mem, mem, copy_size);
+    if ((flags & HEAP_ZERO_MEMORY) && size > copy_size) {
+        std::memset(static_cast<char*>(new_mem) + copy_size, 0, size - copy_size);
+    }
+    g_allocator->deallocate(mem);
+    return new_mem;
+}
+
+SIZE_T WINAPI heap_size_hook(HANDLE heap, DWORD flags, LPCVOID mem)
+{
+    if (mem && g_allocator->owns(mem)) {
+        // HeapSize reports the requested size, not the size of the block
+        return g_allocator->requested_size(mem);
+    }
+    return heap_size_import.call_target(heap, flags, mem);
+}
+
+void install_fast_heap()
+{
+    // Never destroyed: the game keeps freeing blocks until the process is gone
+    g_allocator = new SizeClassAllocator;
+
+    // Free and size hooks go first so no block from the allocator can reach the original functions
+    heap_free_import.install();
+    heap_size_import.install();
+    heap_realloc_import.install();
+    if (!heap_free_import.is_installed() || !heap_size_import.is_installed() || !heap_realloc_import.is_installed()) {
+        xlog::error("Fast heap not installed (heap imports of rf2.exe not found)");
+        return;
+    }
+    heap_alloc_import.install();
+    if (!heap_alloc_import.is_installed()) {
+        xlog::error("Fast heap not installed (HeapAlloc import of rf2.exe not found)");
+        return;
+    }
+    xlog::info("Installed fast heap (blocks up to {} bytes)", SizeClassAllocator::max_small_size);
+}
+
+void print_heap_stats(std::vector<std::string>& out_output_lines)
+{
+    auto stats = g_allocator->stats();
+    char line[160];
+    size_t total_live_bytes = 0;
+    for (const auto& cls : stats.classes) {
+        size_t live_blocks = cls.allocs - cls.frees;
+        if (!live_blocks && !cls.spans) {
+            continue;
+        }
+        size_t live_bytes = live_blocks * cls.block_size;
+        total_live_bytes += live_bytes;
+        std::snprintf(
+            line,
+            sizeof(line),
+            "%5u B: %7u live (%7.1f KiB), %3u spans, %9u allocs",
+            static_cast<unsigned>(cls.block_size),
+            static_cast<unsigned>(live_blocks),
+            live_bytes / 1024.0,
+            static_cast<unsigned>(cls.spans),
+            static_cast<unsigned>(cls.allocs));
+        out_output_lines.emplace_back(line);
+    }
+    std::snprintf(
+        line,
+        sizeof(line),
+        "Total: %.2f MiB live in %.2f MiB of spans, %u thread caches",
+        total_live_bytes / (1024.0 * 1024.0),
+        stats.span_bytes / (1024.0 * 1024.0),
+        static_cast<unsigned>(stats.num_thread_caches));
+    out_output_lines.emplace_back(line);
+}
+
+} // namespace
+
+void heap_apply_settings(const Rf2PatchSettings& settings)
+{
+    if (settings.fast_heap && !g_allocator) {
+        install_fast_heap();
+    }
+}
+
+bool heap_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    if (!string_iequals(trim(command), "heapstats")) {
+        return false;
+    }
+
+    if (!heap_alloc_import.is_installed()) {
+        out_output_lines.emplace_back("Fast heap is off (set fast_heap=1 in sopot_settings.ini and restart).");
+        out_status = "Fast heap is off.";
+        return true;
+    }
+    print_heap_stats(out_output_lines);
+    out_status = "Printed fast heap stats.";
+    out_success = true;
+    return true;
+}
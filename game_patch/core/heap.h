@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../misc/misc.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Installs the fast heap when enabled in settings. It cannot be removed later so it is only applied at startup.
+void heap_apply_settings(const Rf2PatchSettings& settings);
+
+bool heap_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
@@ -1,20 +1,267 @@
 #include "high_fps.h"
+#include "ftol_sites.h"
+#include "../rf2/rf2.h"
+#include <common/utils/string-utils.h>
+#include <patch_common/AsmWriter.h>
+#include <patch_common/CodeArena.h>
+#include <patch_common/PatchTransaction.h>
+#include <windows.h>
 #include <xlog/xlog.h>
+#include <array>
+#include <cstdio>
+#include <cstring>
 
 namespace
 {
+
+// Call sites that were checked in gameplay with the rewrite enabled, as RVAs in the rf2.exe build accepted by the
+// launcher. Only these are rewritten by the ftol_rewrite setting. Every other site, whatever kind the classifier gave
+// it, stays opt-in from the console (`ftol <index> 1`) until it is validated and added here.
+constexpr std::array<uint32_t, 0> validated_ftol_site_rvas{};
+
 bool g_patch_attempted = false;
+uintptr_t g_ftol_addr = 0;
+std::vector<FtolSite> g_ftol_sites{};
+
+std::array<uint8_t, ftol_call_size> encode_rel32(uint8_t opcode, uintptr_t from, uintptr_t to)
+{
+    std::array<uint8_t, ftol_call_size> bytes{};
+    bytes[0] = opcode;
+    auto rel = static_cast<int32_t>(to - (from + ftol_call_size));
+    std::memcpy(&bytes[1], &rel, sizeof(rel));
+    return bytes;
+}
+
+// Stages the site rewrite in the transaction. Caller updates FtolSite::enabled once the transaction is committed.
+bool stage_ftol_site(FtolSite& site, bool enabled, PatchTransaction& patch)
+{
+    if (enabled && !site.cave) {
+        AsmWriter measure_writer;
+        emit_ftol_cave(measure_writer, site.addr + ftol_call_size);
+        site.cave = CodeArena::global().alloc(measure_writer.size(), site.addr);
+        if (!site.cave) {
+            return false;
+        }
+        AsmWriter asm_writer{site.cave};
+        emit_ftol_cave(asm_writer, site.addr + ftol_call_size);
+    }
+    const auto bytes = enabled
+        ? encode_rel32(0xE9, site.addr, reinterpret_cast<uintptr_t>(site.cave)) // jmp cave
+        : encode_rel32(0xE8, site.addr, g_ftol_addr);                           // call __ftol
+    patch.write(site.addr, bytes.data(), bytes.size());
+    return true;
 }
 
-void high_fps_apply_patch()
+void discover_ftol_sites()
+{
+    const uintptr_t base = rf2::module_base();
+    const auto* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    if (!dos || dos->e_magic != IMAGE_DOS_SIGNATURE) {
+        xlog::warn("Unable to scan RF2 __ftol sites: invalid DOS header");
+        return;
+    }
+    const auto* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + static_cast<uintptr_t>(dos->e_lfanew));
+    if (!nt || nt->Signature != IMAGE_NT_SIGNATURE) {
+        xlog::warn("Unable to scan RF2 __ftol sites: invalid NT header");
+        return;
+    }
+
+    std::vector<std::pair<const uint8_t*, size_t>> code_sections;
+    const auto* section = IMAGE_FIRST_SECTION(nt);
+    for (unsigned i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section) {
+        if ((section->Characteristics & IMAGE_SCN_CNT_CODE) == 0) {
+            continue;
+        }
+        const size_t section_size = section->Misc.VirtualSize ? section->Misc.VirtualSize : section->SizeOfRawData;
+        code_sections.emplace_back(reinterpret_cast<const uint8_t*>(base + section->VirtualAddress), section_size);
+    }
+
+    for (const auto& [begin, size] : code_sections) {
+        g_ftol_addr = find_ftol(begin, size, reinterpret_cast<uintptr_t>(begin));
+        if (g_ftol_addr) {
+            break;
+        }
+    }
+    if (!g_ftol_addr) {
+        xlog::warn("RF2 __ftol not found; call-site rewriting is unavailable");
+        return;
+    }
+
+    for (const auto& [begin, size] : code_sections) {
+        find_ftol_sites(begin, size, reinterpret_cast<uintptr_t>(begin), g_ftol_addr, g_ftol_sites);
+    }
+    std::vector<uint32_t> missing_rvas;
+    auto validated = find_ftol_sites_by_rva(g_ftol_sites, base, validated_ftol_site_rvas, missing_rvas);
+    for (size_t index : validated) {
+        g_ftol_sites[index].validated = true;
+    }
+    for (uint32_t rva : missing_rvas) {
+        xlog::warn("Validated __ftol site at RVA 0x{:X} was not found; is this a different rf2.exe build?", rva);
+    }
+    xlog::info("Found RF2 __ftol at 0x{:X} with {} call site(s) ({} validated)",
+        static_cast<unsigned>(g_ftol_addr), g_ftol_sites.size(), validated.size());
+}
+
+// Returns number of sites changed
+size_t set_ftol_sites_enabled(bool enabled, bool validated_only)
+{
+    PatchTransaction patch;
+    std::vector<FtolSite*> changed_sites;
+    for (auto& site : g_ftol_sites) {
+        if (site.enabled == enabled || (validated_only && !site.validated)) {
+            continue;
+        }
+        if (stage_ftol_site(site, enabled, patch)) {
+            changed_sites.push_back(&site);
+        }
+    }
+    if (!patch.commit()) {
+        return 0;
+    }
+    for (auto* site : changed_sites) {
+        site->enabled = enabled;
+    }
+    return changed_sites.size();
+}
+
+std::string format_ftol_site(size_t index, const FtolSite& site)
+{
+    char line[128] = {};
+    std::snprintf(
+        line,
+        sizeof(line),
+        "#%u rva 0x%08X %-7s %-9s %s",
+        static_cast<unsigned>(index),
+        static_cast<unsigned>(site.addr - rf2::module_base()),
+        ftol_site_kind_name(site.kind),
+        site.validated ? "validated" : "opt-in",
+        site.enabled ? "on" : "off");
+    return line;
+}
+
+} // namespace
+
+void high_fps_apply_patch(const Rf2PatchSettings& settings)
 {
     if (g_patch_attempted) {
         return;
     }
     g_patch_attempted = true;
 
-    // Disabled for now: global __ftol interception is too risky in RF2 and can
-    // corrupt gameplay object state. We'll replace this with targeted call-site
-    // fixes like Alpine once each problematic site is validated.
-    xlog::warn("RF2 high-fps __ftol patch is temporarily disabled for stability.");
+    // Global __ftol interception corrupted gameplay object state, so only individual call sites are rewritten and
+    // each of them can be turned off from the console if it misbehaves.
+    if (!IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE)) {
+        xlog::info("SSE3 is not available; RF2 __ftol call sites are left unchanged");
+        return;
+    }
+    discover_ftol_sites();
+    if (!settings.ftol_rewrite) {
+        return;
+    }
+    size_t num_enabled = set_ftol_sites_enabled(true, true);
+    xlog::info("Rewrote {} validated RF2 __ftol call site(s)", num_enabled);
+}
+
+bool high_fps_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    const auto match = string_match_command(command, "ftol");
+    if (!match) {
+        return false;
+    }
+    const std::string_view args = *match;
+
+    if (!g_ftol_addr) {
+        out_output_lines.emplace_back("RF2 __ftol was not found or SSE3 is not available.");
+        out_status = "__ftol rewriting unavailable.";
+        return true;
+    }
+
+    if (args.empty()) {
+        size_t counts[3] = {};
+        size_t num_enabled = 0;
+        size_t num_validated = 0;
+        for (const auto& site : g_ftol_sites) {
+            ++counts[static_cast<int>(site.kind)];
+            num_enabled += site.enabled ? 1 : 0;
+            num_validated += site.validated ? 1 : 0;
+        }
+        char line[192] = {};
+        std::snprintf(
+            line,
+            sizeof(line),
+            "__ftol at 0x%08X: %u site(s) (x87=%u call=%u unknown=%u), %u validated, %u rewritten",
+            static_cast<unsigned>(g_ftol_addr),
+            static_cast<unsigned>(g_ftol_sites.size()),
+            static_cast<unsigned>(counts[0]),
+            static_cast<unsigned>(counts[1]),
+            static_cast<unsigned>(counts[2]),
+            static_cast<unsigned>(num_validated),
+            static_cast<unsigned>(num_enabled));
+        out_output_lines.emplace_back(line);
+        out_output_lines.emplace_back("Usage: ftol list | ftol <index|validated|all> <0|1>");
+        out_status = "Printed __ftol state.";
+        out_success = true;
+        return true;
+    }
+
+    if (string_iequals(args, "list")) {
+        constexpr size_t max_listed_sites = 200;
+        for (size_t i = 0; i < g_ftol_sites.size() && i < max_listed_sites; ++i) {
+            out_output_lines.push_back(format_ftol_site(i, g_ftol_sites[i]));
+        }
+        if (g_ftol_sites.size() > max_listed_sites) {
+            out_output_lines.push_back(
+                "... " + std::to_string(g_ftol_sites.size() - max_listed_sites) + " more site(s)");
+        }
+        out_status = "Listed __ftol sites.";
+        out_success = true;
+        return true;
+    }
+
+    const auto [target, value] = split_once_whitespace(args);
+    if (value != "0" && value != "1") {
+        out_output_lines.emplace_back("Usage: ftol list | ftol <index|validated|all> <0|1>");
+        out_status = "Invalid value.";
+        return true;
+    }
+    const bool enabled = value == "1";
+
+    const bool validated_only = string_iequals(target, "validated");
+    if (validated_only || string_iequals(target, "all")) {
+        size_t num_changed = set_ftol_sites_enabled(enabled, validated_only);
+        out_output_lines.push_back(
+            std::string{enabled ? "Rewrote " : "Restored "} + std::to_string(num_changed) + " __ftol site(s).");
+        out_status = "Applied __ftol sites.";
+        out_success = true;
+        return true;
+    }
+
+    const auto index = string_to_long(target);
+    if (!index || *index < 0 || static_cast<size_t>(*index) >= g_ftol_sites.size()) {
+        out_output_lines.emplace_back("Invalid __ftol site index. Use ftol list to print sites.");
+        out_status = "Invalid site.";
+        return true;
+    }
+    const auto site_index = static_cast<size_t>(*index);
+    auto& site = g_ftol_sites[site_index];
+    if (site.enabled != enabled) {
+        PatchTransaction patch;
+        if (!stage_ftol_site(site, enabled, patch) || !patch.commit()) {
+            out_status = "Failed to patch __ftol site.";
+            return true;
+        }
+        site.enabled = enabled;
+    }
+    out_output_lines.push_back(format_ftol_site(site_index, site));
+    out_status = "Applied __ftol site.";
+    out_success = true;
+    return true;
 }
@@ -1,3 +1,14 @@
 #pragma once
 
-void high_fps_apply_patch();
+#include "../misc/misc.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+void high_fps_apply_patch(const Rf2PatchSettings& settings);
+
+bool high_fps_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
@@ -0,0 +1,150 @@
+#include "hitch.h"
+#include "sampler.h"
+#include <common/utils/detach-on-exit-thread.h>
+#include <common/utils/hitch-detector.h>
+#include <common/utils/string-utils.h>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+
+constexpr unsigned max_hitch_threshold_ms = 10000;
+constexpr DWORD monitor_poll_interval_ms = 5;
+
+HitchDetector g_detector;
+std::mutex g_monitor_control_mutex;
+DetachOnExitThread g_monitor_thread;
+std::atomic<bool> g_monitor_running{false};
+std::atomic<unsigned> g_num_hitches{0};
+
+// Used by the monitor thread only
+std::unique_ptr<StackSymbolizer> g_symbolizer;
+
+uint64_t now_us()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void report_hitch()
+{
+    g_num_hitches.fetch_add(1, std::memory_order_relaxed);
+    // Modules rarely change after startup so the first hitch builds the symbolizer for all later ones
+    if (!g_symbolizer) {
+        g_symbolizer = std::make_unique<StackSymbolizer>(sampler_create_symbolizer());
+    }
+    for (const auto& line : g_detector.format_report(*g_symbolizer)) {
+        xlog::warn("{}", line);
+    }
+}
+
+void monitor_thread_proc()
+{
+    uintptr_t frames[max_sampled_stack_depth];
+    uint64_t next_sample_us = 0;
+    g_detector.cancel_stall();
+    while (g_monitor_running.load(std::memory_order_relaxed)) {
+        uint64_t now = now_us();
+        switch (g_detector.poll(now)) {
+        case HitchDetector::PollResult::stall_started:
+            next_sample_us = now;
+            [[fallthrough]];
+        case HitchDetector::PollResult::stalled:
+            // Spread the samples so longer stalls are covered past their start
+            if (now >= next_sample_us && g_detector.num_samples() < HitchDetector::max_samples) {
+                int depth = sampler_capture_main_thread_stack(frames, max_sampled_stack_depth);
+                if (depth > 0) {
+                    g_detector.add_sample(frames, depth);
+                }
+                next_sample_us = now + std::max<uint64_t>(g_detector.threshold_us() / 4, 1000);
+            }
+            break;
+        case HitchDetector::PollResult::stall_ended:
+            report_hitch();
+            break;
+        case HitchDetector::PollResult::idle:
+            break;
+        }
+        Sleep(monitor_poll_interval_ms);
+    }
+}
+
+void set_hitch_threshold(unsigned threshold_ms)
+{
+    std::lock_guard lock{g_monitor_control_mutex};
+    g_detector.set_threshold_us(static_cast<uint64_t>(threshold_ms) * 1000);
+    bool running = g_monitor_running.load(std::memory_order_relaxed);
+    if (threshold_ms && !running) {
+        g_monitor_running.store(true, std::memory_order_relaxed);
+        g_monitor_thread = DetachOnExitThread{monitor_thread_proc};
+        xlog::info("Hitch detector enabled (threshold {} ms)", threshold_ms);
+    }
+    else if (!threshold_ms && running) {
+        g_monitor_running.store(false, std::memory_order_relaxed);
+        g_monitor_thread.join();
+        xlog::info("Hitch detector disabled");
+    }
+}
+
+} // namespace
+
+void hitch_apply_settings(const Rf2PatchSettings& settings)
+{
+    set_hitch_threshold(std::min(settings.hitch_threshold_ms, max_hitch_threshold_ms));
+}
+
+// Beats even while detection is off so enabling it later does not see a stale heartbeat
+void hitch_on_frame()
+{
+    g_detector.beat(now_us());
+}
+
+void hitch_mark_phase(const char* name)
+{
+    g_detector.mark_phase(name, now_us());
+}
+
+bool hitch_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    const auto args = string_match_command(command, "hitch");
+    if (!args) {
+        return false;
+    }
+
+    if (!args->empty()) {
+        const auto value = string_to_long(*args);
+        if (!value || *value < 0 || *value > static_cast<long>(max_hitch_threshold_ms)) {
+            out_output_lines.emplace_back("Usage: hitch [threshold_ms 0-10000] (0 = off)");
+            out_status = "Invalid threshold.";
+            return true;
+        }
+        set_hitch_threshold(static_cast<unsigned>(*value));
+    }
+
+    const auto threshold_ms = static_cast<unsigned>(g_detector.threshold_us() / 1000);
+    if (threshold_ms) {
+        out_output_lines.emplace_back(
+            "Hitch detector: frames over " + std::to_string(threshold_ms) + " ms are logged ("
+            + std::to_string(g_num_hitches.load(std::memory_order_relaxed)) + " so far).");
+    }
+    else {
+        out_output_lines.emplace_back("Hitch detector: off.");
+    }
+    out_status = args->empty() ? "Printed hitch detector state." : "Updated hitch threshold.";
+    out_success = true;
+    return true;
+}
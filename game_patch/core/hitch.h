@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../misc/misc.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+void hitch_apply_settings(const Rf2PatchSettings& settings);
+
+// Heartbeat of the hitch detector. Called once per frame from the Present hook.
+void hitch_on_frame();
+
+// Starts a new phase of the current frame. Name must point to a string literal.
+void hitch_mark_phase(const char* name);
+
+bool hitch_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
@@ -0,0 +1,116 @@
+#include "logging.h"
+#include <common/utils/string-utils.h>
+#include <xlog/xlog.h>
+#include <array>
+#include <optional>
+#include <string_view>
+
+namespace
+{
+
+constexpr std::array<std::string_view, 5> level_names{"error", "warn", "info", "debug", "trace"};
+
+std::optional<xlog::Level> parse_level(std::string_view name)
+{
+    for (size_t i = 0; i < level_names.size(); ++i) {
+        if (string_iequals(name, level_names[i])) {
+            return static_cast<xlog::Level>(i);
+        }
+    }
+    return {};
+}
+
+std::string_view get_level_name(xlog::Level level)
+{
+    auto index = static_cast<size_t>(level);
+    return index < level_names.size() ? level_names[index] : "?";
+}
+
+// The root logger usually has no name
+std::string get_logger_display_name(const xlog::Logger& logger)
+{
+    return logger.name().empty() ? "root" : logger.name();
+}
+
+// Logger names are lower case
+xlog::Logger* find_logger(std::string_view name)
+{
+    if (string_iequals(name, "root")) {
+        return &xlog::Logger::root();
+    }
+    return xlog::Logger::find(string_to_lower(name));
+}
+
+std::string format_logger_line(const xlog::Logger& logger)
+{
+    std::string line = get_logger_display_name(logger);
+    line += ": ";
+    line += get_level_name(logger.level());
+    if (!logger.has_own_level()) {
+        line += " (inherited from ";
+        line += get_logger_display_name(*logger.parent());
+        line += ")";
+    }
+    return line;
+}
+
+} // namespace
+
+bool logging_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    const auto args = string_match_command(command, "log_level");
+    if (!args) {
+        return false;
+    }
+
+    if (args->empty()) {
+        // Make sure root is listed even before anything logged through it
+        xlog::Logger::root();
+        for (const auto* logger : xlog::Logger::get_all()) {
+            out_output_lines.push_back(format_logger_line(*logger));
+        }
+        out_status = "Printed log levels.";
+        out_success = true;
+        return true;
+    }
+
+    const auto [name, level_arg] = split_once_whitespace(*args);
+    xlog::Logger* logger = find_logger(name);
+    if (!logger) {
+        out_output_lines.emplace_back("Usage: log_level [<subsystem> [error|warn|info|debug|trace|default]]");
+        out_status = "Unknown subsystem, run log_level to list them.";
+        return true;
+    }
+
+    if (!level_arg.empty()) {
+        if (string_iequals(level_arg, "default")) {
+            if (!logger->parent()) {
+                out_status = "The root logger has no parent to inherit from.";
+                return true;
+            }
+            logger->reset_level();
+        }
+        else if (auto level = parse_level(level_arg)) {
+            logger->set_level(level.value());
+        }
+        else {
+            out_output_lines.emplace_back("Usage: log_level [<subsystem> [error|warn|info|debug|trace|default]]");
+            out_status = "Invalid log level.";
+            return true;
+        }
+        xlog::info("Log level of {} set to {}", get_logger_display_name(*logger), get_level_name(logger->level()));
+    }
+
+    out_output_lines.push_back(format_logger_line(*logger));
+    out_status = level_arg.empty() ? "Printed log level." : "Updated log level.";
+    out_success = true;
+    return true;
+}
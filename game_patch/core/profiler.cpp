@@ -0,0 +1,250 @@
+#include "profiler.h"
+#include "alloc_profiler.h"
+#include "frame_memory.h"
+#include "hitch.h"
+#include "sampler.h"
+#include <common/utils/perf-trace.h>
+#include <common/utils/perf-utils.h>
+#include <common/utils/string-utils.h>
+#include <crash_handler_stub/FlightRecorder.h>
+#include <patch_common/HookProfiler.h>
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+
+namespace
+{
+
+constexpr const char* default_csv_path = "logs\\SOPOT-perf.csv";
+constexpr const char* default_trace_path = "logs\\SOPOT-trace.json";
+
+double cycles_to_us(double cycles, double cycles_per_us)
+{
+    return cycles_per_us > 0.0 ? cycles / cycles_per_us : 0.0;
+}
+
+void print_perf_report(
+    PerfReport report,
+    bool hooks_only,
+    std::vector<std::string>& out_output_lines)
+{
+    if (report.frames == 0) {
+        out_output_lines.emplace_back("No frames recorded yet.");
+        return;
+    }
+
+    // Most expensive zones first
+    std::sort(report.zones.begin(), report.zones.end(), [](const auto& a, const auto& b) {
+        return a.cycles > b.cycles;
+    });
+
+    const double frames = static_cast<double>(report.frames);
+    char line[192] = {};
+    std::snprintf(
+        line,
+        sizeof(line),
+        "%u frame(s), avg frame %.3f ms",
+        static_cast<unsigned>(report.frames),
+        cycles_to_us(static_cast<double>(report.frame_cycles), report.cycles_per_us) / frames / 1000.0);
+    out_output_lines.emplace_back(line);
+    out_output_lines.emplace_back(
+        "zone                      calls/frame    mean us     min us     max us   frame %");
+    for (const auto& zone : report.zones) {
+        if (hooks_only && zone.category != PerfZoneCategory::hook) {
+            continue;
+        }
+        const double mean_cycles = zone.calls ? static_cast<double>(zone.cycles) / static_cast<double>(zone.calls) : 0.0;
+        const double frame_share = report.frame_cycles
+            ? 100.0 * static_cast<double>(zone.cycles) / static_cast<double>(report.frame_cycles)
+            : 0.0;
+        std::snprintf(
+            line,
+            sizeof(line),
+            "%-24s %12.2f %10.2f %10.2f %10.2f %8.2f",
+            zone.name,
+            static_cast<double>(zone.calls) / frames,
+            cycles_to_us(mean_cycles, report.cycles_per_us),
+            cycles_to_us(static_cast<double>(zone.min_cycles), report.cycles_per_us),
+            cycles_to_us(static_cast<double>(zone.max_cycles), report.cycles_per_us),
+            frame_share);
+        out_output_lines.emplace_back(line);
+    }
+}
+
+void print_frame_memory_stats(std::vector<std::string>& out_output_lines)
+{
+    const FrameMemoryStats stats = frame_memory_get_stats();
+    char heap_allocs_buf[16] = {};
+    const char* heap_allocs = "not counted (configure with -DSOPOT_COUNT_HEAP_ALLOCS=ON)";
+    if (heap_alloc_counting_enabled) {
+        std::snprintf(heap_allocs_buf, sizeof(heap_allocs_buf), "%u", static_cast<unsigned>(stats.heap_allocs_last_frame));
+        heap_allocs = heap_allocs_buf;
+    }
+    char line[192] = {};
+    std::snprintf(
+        line,
+        sizeof(line),
+        "Heap allocations: %s, frame arena: %u of %u KiB (peak %u KiB)",
+        heap_allocs,
+        static_cast<unsigned>(stats.arena_bytes_last_frame / 1024),
+        static_cast<unsigned>(stats.arena_capacity / 1024),
+        static_cast<unsigned>(stats.arena_peak / 1024));
+    out_output_lines.emplace_back(line);
+}
+
+bool handle_hookstats_command(
+    std::string_view args,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    if (!hook_profiler_enabled) {
+        out_output_lines.emplace_back("Hook profiler is not compiled in (configure with -DSOPOT_HOOK_PROFILER=ON).");
+        out_status = "Hook profiler unavailable.";
+        return true;
+    }
+
+    if (args.empty()) {
+        print_perf_report(perf_get_report(), true, out_output_lines);
+        out_status = "Printed hook stats.";
+        out_success = true;
+        return true;
+    }
+
+    if (string_iequals(args, "reset")) {
+        perf_reset();
+        out_output_lines.emplace_back("Profiler stats reset.");
+        out_status = "Reset hook stats.";
+        out_success = true;
+        return true;
+    }
+
+    out_output_lines.emplace_back("Usage: hookstats [reset]");
+    out_status = "Invalid arguments.";
+    return true;
+}
+
+bool handle_perf_command(
+    std::string_view args,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    if (args.empty() || string_iequals(args, "frame")) {
+        print_perf_report(args.empty() ? perf_get_report() : perf_get_last_frame_report(), false, out_output_lines);
+        if (!args.empty()) {
+            print_frame_memory_stats(out_output_lines);
+        }
+        out_status = "Printed profiler zones.";
+        out_success = true;
+        return true;
+    }
+
+    if (string_iequals(args, "reset")) {
+        perf_reset();
+        out_output_lines.emplace_back("Profiler stats reset.");
+        out_status = "Reset profiler stats.";
+        out_success = true;
+        return true;
+    }
+
+    if (auto csv_args = string_match_command(args, "csv")) {
+        const std::string path{csv_args->empty() ? std::string_view{default_csv_path} : *csv_args};
+        if (!perf_write_csv(perf_get_report(), path)) {
+            out_output_lines.emplace_back("Failed to write " + path);
+            out_status = "CSV export failed.";
+            return true;
+        }
+        out_output_lines.emplace_back("Wrote profiler zones to " + path);
+        out_status = "Exported profiler zones.";
+        out_success = true;
+        return true;
+    }
+
+    out_output_lines.emplace_back("Usage: perf [frame | reset | csv [path]]");
+    out_status = "Invalid arguments.";
+    return true;
+}
+
+bool handle_trace_start_command(
+    std::string_view args,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    if (perf_trace_is_active()) {
+        out_output_lines.emplace_back("Trace is already running (use trace_stop).");
+        out_status = "Trace already running.";
+        return true;
+    }
+    const std::string path{args.empty() ? std::string_view{default_trace_path} : args};
+    if (!perf_trace_start(path)) {
+        out_output_lines.emplace_back("Failed to start trace " + path);
+        out_status = "Trace start failed.";
+        return true;
+    }
+    out_output_lines.emplace_back("Recording trace to " + path);
+    out_status = "Started trace.";
+    out_success = true;
+    return true;
+}
+
+bool handle_trace_stop_command(
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    PerfTraceResult result;
+    if (!perf_trace_stop(&result)) {
+        out_output_lines.emplace_back("No trace is running.");
+        out_status = "Trace not running.";
+        return true;
+    }
+    char line[128] = {};
+    std::snprintf(
+        line,
+        sizeof(line),
+        "Trace stopped: %u event(s) written, %u dropped",
+        static_cast<unsigned>(result.events_written),
+        static_cast<unsigned>(result.events_dropped));
+    out_output_lines.emplace_back(line);
+    out_status = "Stopped trace.";
+    out_success = true;
+    return true;
+}
+
+} // namespace
+
+void profiler_on_present()
+{
+    sampler_register_main_thread();
+    hitch_on_frame();
+    allocprof_on_frame();
+    FlightRecorderAddFrame();
+    perf_end_frame();
+}
+
+bool profiler_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    if (auto args = string_match_command(command, "hookstats")) {
+        return handle_hookstats_command(*args, out_success, out_status, out_output_lines);
+    }
+    if (auto args = string_match_command(command, "perf")) {
+        return handle_perf_command(*args, out_success, out_status, out_output_lines);
+    }
+    if (auto args = string_match_command(command, "trace_start")) {
+        return handle_trace_start_command(*args, out_success, out_status, out_output_lines);
+    }
+    if (string_iequals(trim(command), "trace_stop")) {
+        return handle_trace_stop_command(out_success, out_status, out_output_lines);
+    }
+    return false;
+}
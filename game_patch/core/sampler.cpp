@@ -0,0 +1,243 @@
+#include "sampler.h"
+#include <common/utils/detach-on-exit-thread.h>
+#include <common/utils/os-utils.h>
+#include <common/utils/stack-sampling.h>
+#include <common/utils/string-utils.h>
+#include <windows.h>
+#include <tlhelp32.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+namespace
+{
+
+constexpr int default_sample_rate_hz = 1000;
+constexpr int max_sample_rate_hz = 1000;
+constexpr const char* default_folded_path = "logs\\SOPOT-samples.folded";
+constexpr const char* symbol_map_filename = "sopot_symbols.txt";
+
+std::atomic<HANDLE> g_main_thread{nullptr};
+std::atomic<DWORD> g_main_thread_id{0};
+std::atomic<uintptr_t> g_main_stack_base{0};
+
+std::unique_ptr<StackSampleTable> g_samples;
+DetachOnExitThread g_sampler_thread;
+std::atomic<bool> g_sampler_running{false};
+
+std::string get_patch_module_dir()
+{
+    HMODULE patch_module = nullptr;
+    if (!GetModuleHandleExA(
+            GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+            reinterpret_cast<LPCSTR>(&g_main_thread),
+            &patch_module)) {
+        return {};
+    }
+    return get_module_dir(patch_module);
+}
+
+std::vector<ModuleInfo> get_loaded_modules()
+{
+    std::vector<ModuleInfo> modules;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        xlog::warn("CreateToolhelp32Snapshot failed (error {})", GetLastError());
+        return modules;
+    }
+    MODULEENTRY32 entry{};
+    entry.dwSize = sizeof(entry);
+    for (BOOL ok = Module32First(snapshot, &entry); ok; ok = Module32Next(snapshot, &entry)) {
+        modules.push_back({entry.szModule, reinterpret_cast<uintptr_t>(entry.modBaseAddr), entry.modBaseSize});
+    }
+    CloseHandle(snapshot);
+    return modules;
+}
+
+// Keeps the last symbol of a code section from covering whatever follows the section
+void add_main_module_code_sections(SymbolMap& symbols)
+{
+    const auto base = reinterpret_cast<uintptr_t>(GetModuleHandleA(nullptr));
+    const auto* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    const auto* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + static_cast<uintptr_t>(dos->e_lfanew));
+    const auto* section = IMAGE_FIRST_SECTION(nt);
+    for (unsigned i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section) {
+        if (section->Characteristics & IMAGE_SCN_CNT_CODE) {
+            const DWORD size = section->Misc.VirtualSize ? section->Misc.VirtualSize : section->SizeOfRawData;
+            symbols.add_section(section->VirtualAddress, size);
+        }
+    }
+}
+
+std::string get_main_module_name()
+{
+    std::string path = get_module_pathname(nullptr);
+    auto last_sep = path.rfind('\\');
+    return last_sep == std::string::npos ? path : path.substr(last_sep + 1);
+}
+
+void sampler_thread_proc(int interval_ms)
+{
+    uintptr_t frames[max_sampled_stack_depth];
+    while (g_sampler_running.load(std::memory_order_relaxed)) {
+        int depth = sampler_capture_main_thread_stack(frames, max_sampled_stack_depth);
+        if (depth > 0) {
+            g_samples->add(frames, depth);
+        }
+        Sleep(interval_ms);
+    }
+}
+
+bool start_sampling(int rate_hz)
+{
+    if (g_sampler_running.load(std::memory_order_relaxed) || !g_main_thread.load(std::memory_order_acquire)) {
+        return false;
+    }
+    g_samples = std::make_unique<StackSampleTable>(16384);
+    g_sampler_running.store(true, std::memory_order_relaxed);
+    g_sampler_thread = DetachOnExitThread{sampler_thread_proc, std::max(1, 1000 / rate_hz)};
+    xlog::info("Started sampling main thread at {} Hz", rate_hz);
+    return true;
+}
+
+bool stop_sampling(const std::string& path, std::string& out_message)
+{
+    if (!g_sampler_running.load(std::memory_order_relaxed)) {
+        out_message = "Sampler is not running.";
+        return false;
+    }
+    g_sampler_running.store(false, std::memory_order_relaxed);
+    g_sampler_thread.join();
+
+    StackSymbolizer symbolizer = sampler_create_symbolizer();
+
+    std::ofstream out{path};
+    if (!out) {
+        out_message = "Failed to open " + path;
+        return false;
+    }
+    write_folded_stacks(*g_samples, symbolizer, out);
+    char buf[192];
+    std::snprintf(
+        buf,
+        sizeof(buf),
+        "Wrote %u sample(s) (%u dropped) to %s",
+        static_cast<unsigned>(g_samples->num_samples()),
+        static_cast<unsigned>(g_samples->num_dropped()),
+        path.c_str());
+    out_message = buf;
+    xlog::info("{}", out_message);
+    return true;
+}
+
+} // namespace
+
+void sampler_register_main_thread()
+{
+    DWORD thread_id = GetCurrentThreadId();
+    if (g_main_thread_id.load(std::memory_order_relaxed) == thread_id) {
+        return;
+    }
+    HANDLE thread = nullptr;
+    if (!DuplicateHandle(
+            GetCurrentProcess(),
+            GetCurrentThread(),
+            GetCurrentProcess(),
+            &thread,
+            THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+            FALSE,
+            0)) {
+        xlog::warn("DuplicateHandle failed for main thread (error {})", GetLastError());
+        return;
+    }
+    const auto* tib = reinterpret_cast<const NT_TIB*>(NtCurrentTeb());
+    g_main_stack_base.store(reinterpret_cast<uintptr_t>(tib->StackBase), std::memory_order_relaxed);
+    g_main_thread_id.store(thread_id, std::memory_order_relaxed);
+    // Old handle (if the presenting thread changed) is leaked on purpose because another thread may be using it
+    g_main_thread.store(thread, std::memory_order_release);
+}
+
+int sampler_capture_main_thread_stack(uintptr_t* out_frames, int max_depth)
+{
+    HANDLE thread = g_main_thread.load(std::memory_order_acquire);
+    if (!thread || GetCurrentThreadId() == g_main_thread_id.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (SuspendThread(thread) == static_cast<DWORD>(-1)) {
+        return 0;
+    }
+    // Nothing below may allocate or take locks because the suspended thread can own them
+    int depth = 0;
+    CONTEXT context{};
+    context.ContextFlags = CONTEXT_CONTROL;
+    if (GetThreadContext(thread, &context)) {
+        depth = walk_frame_pointer_chain(
+            context.Eip,
+            context.Ebp,
+            context.Esp,
+            g_main_stack_base.load(std::memory_order_relaxed),
+            out_frames,
+            max_depth);
+    }
+    ResumeThread(thread);
+    return depth;
+}
+
+StackSymbolizer sampler_create_symbolizer()
+{
+    SymbolMap symbols;
+    std::ifstream symbols_file{get_patch_module_dir() + symbol_map_filename};
+    if (symbols_file) {
+        size_t num_symbols = symbols.load(symbols_file);
+        xlog::info("Loaded {} symbols from {}", num_symbols, symbol_map_filename);
+        add_main_module_code_sections(symbols);
+    }
+    return StackSymbolizer{get_loaded_modules(), get_main_module_name(), std::move(symbols)};
+}
+
+bool sampler_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    if (auto args = string_match_command(command, "sample_start")) {
+        int rate_hz = default_sample_rate_hz;
+        if (!args->empty()) {
+            const auto value = string_to_long(*args);
+            if (!value || *value <= 0 || *value > max_sample_rate_hz) {
+                out_output_lines.emplace_back("Usage: sample_start [rate_hz 1-1000]");
+                out_status = "Invalid rate.";
+                return true;
+            }
+            rate_hz = static_cast<int>(*value);
+        }
+        if (!start_sampling(rate_hz)) {
+            out_output_lines.emplace_back("Sampler is already running or the main thread is not known yet.");
+            out_status = "Sampler not started.";
+            return true;
+        }
+        out_output_lines.emplace_back("Sampling main thread at " + std::to_string(rate_hz) + " Hz.");
+        out_status = "Started sampler.";
+        out_success = true;
+        return true;
+    }
+
+    if (auto args = string_match_command(command, "sample_stop")) {
+        const std::string path{args->empty() ? std::string_view{default_folded_path} : *args};
+        std::string message;
+        out_success = stop_sampling(path, message);
+        out_output_lines.push_back(message);
+        out_status = out_success ? "Stopped sampler." : "Sampler not stopped.";
+        return true;
+    }
+
+    return false;
+}
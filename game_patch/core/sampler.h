@@ -0,0 +1,23 @@
+#pragma once
+
+#include <common/utils/stack-sampling.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Remembers the calling thread as the game main thread. Called every frame from the Present hook.
+void sampler_register_main_thread();
+
+// Suspends the main thread, walks its frame pointer chain and resumes it. Must not be called from the main thread.
+// Returns the number of stored addresses (0 on failure).
+int sampler_capture_main_thread_stack(uintptr_t* out_frames, int max_depth);
+
+// Symbolizer for the modules loaded right now, using sopot_symbols.txt for the game executable if it exists
+StackSymbolizer sampler_create_symbolizer();
+
+bool sampler_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
@@ -0,0 +1,195 @@
+#include "vm_monitor.h"
+#include <common/utils/detach-on-exit-thread.h>
+#include <common/utils/string-utils.h>
+#include <common/utils/vm-map.h>
+#include <windows.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+namespace
+{
+
+constexpr unsigned max_interval_s = 3600;
+constexpr DWORD stop_check_interval_ms = 100;
+// RF2 loads levels in big chunks so warn well before the largest block gets small
+constexpr size_t fragmentation_warning_bytes = 256 * 1024 * 1024;
+constexpr size_t fragmentation_critical_bytes = 64 * 1024 * 1024;
+// Smaller changes between two snapshots are not logged
+constexpr size_t trend_log_step_bytes = 32 * 1024 * 1024;
+
+enum class PressureLevel
+{
+    normal,
+    warning,
+    critical,
+};
+
+std::mutex g_monitor_control_mutex;
+DetachOnExitThread g_monitor_thread;
+std::atomic<bool> g_monitor_running{false};
+std::atomic<unsigned> g_interval_s{0};
+std::atomic<PressureLevel> g_pressure_level{PressureLevel::normal};
+
+double to_mib(size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+size_t abs_diff(size_t a, size_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+PressureLevel get_pressure_level(const VmSummary& summary)
+{
+    if (summary.largest_free[0] < fragmentation_critical_bytes) {
+        return PressureLevel::critical;
+    }
+    if (summary.largest_free[0] < fragmentation_warning_bytes) {
+        return PressureLevel::warning;
+    }
+    return PressureLevel::normal;
+}
+
+void check_address_space(VmSummary& last_logged, bool& has_last_logged)
+{
+    std::vector<VmRegion> regions;
+    if (!query_vm_regions(regions)) {
+        return;
+    }
+    VmSummary summary = summarize_vm_regions(regions);
+
+    if (!has_last_logged || abs_diff(summary.largest_free[0], last_logged.largest_free[0]) >= trend_log_step_bytes
+        || abs_diff(summary.committed_private, last_logged.committed_private) >= trend_log_step_bytes) {
+        xlog::info(
+            "Address space: {:.1f} MiB free, largest block {:.1f} MiB, {} regions, {:.1f} MiB private commit",
+            to_mib(summary.total_free),
+            to_mib(summary.largest_free[0]),
+            summary.num_regions,
+            to_mib(summary.committed_private));
+        last_logged = summary;
+        has_last_logged = true;
+    }
+
+    PressureLevel level = get_pressure_level(summary);
+    PressureLevel prev_level = g_pressure_level.exchange(level, std::memory_order_relaxed);
+    if (level == prev_level) {
+        return;
+    }
+    if (level == PressureLevel::critical) {
+        xlog::error(
+            "Address space is badly fragmented: largest free block is {:.1f} MiB ({:.1f} MiB free in total), "
+            "large allocations are likely to fail",
+            to_mib(summary.largest_free[0]),
+            to_mib(summary.total_free));
+    }
+    else if (level == PressureLevel::warning) {
+        xlog::warn(
+            "Address space is getting fragmented: largest free block is {:.1f} MiB ({:.1f} MiB free in total)",
+            to_mib(summary.largest_free[0]),
+            to_mib(summary.total_free));
+    }
+    else {
+        xlog::info("Address space pressure is back to normal");
+    }
+}
+
+void monitor_thread_proc()
+{
+    VmSummary last_logged;
+    bool has_last_logged = false;
+    DWORD waited_ms = 0;
+    check_address_space(last_logged, has_last_logged);
+    while (g_monitor_running.load(std::memory_order_relaxed)) {
+        // Short sleeps so stopping the monitor does not wait for a whole interval
+        Sleep(stop_check_interval_ms);
+        waited_ms += stop_check_interval_ms;
+        if (waited_ms >= g_interval_s.load(std::memory_order_relaxed) * 1000) {
+            waited_ms = 0;
+            check_address_space(last_logged, has_last_logged);
+        }
+    }
+}
+
+void set_monitor_interval(unsigned interval_s)
+{
+    std::lock_guard lock{g_monitor_control_mutex};
+    g_interval_s.store(interval_s, std::memory_order_relaxed);
+    bool running = g_monitor_running.load(std::memory_order_relaxed);
+    if (interval_s && !running) {
+        g_monitor_running.store(true, std::memory_order_relaxed);
+        g_monitor_thread = DetachOnExitThread{monitor_thread_proc};
+        xlog::info("Address space monitor enabled (interval {} s)", interval_s);
+    }
+    else if (!interval_s && running) {
+        g_monitor_running.store(false, std::memory_order_relaxed);
+        g_monitor_thread.join();
+        g_pressure_level.store(PressureLevel::normal, std::memory_order_relaxed);
+        xlog::info("Address space monitor disabled");
+    }
+}
+
+} // namespace
+
+void vm_monitor_apply_settings(const Rf2PatchSettings& settings)
+{
+    set_monitor_interval(std::min(settings.vm_monitor_interval_s, max_interval_s));
+}
+
+bool vm_monitor_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines)
+{
+    out_success = false;
+    out_status.clear();
+    out_output_lines.clear();
+
+    const auto args = string_match_command(command, "vmmap");
+    if (!args) {
+        return false;
+    }
+
+    if (!args->empty()) {
+        const auto value = string_to_long(*args);
+        if (!value || *value < 0 || *value > static_cast<long>(max_interval_s)) {
+            out_output_lines.emplace_back("Usage: vmmap [monitor_interval_s 0-3600] (0 = monitor off)");
+            out_status = "Invalid interval.";
+            return true;
+        }
+        set_monitor_interval(static_cast<unsigned>(*value));
+    }
+
+    std::vector<VmRegion> regions;
+    if (!query_vm_regions(regions)) {
+        out_status = "Failed to query address space.";
+        return true;
+    }
+    VmSummary summary = summarize_vm_regions(regions);
+    out_output_lines = format_vm_summary(summary);
+
+    const char* level_name = "ok";
+    PressureLevel level = get_pressure_level(summary);
+    if (level == PressureLevel::critical) {
+        level_name = "critical (large allocations are likely to fail)";
+    }
+    else if (level == PressureLevel::warning) {
+        level_name = "fragmented";
+    }
+    const unsigned interval_s = g_interval_s.load(std::memory_order_relaxed);
+    char line[160];
+    if (interval_s) {
+        std::snprintf(line, sizeof(line), "State: %s, monitor checks every %u s", level_name, interval_s);
+    }
+    else {
+        std::snprintf(line, sizeof(line), "State: %s, monitor off", level_name);
+    }
+    out_output_lines.emplace_back(line);
+    out_status = args->empty() ? "Printed address space summary." : "Updated address space monitor interval.";
+    out_success = true;
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../misc/misc.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+void vm_monitor_apply_settings(const Rf2PatchSettings& settings);
+
+bool vm_monitor_try_handle_console_command(
+    std::string_view command,
+    bool& out_success,
+    std::string& out_status,
+    std::vector<std::string>& out_output_lines);
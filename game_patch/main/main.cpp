@@ -1,8 +1,11 @@
 #include "main.h"
 #include "../misc/misc.h"
 #include <crash_handler_stub.h>
-#include <xlog/FileAppender.h>
+#include <crash_handler_stub/FlightRecorder.h>
+#include <xlog/AsyncAppender.h>
+#include <xlog/BinaryLog.h>
 #include <xlog/LoggerConfig.h>
+#include <xlog/RotatingFileAppender.h>
 #include <xlog/xlog.h>
 #include <cstring>
 #include <cstdint>
@@ -23,8 +26,15 @@ static void init_logging()
     CreateDirectoryA("logs", nullptr);
     auto& logger_config = xlog::LoggerConfig::get();
     if (logger_config.get_appenders().empty()) {
-        logger_config.add_appender<xlog::FileAppender>("logs\\SOPOT.log", false, true);
+        // Lines are written and flushed by a background thread so logging from hooks does not stall the game. The log
+        // of the previous run is kept as SOPOT.1.log. The flight recorder keeps the most recent lines in memory for
+        // crash dumps and gets the text already formatted for the file.
+        auto file_appender = std::make_unique<xlog::RotatingFileAppender>("logs\\SOPOT.log");
+        logger_config.add_appender(std::make_unique<xlog::AsyncAppender>(std::move(file_appender), 4096,
+            xlog::AsyncOverflowPolicy::drop, std::make_unique<FlightRecorderAppender>()));
     }
+    // Decodes XLOG_BIN records from hooks into the log
+    xlog::start_bin_log_writer();
 
     xlog::info("SOPOT logging initialized");
     xlog::info("Command line: {}", GetCommandLineA());
@@ -91,6 +101,21 @@ static bool parse_max_fps_value(const std::string& value, float& max_fps)
     }
 }
 
+static bool parse_unsigned_value(const std::string& value, unsigned& out_value)
+{
+    const std::string text = trim_copy(value);
+    if (text.empty()) {
+        return false;
+    }
+    try {
+        out_value = static_cast<unsigned>(std::stoul(text));
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
 static bool parse_resolution_value(const std::string& value, unsigned& width, unsigned& height)
 {
     std::string text = to_lower_copy(trim_copy(value));
@@ -215,6 +240,24 @@ static Rf2PatchSettings load_patch_settings()
         else if (key == "experimental_fps_stabilization") {
             settings.experimental_fps_stabilization = parse_bool_value(value);
         }
+        else if (key == "ftol_rewrite") {
+            settings.ftol_rewrite = parse_bool_value(value);
+        }
+        else if (key == "hitch_threshold_ms") {
+            unsigned threshold_ms = settings.hitch_threshold_ms;
+            if (parse_unsigned_value(value, threshold_ms)) {
+                settings.hitch_threshold_ms = threshold_ms;
+            }
+        }
+        else if (key == "vm_monitor_interval_s") {
+            unsigned interval_s = settings.vm_monitor_interval_s;
+            if (parse_unsigned_value(value, interval_s)) {
+                settings.vm_monitor_interval_s = interval_s;
+            }
+        }
+        else if (key == "fast_heap") {
+            settings.fast_heap = parse_bool_value(value);
+        }
     }
 
     const char* mode_name = "windowed";
@@ -226,7 +269,7 @@ static Rf2PatchSettings load_patch_settings()
     }
 
     xlog::info(
-        "Loaded settings from {}: window_mode={}, resolution={}x{}, fast_start={}, vsync={}, direct_input_mouse={}, aim_slowdown_on_target={}, crosshair_enemy_indicator={}, r_showfps={}, experimental_fps_stabilization={}, fov={}, max_fps={}",
+        "Loaded settings from {}: window_mode={}, resolution={}x{}, fast_start={}, vsync={}, direct_input_mouse={}, aim_slowdown_on_target={}, crosshair_enemy_indicator={}, r_showfps={}, experimental_fps_stabilization={}, ftol_rewrite={}, fov={}, max_fps={}, hitch_threshold_ms={}, vm_monitor_interval_s={}, fast_heap={}",
         settings_path,
         mode_name,
         settings.window_width,
@@ -238,8 +281,12 @@ static Rf2PatchSettings load_patch_settings()
         settings.crosshair_enemy_indicator ? 1 : 0,
         settings.r_showfps ? 1 : 0,
         settings.experimental_fps_stabilization ? 1 : 0,
+        settings.ftol_rewrite ? 1 : 0,
         settings.fov,
-        settings.max_fps);
+        settings.max_fps,
+        settings.hitch_threshold_ms,
+        settings.vm_monitor_interval_s,
+        settings.fast_heap ? 1 : 0);
     return settings;
 }
 
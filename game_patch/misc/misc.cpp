@@ -1,7 +1,12 @@
 #include "misc.h"
 #include "../core/console.h"
 #include "../core/frame_limiter.h"
+#include "../core/frame_memory.h"
+#include "../core/heap.h"
 #include "../core/high_fps.h"
+#include "../core/hitch.h"
+#include "../core/profiler.h"
+#include "../core/vm_monitor.h"
 #include "../player/camera.h"
 #include "../rf2/gr/gr.h"
 #include "../rf2/os/input.h"
@@ -11,23 +16,28 @@
 #include "../rf2/player/reticle.h"
 #include "../rf2/rf2.h"
 #include <common/utils/os-utils.h>
+#include <common/utils/perf-utils.h>
+#include <common/utils/string-utils.h>
 #include <patch_common/FunHook.h>
+#include <patch_common/HookProfiler.h>
 #include <patch_common/AsmOpcodes.h>
 #include <patch_common/AsmWriter.h>
 #include <patch_common/MemUtils.h>
+#include <patch_common/VtableHookSet.h>
 #include <windows.h>
 #include <d3d8.h>
+#include <xlog/RateLimit.h>
 #include <xlog/xlog.h>
 #include <intrin.h>
 #include <algorithm>
 #include <array>
 #include <atomic>
-#include <cctype>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <limits>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -35,11 +45,16 @@
 namespace
 {
 
+xlog::Logger g_logger{"misc", xlog::Logger::root()};
+xlog::Logger g_d3d8to9_logger{"d3d8to9", xlog::Logger::root()};
+
 constexpr UINT default_window_width = 1024;
 constexpr UINT default_window_height = 768;
 constexpr int default_window_x = 40;
 constexpr int default_window_y = 40;
+constexpr size_t d3d8_vtbl_size = 16;
 constexpr size_t d3d8_create_device_vtbl_index = 15;
+constexpr size_t d3d8_device_vtbl_size = 97;
 constexpr size_t d3d8_device_reset_vtbl_index = 14;
 constexpr size_t d3d8_device_present_vtbl_index = 15;
 
@@ -69,7 +84,8 @@ void configure_window_mode_settings()
 
     if (!g_force_window_mode) {
         camera_set_resolution(g_forced_window_width, g_forced_window_height);
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Window mode setting: fullscreen (no forced window patch, selected resolution {}x{})",
             g_forced_window_width,
             g_forced_window_height);
@@ -81,7 +97,8 @@ void configure_window_mode_settings()
         g_forced_window_y = 0;
         camera_set_resolution(g_forced_window_width, g_forced_window_height);
 
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Window mode setting: borderless {}x{} at {},{}",
             g_forced_window_width,
             g_forced_window_height,
@@ -93,7 +110,8 @@ void configure_window_mode_settings()
     g_forced_window_x = default_window_x;
     g_forced_window_y = default_window_y;
     camera_set_resolution(g_forced_window_width, g_forced_window_height);
-    xlog::info(
+    XLOG_INFO(
+        g_logger,
         "Window mode setting: windowed {}x{} at {},{}",
         g_forced_window_width,
         g_forced_window_height,
@@ -171,7 +189,7 @@ bool patch_vram_check_opcode(uint8_t expected_jcc_opcode)
     }
 
     write_mem<uint8_t>(jcc_addr, 0xEB); // jmp short
-    xlog::info("Disabled RF2 video memory requirement check at 0x{:x}", jcc_addr);
+    XLOG_INFO(g_logger, "Disabled RF2 video memory requirement check at 0x{:x}", jcc_addr);
     return true;
 }
 
@@ -204,22 +222,14 @@ HWND g_game_window = nullptr;
 CreateDeviceFn g_original_create_device = nullptr;
 ResetFn g_original_reset = nullptr;
 PresentFn g_original_present = nullptr;
+VtableHookSet g_d3d8_hooks{d3d8_vtbl_size};
+VtableHookSet g_d3d8_device_hooks{d3d8_device_vtbl_size};
 Direct3DCreate8Fn g_d3d8to9_create8_export = nullptr;
 ShowWindowFn g_original_show_window = nullptr;
 ShowWindowAsyncFn g_original_show_window_async = nullptr;
 SetWindowPosFn g_original_set_window_pos = nullptr;
 SetWindowLongFn g_original_set_window_long_a = nullptr;
 SetWindowLongFn g_original_set_window_long_w = nullptr;
-int g_video_mode_log_count = 0;
-int g_set_window_pos_log_count = 0;
-int g_mouse_clip_log_count = 0;
-int g_mouse_surface_log_count = 0;
-std::atomic<int> g_thread_priority_log_count{0};
-std::atomic<int> g_sleep_clamp_log_count{0};
-int g_active_override_log_count = 0;
-int g_input_flush_log_count = 0;
-int g_fast_start_log_count = 0;
-int g_direct_input_log_count = 0;
 
 std::string get_patch_module_dir()
 {
@@ -228,7 +238,7 @@ std::string get_patch_module_dir()
             GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
             reinterpret_cast<LPCSTR>(&g_settings),
             &patch_module)) {
-        xlog::warn("GetModuleHandleExA failed for SOPOT module (error {})", GetLastError());
+        XLOG_WARN(g_logger, "GetModuleHandleExA failed for SOPOT module (error {})", GetLastError());
         return {};
     }
     return get_module_dir(patch_module);
@@ -244,29 +254,27 @@ void init_d3d8to9_bridge()
 
     std::string module_dir = get_patch_module_dir();
     if (module_dir.empty()) {
-        xlog::warn("Could not resolve SOPOT module directory for d3d8to9");
+        XLOG_WARN(g_d3d8to9_logger, "Could not resolve SOPOT module directory for d3d8to9");
         return;
     }
 
     const std::string d3d8to9_path = module_dir + "d3d8to9.dll";
-    xlog::info("Loading d3d8to9.dll: {}", d3d8to9_path);
+    XLOG_INFO(g_d3d8to9_logger, "Loading d3d8to9.dll: {}", d3d8to9_path);
     HMODULE d3d8to9_module = LoadLibraryA(d3d8to9_path.c_str());
     if (!d3d8to9_module) {
-        xlog::warn("Failed to load d3d8to9.dll (error {}), falling back to d3d8.dll", GetLastError());
+        XLOG_WARN(g_d3d8to9_logger, "Failed to load d3d8to9.dll (error {}), falling back to d3d8.dll", GetLastError());
         return;
     }
 
     auto* d3d8to9_create8_export = reinterpret_cast<Direct3DCreate8Fn>(GetProcAddress(d3d8to9_module, "Direct3DCreate8"));
     if (!d3d8to9_create8_export) {
-        xlog::warn("Could not resolve Direct3DCreate8 in d3d8to9.dll, falling back to d3d8.dll");
+        XLOG_WARN(g_d3d8to9_logger, "Could not resolve Direct3DCreate8 in d3d8to9.dll, falling back to d3d8.dll");
         return;
     }
 
     g_d3d8to9_create8_export = d3d8to9_create8_export;
-    xlog::info("Using d3d8to9 Direct3DCreate8 bridge");
+    XLOG_INFO(g_d3d8to9_logger, "Using d3d8to9 Direct3DCreate8 bridge");
 }
-int g_aim_slowdown_log_count = 0;
-int g_crosshair_indicator_log_count = 0;
 std::array<uintptr_t, 16> g_inactive_callsite_rvas{};
 size_t g_inactive_callsite_count = 0;
 float g_orig_aa_slowdown_min = 0.0f;
@@ -603,34 +611,6 @@ void force_windowed_style(HWND window, UINT client_width, UINT client_height, bo
     update_mouse_clip(window);
 }
 
-bool patch_vtable_entry(void* instance, size_t index, void* replacement, void** original_out)
-{
-    if (!instance) {
-        return false;
-    }
-
-    auto** vtable = *reinterpret_cast<void***>(instance);
-    void** slot = &vtable[index];
-    if (*slot == replacement) {
-        return true;
-    }
-
-    DWORD old_protect = 0;
-    if (!VirtualProtect(slot, sizeof(void*), PAGE_EXECUTE_READWRITE, &old_protect)) {
-        xlog::warn("VirtualProtect failed while patching vtable");
-        return false;
-    }
-
-    if (original_out) {
-        *original_out = *slot;
-    }
-    *slot = replacement;
-
-    DWORD dummy = 0;
-    VirtualProtect(slot, sizeof(void*), old_protect, &dummy);
-    return true;
-}
-
 HRESULT __stdcall d3d8_reset_hook(IDirect3DDevice8* self, D3DPRESENT_PARAMETERS* params)
 {
     frame_limiter_on_device_reset();
@@ -666,10 +646,17 @@ HRESULT __stdcall d3d8_present_hook(
     HWND dst_window_override,
     const RGNDATA* dirty_region)
 {
+    frame_memory_on_present();
+    profiler_on_present();
+    hitch_mark_phase("limiter_wait");
     frame_limiter_on_present();
-    const HRESULT hr = g_original_present
-        ? g_original_present(self, src_rect, dst_rect, dst_window_override, dirty_region)
-        : D3DERR_INVALIDCALL;
+    hitch_mark_phase("d3d_present");
+    HRESULT hr = D3DERR_INVALIDCALL;
+    if (g_original_present) {
+        PERF_ZONE("d3d_present");
+        hr = g_original_present(self, src_rect, dst_rect, dst_window_override, dirty_region);
+    }
+    hitch_mark_phase("overlay");
     if (SUCCEEDED(hr)) {
         HWND overlay_window = resolve_target_window(dst_window_override);
         if (!overlay_window && self) {
@@ -681,24 +668,15 @@ HRESULT __stdcall d3d8_present_hook(
         frame_limiter_draw_overlay(overlay_window);
         console_on_present(overlay_window);
     }
+    hitch_mark_phase("game");
     return hr;
 }
 
 void hook_d3d8_device(IDirect3DDevice8* device)
 {
-    if (!device) {
-        return;
+    if (!g_d3d8_device_hooks.install(device)) {
+        XLOG_WARN(g_logger, "Failed to hook Direct3D device");
     }
-    patch_vtable_entry(
-        device,
-        d3d8_device_reset_vtbl_index,
-        reinterpret_cast<void*>(d3d8_reset_hook),
-        reinterpret_cast<void**>(&g_original_reset));
-    patch_vtable_entry(
-        device,
-        d3d8_device_present_vtbl_index,
-        reinterpret_cast<void*>(d3d8_present_hook),
-        reinterpret_cast<void**>(&g_original_present));
 }
 
 HRESULT __stdcall d3d8_create_device_hook(
@@ -756,17 +734,17 @@ int __cdecl set_video_mode_hook(
     if (!g_force_window_mode) {
         const int target_width = static_cast<int>(g_forced_window_width);
         const int target_height = static_cast<int>(g_forced_window_height);
-        if (g_video_mode_log_count < 16) {
-            ++g_video_mode_log_count;
-            xlog::info(
-                "RF2 video mode request (fullscreen): {}x{} mode=0x{:X} -> forcing {}x{} mode=0x{:X}",
-                width,
-                height,
-                window_mode,
-                target_width,
-                target_height,
-                window_mode);
-        }
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            16,
+            "RF2 video mode request (fullscreen): {}x{} mode=0x{:X} -> forcing {}x{} mode=0x{:X}",
+            width,
+            height,
+            window_mode,
+            target_width,
+            target_height,
+            window_mode);
         const int result = g_set_video_mode_hook.call_target(
             target_width,
             target_height,
@@ -785,17 +763,17 @@ int __cdecl set_video_mode_hook(
 
     g_windowed_mode_forced = true;
 
-    if (g_video_mode_log_count < 16) {
-        ++g_video_mode_log_count;
-        xlog::info(
-            "RF2 video mode request: {}x{} mode=0x{:X} -> forcing {}x{} mode=0x{:X}",
-            width,
-            height,
-            window_mode,
-            g_forced_window_width,
-            g_forced_window_height,
-            g_forced_window_mode);
-    }
+    XLOG_FIRST_N(
+        g_logger,
+        xlog::Level::info,
+        16,
+        "RF2 video mode request: {}x{} mode=0x{:X} -> forcing {}x{} mode=0x{:X}",
+        width,
+        height,
+        window_mode,
+        g_forced_window_width,
+        g_forced_window_height,
+        g_forced_window_mode);
 
     int result = g_set_video_mode_hook.call_target(
         static_cast<int>(g_forced_window_width),
@@ -826,15 +804,15 @@ void __cdecl init_mouse_surface_hook(int width, int height)
         return;
     }
 
-    if (g_mouse_surface_log_count < 16) {
-        ++g_mouse_surface_log_count;
-        xlog::info(
-            "RF2 mouse surface init: {}x{} -> forcing {}x{}",
-            width,
-            height,
-            g_forced_window_width,
-            g_forced_window_height);
-    }
+    XLOG_FIRST_N(
+        g_logger,
+        xlog::Level::info,
+        16,
+        "RF2 mouse surface init: {}x{} -> forcing {}x{}",
+        width,
+        height,
+        g_forced_window_width,
+        g_forced_window_height);
 
     g_init_mouse_surface_hook.call_target(static_cast<int>(g_forced_window_width), static_cast<int>(g_forced_window_height));
     sync_resolution_globals();
@@ -876,52 +854,6 @@ int __cdecl get_viewport_height_hook()
     return static_cast<int>(g_forced_window_height);
 }
 
-std::string trim_ascii_copy(std::string value)
-{
-    auto not_space = [](unsigned char c) { return !std::isspace(c); };
-    value.erase(value.begin(), std::find_if(value.begin(), value.end(), not_space));
-    value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(), value.end());
-    return value;
-}
-
-std::string to_lower_ascii_copy(std::string value)
-{
-    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-    return value;
-}
-
-bool starts_with_case_insensitive(std::string_view value, std::string_view prefix)
-{
-    if (prefix.size() > value.size()) {
-        return false;
-    }
-    for (size_t i = 0; i < prefix.size(); ++i) {
-        unsigned char lc = static_cast<unsigned char>(value[i]);
-        unsigned char rc = static_cast<unsigned char>(prefix[i]);
-        if (std::tolower(lc) != std::tolower(rc)) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool equals_case_insensitive(std::string_view left, std::string_view right)
-{
-    return left.size() == right.size() && starts_with_case_insensitive(left, right);
-}
-
-bool contains_case_insensitive(std::string_view haystack, std::string_view needle)
-{
-    if (needle.empty()) {
-        return true;
-    }
-    const std::string haystack_lc = to_lower_ascii_copy(std::string{haystack});
-    const std::string needle_lc = to_lower_ascii_copy(std::string{needle});
-    return haystack_lc.find(needle_lc) != std::string::npos;
-}
-
 std::string get_window_text(HWND control)
 {
     if (!control || !IsWindow(control)) {
@@ -948,29 +880,14 @@ std::string_view movie_basename(std::string_view movie_name)
     return movie_name.substr(slash_pos + 1);
 }
 
-bool iequals_ascii(std::string_view left, std::string_view right)
-{
-    if (left.size() != right.size()) {
-        return false;
-    }
-    for (size_t i = 0; i < left.size(); ++i) {
-        unsigned char lc = static_cast<unsigned char>(left[i]);
-        unsigned char rc = static_cast<unsigned char>(right[i]);
-        if (std::tolower(lc) != std::tolower(rc)) {
-            return false;
-        }
-    }
-    return true;
-}
-
 bool parse_bool_like(std::string_view value, bool& out_value)
 {
-    const std::string lowered = to_lower_ascii_copy(trim_ascii_copy(std::string{value}));
-    if (lowered == "1" || lowered == "true" || lowered == "yes" || lowered == "on") {
+    value = trim(value);
+    if (value == "1" || string_iequals(value, "true") || string_iequals(value, "yes") || string_iequals(value, "on")) {
         out_value = true;
         return true;
     }
-    if (lowered == "0" || lowered == "false" || lowered == "no" || lowered == "off") {
+    if (value == "0" || string_iequals(value, "false") || string_iequals(value, "no") || string_iequals(value, "off")) {
         out_value = false;
         return true;
     }
@@ -988,7 +905,8 @@ void save_direct_input_mouse_setting()
             g_direct_input_mouse_enabled ? "1" : "0",
             g_settings.settings_file_path.c_str()))
     {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "Failed to persist direct_input_mouse={} to {}",
             g_direct_input_mouse_enabled ? 1 : 0,
             g_settings.settings_file_path);
@@ -1004,9 +922,13 @@ void apply_direct_input_mouse_mode(bool log_change)
     if (g_direct_input_mouse_enabled) {
         if (!rf2::os::input::mouse_device && rf2::os::input::direct_input_api) {
             const int init_result = rf2::os::input::mouse_init_direct_input();
-            if (log_change && g_direct_input_log_count < 12) {
-                ++g_direct_input_log_count;
-                xlog::info("DirectInput mouse init attempt returned {}", init_result);
+            if (log_change) {
+                XLOG_FIRST_N(
+                    g_logger,
+                    xlog::Level::info,
+                    12,
+                    "DirectInput mouse init attempt returned {}",
+                    init_result);
             }
         }
 
@@ -1017,7 +939,7 @@ void apply_direct_input_mouse_mode(bool log_change)
 
         rf2::os::input::mouse_direct_input_enabled = 0;
         if (log_change) {
-            xlog::warn("DirectInput mouse requested but RF2 mouse device is unavailable");
+            XLOG_WARN(g_logger, "DirectInput mouse requested but RF2 mouse device is unavailable");
         }
         return;
     }
@@ -1026,9 +948,8 @@ void apply_direct_input_mouse_mode(bool log_change)
         rf2::os::input::mouse_release_direct_input();
     }
     rf2::os::input::mouse_direct_input_enabled = 0;
-    if (log_change && g_direct_input_log_count < 12) {
-        ++g_direct_input_log_count;
-        xlog::info("DirectInput mouse disabled");
+    if (log_change) {
+        XLOG_FIRST_N(g_logger, xlog::Level::info, 12, "DirectInput mouse disabled");
     }
 }
 
@@ -1043,7 +964,8 @@ void save_aim_slowdown_setting()
             g_aim_slowdown_on_target_enabled ? "1" : "0",
             g_settings.settings_file_path.c_str()))
     {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "Failed to persist aim_slowdown_on_target={} to {}",
             g_aim_slowdown_on_target_enabled ? 1 : 0,
             g_settings.settings_file_path);
@@ -1061,7 +983,8 @@ void save_crosshair_enemy_indicator_setting()
             g_crosshair_enemy_indicator_enabled ? "1" : "0",
             g_settings.settings_file_path.c_str()))
     {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "Failed to persist crosshair_enemy_indicator={} to {}",
             g_crosshair_enemy_indicator_enabled ? 1 : 0,
             g_settings.settings_file_path);
@@ -1079,9 +1002,11 @@ void apply_aim_slowdown_setting(bool log_change)
     if (g_aim_slowdown_on_target_enabled) {
         rf2::player::autoaim::slowdown_factor_min = g_orig_aa_slowdown_min;
         rf2::player::autoaim::slowdown_factor_max = g_orig_aa_slowdown_max;
-        if (log_change && g_aim_slowdown_log_count < 8) {
-            ++g_aim_slowdown_log_count;
-            xlog::info(
+        if (log_change) {
+            XLOG_FIRST_N(
+                g_logger,
+                xlog::Level::info,
+                8,
                 "Aim slowdown enabled (aa_slowdown_factor_min={}, aa_slowdown_factor_max={})",
                 g_orig_aa_slowdown_min,
                 g_orig_aa_slowdown_max);
@@ -1091,9 +1016,12 @@ void apply_aim_slowdown_setting(bool log_change)
 
     rf2::player::autoaim::slowdown_factor_min = 1.0f;
     rf2::player::autoaim::slowdown_factor_max = 1.0f;
-    if (log_change && g_aim_slowdown_log_count < 8) {
-        ++g_aim_slowdown_log_count;
-        xlog::info("Aim slowdown disabled (aa_slowdown_factor_min/max forced to 1.0)");
+    if (log_change) {
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            8,
+            "Aim slowdown disabled (aa_slowdown_factor_min/max forced to 1.0)");
     }
 }
 
@@ -1112,9 +1040,8 @@ void apply_crosshair_enemy_indicator_setting(bool log_change)
             const auto& pair = rf2::player::reticle::enemy_variant_pairs[i];
             addr_as_ref<uintptr_t>(pair.enemy_ptr_addr) = g_orig_enemy_reticle_ptrs[i];
         }
-        if (log_change && g_crosshair_indicator_log_count < 8) {
-            ++g_crosshair_indicator_log_count;
-            xlog::info("Enemy crosshair indicator enabled");
+        if (log_change) {
+            XLOG_FIRST_N(g_logger, xlog::Level::info, 8, "Enemy crosshair indicator enabled");
         }
         return;
     }
@@ -1122,9 +1049,12 @@ void apply_crosshair_enemy_indicator_setting(bool log_change)
     for (const auto& pair : rf2::player::reticle::enemy_variant_pairs) {
         addr_as_ref<uintptr_t>(pair.enemy_ptr_addr) = addr_as_ref<uintptr_t>(pair.normal_ptr_addr);
     }
-    if (log_change && g_crosshair_indicator_log_count < 8) {
-        ++g_crosshair_indicator_log_count;
-        xlog::info("Enemy crosshair indicator disabled (enemy reticle variants remapped)");
+    if (log_change) {
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            8,
+            "Enemy crosshair indicator disabled (enemy reticle variants remapped)");
     }
 }
 
@@ -1135,18 +1065,21 @@ bool is_fast_start_logo_movie(const char* movie_name)
     }
 
     const std::string_view name = movie_basename(movie_name);
-    return iequals_ascii(name, "thq-v.bik")
-        || iequals_ascii(name, "volition-logo.bik")
-        || iequals_ascii(name, "outrage-logo.bik");
+    return string_iequals(name, "thq-v.bik")
+        || string_iequals(name, "volition-logo.bik")
+        || string_iequals(name, "outrage-logo.bik");
 }
 
 int __cdecl play_movie_hook(const char* movie_name, int mode)
 {
     if (g_fast_start_enabled && is_fast_start_logo_movie(movie_name)) {
-        if (g_fast_start_log_count < 12) {
-            ++g_fast_start_log_count;
-            xlog::info("Fast start: skipping startup movie {} (mode {})", movie_name ? movie_name : "<null>", mode);
-        }
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            12,
+            "Fast start: skipping startup movie {} (mode {})",
+            movie_name ? movie_name : "<null>",
+            mode);
         return 1;
     }
 
@@ -1155,6 +1088,7 @@ int __cdecl play_movie_hook(const char* movie_name, int mode)
 
 void __cdecl mouse_update_hook()
 {
+    HOOK_PROFILE("mouse_update_hook");
     apply_direct_input_mouse_mode(false);
     apply_aim_slowdown_setting(false);
     g_mouse_update_hook.call_target();
@@ -1168,6 +1102,7 @@ void __cdecl mouse_update_hook()
 
 void __cdecl mouse_get_delta_hook(int* x, int* y, int* z)
 {
+    HOOK_PROFILE("mouse_get_delta_hook");
     g_mouse_get_delta_hook.call_target(x, y, z);
     if (rf2::os::input::mouse_direct_input_enabled == 0) {
         return;
@@ -1206,6 +1141,7 @@ bool is_game_window_foreground()
 
 uint8_t __cdecl is_window_active_hook()
 {
+    HOOK_PROFILE("is_window_active_hook");
     frame_limiter_apply_runtime_overrides();
     const uint8_t active = g_is_window_active_hook.call_target();
     if (active) {
@@ -1233,13 +1169,14 @@ uint8_t __cdecl is_window_active_hook()
     case rf2::os::window::inactive_wait_caller_rva_5:
     case rf2::os::window::inactive_wait_caller_rva_6:
     case rf2::os::window::inactive_wait_caller_rva_7:
-        if (g_active_override_log_count < 12) {
-            ++g_active_override_log_count;
-            xlog::info(
-                "Bypassing RF2 inactive wait loop at caller rva=0x{:X} va=0x{:X}",
-                static_cast<unsigned>(caller_rva),
-                static_cast<unsigned>(caller_va));
-        }
+        XLOG_PER_INTERVAL(
+            g_logger,
+            xlog::Level::info,
+            1,
+            10000,
+            "Bypassing RF2 inactive wait loop at caller rva=0x{:X} va=0x{:X}",
+            static_cast<unsigned>(caller_rva),
+            static_cast<unsigned>(caller_va));
         return 1;
     default:
         bool seen = false;
@@ -1251,7 +1188,8 @@ uint8_t __cdecl is_window_active_hook()
         }
         if (!seen && g_inactive_callsite_count < g_inactive_callsite_rvas.size()) {
             g_inactive_callsite_rvas[g_inactive_callsite_count++] = caller_rva;
-            xlog::info(
+            XLOG_INFO(
+                g_logger,
                 "RF2 inactive state observed at unhandled caller rva=0x{:X} va=0x{:X}",
                 static_cast<unsigned>(caller_rva),
                 static_cast<unsigned>(caller_va));
@@ -1268,10 +1206,7 @@ void flush_input_state_on_deactivate()
     rf2::os::input::alt_key_down = 0;
     rf2::os::input::tab_key_down = 0;
 
-    if (g_input_flush_log_count < 8) {
-        ++g_input_flush_log_count;
-        xlog::info("Flushed RF2 input state on focus loss");
-    }
+    XLOG_FIRST_N(g_logger, xlog::Level::info, 8, "Flushed RF2 input state on focus loss");
 }
 
 BOOL __stdcall set_thread_priority_hook(HANDLE thread, int priority)
@@ -1282,19 +1217,21 @@ BOOL __stdcall set_thread_priority_hook(HANDLE thread, int priority)
     if (caller_in_rf2 && patched_priority < THREAD_PRIORITY_NORMAL) {
         flush_input_state_on_deactivate();
         patched_priority = THREAD_PRIORITY_NORMAL;
-        const int log_idx = g_thread_priority_log_count.fetch_add(1, std::memory_order_relaxed);
-        if (log_idx < 8) {
-            xlog::info(
-                "Clamping SetThreadPriority from {} to {} to avoid background throttling",
-                priority,
-                patched_priority);
-        }
+        XLOG_BIN_PER_INTERVAL(
+            g_logger,
+            xlog::Level::info,
+            4,
+            10000,
+            "Clamping SetThreadPriority from {} to {} to avoid background throttling",
+            priority,
+            patched_priority);
     }
     return g_original_set_thread_priority ? g_original_set_thread_priority(thread, patched_priority) : FALSE;
 }
 
 VOID __stdcall sleep_hook(DWORD milliseconds)
 {
+    HOOK_PROFILE("sleep_hook");
     struct Guard
     {
         bool& flag;
@@ -1322,15 +1259,15 @@ VOID __stdcall sleep_hook(DWORD milliseconds)
             (g_is_window_active_hook.call_target() != 0) || console_is_open() || is_game_window_foreground();
         if (!is_active) {
             patched_milliseconds = 0;
-            const int log_idx = g_sleep_clamp_log_count.fetch_add(1, std::memory_order_relaxed);
-            if (log_idx < 16) {
-                const uintptr_t caller_rva = caller_va - rf2::module_base();
-                xlog::info(
-                    "Clamping inactive Sleep from {}ms to 0ms at caller rva=0x{:X} va=0x{:X}",
-                    static_cast<unsigned>(milliseconds),
-                    static_cast<unsigned>(caller_rva),
-                    static_cast<unsigned>(caller_va));
-            }
+            XLOG_BIN_PER_INTERVAL(
+                g_logger,
+                xlog::Level::info,
+                1,
+                10000,
+                "Clamping inactive Sleep from {}ms to 0ms at caller rva=0x{:X} va=0x{:X}",
+                static_cast<unsigned>(milliseconds),
+                static_cast<unsigned>(caller_va - rf2::module_base()),
+                static_cast<unsigned>(caller_va));
         }
     }
     g_sleep_hook.call_target(patched_milliseconds);
@@ -1383,6 +1320,7 @@ BOOL __stdcall show_window_async_hook(HWND window, int cmd_show)
 
 BOOL __stdcall set_window_pos_hook(HWND window, HWND insert_after, int x, int y, int cx, int cy, UINT flags)
 {
+    HOOK_PROFILE("set_window_pos_hook");
     if (should_patch_window(window)) {
         const UINT original_flags = flags;
         const HWND original_insert_after = insert_after;
@@ -1409,41 +1347,41 @@ BOOL __stdcall set_window_pos_hook(HWND window, HWND insert_after, int x, int y,
         cx = static_cast<int>(g_forced_window_width);
         cy = static_cast<int>(g_forced_window_height);
 
-        if (g_set_window_pos_log_count < 24) {
-            ++g_set_window_pos_log_count;
-            xlog::info(
-                "SetWindowPos override hwnd={} z={} x/y {}x{} -> {}x{} size {}x{} -> {}x{} flags 0x{:X} -> 0x{:X}",
-                static_cast<void*>(window),
-                static_cast<void*>(original_insert_after),
-                original_x,
-                original_y,
-                x,
-                y,
-                original_cx,
-                original_cy,
-                cx,
-                cy,
-                original_flags,
-                flags);
-        }
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            24,
+            "SetWindowPos override hwnd={} z={} x/y {}x{} -> {}x{} size {}x{} -> {}x{} flags 0x{:X} -> 0x{:X}",
+            static_cast<void*>(window),
+            static_cast<void*>(original_insert_after),
+            original_x,
+            original_y,
+            x,
+            y,
+            original_cx,
+            original_cy,
+            cx,
+            cy,
+            original_flags,
+            flags);
 
         BOOL result = g_original_set_window_pos
             ? g_original_set_window_pos(window, insert_after, x, y, cx, cy, flags)
             : FALSE;
         RECT actual_rect{};
         bool got_rect = GetWindowRect(window, &actual_rect) == TRUE;
-        if (g_set_window_pos_log_count < 48) {
-            ++g_set_window_pos_log_count;
-            xlog::info(
-                "SetWindowPos result hwnd={} ok={} gle={} actual={}x{}+{},{}",
-                static_cast<void*>(window),
-                result ? 1 : 0,
-                result ? 0 : static_cast<int>(GetLastError()),
-                got_rect ? (actual_rect.right - actual_rect.left) : -1,
-                got_rect ? (actual_rect.bottom - actual_rect.top) : -1,
-                got_rect ? actual_rect.left : -1,
-                got_rect ? actual_rect.top : -1);
-        }
+        XLOG_FIRST_N(
+            g_logger,
+            xlog::Level::info,
+            24,
+            "SetWindowPos result hwnd={} ok={} gle={} actual={}x{}+{},{}",
+            static_cast<void*>(window),
+            result ? 1 : 0,
+            result ? 0 : static_cast<int>(GetLastError()),
+            got_rect ? (actual_rect.right - actual_rect.left) : -1,
+            got_rect ? (actual_rect.bottom - actual_rect.top) : -1,
+            got_rect ? actual_rect.left : -1,
+            got_rect ? actual_rect.top : -1);
         ShowWindow(window, SW_RESTORE);
         BringWindowToTop(window);
         SetForegroundWindow(window);
@@ -1520,7 +1458,7 @@ void install_show_window_hooks()
         user32_module = LoadLibraryA("user32.dll");
     }
     if (!user32_module) {
-        xlog::warn("Failed to load user32.dll for window hooks");
+        XLOG_WARN(g_logger, "Failed to load user32.dll for window hooks");
         return;
     }
 
@@ -1530,7 +1468,7 @@ void install_show_window_hooks()
     auto* set_window_long_a_addr = reinterpret_cast<SetWindowLongFn>(GetProcAddress(user32_module, "SetWindowLongA"));
     auto* set_window_long_w_addr = reinterpret_cast<SetWindowLongFn>(GetProcAddress(user32_module, "SetWindowLongW"));
     if (!show_window_addr || !show_window_async_addr || !set_window_pos_addr || !set_window_long_a_addr || !set_window_long_w_addr) {
-        xlog::warn("Could not resolve one or more user32 window exports");
+        XLOG_WARN(g_logger, "Could not resolve one or more user32 window exports");
         return;
     }
 
@@ -1560,7 +1498,7 @@ void install_background_activity_patch()
         kernel32_module = LoadLibraryA("kernel32.dll");
     }
     if (!kernel32_module) {
-        xlog::warn("Failed to load kernel32.dll for thread priority hook");
+        XLOG_WARN(g_logger, "Failed to load kernel32.dll for thread priority hook");
         installed = true;
         return;
     }
@@ -1572,7 +1510,7 @@ void install_background_activity_patch()
         g_set_thread_priority_hook.install();
     }
     else {
-        xlog::warn("Could not resolve SetThreadPriority export");
+        XLOG_WARN(g_logger, "Could not resolve SetThreadPriority export");
     }
 
     auto* sleep_addr = reinterpret_cast<SleepFn>(GetProcAddress(kernel32_module, "Sleep"));
@@ -1581,11 +1519,11 @@ void install_background_activity_patch()
         g_sleep_hook.install();
     }
     else {
-        xlog::warn("Could not resolve Sleep export");
+        XLOG_WARN(g_logger, "Could not resolve Sleep export");
     }
 
     installed = true;
-    xlog::info("Installed background activity patch (inactive-wait bypass + thread priority/sleep clamps)");
+    XLOG_INFO(g_logger, "Installed background activity patch (inactive-wait bypass + thread priority/sleep clamps)");
 }
 
 IDirect3D8* __stdcall d3d8_create8_export_hook(UINT sdk_version);
@@ -1596,14 +1534,9 @@ FunHook<IDirect3D8* __stdcall(UINT)> g_d3d8_create8_export_hook{
 
 void hook_d3d8_instance(IDirect3D8* d3d8)
 {
-    if (!d3d8) {
-        return;
+    if (!g_d3d8_hooks.install(d3d8)) {
+        XLOG_WARN(g_logger, "Failed to hook Direct3D instance");
     }
-    patch_vtable_entry(
-        d3d8,
-        d3d8_create_device_vtbl_index,
-        reinterpret_cast<void*>(d3d8_create_device_hook),
-        reinterpret_cast<void**>(&g_original_create_device));
 }
 
 IDirect3D8* __stdcall d3d8_create8_export_hook(UINT sdk_version)
@@ -1639,7 +1572,7 @@ void install_window_mode_patch()
     if (!g_force_window_mode) {
         install_background_activity_patch();
         installed = true;
-        xlog::info("Installed video mode resolution hook (fullscreen setting)");
+        XLOG_INFO(g_logger, "Installed video mode resolution hook (fullscreen setting)");
         return;
     }
 
@@ -1651,22 +1584,27 @@ void install_window_mode_patch()
         d3d8_module = LoadLibraryA("d3d8.dll");
     }
     if (!d3d8_module) {
-        xlog::warn("Failed to load d3d8.dll, windowed mode patch not installed");
+        XLOG_WARN(g_logger, "Failed to load d3d8.dll, windowed mode patch not installed");
         return;
     }
 
     auto* d3d8_create8_export = reinterpret_cast<Direct3DCreate8Fn>(GetProcAddress(d3d8_module, "Direct3DCreate8"));
     if (!d3d8_create8_export) {
-        xlog::warn("Could not resolve Direct3DCreate8 export");
+        XLOG_WARN(g_logger, "Could not resolve Direct3DCreate8 export");
         return;
     }
 
+    // Only objects created by the game get shadow vtables so other D3D users in the process are not affected
+    g_d3d8_hooks.hook(d3d8_create_device_vtbl_index, d3d8_create_device_hook, &g_original_create_device);
+    g_d3d8_device_hooks.hook(d3d8_device_reset_vtbl_index, d3d8_reset_hook, &g_original_reset);
+    g_d3d8_device_hooks.hook(d3d8_device_present_vtbl_index, d3d8_present_hook, &g_original_present);
     g_d3d8_create8_export_hook.set_addr(reinterpret_cast<uintptr_t>(d3d8_create8_export));
     g_d3d8_create8_export_hook.install();
     install_background_activity_patch();
     // Keep user32 APIs unhooked for now; direct mode hook + explicit style/resize calls are more reliable.
     installed = true;
-    xlog::info(
+    XLOG_INFO(
+        g_logger,
         "Installed window mode patch ({})",
         g_borderless_mode ? "borderless" : "windowed");
 }
@@ -1679,7 +1617,7 @@ void disable_video_memory_requirement_check()
     }
 
     if (!patch_vram_check_opcode(0x7D) && !patch_vram_check_opcode(0x7C)) {
-        xlog::warn("RF2 video memory requirement signature not found; check not patched");
+        XLOG_WARN(g_logger, "RF2 video memory requirement signature not found; check not patched");
         return;
     }
 
@@ -1694,13 +1632,13 @@ void install_fast_start_patch()
     }
 
     if (!g_fast_start_enabled) {
-        xlog::info("Fast start disabled by settings");
+        XLOG_INFO(g_logger, "Fast start disabled by settings");
         return;
     }
 
     g_play_movie_hook.install();
     installed = true;
-    xlog::info("Installed fast start patch (startup logo movies will be skipped)");
+    XLOG_INFO(g_logger, "Installed fast start patch (startup logo movies will be skipped)");
 }
 
 } // namespace
@@ -1720,9 +1658,12 @@ void misc_apply_patches(const Rf2PatchSettings& settings)
     g_aim_slowdown_on_target_enabled = g_settings.aim_slowdown_on_target;
     g_crosshair_enemy_indicator_enabled = g_settings.crosshair_enemy_indicator;
 
+    heap_apply_settings(g_settings);
     fix_launch_hook.install();
     frame_limiter_apply_settings(g_settings);
-    high_fps_apply_patch();
+    hitch_apply_settings(g_settings);
+    vm_monitor_apply_settings(g_settings);
+    high_fps_apply_patch(g_settings);
     camera_apply_settings(g_settings);
     configure_window_mode_settings();
     disable_video_memory_requirement_check();
@@ -1753,7 +1694,7 @@ bool misc_get_mouse_aim_sensitivity(float& out_value)
 }
 
 bool misc_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines)
@@ -1762,22 +1703,19 @@ bool misc_try_handle_console_command(
     out_status.clear();
     out_output_lines.clear();
 
-    const std::string trimmed = trim_ascii_copy(command);
-
     auto handle_bool_command = [&](
-        bool matches,
-        std::string_view primary_name,
+        std::optional<std::string_view> args,
         std::string_view usage,
         bool& backing_value,
         auto&& apply_fn,
         auto&& save_fn,
         auto&& status_fn)
     {
-        if (!matches) {
+        if (!args) {
             return false;
         }
 
-        const std::string arg_text = trim_ascii_copy(trimmed.substr(primary_name.size()));
+        const std::string_view arg_text = *args;
         if (arg_text.empty()) {
             out_output_lines.push_back(status_fn());
             out_status = "Printed setting state.";
@@ -1801,12 +1739,12 @@ bool misc_try_handle_console_command(
         return true;
     };
 
-    const bool is_directinput =
-        starts_with_case_insensitive(trimmed, "directinput")
-        || starts_with_case_insensitive(trimmed, "dinput");
+    auto directinput_args = string_match_command(command, "directinput");
+    if (!directinput_args) {
+        directinput_args = string_match_command(command, "dinput");
+    }
     if (handle_bool_command(
-            is_directinput,
-            starts_with_case_insensitive(trimmed, "directinput") ? "directinput" : "dinput",
+            directinput_args,
             "Usage: directinput <0|1> (alias: dinput <0|1>)",
             g_direct_input_mouse_enabled,
             apply_direct_input_mouse_mode,
@@ -1826,8 +1764,7 @@ bool misc_try_handle_console_command(
     }
 
     if (handle_bool_command(
-            starts_with_case_insensitive(trimmed, "aimslow"),
-            "aimslow",
+            string_match_command(command, "aimslow"),
             "Usage: aimslow <0|1>",
             g_aim_slowdown_on_target_enabled,
             apply_aim_slowdown_setting,
@@ -1848,8 +1785,7 @@ bool misc_try_handle_console_command(
     }
 
     if (handle_bool_command(
-            starts_with_case_insensitive(trimmed, "enemycrosshair"),
-            "enemycrosshair",
+            string_match_command(command, "enemycrosshair"),
             "Usage: enemycrosshair <0|1>",
             g_crosshair_enemy_indicator_enabled,
             apply_crosshair_enemy_indicator_setting,
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class Rf2PatchWindowMode
@@ -23,13 +24,17 @@ struct Rf2PatchSettings
     bool crosshair_enemy_indicator = true;
     bool r_showfps = false;
     bool experimental_fps_stabilization = false;
+    bool ftol_rewrite = false;
+    unsigned hitch_threshold_ms = 0;
+    unsigned vm_monitor_interval_s = 5;
+    bool fast_heap = false;
     std::string settings_file_path{};
 };
 
 void misc_apply_patches(const Rf2PatchSettings& settings);
 
 bool misc_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines);
@@ -1,11 +1,12 @@
 #include "camera.h"
 #include "../rf2/player/camera.h"
+#include <common/utils/string-utils.h>
 #include <patch_common/FunHook.h>
 #include <patch_common/MemUtils.h>
+#include <patch_common/PatchTransaction.h>
 #include <windows.h>
 #include <xlog/xlog.h>
 #include <algorithm>
-#include <cctype>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
@@ -14,6 +15,8 @@
 namespace
 {
 
+xlog::Logger g_logger{"camera", xlog::Logger::root()};
+
 constexpr float rf2_base_hfov_4_3 = 90.0f;
 constexpr float rf2_base_aspect_4_3 = 4.0f / 3.0f;
 
@@ -32,29 +35,6 @@ FunHook<int __cdecl(int, int, int, int, int, float)> g_set_camera_params_hook{
     set_camera_params_hook,
 };
 
-std::string trim_ascii_copy(std::string value)
-{
-    auto not_space = [](unsigned char c) { return !std::isspace(c); };
-    value.erase(value.begin(), std::find_if(value.begin(), value.end(), not_space));
-    value.erase(std::find_if(value.rbegin(), value.rend(), not_space).base(), value.end());
-    return value;
-}
-
-bool starts_with_case_insensitive(std::string_view value, std::string_view prefix)
-{
-    if (prefix.size() > value.size()) {
-        return false;
-    }
-    for (size_t i = 0; i < prefix.size(); ++i) {
-        unsigned char lc = static_cast<unsigned char>(value[i]);
-        unsigned char rc = static_cast<unsigned char>(prefix[i]);
-        if (std::tolower(lc) != std::tolower(rc)) {
-            return false;
-        }
-    }
-    return true;
-}
-
 float clamp_fov(float value)
 {
     return std::clamp(value, 1.0f, 179.0f);
@@ -89,7 +69,8 @@ void install_camera_fov_hook()
 
     const uint8_t first_op = addr_as_ref<uint8_t>(rf2::player::camera::set_camera_params_addr);
     if (first_op != 0xA0 && first_op != 0x55) {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "RF2 camera FOV hook signature mismatch at 0x{:X}",
             static_cast<unsigned>(rf2::player::camera::set_camera_params_addr));
         return;
@@ -97,7 +78,8 @@ void install_camera_fov_hook()
 
     g_set_camera_params_hook.install();
     g_camera_fov_hook_installed = true;
-    xlog::info(
+    XLOG_INFO(
+        g_logger,
         "Installed RF2 camera FOV hook at 0x{:X}",
         static_cast<unsigned>(rf2::player::camera::set_camera_params_addr));
 }
@@ -116,7 +98,7 @@ void save_fov_to_settings()
         std::snprintf(fov_value, sizeof(fov_value), "%.3f", clamp_fov(g_user_fov));
     }
     if (!WritePrivateProfileStringA("sopot", "fov", fov_value, g_settings_path.c_str())) {
-        xlog::warn("Failed to persist fov={} to {}", fov_value, g_settings_path);
+        XLOG_WARN(g_logger, "Failed to persist fov={} to {}", fov_value, g_settings_path);
     }
 }
 
@@ -130,13 +112,13 @@ void discover_fov_instruction_sites()
     const uintptr_t base = rf2::module_base();
     const auto* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
     if (!dos || dos->e_magic != IMAGE_DOS_SIGNATURE) {
-        xlog::warn("Unable to scan RF2 FOV sites: invalid DOS header");
+        XLOG_WARN(g_logger, "Unable to scan RF2 FOV sites: invalid DOS header");
         return;
     }
 
     const auto* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + static_cast<uintptr_t>(dos->e_lfanew));
     if (!nt || nt->Signature != IMAGE_NT_SIGNATURE) {
-        xlog::warn("Unable to scan RF2 FOV sites: invalid NT header");
+        XLOG_WARN(g_logger, "Unable to scan RF2 FOV sites: invalid NT header");
         return;
     }
 
@@ -175,7 +157,8 @@ void discover_fov_instruction_sites()
     }
 
     if (g_fov_instruction_immediates.size() > 32) {
-        xlog::warn(
+        XLOG_WARN(
+            g_logger,
             "RF2 FOV scan found suspiciously high site count ({}), ignoring instruction patching",
             g_fov_instruction_immediates.size());
         g_fov_instruction_immediates.clear();
@@ -183,19 +166,22 @@ void discover_fov_instruction_sites()
     }
 
     if (!g_fov_instruction_immediates.empty()) {
-        xlog::info("Discovered {} RF2 FOV instruction site(s)", g_fov_instruction_immediates.size());
+        XLOG_INFO(g_logger, "Discovered {} RF2 FOV instruction site(s)", g_fov_instruction_immediates.size());
     }
 }
 
 size_t patch_fov_instruction_immediates(float fov)
 {
     discover_fov_instruction_sites();
+    // Sites share a few code pages so unprotect each page once instead of once per site
+    PatchTransaction patch;
     for (uintptr_t imm_addr : g_fov_instruction_immediates) {
-        write_mem<float>(imm_addr, fov);
+        patch.write<float>(imm_addr, fov);
     }
+    patch.commit();
     if (g_fov_instruction_immediates.empty() && !g_warned_missing_fov_sites) {
         g_warned_missing_fov_sites = true;
-        xlog::warn("No RF2 FOV instruction sites found; using player-instance fallback only");
+        XLOG_WARN(g_logger, "No RF2 FOV instruction sites found; using player-instance fallback only");
     }
     return g_fov_instruction_immediates.size();
 }
@@ -217,7 +203,8 @@ void apply_target_fov(bool log)
     const bool local_player_patched = patch_local_player_fov(target);
 
     if (log) {
-        xlog::info(
+        XLOG_INFO(
+            g_logger,
             "Applied RF2 FOV: setting={} target={} resolution={}x{} (sites={}, local_player={})",
             g_user_fov,
             target,
@@ -228,28 +215,18 @@ void apply_target_fov(bool log)
     }
 }
 
-bool parse_fov_command_value(std::string_view command, float& out_value)
+bool parse_fov_command_value(std::string_view args, float& out_value)
 {
-    const std::string trimmed = trim_ascii_copy(std::string{command});
-    if (!starts_with_case_insensitive(trimmed, "fov")) {
-        return false;
-    }
-    if (trimmed.size() == 3) {
-        out_value = g_user_fov;
-        return true;
-    }
-    std::string remainder = trim_ascii_copy(trimmed.substr(3));
-    if (remainder.empty()) {
+    if (args.empty()) {
         out_value = g_user_fov;
         return true;
     }
-    try {
-        out_value = std::stof(remainder);
-        return true;
-    }
-    catch (...) {
+    const auto value = string_to_float(args);
+    if (!value || !std::isfinite(*value)) {
         return false;
     }
+    out_value = *value;
+    return true;
 }
 
 } // namespace
@@ -274,7 +251,7 @@ void camera_set_resolution(unsigned width, unsigned height)
 }
 
 bool camera_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines)
@@ -283,20 +260,20 @@ bool camera_try_handle_console_command(
     out_status.clear();
     out_output_lines.clear();
 
-    const std::string trimmed = trim_ascii_copy(command);
-    if (!starts_with_case_insensitive(trimmed, "fov")) {
+    const auto args = string_match_command(command, "fov");
+    if (!args) {
         return false;
     }
 
     float value = 0.0f;
-    if (!parse_fov_command_value(trimmed, value)) {
+    if (!parse_fov_command_value(*args, value)) {
         out_output_lines.push_back("Usage: fov <num>");
         out_output_lines.push_back("Use fov 0 to enable auto aspect-ratio scaling.");
         out_status = "Invalid fov value.";
         return true;
     }
 
-    if (trimmed.size() == 3) {
+    if (args->empty()) {
         const float auto_fov = compute_auto_hfov(g_res_width, g_res_height);
         if (g_user_fov <= 0.0f) {
             char line[160] = {};
@@ -2,13 +2,14 @@
 
 #include "../misc/misc.h"
 #include <string>
+#include <string_view>
 #include <vector>
 
 void camera_apply_settings(const Rf2PatchSettings& settings);
 void camera_set_resolution(unsigned width, unsigned height);
 
 bool camera_try_handle_console_command(
-    const std::string& command,
+    std::string_view command,
     bool& out_success,
     std::string& out_status,
     std::vector<std::string>& out_output_lines);
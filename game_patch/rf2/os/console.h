@@ -7,6 +7,7 @@
 namespace rf2::os::console
 {
     constexpr uintptr_t execute_command_rva = 0x0012F7D0; // sub_52F7D0
+    constexpr uintptr_t command_table_addr = 0x00B62888;
     constexpr int max_commands = 0x190;
 
     struct CommandEntry
@@ -21,7 +22,7 @@ namespace rf2::os::console
     static auto& command_count = addr_as_ref<int>(0x00B62F94);
     inline auto command_table_entries()
     {
-        return reinterpret_cast<CommandEntry**>(0x00B62888);
+        return reinterpret_cast<CommandEntry**>(command_table_addr);
     }
 
     inline auto execute_command_ptr()
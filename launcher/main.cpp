@@ -1,20 +1,23 @@
 #include <launcher_common/PatchedAppLauncher.h>
+#include <common/utils/sha.h>
 #include <common/version/version.h>
 #include <windows.h>
 #include <commdlg.h>
 #include <shellapi.h>
-#include <wincrypt.h>
 #include <optional>
 #include <string>
 #include <vector>
-#include <array>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 namespace
 {
@@ -44,6 +47,8 @@ constexpr const char* main_window_class_name = "SopotLauncherMainWindow";
 constexpr const char* settings_window_class_name = "SopotLauncherSettingsWindow";
 constexpr const char* about_window_class_name = "SopotLauncherAboutWindow";
 constexpr const char* expected_rf2_sha1 = "5af980c1f2d2588296d40881eb509005b6b3bac9";
+// Posted by the background rf2.exe check, lParam is an Rf2ExeVerification to be deleted by the receiver
+constexpr UINT wm_rf2_exe_verified = WM_APP + 1;
 
 enum class LauncherWindowMode
 {
@@ -125,8 +130,21 @@ struct MainWindowState
     LaunchArgs launch_args;
     PatchSettings settings;
     std::string settings_path;
+    std::string validation_cache_path;
     std::string initial_game_path;
     HWND path_summary = nullptr;
+    // rf2.exe is hashed on a background thread. Results of checks that were superseded by a newer one are ignored.
+    unsigned verification_id = 0;
+    bool verification_running = false;
+    std::string verification_path;
+    std::optional<std::string> verified_sha1;
+    bool launch_when_verified = false;
+};
+
+struct Rf2ExeVerification
+{
+    unsigned id;
+    std::optional<std::string> sha1;
 };
 
 struct AboutDialogState
@@ -276,84 +294,67 @@ bool is_existing_regular_file(const std::string& path)
     return attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_DIRECTORY) == 0;
 }
 
-std::optional<std::string> compute_file_hash_hex(const std::string& path, ALG_ID alg_id)
+std::string get_validation_cache_file_path()
 {
-    HCRYPTPROV provider = 0;
-    HCRYPTHASH hash = 0;
+    return get_module_directory() + "\\sopot_validation_cache.ini";
+}
 
-    if (!CryptAcquireContextA(&provider, nullptr, nullptr, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
-        return std::nullopt;
-    }
+// Verification threads are detached and may overlap, each key is a separate call so the cache is read and written
+// under this lock
+std::mutex validation_cache_mutex;
 
-    if (!CryptCreateHash(provider, alg_id, 0, 0, &hash)) {
-        CryptReleaseContext(provider, 0);
-        return std::nullopt;
-    }
+std::string read_cache_value(const std::string& cache_path, const char* key)
+{
+    char buf[MAX_PATH * 2] = {};
+    GetPrivateProfileStringA("rf2_exe", key, "", buf, static_cast<DWORD>(sizeof(buf)), cache_path.c_str());
+    return buf;
+}
 
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        CryptDestroyHash(hash);
-        CryptReleaseContext(provider, 0);
+// Returns the SHA-1 of rf2.exe as lowercase hex. The result is remembered in the cache file together with the path,
+// size and modification time of the file, as long as those match it is not hashed again.
+std::optional<std::string> compute_rf2_exe_sha1(const std::string& exe_path, const std::string& cache_path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attrs{};
+    if (!GetFileAttributesExA(exe_path.c_str(), GetFileExInfoStandard, &attrs)) {
         return std::nullopt;
     }
-
-    std::array<char, 16 * 1024> buffer{};
-    while (file) {
-        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-        const std::streamsize bytes_read = file.gcount();
-        if (bytes_read > 0) {
-            if (!CryptHashData(hash, reinterpret_cast<const BYTE*>(buffer.data()), static_cast<DWORD>(bytes_read), 0)) {
-                CryptDestroyHash(hash);
-                CryptReleaseContext(provider, 0);
-                return std::nullopt;
-            }
+    const uint64_t size = (static_cast<uint64_t>(attrs.nFileSizeHigh) << 32) | attrs.nFileSizeLow;
+    const uint64_t mtime =
+        (static_cast<uint64_t>(attrs.ftLastWriteTime.dwHighDateTime) << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+    const std::string size_text = std::to_string(size);
+    const std::string mtime_text = std::to_string(mtime);
+
+    {
+        std::lock_guard lock{validation_cache_mutex};
+        const std::string cached_sha1 = read_cache_value(cache_path, "sha1");
+        if (cached_sha1.size() == 40
+            && to_lower_copy(read_cache_value(cache_path, "path")) == to_lower_copy(exe_path)
+            && read_cache_value(cache_path, "size") == size_text
+            && read_cache_value(cache_path, "mtime") == mtime_text) {
+            return cached_sha1;
         }
     }
-    if (file.bad()) {
-        CryptDestroyHash(hash);
-        CryptReleaseContext(provider, 0);
-        return std::nullopt;
-    }
-
-    DWORD hash_size = 0;
-    DWORD hash_size_len = sizeof(hash_size);
-    if (!CryptGetHashParam(hash, HP_HASHSIZE, reinterpret_cast<BYTE*>(&hash_size), &hash_size_len, 0)
-        || hash_size == 0) {
-        CryptDestroyHash(hash);
-        CryptReleaseContext(provider, 0);
-        return std::nullopt;
-    }
 
-    std::vector<BYTE> hash_bytes(hash_size);
-    DWORD hash_len = hash_size;
-    if (!CryptGetHashParam(hash, HP_HASHVAL, hash_bytes.data(), &hash_len, 0)) {
-        CryptDestroyHash(hash);
-        CryptReleaseContext(provider, 0);
-        return std::nullopt;
+    // Hashing is not under the lock so a newly selected file does not wait for the previous one
+    auto sha1 = sha_hash_file_hex(exe_path, ShaAlgorithm::sha1);
+    if (sha1) {
+        std::lock_guard lock{validation_cache_mutex};
+        WritePrivateProfileStringA("rf2_exe", "path", exe_path.c_str(), cache_path.c_str());
+        WritePrivateProfileStringA("rf2_exe", "size", size_text.c_str(), cache_path.c_str());
+        WritePrivateProfileStringA("rf2_exe", "mtime", mtime_text.c_str(), cache_path.c_str());
+        WritePrivateProfileStringA("rf2_exe", "sha1", sha1->c_str(), cache_path.c_str());
     }
-
-    CryptDestroyHash(hash);
-    CryptReleaseContext(provider, 0);
-
-    static constexpr char hex_digits[] = "0123456789abcdef";
-    std::string hex;
-    hex.resize(static_cast<size_t>(hash_len) * 2);
-    for (DWORD i = 0; i < hash_len; ++i) {
-        const BYTE value = hash_bytes[i];
-        hex[static_cast<size_t>(i) * 2] = hex_digits[(value >> 4) & 0x0F];
-        hex[static_cast<size_t>(i) * 2 + 1] = hex_digits[value & 0x0F];
-    }
-    return hex;
+    return sha1;
 }
 
-bool validate_rf2_exe_hashes(const std::string& exe_path, std::string& error_message)
+bool validate_rf2_exe_hashes(
+    const std::string& exe_path, const std::optional<std::string>& sha1, std::string& error_message)
 {
     if (!is_existing_regular_file(exe_path)) {
         error_message = "Could not find selected rf2.exe:\n" + exe_path;
         return false;
     }
 
-    const auto sha1 = compute_file_hash_hex(exe_path, CALG_SHA1);
     if (!sha1) {
         error_message = "Failed to compute SHA-1 for rf2.exe.\nPath:\n" + exe_path;
         return false;
@@ -617,6 +618,12 @@ void update_main_path_summary(MainWindowState* state)
     }
     else {
         text += state->settings.game_exe_path;
+        if (state->verification_running) {
+            text += "  (verifying...)";
+        }
+        else if (state->verified_sha1) {
+            text += *state->verified_sha1 == expected_rf2_sha1 ? "  (verified)" : "  (unsupported version)";
+        }
     }
     SetWindowTextA(state->path_summary, text.c_str());
 }
@@ -1214,6 +1221,70 @@ bool launch_game(const LaunchArgs& launch_args, const std::string& game_path, st
     return false;
 }
 
+void start_rf2_exe_verification(HWND hwnd, MainWindowState* state)
+{
+    const unsigned id = ++state->verification_id;
+    state->verification_path = trim_copy(state->settings.game_exe_path);
+    state->verified_sha1.reset();
+    state->verification_running = !state->verification_path.empty();
+    update_main_path_summary(state);
+    if (!state->verification_running) {
+        return;
+    }
+
+    auto verify = [hwnd, id, path = state->verification_path, cache_path = state->validation_cache_path]() {
+        auto result = std::make_unique<Rf2ExeVerification>();
+        result->id = id;
+        result->sha1 = compute_rf2_exe_sha1(path, cache_path);
+        if (PostMessageA(hwnd, wm_rf2_exe_verified, 0, reinterpret_cast<LPARAM>(result.get()))) {
+            result.release();
+        }
+    };
+    try {
+        std::thread{verify}.detach();
+    }
+    catch (const std::system_error&) {
+        verify();
+    }
+}
+
+void launch_verified_rf2_exe(HWND hwnd, MainWindowState* state)
+{
+    const std::string& game_path = state->verification_path;
+    std::string hash_validation_error;
+    if (!validate_rf2_exe_hashes(game_path, state->verified_sha1, hash_validation_error)) {
+        MessageBoxA(
+            hwnd,
+            hash_validation_error.c_str(),
+            "RF2 Community Patch (SOPOT)",
+            MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    state->settings.game_exe_path = game_path;
+    if (!save_patch_settings(state->settings_path, state->settings)) {
+        MessageBoxA(
+            hwnd,
+            "Failed to save sopot_settings.ini.",
+            "RF2 Community Patch (SOPOT)",
+            MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    std::string launch_error;
+    if (launch_game(state->launch_args, game_path, launch_error)) {
+        if (state->settings.auto_close_launcher) {
+            DestroyWindow(hwnd);
+        }
+        return;
+    }
+    MessageBoxA(
+        hwnd,
+        launch_error.c_str(),
+        "RF2 Community Patch (SOPOT)",
+        MB_OK | MB_ICONERROR);
+}
+
 LRESULT CALLBACK main_window_proc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_param)
 {
     auto* state = reinterpret_cast<MainWindowState*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
@@ -1244,7 +1315,7 @@ LRESULT CALLBACK main_window_proc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_
             592,
             20,
             id_main_path_summary);
-        update_main_path_summary(state);
+        start_rf2_exe_verification(hwnd, state);
         create_control(
             hwnd,
             "BUTTON",
@@ -1297,8 +1368,15 @@ LRESULT CALLBACK main_window_proc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_
         if (control_id == id_settings_button) {
             PatchSettings new_settings = state->settings;
             if (show_settings_dialog(hwnd, new_settings)) {
+                const bool path_changed = trim_copy(new_settings.game_exe_path) != state->verification_path;
                 state->settings = new_settings;
-                update_main_path_summary(state);
+                if (path_changed) {
+                    state->launch_when_verified = false;
+                    start_rf2_exe_verification(hwnd, state);
+                }
+                else {
+                    update_main_path_summary(state);
+                }
                 if (!save_patch_settings(state->settings_path, state->settings)) {
                     MessageBoxA(
                         hwnd,
@@ -1326,38 +1404,12 @@ LRESULT CALLBACK main_window_proc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_
                 return 0;
             }
 
-            std::string hash_validation_error;
-            if (!validate_rf2_exe_hashes(game_path, hash_validation_error)) {
-                MessageBoxA(
-                    hwnd,
-                    hash_validation_error.c_str(),
-                    "RF2 Community Patch (SOPOT)",
-                    MB_OK | MB_ICONERROR);
-                return 0;
-            }
-
-            state->settings.game_exe_path = game_path;
-            if (!save_patch_settings(state->settings_path, state->settings)) {
-                MessageBoxA(
-                    hwnd,
-                    "Failed to save sopot_settings.ini.",
-                    "RF2 Community Patch (SOPOT)",
-                    MB_OK | MB_ICONERROR);
-                return 0;
-            }
-
-            std::string launch_error;
-            if (launch_game(state->launch_args, game_path, launch_error)) {
-                if (state->settings.auto_close_launcher) {
-                    DestroyWindow(hwnd);
-                }
-                return 0;
+            // Checked again in case rf2.exe changed since the launcher started, the cached hash makes this quick
+            // otherwise. The game is launched once the check has finished.
+            state->launch_when_verified = true;
+            if (!state->verification_running || state->verification_path != game_path) {
+                start_rf2_exe_verification(hwnd, state);
             }
-            MessageBoxA(
-                hwnd,
-                launch_error.c_str(),
-                "RF2 Community Patch (SOPOT)",
-                MB_OK | MB_ICONERROR);
             return 0;
         }
 
@@ -1368,6 +1420,21 @@ LRESULT CALLBACK main_window_proc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_
         break;
     }
 
+    case wm_rf2_exe_verified: {
+        std::unique_ptr<Rf2ExeVerification> result{reinterpret_cast<Rf2ExeVerification*>(l_param)};
+        if (!state || result->id != state->verification_id) {
+            return 0;
+        }
+        state->verification_running = false;
+        state->verified_sha1 = std::move(result->sha1);
+        update_main_path_summary(state);
+        if (state->launch_when_verified) {
+            state->launch_when_verified = false;
+            launch_verified_rf2_exe(hwnd, state);
+        }
+        return 0;
+    }
+
     case WM_CLOSE:
         DestroyWindow(hwnd);
         return 0;
@@ -1434,6 +1501,7 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int show_cmd)
     state->launch_args = launch_args;
     state->settings = settings;
     state->settings_path = settings_path;
+    state->validation_cache_path = get_validation_cache_file_path();
     state->initial_game_path = initial_game_path;
 
     HWND window = CreateWindowExA(
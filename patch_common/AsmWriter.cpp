@@ -0,0 +1,153 @@
+#include <patch_common/AsmWriter.h>
+#include <patch_common/MemUtils.h>
+#include <xlog/xlog.h>
+
+AsmWriter& AsmWriter::bind(AsmLabel label)
+{
+    assert(label.id >= 0 && label.id < static_cast<int>(m_labels.size()));
+    auto& pos = m_labels[label.id];
+    assert(!pos.bound && "label bound twice");
+    pos = {m_code.size(), m_branches.size(), true};
+    return *this;
+}
+
+size_t AsmWriter::size()
+{
+    relax();
+    size_t total = m_code.size();
+    for (const auto& branch : m_branches) {
+        total += branch_size(branch);
+    }
+    return total;
+}
+
+void AsmWriter::finish()
+{
+    assert(m_has_addr && !m_finished);
+    m_finished = true;
+    relax();
+    auto code = encode();
+    if (m_end_addr != unk_end_addr) {
+        assert(m_begin_addr + code.size() <= m_end_addr);
+        while (m_begin_addr + code.size() < m_end_addr) {
+            code.push_back(0x90); // nop
+        }
+    }
+    if (!code.empty()) {
+        write_mem(m_begin_addr, code.data(), code.size());
+    }
+}
+
+void AsmWriter::finish(uintptr_t begin_addr)
+{
+    assert(!m_has_addr);
+    m_begin_addr = begin_addr;
+    m_has_addr = true;
+    finish();
+}
+
+size_t AsmWriter::branch_size(const Branch& branch)
+{
+    if (!branch.is_long) {
+        return 2;
+    }
+    return branch.kind == BranchKind::jcc ? 6 : 5;
+}
+
+void AsmWriter::compute_branch_offsets()
+{
+    m_branch_offsets.resize(m_branches.size());
+    size_t branches_size = 0;
+    for (size_t i = 0; i < m_branches.size(); ++i) {
+        m_branch_offsets[i] = m_branches[i].code_offset + branches_size;
+        branches_size += branch_size(m_branches[i]);
+    }
+}
+
+size_t AsmWriter::label_offset(int label) const
+{
+    const auto& pos = m_labels[label];
+    if (pos.num_branches_before == 0) {
+        return pos.code_offset;
+    }
+    // Offset of the last branch before the label already includes sizes of all branches before it
+    size_t last_idx = pos.num_branches_before - 1;
+    const auto& last = m_branches[last_idx];
+    return m_branch_offsets[last_idx] + branch_size(last) + (pos.code_offset - last.code_offset);
+}
+
+intptr_t AsmWriter::branch_displacement(size_t branch_idx) const
+{
+    const auto& branch = m_branches[branch_idx];
+    size_t next_offset = m_branch_offsets[branch_idx] + branch_size(branch);
+    if (branch.target_label >= 0) {
+        return static_cast<intptr_t>(label_offset(branch.target_label) - next_offset);
+    }
+    return static_cast<intptr_t>(branch.target_addr - (m_begin_addr + next_offset));
+}
+
+void AsmWriter::relax()
+{
+    for (auto& label : m_labels) {
+        if (!label.bound) {
+            xlog::error("AsmWriter: branch to unbound label");
+            assert(false);
+            label = {m_code.size(), m_branches.size(), true};
+        }
+    }
+
+    // Start from the smallest encodings. Branches only ever grow so the loop stops after at most one pass per branch.
+    for (auto& branch : m_branches) {
+        if (branch.forced_size == BranchSize::relaxed) {
+            // Without a base address displacements to absolute targets are unknown so assume the worst case
+            branch.is_long = branch.target_label < 0 && !m_has_addr;
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_branch_offsets();
+        for (size_t i = 0; i < m_branches.size(); ++i) {
+            auto& branch = m_branches[i];
+            if (branch.is_long || branch.forced_size != BranchSize::relaxed) {
+                continue;
+            }
+            intptr_t disp = branch_displacement(i);
+            if (disp < -128 || disp > 127) {
+                branch.is_long = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+std::vector<u8> AsmWriter::encode() const
+{
+    std::vector<u8> out;
+    out.reserve(m_code.size() + m_branches.size() * 6);
+    size_t code_pos = 0;
+    for (size_t i = 0; i < m_branches.size(); ++i) {
+        const auto& branch = m_branches[i];
+        out.insert(out.end(), m_code.begin() + code_pos, m_code.begin() + branch.code_offset);
+        code_pos = branch.code_offset;
+
+        auto disp = static_cast<int32_t>(branch_displacement(i));
+        if (!branch.is_long) {
+            assert(disp >= -128 && disp <= 127 && "short branch out of range");
+            out.push_back(branch.kind == BranchKind::jcc ? 0x70 | static_cast<u8>(branch.cond) : 0xEB);
+            out.push_back(static_cast<u8>(disp));
+            continue;
+        }
+        if (branch.kind == BranchKind::jcc) {
+            out.push_back(0x0F);
+            out.push_back(0x80 | static_cast<u8>(branch.cond));
+        }
+        else {
+            out.push_back(branch.kind == BranchKind::call ? 0xE8 : 0xE9);
+        }
+        const auto* disp_bytes = reinterpret_cast<const u8*>(&disp);
+        out.insert(out.end(), disp_bytes, disp_bytes + sizeof(disp));
+    }
+    out.insert(out.end(), m_code.begin() + code_pos, m_code.end());
+    return out;
+}
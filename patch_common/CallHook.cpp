@@ -3,11 +3,13 @@
 #include <patch_common/ShortTypes.h>
 #include <patch_common/AsmOpcodes.h>
 #include <patch_common/MemUtils.h>
+#include <patch_common/PatchTransaction.h>
 #include <cstdint>
 
 void CallHookImpl::install()
     {
         m_target_fun_ptr = nullptr;
+        PatchTransaction patch;
         for (auto addr : m_call_op_addr_vec) {
             uint8_t opcode = *reinterpret_cast<uint8_t*>(addr);
             if (opcode != asm_opcodes::call_rel_long) {
@@ -26,6 +28,7 @@ void CallHookImpl::install()
             }
 
             intptr_t new_offset = reinterpret_cast<intptr_t>(m_hook_fun_ptr) - addr - call_op_size;
-            write_mem<i32>(addr + 1, new_offset);
+            patch.write<i32>(addr + 1, new_offset);
         }
+        patch.commit();
     }
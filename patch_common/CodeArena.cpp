@@ -0,0 +1,344 @@
+#include <patch_common/CodeArena.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdio>
+#endif
+
+static uintptr_t align_down(uintptr_t value, size_t alignment)
+{
+    return value - value % alignment;
+}
+
+static uintptr_t align_up(uintptr_t value, size_t alignment)
+{
+    return align_down(value + alignment - 1, alignment);
+}
+
+static size_t distance(uintptr_t a, uintptr_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+#ifdef _WIN32
+
+class Win32CodePageAllocator : public CodePageAllocator
+{
+    size_t m_granularity;
+    uintptr_t m_min_addr;
+    uintptr_t m_max_addr;
+
+public:
+    Win32CodePageAllocator()
+    {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+        m_granularity = sys_info.dwAllocationGranularity;
+        m_min_addr = align_up(reinterpret_cast<uintptr_t>(sys_info.lpMinimumApplicationAddress), m_granularity);
+        m_max_addr = reinterpret_cast<uintptr_t>(sys_info.lpMaximumApplicationAddress);
+    }
+
+    [[nodiscard]] size_t granularity() const override
+    {
+        return m_granularity;
+    }
+
+    void* alloc_near(uintptr_t hint, size_t size, size_t max_distance) override
+    {
+        size = align_up(size, m_granularity);
+        if (!hint) {
+            return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        }
+
+        // Another thread can take a free region between VirtualQuery and VirtualAlloc so retry a few times
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            uintptr_t above = find_free_above(hint, size, max_distance);
+            uintptr_t below = find_free_below(hint, size, max_distance);
+            uintptr_t addr;
+            if (above && below) {
+                addr = distance(above, hint) < distance(below, hint) ? above : below;
+            }
+            else {
+                addr = above ? above : below;
+            }
+            if (!addr) {
+                break;
+            }
+            void* ptr = VirtualAlloc(reinterpret_cast<void*>(addr), size, MEM_RESERVE | MEM_COMMIT,
+                PAGE_EXECUTE_READWRITE);
+            if (ptr) {
+                return ptr;
+            }
+        }
+        return nullptr;
+    }
+
+    void free(void* ptr, [[maybe_unused]] size_t size) override
+    {
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+private:
+    uintptr_t find_free_above(uintptr_t hint, size_t size, size_t max_distance) const
+    {
+        uintptr_t limit = m_max_addr - hint > max_distance ? hint + max_distance : m_max_addr;
+        uintptr_t addr = align_up(std::max(hint, m_min_addr), m_granularity);
+        while (addr < limit && limit - addr >= size) {
+            MEMORY_BASIC_INFORMATION mbi;
+            if (!VirtualQuery(reinterpret_cast<void*>(addr), &mbi, sizeof(mbi))) {
+                break;
+            }
+            uintptr_t region_end = reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize;
+            if (mbi.State == MEM_FREE && region_end - addr >= size) {
+                return addr;
+            }
+            if (region_end <= addr) {
+                break;
+            }
+            addr = align_up(region_end, m_granularity);
+        }
+        return 0;
+    }
+
+    uintptr_t find_free_below(uintptr_t hint, size_t size, size_t max_distance) const
+    {
+        uintptr_t limit = hint - m_min_addr > max_distance ? hint - max_distance : m_min_addr;
+        if (hint < limit + size) {
+            return 0;
+        }
+        uintptr_t addr = align_down(hint - size, m_granularity);
+        while (addr >= limit) {
+            MEMORY_BASIC_INFORMATION mbi;
+            if (!VirtualQuery(reinterpret_cast<void*>(addr), &mbi, sizeof(mbi))) {
+                break;
+            }
+            uintptr_t region_base = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+            uintptr_t region_end = region_base + mbi.RegionSize;
+            if (mbi.State == MEM_FREE && region_end - addr >= size) {
+                return addr;
+            }
+            if (region_base < limit + size) {
+                break;
+            }
+            addr = align_down(region_base - size, m_granularity);
+        }
+        return 0;
+    }
+};
+
+using DefaultCodePageAllocator = Win32CodePageAllocator;
+
+#else
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+class PosixCodePageAllocator : public CodePageAllocator
+{
+    // Linux does not map anything below vm.mmap_min_addr (64 KB by default)
+    static constexpr uintptr_t min_addr = 0x10000;
+    // Top of the user address space (x86-64 with 4-level page tables)
+    static constexpr uintptr_t max_addr = sizeof(uintptr_t) > 4 ? static_cast<uintptr_t>(0x7FFFFFFFF000) : 0xFFFF0000;
+
+    size_t m_granularity = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+public:
+    [[nodiscard]] size_t granularity() const override
+    {
+        return m_granularity;
+    }
+
+    void* alloc_near(uintptr_t hint, size_t size, size_t max_distance) override
+    {
+        size = align_up(size, m_granularity);
+        if (!hint) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return ptr != MAP_FAILED ? ptr : nullptr;
+        }
+
+        // Another thread can map a free region between reading the mappings and mmap so retry a few times
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            uintptr_t addr = find_free_near(hint, size, max_distance);
+            if (!addr) {
+                break;
+            }
+            void* ptr = mmap(reinterpret_cast<void*>(addr), size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+            if (ptr == reinterpret_cast<void*>(addr)) {
+                return ptr;
+            }
+            // Kernels older than 4.17 treat the address as a hint only
+            if (ptr != MAP_FAILED) {
+                munmap(ptr, size);
+            }
+        }
+        return nullptr;
+    }
+
+    void free(void* ptr, size_t size) override
+    {
+        munmap(ptr, align_up(size, m_granularity));
+    }
+
+private:
+    uintptr_t find_free_near(uintptr_t hint, size_t size, size_t max_distance) const
+    {
+        // Gaps between the mappings listed in /proc/self/maps (sorted by address) are free
+        std::FILE* maps = std::fopen("/proc/self/maps", "r");
+        if (!maps) {
+            return 0;
+        }
+        uintptr_t best = 0;
+        uintptr_t gap_begin = min_addr;
+        char line[512];
+        bool done = false;
+        while (!done) {
+            uintptr_t begin = max_addr;
+            uintptr_t end = max_addr;
+            if (!std::fgets(line, sizeof(line), maps)) {
+                done = true;
+            }
+            else if (std::sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &begin, &end) != 2) {
+                continue;
+            }
+            begin = std::min(begin, max_addr);
+            if (begin > gap_begin && begin - gap_begin >= size) {
+                // Place the region as close to the hint as the gap allows
+                uintptr_t lowest = align_up(gap_begin, m_granularity);
+                uintptr_t highest = align_down(begin - size, m_granularity);
+                uintptr_t addr = std::clamp(align_down(hint, m_granularity), lowest, std::max(lowest, highest));
+                if (addr <= highest && distance(addr, hint) <= max_distance &&
+                    (!best || distance(addr, hint) < distance(best, hint))) {
+                    best = addr;
+                }
+            }
+            gap_begin = std::max(gap_begin, end);
+        }
+        std::fclose(maps);
+        return best;
+    }
+};
+
+using DefaultCodePageAllocator = PosixCodePageAllocator;
+
+#endif
+
+CodePageAllocator& get_default_code_page_allocator()
+{
+    static DefaultCodePageAllocator allocator;
+    return allocator;
+}
+
+CodeArena::CodeArena(CodePageAllocator& page_allocator) :
+    m_page_allocator(page_allocator)
+{}
+
+CodeArena::~CodeArena()
+{
+    for (auto& chunk : m_chunks) {
+        m_page_allocator.free(chunk.base, chunk.size);
+    }
+}
+
+CodeArena& CodeArena::global()
+{
+    static CodeArena arena;
+    return arena;
+}
+
+void* CodeArena::alloc(size_t size, uintptr_t hint)
+{
+    size = align_up(size, alignment);
+    Chunk* chunk = find_chunk(size, hint);
+    if (!chunk) {
+        chunk = alloc_chunk(size, hint);
+    }
+    if (!chunk) {
+        xlog::error("Failed to allocate {} bytes of executable memory", size);
+        return nullptr;
+    }
+    void* ptr = chunk->base + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+CodeArena::Generation CodeArena::begin_generation()
+{
+    return ++m_generation;
+}
+
+void CodeArena::free_generation(Generation generation)
+{
+    auto it = std::remove_if(m_chunks.begin(), m_chunks.end(), [&](const Chunk& chunk) {
+        if (chunk.generation != generation) {
+            return false;
+        }
+        m_page_allocator.free(chunk.base, chunk.size);
+        return true;
+    });
+    m_chunks.erase(it, m_chunks.end());
+}
+
+size_t CodeArena::bytes_used() const
+{
+    size_t total = 0;
+    for (const auto& chunk : m_chunks) {
+        total += chunk.used;
+    }
+    return total;
+}
+
+size_t CodeArena::bytes_reserved() const
+{
+    size_t total = 0;
+    for (const auto& chunk : m_chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+CodeArena::Chunk* CodeArena::find_chunk(size_t size, uintptr_t hint)
+{
+    // Prefer the closest chunk so thunks for nearby patches end up on the same pages
+    Chunk* best = nullptr;
+    size_t best_distance = 0;
+    for (auto& chunk : m_chunks) {
+        if (chunk.generation != m_generation || chunk.size - chunk.used < size) {
+            continue;
+        }
+        uintptr_t chunk_addr = reinterpret_cast<uintptr_t>(chunk.base);
+        size_t chunk_distance = hint ? distance(chunk_addr, hint) : 0;
+        if (hint && chunk_distance > max_near_distance) {
+            continue;
+        }
+        if (!best || chunk_distance < best_distance) {
+            best = &chunk;
+            best_distance = chunk_distance;
+        }
+    }
+    return best;
+}
+
+CodeArena::Chunk* CodeArena::alloc_chunk(size_t size, uintptr_t hint)
+{
+    size_t chunk_size = align_up(std::max(size, default_chunk_size), m_page_allocator.granularity());
+    void* ptr = m_page_allocator.alloc_near(hint, chunk_size, max_near_distance);
+    if (!ptr && hint) {
+        xlog::warn("No free memory near 0x{:x} for code chunk, allocating anywhere", hint);
+        ptr = m_page_allocator.alloc_near(0, chunk_size, max_near_distance);
+    }
+    if (!ptr) {
+        return nullptr;
+    }
+    xlog::trace("Allocated code chunk at 0x{:x} (size 0x{:x}, hint 0x{:x})",
+        reinterpret_cast<uintptr_t>(ptr), chunk_size, hint);
+    m_chunks.push_back({static_cast<std::byte*>(ptr), chunk_size, 0, m_generation});
+    return &m_chunks.back();
+}
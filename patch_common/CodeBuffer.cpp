@@ -1,21 +1,9 @@
 #include <patch_common/CodeBuffer.h>
-#include <windows.h>
+#include <patch_common/CodeArena.h>
 
-static HANDLE get_code_heap()
+void CodeBuffer::alloc_near(uintptr_t hint)
 {
-    static HANDLE heap = HeapCreate(HEAP_CREATE_ENABLE_EXECUTE, 0, 0);
-    return heap;
-}
-
-CodeBuffer::CodeBuffer(size_t len)
-{
-    m_ptr = HeapAlloc(get_code_heap(), 0, len);
-}
-
-CodeBuffer::~CodeBuffer()
-{
-    if (m_ptr) {
-        HeapFree(get_code_heap(), 0, m_ptr);
+    if (!m_ptr) {
+        m_ptr = CodeArena::global().alloc(m_len, hint);
     }
 }
-
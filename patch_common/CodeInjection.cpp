@@ -4,6 +4,12 @@
 
 void BaseCodeInjection::install()
 {
+    // Measure the code first so it takes only as much arena space as needed. Use a placeholder trampoline address
+    // that does not fit in imm8 so the measured size is not smaller than the final one.
+    AsmWriter measure_writer;
+    emit_code(measure_writer, reinterpret_cast<void*>(m_addr));
+    m_code_buf.alloc_near(m_addr, measure_writer.size());
+
     void* trampoline = nullptr;
     if (m_needs_trampoline) {
         m_subhook.Install(reinterpret_cast<void*>(m_addr), m_code_buf);
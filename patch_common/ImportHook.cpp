@@ -0,0 +1,114 @@
+#include <patch_common/ImportHook.h>
+#include <patch_common/MemUtils.h>
+#include <xlog/xlog.h>
+#include <cctype>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// PE structures are read by offset so find_import_slot does not depend on windows.h
+namespace pe
+{
+    constexpr uint16_t dos_signature = 0x5A4D; // MZ
+    constexpr uint32_t nt_signature = 0x00004550; // PE\0\0
+    constexpr uint16_t optional_header_magic_pe32 = 0x10B;
+    constexpr size_t dos_e_lfanew_offset = 0x3C;
+    constexpr size_t optional_header_offset = 4 + 20;
+    constexpr size_t num_rva_and_sizes_offset = 92;
+    constexpr size_t data_directories_offset = 96;
+    constexpr size_t directory_entry_import = 1;
+    constexpr size_t import_descriptor_size = 20;
+    constexpr size_t import_original_first_thunk_offset = 0;
+    constexpr size_t import_name_offset = 12;
+    constexpr size_t import_first_thunk_offset = 16;
+    constexpr uint32_t ordinal_flag = 0x80000000;
+    constexpr size_t import_by_name_hint_size = 2;
+}
+
+template<typename T>
+static T read_image(uintptr_t addr)
+{
+    T value;
+    std::memcpy(&value, reinterpret_cast<const void*>(addr), sizeof(value));
+    return value;
+}
+
+static bool equals_ignore_case(const char* a, const char* b)
+{
+    while (*a && *b) {
+        if (std::tolower(static_cast<unsigned char>(*a)) != std::tolower(static_cast<unsigned char>(*b))) {
+            return false;
+        }
+        ++a;
+        ++b;
+    }
+    return *a == *b;
+}
+
+uintptr_t find_import_slot(uintptr_t image_base, const char* dll_name, const char* func_name)
+{
+    if (read_image<uint16_t>(image_base) != pe::dos_signature) {
+        return 0;
+    }
+    uintptr_t nt_headers = image_base + read_image<uint32_t>(image_base + pe::dos_e_lfanew_offset);
+    uintptr_t optional_header = nt_headers + pe::optional_header_offset;
+    if (read_image<uint32_t>(nt_headers) != pe::nt_signature
+        || read_image<uint16_t>(optional_header) != pe::optional_header_magic_pe32) {
+        return 0;
+    }
+    if (read_image<uint32_t>(optional_header + pe::num_rva_and_sizes_offset) <= pe::directory_entry_import) {
+        return 0;
+    }
+    auto import_rva = read_image<uint32_t>(optional_header + pe::data_directories_offset + pe::directory_entry_import * 8);
+    if (!import_rva) {
+        return 0;
+    }
+
+    for (uintptr_t desc = image_base + import_rva;; desc += pe::import_descriptor_size) {
+        auto name_rva = read_image<uint32_t>(desc + pe::import_name_offset);
+        if (!name_rva) {
+            break;
+        }
+        if (!equals_ignore_case(reinterpret_cast<const char*>(image_base + name_rva), dll_name)) {
+            continue;
+        }
+        // The name table is optional in old images, without it bound addresses are all that is left
+        auto names_rva = read_image<uint32_t>(desc + pe::import_original_first_thunk_offset);
+        auto slots_rva = read_image<uint32_t>(desc + pe::import_first_thunk_offset);
+        if (!names_rva) {
+            xlog::warn("Imports from {} have no name table", dll_name);
+            continue;
+        }
+        for (size_t i = 0;; ++i) {
+            auto thunk = read_image<uint32_t>(image_base + names_rva + i * sizeof(uint32_t));
+            if (!thunk) {
+                break;
+            }
+            if (thunk & pe::ordinal_flag) {
+                continue;
+            }
+            const auto* name = reinterpret_cast<const char*>(image_base + thunk + pe::import_by_name_hint_size);
+            if (std::strcmp(name, func_name) == 0) {
+                return image_base + slots_rva + i * sizeof(uint32_t);
+            }
+        }
+    }
+    return 0;
+}
+
+void ImportHookImpl::install()
+{
+#ifdef _WIN32
+    auto image_base = reinterpret_cast<uintptr_t>(GetModuleHandleA(nullptr));
+    uintptr_t slot = find_import_slot(image_base, m_dll_name, m_func_name);
+    if (!slot) {
+        xlog::error("Import {}!{} not found in main module", m_dll_name, m_func_name);
+        return;
+    }
+    m_original_fun_ptr = reinterpret_cast<void*>(read_image<uint32_t>(slot));
+    // A single aligned store, so threads calling the import at the same time see either the old or the new pointer
+    write_mem_ptr(slot, m_hook_fun_ptr);
+    xlog::debug("Hooked import {}!{} at 0x{:x}", m_dll_name, m_func_name, slot);
+#endif
+}
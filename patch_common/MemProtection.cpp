@@ -0,0 +1,137 @@
+#include <patch_common/MemProtection.h>
+#include <xlog/xlog.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+class Win32MemProtectionBackend : public MemProtectionBackend
+{
+    size_t m_page_size;
+
+public:
+    Win32MemProtectionBackend()
+    {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+        m_page_size = sys_info.dwPageSize;
+    }
+
+    [[nodiscard]] size_t page_size() const override
+    {
+        return m_page_size;
+    }
+
+    bool unprotect(uintptr_t addr, size_t size, unsigned& old_protect) override
+    {
+        DWORD old_protect_dw;
+        if (!VirtualProtect(reinterpret_cast<void*>(addr), size, PAGE_EXECUTE_READWRITE, &old_protect_dw)) {
+            xlog::warn("VirtualProtect failed: addr {:x} size {:x} error {}", addr, size, GetLastError());
+            return false;
+        }
+        old_protect = old_protect_dw;
+        return true;
+    }
+
+    bool restore(uintptr_t addr, size_t size, unsigned old_protect) override
+    {
+        DWORD dummy;
+        if (!VirtualProtect(reinterpret_cast<void*>(addr), size, old_protect, &dummy)) {
+            xlog::warn("VirtualProtect failed: addr {:x} size {:x} error {}", addr, size, GetLastError());
+            return false;
+        }
+        return true;
+    }
+
+    void flush_instruction_cache(uintptr_t addr, size_t size) override
+    {
+        FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<void*>(addr), size);
+    }
+};
+
+using DefaultMemProtectionBackend = Win32MemProtectionBackend;
+
+#else
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <optional>
+
+class PosixMemProtectionBackend : public MemProtectionBackend
+{
+    size_t m_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+public:
+    [[nodiscard]] size_t page_size() const override
+    {
+        return m_page_size;
+    }
+
+    // old_protect receives the PROT_* flags of the page containing addr
+    bool unprotect(uintptr_t addr, size_t size, unsigned& old_protect) override
+    {
+        std::optional<unsigned> prot = query_protection(addr);
+        if (!prot) {
+            xlog::warn("Cannot unprotect unmapped memory: addr {:x}", addr);
+            return false;
+        }
+        if (mprotect(reinterpret_cast<void*>(addr), size, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+            xlog::warn("mprotect failed: addr {:x} size {:x} error {}", addr, size, errno);
+            return false;
+        }
+        old_protect = prot.value();
+        return true;
+    }
+
+    bool restore(uintptr_t addr, size_t size, unsigned old_protect) override
+    {
+        if (mprotect(reinterpret_cast<void*>(addr), size, static_cast<int>(old_protect)) != 0) {
+            xlog::warn("mprotect failed: addr {:x} size {:x} error {}", addr, size, errno);
+            return false;
+        }
+        return true;
+    }
+
+    void flush_instruction_cache(uintptr_t addr, size_t size) override
+    {
+        auto* begin = reinterpret_cast<char*>(addr);
+        __builtin___clear_cache(begin, begin + size);
+    }
+
+private:
+    // There is no call that returns the current protection of a page, look it up in the list of mappings
+    static std::optional<unsigned> query_protection(uintptr_t addr)
+    {
+        std::FILE* maps = std::fopen("/proc/self/maps", "r");
+        if (!maps) {
+            return {};
+        }
+        std::optional<unsigned> result;
+        char line[512];
+        while (std::fgets(line, sizeof(line), maps)) {
+            uintptr_t begin, end;
+            char perms[5];
+            if (std::sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s", &begin, &end, perms) == 3 &&
+                addr >= begin && addr < end) {
+                result = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) |
+                    (perms[2] == 'x' ? PROT_EXEC : 0);
+                break;
+            }
+        }
+        std::fclose(maps);
+        return result;
+    }
+};
+
+using DefaultMemProtectionBackend = PosixMemProtectionBackend;
+
+#endif
+
+MemProtectionBackend& get_default_mem_protection_backend()
+{
+    static DefaultMemProtectionBackend backend;
+    return backend;
+}
@@ -1,8 +1,11 @@
 #include <patch_common/MemUtils.h>
-#include <windows.h>
 #include <xlog/xlog.h>
 #include <cstring>
 
+#ifdef _WIN32
+
+#include <windows.h>
+
 void write_mem(unsigned addr, const void* data, unsigned size)
 {
     DWORD old_protect;
@@ -22,6 +25,28 @@ void unprotect_mem(void* ptr, unsigned len)
     }
 }
 
+#else
+
+#include <patch_common/PatchTransaction.h>
+
+void write_mem(unsigned addr, const void* data, unsigned size)
+{
+    PatchTransaction tx;
+    tx.write(addr, data, size);
+    tx.commit();
+}
+
+void unprotect_mem(void* ptr, unsigned len)
+{
+    auto& backend = get_default_mem_protection_backend();
+    auto addr = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t begin = addr & ~(backend.page_size() - 1);
+    unsigned old_protect;
+    backend.unprotect(begin, addr + len - begin, old_protect);
+}
+
+#endif
+
 extern "C" size_t subhook_disasm(void *src, int32_t *reloc_op_offset);
 
 size_t get_instruction_len(void* ptr)
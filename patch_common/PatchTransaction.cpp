@@ -0,0 +1,125 @@
+#include <patch_common/PatchTransaction.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+#include <cstring>
+
+void PatchTransaction::write(uintptr_t addr, const void* data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    if (m_committed) {
+        xlog::warn("Staging write at 0x{:x} into already committed patch transaction", addr);
+    }
+    auto* bytes = static_cast<const std::byte*>(data);
+    m_writes.push_back({addr, size, m_new_data.size()});
+    m_new_data.insert(m_new_data.end(), bytes, bytes + size);
+}
+
+bool PatchTransaction::commit()
+{
+    if (m_committed) {
+        xlog::error("Patch transaction is already committed");
+        return false;
+    }
+    if (m_writes.empty()) {
+        return true;
+    }
+
+    std::vector<PageProtection> protections;
+    if (!unprotect_pages(collect_pages(), protections)) {
+        restore_pages(protections);
+        return false;
+    }
+
+    m_old_data.resize(m_new_data.size());
+    for (const auto& w : m_writes) {
+        auto* ptr = reinterpret_cast<void*>(w.addr);
+        std::memcpy(&m_old_data[w.data_offset], ptr, w.size);
+        std::memcpy(ptr, &m_new_data[w.data_offset], w.size);
+    }
+
+    restore_pages(protections);
+    flush_instruction_cache(protections);
+    m_committed = true;
+    return true;
+}
+
+bool PatchTransaction::rollback()
+{
+    if (!m_committed) {
+        xlog::error("Cannot rollback patch transaction that is not committed");
+        return false;
+    }
+
+    std::vector<PageProtection> protections;
+    if (!unprotect_pages(collect_pages(), protections)) {
+        restore_pages(protections);
+        return false;
+    }
+
+    // Walk in reverse order so overlapping writes are reverted to the oldest value
+    for (auto it = m_writes.rbegin(); it != m_writes.rend(); ++it) {
+        std::memcpy(reinterpret_cast<void*>(it->addr), &m_old_data[it->data_offset], it->size);
+    }
+
+    restore_pages(protections);
+    flush_instruction_cache(protections);
+    m_committed = false;
+    return true;
+}
+
+void PatchTransaction::clear()
+{
+    m_writes.clear();
+    m_new_data.clear();
+    m_old_data.clear();
+    m_committed = false;
+}
+
+std::vector<uintptr_t> PatchTransaction::collect_pages() const
+{
+    const uintptr_t page_size = m_backend.page_size();
+    std::vector<uintptr_t> pages;
+    for (const auto& w : m_writes) {
+        uintptr_t first_page = w.addr & ~(page_size - 1);
+        uintptr_t last_page = (w.addr + w.size - 1) & ~(page_size - 1);
+        for (uintptr_t page = first_page; page <= last_page; page += page_size) {
+            pages.push_back(page);
+        }
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    return pages;
+}
+
+bool PatchTransaction::unprotect_pages(const std::vector<uintptr_t>& pages, std::vector<PageProtection>& out_protections)
+{
+    const size_t page_size = m_backend.page_size();
+    out_protections.reserve(pages.size());
+    for (uintptr_t page : pages) {
+        unsigned old_protect;
+        if (!m_backend.unprotect(page, page_size, old_protect)) {
+            xlog::error("Failed to unprotect page 0x{:x} - patch transaction aborted", page);
+            return false;
+        }
+        out_protections.push_back({page, old_protect});
+    }
+    return true;
+}
+
+void PatchTransaction::restore_pages(const std::vector<PageProtection>& protections)
+{
+    const size_t page_size = m_backend.page_size();
+    for (const auto& prot : protections) {
+        m_backend.restore(prot.addr, page_size, prot.old_protect);
+    }
+}
+
+void PatchTransaction::flush_instruction_cache(const std::vector<PageProtection>& protections)
+{
+    const size_t page_size = m_backend.page_size();
+    for (const auto& prot : protections) {
+        m_backend.flush_instruction_cache(prot.addr, page_size);
+    }
+}
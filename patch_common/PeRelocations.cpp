@@ -0,0 +1,114 @@
+#include <patch_common/PeRelocations.h>
+#include <xlog/xlog.h>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// PE structures are read by offset so this file does not depend on windows.h
+namespace pe
+{
+    constexpr uint16_t dos_signature = 0x5A4D; // MZ
+    constexpr uint32_t nt_signature = 0x00004550; // PE\0\0
+    constexpr uint16_t optional_header_magic_pe32 = 0x10B;
+    constexpr size_t dos_e_lfanew_offset = 0x3C;
+    constexpr size_t file_header_offset = 4;
+    constexpr size_t optional_header_offset = 4 + 20;
+    constexpr size_t num_rva_and_sizes_offset = 92;
+    constexpr size_t data_directories_offset = 96;
+    constexpr size_t directory_entry_basereloc = 5;
+    constexpr size_t reloc_block_header_size = 8;
+    constexpr unsigned rel_based_absolute = 0;
+    constexpr unsigned rel_based_highlow = 3;
+}
+
+template<typename T>
+static T read_image(uintptr_t addr)
+{
+    T value;
+    std::memcpy(&value, reinterpret_cast<const void*>(addr), sizeof(value));
+    return value;
+}
+
+bool get_image_relocations(uintptr_t image_base, std::vector<uintptr_t>& out_addrs)
+{
+    if (read_image<uint16_t>(image_base) != pe::dos_signature) {
+        xlog::warn("Image at 0x{:x} has no DOS header", image_base);
+        return false;
+    }
+    uintptr_t nt_headers = image_base + read_image<uint32_t>(image_base + pe::dos_e_lfanew_offset);
+    if (read_image<uint32_t>(nt_headers) != pe::nt_signature) {
+        xlog::warn("Image at 0x{:x} has no NT headers", image_base);
+        return false;
+    }
+    uintptr_t optional_header = nt_headers + pe::optional_header_offset;
+    if (read_image<uint16_t>(optional_header) != pe::optional_header_magic_pe32) {
+        xlog::warn("Image at 0x{:x} is not a PE32 image", image_base);
+        return false;
+    }
+    auto num_dirs = read_image<uint32_t>(optional_header + pe::num_rva_and_sizes_offset);
+    if (num_dirs <= pe::directory_entry_basereloc) {
+        return false;
+    }
+    uintptr_t reloc_dir = optional_header + pe::data_directories_offset + pe::directory_entry_basereloc * 8;
+    auto reloc_rva = read_image<uint32_t>(reloc_dir);
+    auto reloc_size = read_image<uint32_t>(reloc_dir + 4);
+    if (!reloc_rva || !reloc_size) {
+        return false;
+    }
+
+    uintptr_t block = image_base + reloc_rva;
+    uintptr_t relocs_end = block + reloc_size;
+    while (block + pe::reloc_block_header_size <= relocs_end) {
+        auto page_rva = read_image<uint32_t>(block);
+        auto block_size = read_image<uint32_t>(block + 4);
+        if (block_size < pe::reloc_block_header_size || block + block_size > relocs_end) {
+            xlog::warn("Malformed relocation block at 0x{:x}", block);
+            break;
+        }
+        size_t num_entries = (block_size - pe::reloc_block_header_size) / sizeof(uint16_t);
+        for (size_t i = 0; i < num_entries; ++i) {
+            auto entry = read_image<uint16_t>(block + pe::reloc_block_header_size + i * sizeof(uint16_t));
+            unsigned type = entry >> 12;
+            if (type == pe::rel_based_highlow) {
+                out_addrs.push_back(image_base + page_rva + (entry & 0xFFF));
+            }
+            else if (type != pe::rel_based_absolute) {
+                // Other types are not used by 32-bit x86 images
+                xlog::trace("Ignoring relocation type {} at RVA 0x{:x}", type, page_rva + (entry & 0xFFF));
+            }
+        }
+        block += block_size;
+    }
+    return true;
+}
+
+const std::vector<uintptr_t>& get_main_module_relocations()
+{
+    static std::vector<uintptr_t> relocs = []() {
+        std::vector<uintptr_t> result;
+#ifdef _WIN32
+        auto image_base = reinterpret_cast<uintptr_t>(GetModuleHandleA(nullptr));
+        if (get_image_relocations(image_base, result)) {
+            xlog::debug("Main module has {} relocations", result.size());
+        }
+        else {
+            xlog::warn("Main module has no relocation table");
+        }
+#endif
+        return result;
+    }();
+    return relocs;
+}
+
+std::vector<PointerRef> find_relocated_refs(const std::vector<uintptr_t>& reloc_addrs, uintptr_t begin, uintptr_t end)
+{
+    std::vector<PointerRef> refs;
+    for (auto addr : reloc_addrs) {
+        auto value = read_image<uint32_t>(addr);
+        if (value >= begin && value < end) {
+            refs.push_back({addr, value});
+        }
+    }
+    return refs;
+}
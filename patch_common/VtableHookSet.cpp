@@ -0,0 +1,68 @@
+#include <patch_common/VtableHookSet.h>
+#include <xlog/xlog.h>
+#include <algorithm>
+
+static void**& vptr(void* instance)
+{
+    return *static_cast<void***>(instance);
+}
+
+void VtableHookSet::hook(size_t index, void* replacement, void** original_out)
+{
+    if (index >= m_num_slots) {
+        xlog::error("Vtable slot {} out of range (size {})", index, m_num_slots);
+        return;
+    }
+    m_hooks.push_back({index, replacement, original_out});
+}
+
+bool VtableHookSet::install(void* instance)
+{
+    if (!instance) {
+        return false;
+    }
+    if (is_installed_on(instance)) {
+        return true;
+    }
+
+    void** original_vtable = vptr(instance);
+    Shadow shadow{std::make_unique<void*[]>(num_prefix_slots + m_num_slots), original_vtable};
+    std::copy_n(original_vtable - num_prefix_slots, num_prefix_slots + m_num_slots, shadow.slots.get());
+    void** vtable = shadow_vtable(shadow);
+    for (const auto& hook : m_hooks) {
+        if (hook.original_out) {
+            *hook.original_out = original_vtable[hook.index];
+        }
+        vtable[hook.index] = hook.replacement;
+    }
+
+    // Shadow is fully initialized before the object can see it
+    vptr(instance) = vtable;
+    m_shadows.push_back(std::move(shadow));
+    m_instance = instance;
+    xlog::trace("Installed {} vtable hooks on object 0x{:x}", m_hooks.size(), reinterpret_cast<uintptr_t>(instance));
+    return true;
+}
+
+void VtableHookSet::remove()
+{
+    if (!m_instance || m_shadows.empty()) {
+        return;
+    }
+    const auto& shadow = m_shadows.back();
+    if (vptr(m_instance) == shadow_vtable(shadow)) {
+        vptr(m_instance) = shadow.original_vtable;
+    }
+    m_instance = nullptr;
+}
+
+bool VtableHookSet::is_installed_on(const void* instance) const
+{
+    if (!instance) {
+        return false;
+    }
+    void** current = *static_cast<void** const*>(instance);
+    return std::any_of(m_shadows.begin(), m_shadows.end(), [&](const Shadow& shadow) {
+        return current == shadow_vtable(shadow);
+    });
+}
@@ -4,8 +4,10 @@
 #include <patch_common/MemUtils.h>
 #include <patch_common/ShortTypes.h>
 #include <cassert>
+#include <cstdlib>
 #include <optional>
 #include <utility>
+#include <vector>
 
 class AsmReg
 {
@@ -56,16 +58,86 @@ struct AsmReg8 : public AsmReg
     {}
 };
 
+struct AsmXmmReg : public AsmReg
+{
+    explicit constexpr AsmXmmReg(int num) :
+        AsmReg(num, 16)
+    {}
+};
+
+// Index register multiplied by scale, e.g. `ecx * 4`
+struct AsmScaledReg32
+{
+    AsmReg32 reg;
+    int scale;
+};
+
+// Memory operand using a SIB byte, e.g. `*(eax + ecx * 4 + 8)`
+struct AsmSibAddr
+{
+    std::optional<AsmReg32> base;
+    AsmScaledReg32 index;
+    int32_t displacement;
+};
+
+inline AsmScaledReg32 operator*(AsmReg32 reg, int scale)
+{
+    assert(scale == 1 || scale == 2 || scale == 4 || scale == 8);
+    return {reg, scale};
+}
+
+inline AsmSibAddr operator+(AsmReg32 base, AsmScaledReg32 index)
+{
+    return {base, index, 0};
+}
+
+inline AsmSibAddr operator+(AsmReg32 base, AsmReg32 index)
+{
+    return {base, {index, 1}, 0};
+}
+
+inline AsmSibAddr operator+(std::pair<AsmReg32, int> base, AsmScaledReg32 index)
+{
+    return {base.first, index, base.second};
+}
+
+inline AsmSibAddr operator+(AsmScaledReg32 index, int n)
+{
+    return {std::nullopt, index, n};
+}
+
+inline AsmSibAddr operator+(AsmSibAddr addr, int n)
+{
+    addr.displacement += n;
+    return addr;
+}
+
+inline AsmSibAddr operator-(AsmSibAddr addr, int n)
+{
+    addr.displacement -= n;
+    return addr;
+}
+
 struct AsmRegMem
 {
     bool memory;
     std::optional<AsmReg> reg_opt;
     int32_t displacement;
+    std::optional<AsmReg> index_opt;
+    int scale = 1;
 
     AsmRegMem(bool memory, std::optional<AsmReg> reg_opt, int32_t displacement = 0) :
         memory(memory), reg_opt(reg_opt), displacement(displacement)
     {}
 
+    AsmRegMem(const AsmSibAddr& addr) :
+        memory(true), displacement(addr.displacement), index_opt({addr.index.reg}), scale(addr.index.scale)
+    {
+        if (addr.base) {
+            reg_opt = {addr.base.value()};
+        }
+    }
+
     AsmRegMem(AsmReg reg) :
         memory(false), reg_opt({reg}), displacement(0)
     {}
@@ -90,6 +162,11 @@ inline AsmRegMem operator*(std::pair<AsmReg32, int> p)
     return {true, {p.first}, p.second};
 }
 
+inline AsmRegMem operator*(const AsmSibAddr& addr)
+{
+    return {addr};
+}
+
 namespace asm_regs
 {
 
@@ -116,29 +193,71 @@ constexpr AsmReg16 ax(asm_reg_num::AX), cx(asm_reg_num::CX), dx(asm_reg_num::DX)
 constexpr AsmReg16 sp(asm_reg_num::SP), bp(asm_reg_num::BP), si(asm_reg_num::SI), di(asm_reg_num::DI);
 constexpr AsmReg8 al(asm_reg_num::AX), cl(asm_reg_num::CX), dl(asm_reg_num::DX), bl(asm_reg_num::BX);
 constexpr AsmReg8 ah(asm_reg_num::SP), ch(asm_reg_num::BP), dh(asm_reg_num::SI), bh(asm_reg_num::DI);
+constexpr AsmXmmReg xmm0(0), xmm1(1), xmm2(2), xmm3(3), xmm4(4), xmm5(5), xmm6(6), xmm7(7);
 } // namespace asm_regs
 
+// Position in code generated by AsmWriter. Created by AsmWriter::new_label and bound by AsmWriter::bind.
+struct AsmLabel
+{
+    int id = -1;
+};
+
+// Condition codes used by jcc (lower nibble of the opcode)
+enum class AsmCond : u8
+{
+    o, no, b, ae, e, ne, be, a, s, ns, p, np, l, ge, le, g,
+};
+
+// Instructions are buffered and written to memory at once by finish() (or the destructor). Until then branches can
+// target labels that are bound later. Branches without an explicit size start with a rel8 encoding and are widened
+// to rel32 only when the displacement does not fit.
 class AsmWriter
 {
 public:
     static constexpr uintptr_t unk_end_addr = UINTPTR_MAX;
 
     AsmWriter(uintptr_t begin_addr, uintptr_t end_addr = unk_end_addr) :
-        m_addr(begin_addr), m_end_addr(end_addr)
+        m_begin_addr(begin_addr), m_end_addr(end_addr), m_has_addr(true)
     {}
 
     AsmWriter(void* begin_ptr, void* end_ptr = reinterpret_cast<void*>(unk_end_addr)) :
-        m_addr(reinterpret_cast<uintptr_t>(begin_ptr)), m_end_addr(reinterpret_cast<uintptr_t>(end_ptr))
+        AsmWriter(reinterpret_cast<uintptr_t>(begin_ptr), reinterpret_cast<uintptr_t>(end_ptr))
     {}
 
+    // Measure mode: code is only assembled to compute its size (see size()) and can be written later by finish(addr)
+    AsmWriter() :
+        m_begin_addr(0), m_end_addr(unk_end_addr), m_has_addr(false)
+    {}
+
+    AsmWriter(const AsmWriter& other) = delete;
+    AsmWriter& operator=(const AsmWriter& other) = delete;
+
     ~AsmWriter()
     {
-        if (m_end_addr != unk_end_addr) {
-            assert(m_addr <= m_end_addr);
-            while (m_addr < m_end_addr) nop();
+        if (m_has_addr && !m_finished) {
+            finish();
         }
     }
 
+    AsmLabel new_label()
+    {
+        m_labels.push_back({0, 0, false});
+        return {static_cast<int>(m_labels.size() - 1)};
+    }
+
+    // Binds the label to the current position
+    AsmWriter& bind(AsmLabel label);
+
+    // Size of the code after branch relaxation. In measure mode branches to absolute addresses are assumed to be
+    // rel32 so the result is an upper bound of the final size (exact if all branches target labels).
+    [[nodiscard]] size_t size();
+
+    // Writes the code to memory, padding it with NOPs up to the end address if it was given
+    void finish();
+
+    // Writes code assembled in measure mode to the given address
+    void finish(uintptr_t begin_addr);
+
     AsmWriter& add(const AsmRegMem& dst_rm, const AsmReg32& src_reg)
     {
         write<u8>(0x01); // Opcode
@@ -170,11 +289,32 @@ public:
     // Method to perform a `jg` (jump if greater) to a given address
     AsmWriter& jg(uintptr_t address)
     {
-        write<u8>(0x0F);
-        write<u8>(0x8F);                                               // Opcode for `jg`
-        int32_t offset = static_cast<int32_t>(address - (m_addr + 6)); // Offset for the relative jump
-        write<i32>(offset);
-        return *this;
+        return add_branch(BranchKind::jcc, AsmCond::g, address, -1, BranchSize::long_);
+    }
+
+    AsmWriter& jg(AsmLabel label)
+    {
+        return jcc(AsmCond::g, label);
+    }
+
+    AsmWriter& jcc(AsmCond cond, uintptr_t addr)
+    {
+        return add_branch(BranchKind::jcc, cond, addr, -1, BranchSize::relaxed);
+    }
+
+    AsmWriter& jcc(AsmCond cond, AsmLabel label)
+    {
+        return add_branch(BranchKind::jcc, cond, 0, label.id, BranchSize::relaxed);
+    }
+
+    AsmWriter& je(AsmLabel label)
+    {
+        return jcc(AsmCond::e, label);
+    }
+
+    AsmWriter& jne(AsmLabel label)
+    {
+        return jcc(AsmCond::ne, label);
     }
 
     AsmWriter& xor_(const AsmReg32& dst_reg, const AsmRegMem& src_reg_mem)
@@ -315,7 +455,7 @@ public:
 
     AsmWriter& add(const AsmRegMem& dst_rm, int32_t imm32)
     {
-        if (abs(imm32) < 128)
+        if (std::abs(imm32) < 128)
             return add(dst_rm, static_cast<int8_t>(imm32));
         write<u8>(0x81); // Opcode
         write_mod_rm(dst_rm, 0);
@@ -325,7 +465,7 @@ public:
 
     AsmWriter& sub(const AsmRegMem& dst_rm, int32_t imm32)
     {
-        if (abs(imm32) < 128)
+        if (std::abs(imm32) < 128)
             return sub(dst_rm, static_cast<int8_t>(imm32));
         write<u8>(0x81); // Opcode
         write_mod_rm(dst_rm, 5);
@@ -333,6 +473,59 @@ public:
         return *this;
     }
 
+    AsmWriter& sub(const AsmRegMem& dst_rm, const AsmReg32& src_reg)
+    {
+        write<u8>(0x29); // Opcode
+        write_mod_rm(dst_rm, src_reg);
+        return *this;
+    }
+
+    AsmWriter& sub(const AsmReg32& dst_reg, const AsmRegMem& src_rm)
+    {
+        write<u8>(0x2B); // Opcode
+        write_mod_rm(src_rm, dst_reg);
+        return *this;
+    }
+
+    AsmWriter& sub(const AsmReg32& dst_reg, const AsmReg32& src_reg)
+    {
+        return sub(AsmRegMem(dst_reg), src_reg);
+    }
+
+    AsmWriter& and_(const AsmRegMem& dst_rm, const AsmReg32& src_reg)
+    {
+        write<u8>(0x21); // Opcode
+        write_mod_rm(dst_rm, src_reg);
+        return *this;
+    }
+
+    AsmWriter& and_(const AsmReg32& dst_reg, const AsmRegMem& src_rm)
+    {
+        write<u8>(0x23); // Opcode
+        write_mod_rm(src_rm, dst_reg);
+        return *this;
+    }
+
+    AsmWriter& and_(const AsmReg32& dst_reg, const AsmReg32& src_reg)
+    {
+        return and_(AsmRegMem(dst_reg), src_reg);
+    }
+
+    AsmWriter& and_(const AsmRegMem& dst_rm, int32_t imm32)
+    {
+        if (can_imm_fit_in_one_byte(imm32)) {
+            write<u8>(0x83); // Opcode
+            write_mod_rm(dst_rm, 4);
+            write<i8>(static_cast<i8>(imm32));
+        }
+        else {
+            write<u8>(0x81); // Opcode
+            write_mod_rm(dst_rm, 4);
+            write<i32>(imm32);
+        }
+        return *this;
+    }
+
     AsmWriter& add(const AsmRegMem& dst_rm, int8_t imm8)
     {
         write<u8>(0x83); // Opcode
@@ -413,10 +606,12 @@ public:
 
     AsmWriter& call_long(uint32_t addr)
     {
-        auto jmp_addr = m_addr;
-        write<u8>(0xE8);
-        write<i32>(addr - (jmp_addr + 0x5));
-        return *this;
+        return add_branch(BranchKind::call, {}, addr, -1, BranchSize::long_);
+    }
+
+    AsmWriter& call(AsmLabel label)
+    {
+        return add_branch(BranchKind::call, {}, 0, label.id, BranchSize::long_);
     }
 
     AsmWriter& call(uint32_t addr)
@@ -432,40 +627,42 @@ public:
 
     AsmWriter& jl(uintptr_t target_addr)
     {
-        // Calculate relative offset
-        int8_t offset = static_cast<int8_t>(target_addr - (m_addr + 2));
-
-        // Check if offset is within short jump range
-        assert(offset >= -128 && offset <= 127 && "jl short jump out of range");
+        return add_branch(BranchKind::jcc, AsmCond::l, target_addr, -1, BranchSize::short_);
+    }
 
-        // Write `jl` opcode for short jump (0x7C) followed by the offset
-        write<u8>(0x7C);   // Opcode for `jl`
-        write<i8>(offset); // Relative offset to the target address
-        return *this;
+    AsmWriter& jl(AsmLabel label)
+    {
+        return jcc(AsmCond::l, label);
     }
 
     AsmWriter& jmp_long(uint32_t addr)
     {
-        auto jmp_addr = m_addr;
-        write<u8>(0xE9);
-        write<i32>(addr - (jmp_addr + 0x5));
-        return *this;
+        return add_branch(BranchKind::jmp, {}, addr, -1, BranchSize::long_);
+    }
+
+    AsmWriter& jmp_long(AsmLabel label)
+    {
+        return add_branch(BranchKind::jmp, {}, 0, label.id, BranchSize::long_);
     }
 
     AsmWriter& jmp_short(uint32_t addr)
     {
-        auto jmp_addr = m_addr;
-        write<u8>(0xEB);
-        write<i8>(addr - (jmp_addr + 0x2));
-        return *this;
+        return add_branch(BranchKind::jmp, {}, addr, -1, BranchSize::short_);
+    }
+
+    AsmWriter& jmp_short(AsmLabel label)
+    {
+        return add_branch(BranchKind::jmp, {}, 0, label.id, BranchSize::short_);
     }
 
     AsmWriter& jmp(uint32_t addr)
     {
-        if (std::abs(static_cast<int>(addr - (m_addr + 0x2))) < 127) {
-            return jmp_short(addr);
-        }
-        return jmp_long(addr);
+        return add_branch(BranchKind::jmp, {}, addr, -1, BranchSize::relaxed);
+    }
+
+    AsmWriter& jmp(AsmLabel label)
+    {
+        return add_branch(BranchKind::jmp, {}, 0, label.id, BranchSize::relaxed);
     }
 
     template<typename T>
@@ -547,44 +744,189 @@ public:
         return *this;
     }
 
+    template<typename T>
+    AsmWriter& fild(const AsmRegMem& src_rm);
+
+    template<typename T>
+    AsmWriter& fistp(const AsmRegMem& dst_rm);
+
+    // Truncating store. Requires SSE3.
+    template<typename T>
+    AsmWriter& fisttp(const AsmRegMem& dst_rm);
+
+    AsmWriter& movss(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF3, 0x10, src_rm, dst_reg);
+    }
+
+    AsmWriter& movss(const AsmRegMem& dst_rm, const AsmXmmReg& src_reg)
+    {
+        return write_sse_op(0xF3, 0x11, dst_rm, src_reg);
+    }
+
+    AsmWriter& movss(const AsmXmmReg& dst_reg, const AsmXmmReg& src_reg)
+    {
+        return movss(dst_reg, AsmRegMem(src_reg));
+    }
+
+    AsmWriter& movsd(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF2, 0x10, src_rm, dst_reg);
+    }
+
+    AsmWriter& movsd(const AsmRegMem& dst_rm, const AsmXmmReg& src_reg)
+    {
+        return write_sse_op(0xF2, 0x11, dst_rm, src_reg);
+    }
+
+    AsmWriter& movsd(const AsmXmmReg& dst_reg, const AsmXmmReg& src_reg)
+    {
+        return movsd(dst_reg, AsmRegMem(src_reg));
+    }
+
+    // Memory operand must be 16-byte aligned
+    AsmWriter& movaps(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0, 0x28, src_rm, dst_reg);
+    }
+
+    AsmWriter& movaps(const AsmRegMem& dst_rm, const AsmXmmReg& src_reg)
+    {
+        return write_sse_op(0, 0x29, dst_rm, src_reg);
+    }
+
+    AsmWriter& movaps(const AsmXmmReg& dst_reg, const AsmXmmReg& src_reg)
+    {
+        return movaps(dst_reg, AsmRegMem(src_reg));
+    }
+
+    AsmWriter& cvttss2si(const AsmReg32& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF3, 0x2C, src_rm, dst_reg);
+    }
+
+    AsmWriter& cvtsi2ss(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF3, 0x2A, src_rm, dst_reg);
+    }
+
+    AsmWriter& addss(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF3, 0x58, src_rm, dst_reg);
+    }
+
+    AsmWriter& mulss(const AsmXmmReg& dst_reg, const AsmRegMem& src_rm)
+    {
+        return write_sse_op(0xF3, 0x59, src_rm, dst_reg);
+    }
 
 private:
-    uintptr_t m_addr, m_end_addr;
+    enum class BranchKind : u8
+    {
+        jmp,
+        call,
+        jcc,
+    };
+
+    enum class BranchSize : u8
+    {
+        relaxed,
+        short_,
+        long_,
+    };
+
+    struct Branch
+    {
+        // Offset in m_code of the first byte after the branch (branches are not stored in m_code)
+        size_t code_offset;
+        BranchKind kind;
+        AsmCond cond;
+        BranchSize forced_size;
+        bool is_long;
+        uintptr_t target_addr;
+        int target_label; // -1 if target_addr is used
+    };
+
+    struct LabelPos
+    {
+        size_t code_offset;
+        size_t num_branches_before;
+        bool bound;
+    };
+
+    uintptr_t m_begin_addr, m_end_addr;
+    bool m_has_addr;
+    bool m_finished = false;
+    std::vector<u8> m_code;
+    std::vector<Branch> m_branches;
+    std::vector<LabelPos> m_labels;
+    // Final offsets of branches computed by relax()
+    std::vector<size_t> m_branch_offsets;
 
     static constexpr u8 operand_size_override_prefix = 0x66;
 
+    AsmWriter& add_branch(BranchKind kind, AsmCond cond, uintptr_t target_addr, int target_label, BranchSize size)
+    {
+        assert(target_label < static_cast<int>(m_labels.size()));
+        assert(kind != BranchKind::call || size == BranchSize::long_);
+        m_branches.push_back({m_code.size(), kind, cond, size, size != BranchSize::short_, target_addr, target_label});
+        return *this;
+    }
+
+    static size_t branch_size(const Branch& branch);
+    void compute_branch_offsets();
+    size_t label_offset(int label) const;
+    intptr_t branch_displacement(size_t branch_idx) const;
+    void relax();
+    std::vector<u8> encode() const;
+
     void write_mod_rm(const AsmRegMem& rm, uint8_t reg_field)
     {
+        using namespace asm_regs::asm_reg_num;
+        int base_num = rm.reg_opt ? rm.reg_opt.value().reg_num : -1;
         uint8_t mod_field = 0;
         if (!rm.memory)
             mod_field = 3;
-        else if (rm.displacement == 0 || !rm.reg_opt)
+        // Note: mod 0 with EBP base means disp32 without base so EBP always needs a displacement
+        else if ((rm.displacement == 0 && base_num != BP) || !rm.reg_opt)
             mod_field = 0;
-        else if (abs(rm.displacement) < 128)
+        else if (std::abs(rm.displacement) < 128)
             mod_field = 1;
         else
             mod_field = 2;
 
-        uint8_t rm_field = rm.reg_opt ? rm.reg_opt.value().reg_num : 5;
+        bool needs_sib = mod_field != 3 && (rm.index_opt || base_num == SP);
+        uint8_t rm_field = needs_sib ? 4 : (rm.reg_opt ? base_num : 5);
         uint8_t mod_reg_rm_byte = (mod_field << 6) | (reg_field << 3) | rm_field;
         write<u8>(mod_reg_rm_byte); // 0xD
 
-        // TODO: full SIB support?
-        if (rm_field == 4 && mod_field != 3) {
-            uint8_t scale_field = 0;
-            uint8_t index_field = 4; // no index
-            uint8_t base_field = 4;  // esp
+        if (needs_sib) {
+            assert(!rm.index_opt || rm.index_opt.value().reg_num != SP); // ESP cannot be used as index
+            uint8_t scale_field = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+            uint8_t index_field = rm.index_opt ? rm.index_opt.value().reg_num : 4; // 4 - no index
+            uint8_t base_field = rm.reg_opt ? base_num : 5; // 5 with mod 0 - no base, disp32 follows
             uint8_t sib_byte = (scale_field << 6) | (index_field << 3) | base_field;
             write<u8>(sib_byte);
         }
 
         if (mod_field == 1)
             write<i8>(rm.displacement);
-        else if (mod_field == 2 || !rm.reg_opt) {
+        else if (mod_field == 2 || (mod_field == 0 && !rm.reg_opt)) {
             write<i32>(rm.displacement);
         }
     }
 
+    AsmWriter& write_sse_op(u8 prefix, u8 opcode, const AsmRegMem& rm, const AsmReg& reg)
+    {
+        if (prefix) {
+            write<u8>(prefix);
+        }
+        write<u8>(0x0F);
+        write<u8>(opcode);
+        write_mod_rm(rm, reg);
+        return *this;
+    }
+
     void write_mod_rm(const AsmRegMem& rm, const AsmReg& reg)
     {
         write_mod_rm(rm, reg.reg_num);
@@ -593,15 +935,15 @@ private:
     template<typename T>
     void write(typename TypeIdentity<T>::type value)
     {
-        write_mem<T>(m_addr, value);
-        m_addr += sizeof(value);
+        const auto* bytes = reinterpret_cast<const u8*>(&value);
+        m_code.insert(m_code.end(), bytes, bytes + sizeof(value));
     }
 
     template<typename T>
     static bool can_imm_fit_in_one_byte(T imm)
     {
         static_assert(sizeof(T) <= 4);
-        return abs(static_cast<int32_t>(imm)) < 128;
+        return std::abs(static_cast<int32_t>(imm)) < 128;
     }
 };
 
@@ -682,3 +1024,75 @@ inline AsmWriter& AsmWriter::fmul<float>(const AsmRegMem& src_rm)
     write_mod_rm(src_rm, 1);
     return *this;
 }
+
+template<>
+inline AsmWriter& AsmWriter::fild<int16_t>(const AsmRegMem& src_rm)
+{
+    write<u8>(0xDF);
+    write_mod_rm(src_rm, 0);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fild<int32_t>(const AsmRegMem& src_rm)
+{
+    write<u8>(0xDB);
+    write_mod_rm(src_rm, 0);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fild<int64_t>(const AsmRegMem& src_rm)
+{
+    write<u8>(0xDF);
+    write_mod_rm(src_rm, 5);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fistp<int16_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDF);
+    write_mod_rm(dst_rm, 3);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fistp<int32_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDB);
+    write_mod_rm(dst_rm, 3);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fistp<int64_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDF);
+    write_mod_rm(dst_rm, 7);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fisttp<int16_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDF);
+    write_mod_rm(dst_rm, 1);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fisttp<int32_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDB);
+    write_mod_rm(dst_rm, 1);
+    return *this;
+}
+
+template<>
+inline AsmWriter& AsmWriter::fisttp<int64_t>(const AsmRegMem& dst_rm)
+{
+    write<u8>(0xDD);
+    write_mod_rm(dst_rm, 1);
+    return *this;
+}
@@ -24,6 +24,8 @@ public:
 
     void install() override
     {
+        m_enter_code.alloc_near(m_addr);
+        m_leave_code.alloc_near(m_addr);
         auto opcode = addr_as_ref<uint8_t>(m_addr);
         if (opcode != asm_opcodes::call_rel_long) {
             xlog::error("not a call at 0x{:x}", m_addr);
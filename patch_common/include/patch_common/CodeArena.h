@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Source of executable pages for CodeArena
+class CodePageAllocator
+{
+public:
+    virtual ~CodePageAllocator() = default;
+
+    // Size and alignment of regions returned by alloc_near
+    [[nodiscard]] virtual size_t granularity() const = 0;
+
+    // Allocates a readable, writable and executable region starting no further than max_distance bytes from hint.
+    // If hint is 0 the region can be placed anywhere. Returns nullptr on failure.
+    virtual void* alloc_near(uintptr_t hint, size_t size, size_t max_distance) = 0;
+
+    virtual void free(void* ptr, size_t size) = 0;
+};
+
+CodePageAllocator& get_default_code_page_allocator();
+
+// Bump-pointer allocator for hook thunks and code injections. Thunks are packed densely into large chunks of
+// executable memory reserved close to the patched code so rel32 jumps between them always fit.
+// Individual allocations are never freed. Instead, allocations are tagged with the generation that was current when
+// they were made and a whole generation can be released at once.
+// Note: it is not thread-safe
+class CodeArena
+{
+public:
+    using Generation = unsigned;
+
+    static constexpr size_t alignment = 16;
+    static constexpr size_t default_chunk_size = 0x10000;
+    // Max distance between a thunk and its hint that keeps rel32 displacements in range (with some margin)
+    static constexpr size_t max_near_distance = 0x7FF00000;
+
+    explicit CodeArena(CodePageAllocator& page_allocator = get_default_code_page_allocator());
+    CodeArena(const CodeArena& other) = delete;
+    CodeArena& operator=(const CodeArena& other) = delete;
+    ~CodeArena();
+
+    static CodeArena& global();
+
+    // Returns a 16-byte aligned executable block. If hint is not 0 the block is placed within max_near_distance of it
+    // when possible. Returns nullptr on failure.
+    void* alloc(size_t size, uintptr_t hint = 0);
+
+    // Starts a new generation. Following allocations never share a chunk with older generations.
+    Generation begin_generation();
+
+    // Releases all memory allocated in the given generation
+    void free_generation(Generation generation);
+
+    [[nodiscard]] Generation current_generation() const
+    {
+        return m_generation;
+    }
+
+    [[nodiscard]] size_t bytes_used() const;
+    [[nodiscard]] size_t bytes_reserved() const;
+
+private:
+    struct Chunk
+    {
+        std::byte* base;
+        size_t size;
+        size_t used;
+        Generation generation;
+    };
+
+    Chunk* find_chunk(size_t size, uintptr_t hint);
+    Chunk* alloc_chunk(size_t size, uintptr_t hint);
+
+    CodePageAllocator& m_page_allocator;
+    std::vector<Chunk> m_chunks;
+    Generation m_generation = 0;
+};
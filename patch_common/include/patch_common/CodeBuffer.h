@@ -1,16 +1,33 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
+// Executable buffer allocated from CodeArena::global(). Memory is allocated on first use so the owner can ask for it to
+// be placed near the patched code (see alloc_near) and it is never freed individually.
 class CodeBuffer
 {
 public:
-    CodeBuffer(size_t len);
+    CodeBuffer(size_t len) : m_len(len) {}
     CodeBuffer(const CodeBuffer& other) = delete;
-    ~CodeBuffer();
+
+    // Allocates the buffer close to hint. Does nothing if the buffer has already been allocated.
+    void alloc_near(uintptr_t hint);
+
+    // Same as above but overrides the length passed to the constructor
+    void alloc_near(uintptr_t hint, size_t len)
+    {
+        if (!m_ptr) {
+            m_len = len;
+        }
+        alloc_near(hint);
+    }
 
     [[nodiscard]] void* get() const
     {
+        if (!m_ptr) {
+            const_cast<CodeBuffer*>(this)->alloc_near(0);
+        }
         return m_ptr;
     }
 
@@ -20,5 +37,6 @@ public:
     }
 
 private:
-    void* m_ptr;
+    size_t m_len;
+    void* m_ptr = nullptr;
 };
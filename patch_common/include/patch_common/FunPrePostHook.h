@@ -27,6 +27,8 @@ public:
 
     void install() override
     {
+        m_enter_code.alloc_near(m_addr);
+        m_leave_code.alloc_near(m_addr);
         m_subhook.Install(reinterpret_cast<void*>(m_addr), m_enter_code.get());
         void* trampoline = m_subhook.GetTrampoline();
         if (!trampoline) {
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <common/utils/perf-utils.h>
+
+// Per-hook call counting and inclusive cycle measurement built on the zone profiler.
+// Put HOOK_PROFILE("name") at the top of a hook handler (FunHook, CallHook or CodeInjection) to instrument it.
+// The instrumentation is compiled in only if SOPOT_HOOK_PROFILER is defined, otherwise the macro expands to nothing.
+
+#ifdef SOPOT_HOOK_PROFILER
+
+constexpr bool hook_profiler_enabled = true;
+
+#define HOOK_PROFILE(name) \
+    static const PerfZone hook_profile_zone_{name, PerfZoneCategory::hook}; \
+    const ScopedPerfZone hook_profile_scope_{hook_profile_zone_}
+
+#else
+
+constexpr bool hook_profiler_enabled = false;
+
+#define HOOK_PROFILE(name) static_cast<void>(0)
+
+#endif
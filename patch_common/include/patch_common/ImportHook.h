@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <patch_common/Installable.h>
+
+// Returns the address of the import address table entry through which the PE32 image mapped at image_base calls
+// dll_name!func_name (DLL name is compared case-insensitively) or 0 if the function is not imported by name.
+// Note: it only reads memory so it works on synthetic images as well
+uintptr_t find_import_slot(uintptr_t image_base, const char* dll_name, const char* func_name);
+
+// Redirects calls made by the main executable to an imported function. Other modules keep calling the original.
+class ImportHookImpl : public Installable
+{
+protected:
+    const char* m_dll_name;
+    const char* m_func_name;
+    void* m_hook_fun_ptr;
+    void* m_original_fun_ptr = nullptr;
+
+    ImportHookImpl(const char* dll_name, const char* func_name, void* hook_fun_ptr) :
+        m_dll_name(dll_name), m_func_name(func_name), m_hook_fun_ptr(hook_fun_ptr)
+    {}
+
+public:
+    void install() override;
+
+    [[nodiscard]] bool is_installed() const
+    {
+        return m_original_fun_ptr != nullptr;
+    }
+};
+
+template<class T>
+class ImportHook;
+
+template<class R, class... A>
+class ImportHook<R __stdcall(A...)> : public ImportHookImpl
+{
+private:
+    using FunType = R __stdcall(A...);
+
+public:
+    ImportHook(const char* dll_name, const char* func_name, FunType* hook_fun_ptr) :
+        ImportHookImpl(dll_name, func_name, reinterpret_cast<void*>(hook_fun_ptr))
+    {}
+
+    R call_target(A... a) const
+    {
+        auto original_ptr = reinterpret_cast<FunType*>(m_original_fun_ptr);
+        return original_ptr(a...);
+    }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Interface to the OS memory protection API. Patching code talks to it instead of calling VirtualProtect directly so
+// page protection changes can be batched (see PatchTransaction) and the patching logic does not depend on Win32.
+class MemProtectionBackend
+{
+public:
+    virtual ~MemProtectionBackend() = default;
+
+    [[nodiscard]] virtual size_t page_size() const = 0;
+
+    // Makes the range writable and stores an opaque value describing the previous protection in old_protect
+    virtual bool unprotect(uintptr_t addr, size_t size, unsigned& old_protect) = 0;
+
+    // Restores protection returned by unprotect
+    virtual bool restore(uintptr_t addr, size_t size, unsigned old_protect) = 0;
+
+    // Called after the range has been modified so the CPU does not execute stale code
+    virtual void flush_instruction_cache([[maybe_unused]] uintptr_t addr, [[maybe_unused]] size_t size) {}
+};
+
+MemProtectionBackend& get_default_mem_protection_backend();
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <patch_common/MemProtection.h>
+#include <patch_common/MemUtils.h>
+
+// Batches memory writes so every touched page is unprotected and re-protected only once.
+// Writes are staged by write() and applied together by commit(). Original bytes are saved during commit so the whole
+// batch can be reverted by rollback().
+// Note: it is not thread-safe
+class PatchTransaction
+{
+public:
+    explicit PatchTransaction(MemProtectionBackend& backend = get_default_mem_protection_backend()) :
+        m_backend(backend)
+    {}
+
+    PatchTransaction(const PatchTransaction& other) = delete;
+    PatchTransaction& operator=(const PatchTransaction& other) = delete;
+
+    void write(uintptr_t addr, const void* data, size_t size);
+
+    template<typename T>
+    void write(uintptr_t addr, typename TypeIdentity<T>::type value)
+    {
+        write(addr, &value, sizeof(value));
+    }
+
+    template<typename T>
+    void write_ptr(uintptr_t addr, T* value)
+    {
+        write(addr, &value, sizeof(T*));
+    }
+
+    // Applies all staged writes. If any page cannot be unprotected nothing is written.
+    bool commit();
+
+    // Restores bytes overwritten by the last commit
+    bool rollback();
+
+    // Drops staged writes. Committed writes are not reverted.
+    void clear();
+
+    [[nodiscard]] size_t num_writes() const
+    {
+        return m_writes.size();
+    }
+
+    [[nodiscard]] bool is_committed() const
+    {
+        return m_committed;
+    }
+
+private:
+    struct StagedWrite
+    {
+        uintptr_t addr;
+        size_t size;
+        size_t data_offset;
+    };
+
+    struct PageProtection
+    {
+        uintptr_t addr;
+        unsigned old_protect;
+    };
+
+    MemProtectionBackend& m_backend;
+    std::vector<StagedWrite> m_writes;
+    std::vector<std::byte> m_new_data;
+    std::vector<std::byte> m_old_data;
+    bool m_committed = false;
+
+    std::vector<uintptr_t> collect_pages() const;
+    bool unprotect_pages(const std::vector<uintptr_t>& pages, std::vector<PageProtection>& out_protections);
+    void restore_pages(const std::vector<PageProtection>& protections);
+    void flush_instruction_cache(const std::vector<PageProtection>& protections);
+};
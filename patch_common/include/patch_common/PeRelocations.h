@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Returns addresses of all 32-bit absolute pointers listed in the base relocation table of a PE image mapped at
+// image_base. Returns false if the image is not a valid PE32 image or it has no relocation table (e.g. it was linked
+// with /FIXED).
+// Note: it only reads memory so it works on synthetic images as well
+bool get_image_relocations(uintptr_t image_base, std::vector<uintptr_t>& out_addrs);
+
+// Relocations of the main executable. They are parsed once and cached.
+const std::vector<uintptr_t>& get_main_module_relocations();
+
+struct PointerRef
+{
+    // address of the pointer (inside an instruction operand or data)
+    uintptr_t addr;
+    // value stored at addr
+    uintptr_t value;
+};
+
+// Returns all relocated pointers with a value in [begin, end)
+std::vector<PointerRef> find_relocated_refs(const std::vector<uintptr_t>& reloc_addrs, uintptr_t begin, uintptr_t end);
@@ -2,12 +2,22 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
+#include <utility>
 #include <patch_common/MemUtils.h>
 #include <patch_common/Installable.h>
+#include <patch_common/PatchTransaction.h>
+#include <patch_common/PeRelocations.h>
 #include <xlog/xlog.h>
 
+// Moves a static array to a bigger buffer and updates all references to it.
+// References can be listed explicitly or, if no list is given, discovered from the main module relocation table. Every
+// relocated pointer into the old buffer is remapped. Pointers less than one element past its end may be loop end
+// conditions but also pointers to a variable that follows the buffer, so they are only remapped if their addresses
+// were confirmed by the caller (see ConfirmedEndRefs). If an unconfirmed one is found the buffer is not moved.
+// Note: element count limits encoded as immediates (e.g. cmp eax, 100) are not updated
 template<typename T>
 class StaticBufferResizePatch : public Installable
 {
@@ -20,17 +30,49 @@ public:
         bool is_end_ref = false;
     };
 
+    // Addresses of instructions (or data) using a discovered pointer to the end of the buffer that were checked to
+    // really mean the buffer end
+    struct ConfirmedEndRefs
+    {
+        std::vector<uintptr_t> addrs;
+
+        ConfirmedEndRefs() = default;
+
+        // Explicit so a braced list is never mistaken for a RefInfo list
+        explicit ConfirmedEndRefs(std::vector<uintptr_t> addrs) :
+            addrs(std::move(addrs))
+        {}
+    };
+
 private:
     static constexpr size_t element_size = sizeof(T); // NOLINT(bugprone-sizeof-expression)
+    // Max distance between the address of an instruction and its pointer operand
+    static constexpr int max_ref_offset = 6;
 
     uintptr_t buf_addr_;
     size_t old_num_elements_;
     size_t new_num_elements_;
     std::vector<RefInfo> refs_;
+    bool discover_refs_ = false;
+    std::vector<uintptr_t> confirmed_end_refs_;
+    const std::vector<uintptr_t>* relocs_ = nullptr;
     std::unique_ptr<std::byte[]> new_buf_owned_;
     T* new_buf_;
+    bool installed_ = false;
 
 public:
+    StaticBufferResizePatch(uintptr_t buf_addr, size_t old_num_elements, size_t new_num_elements,
+        ConfirmedEndRefs end_refs = {}) :
+        buf_addr_(buf_addr), old_num_elements_(old_num_elements), new_num_elements_(new_num_elements),
+        discover_refs_(true), confirmed_end_refs_(std::move(end_refs.addrs)), new_buf_(nullptr)
+    {}
+
+    template<size_t N>
+    StaticBufferResizePatch(uintptr_t buf_addr, size_t old_num_elements, T (&new_buf)[N],
+        ConfirmedEndRefs end_refs = {}) :
+        buf_addr_(buf_addr), old_num_elements_(old_num_elements), new_num_elements_(N),
+        discover_refs_(true), confirmed_end_refs_(std::move(end_refs.addrs)), new_buf_(new_buf)
+    {}
 
     StaticBufferResizePatch(uintptr_t buf_addr, size_t old_num_elements, size_t new_num_elements,
         std::vector<RefInfo>&& refs) :
@@ -45,10 +87,14 @@ public:
         new_num_elements_(N), refs_(refs), new_buf_(new_buf)
     {}
 
+    // Discovers references in another image than the main module (e.g. a DLL). Must be called before install().
+    void set_relocations(const std::vector<uintptr_t>& relocs)
+    {
+        relocs_ = &relocs;
+    }
+
     void install() override
     {
-        constexpr int max_offset = 6;
-        size_t old_buf_size = old_num_elements_ * element_size;
         size_t new_buf_size = new_num_elements_ * element_size;
         if (!new_buf_) {
             // Alloc owned buffer
@@ -58,35 +104,25 @@ public:
             new_buf_ = reinterpret_cast<T*>(new_buf_owned_.get());
         }
 
-        // update all references
-        for (auto& ref : refs_) {
-            int offset;
-            for (offset = 0; offset <= max_offset; ++offset) {
-                auto addr = ref.addr + offset;
-                auto* ptr = reinterpret_cast<void*>(addr);
-                uintptr_t remap_begin_addr;
-                intptr_t remap_new_addr;
-                if (ref.is_end_ref) {
-                    remap_begin_addr = buf_addr_ + old_buf_size;
-                    remap_new_addr = reinterpret_cast<intptr_t>(new_buf_) + new_buf_size;
-                }
-                else {
-                    remap_begin_addr = buf_addr_;
-                    remap_new_addr = reinterpret_cast<intptr_t>(new_buf_);
-                }
-                uintptr_t remap_end_addr = remap_begin_addr + element_size;
-                uintptr_t data;
-                std::memcpy(&data, ptr, sizeof(data));
-                if (data >= remap_begin_addr && data < remap_end_addr) {
-                    data = (data - remap_begin_addr) + remap_new_addr;
-                    write_mem_ptr(addr, reinterpret_cast<void*>(data));
-                    break;
-                }
-            }
-            if (offset == max_offset) {
-                xlog::warn("Invalid reference {:x}", ref.addr);
-            }
+        PatchTransaction transaction;
+        bool staged = discover_refs_ ? stage_discovered_refs(transaction) : stage_listed_refs(transaction);
+        if (!staged) {
+            return;
+        }
+        // Keep elements the program has already stored in the old buffer
+        std::memcpy(static_cast<void*>(new_buf_), reinterpret_cast<const void*>(buf_addr_),
+            old_num_elements_ * element_size);
+        if (!transaction.commit()) {
+            xlog::error("Failed to update references to buffer 0x{:x}", buf_addr_);
+            return;
         }
+        installed_ = true;
+    }
+
+    // False if references could not be updated and the program still uses the old buffer
+    [[nodiscard]] bool is_installed() const
+    {
+        return installed_;
     }
 
     [[nodiscard]] T* get_buffer() const
@@ -98,4 +134,93 @@ public:
     {
         return new_buf_[index];
     }
+
+private:
+    [[nodiscard]] uintptr_t remap(uintptr_t old_addr) const
+    {
+        uintptr_t old_end_addr = buf_addr_ + old_num_elements_ * element_size;
+        uintptr_t new_addr = reinterpret_cast<uintptr_t>(new_buf_);
+        if (old_addr >= old_end_addr) {
+            // Reference past the end (e.g. loop end condition) stays past the end of the new buffer
+            return old_addr - old_end_addr + new_addr + new_num_elements_ * element_size;
+        }
+        return old_addr - buf_addr_ + new_addr;
+    }
+
+    [[nodiscard]] bool is_confirmed_end_ref(uintptr_t ref_addr) const
+    {
+        return std::any_of(confirmed_end_refs_.begin(), confirmed_end_refs_.end(), [=](uintptr_t addr) {
+            return ref_addr >= addr && ref_addr <= addr + max_ref_offset;
+        });
+    }
+
+    bool stage_discovered_refs(PatchTransaction& transaction)
+    {
+        uintptr_t old_end_addr = buf_addr_ + old_num_elements_ * element_size;
+        const auto& relocs = relocs_ ? *relocs_ : get_main_module_relocations();
+        auto refs = find_relocated_refs(relocs, buf_addr_, old_end_addr + element_size);
+        if (refs.empty()) {
+            xlog::warn("No relocated references to buffer 0x{:x} found", buf_addr_);
+            return false;
+        }
+        size_t num_end_refs = 0;
+        size_t num_unconfirmed = 0;
+        for (auto& ref : refs) {
+            if (ref.value < old_end_addr) {
+                continue;
+            }
+            ++num_end_refs;
+            if (!is_confirmed_end_ref(ref.addr)) {
+                ++num_unconfirmed;
+                xlog::warn("Unconfirmed reference to the end of buffer 0x{:x} at 0x{:x} (value 0x{:x})", buf_addr_,
+                    ref.addr, ref.value);
+            }
+        }
+        for (uintptr_t addr : confirmed_end_refs_) {
+            bool found = std::any_of(refs.begin(), refs.end(), [=](const PointerRef& ref) {
+                return ref.value >= old_end_addr && ref.addr >= addr && ref.addr <= addr + max_ref_offset;
+            });
+            if (!found) {
+                xlog::warn("Confirmed end reference 0x{:x} to buffer 0x{:x} not found", addr, buf_addr_);
+            }
+        }
+        if (num_unconfirmed) {
+            xlog::error("Buffer 0x{:x} not resized: {} reference(s) past its end must be confirmed by the caller",
+                buf_addr_, num_unconfirmed);
+            return false;
+        }
+        for (auto& ref : refs) {
+            uintptr_t new_value = remap(ref.value);
+            xlog::debug("  0x{:x}: 0x{:x} -> 0x{:x}{}", ref.addr, ref.value, new_value,
+                ref.value >= old_end_addr ? " (end)" : "");
+            transaction.write<uint32_t>(ref.addr, static_cast<uint32_t>(new_value));
+        }
+        xlog::info("Resizing buffer 0x{:x} from {} to {} elements: {} references ({} past the end)", buf_addr_,
+            old_num_elements_, new_num_elements_, refs.size(), num_end_refs);
+        return true;
+    }
+
+    bool stage_listed_refs(PatchTransaction& transaction)
+    {
+        uintptr_t old_end_addr = buf_addr_ + old_num_elements_ * element_size;
+        for (auto& ref : refs_) {
+            uintptr_t remap_begin_addr = ref.is_end_ref ? old_end_addr : buf_addr_;
+            uintptr_t remap_end_addr = remap_begin_addr + element_size;
+            bool found = false;
+            for (int offset = 0; offset <= max_ref_offset; ++offset) {
+                auto addr = ref.addr + offset;
+                uint32_t data;
+                std::memcpy(&data, reinterpret_cast<void*>(addr), sizeof(data));
+                if (data >= remap_begin_addr && data < remap_end_addr) {
+                    transaction.write<uint32_t>(addr, static_cast<uint32_t>(remap(data)));
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                xlog::warn("Invalid reference {:x}", ref.addr);
+            }
+        }
+        return true;
+    }
 };
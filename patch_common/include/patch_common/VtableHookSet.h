@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Hooks virtual methods of a single object by pointing its vptr to a private copy of the class vtable with some slots
+// replaced. The shared vtable is never modified, so other instances are not affected, no page protection changes are
+// needed and the hooks can be removed by restoring the vptr.
+// Works for COM interfaces and for C++ classes with single inheritance.
+// Note: it is not thread-safe
+class VtableHookSet
+{
+public:
+    // num_slots is the number of virtual methods in the most derived interface used by callers
+    explicit VtableHookSet(size_t num_slots) :
+        m_num_slots(num_slots)
+    {}
+
+    VtableHookSet(const VtableHookSet& other) = delete;
+    VtableHookSet& operator=(const VtableHookSet& other) = delete;
+
+    // Registers a replacement for a slot. The original method is stored in *original_out on every install.
+    void hook(size_t index, void* replacement, void** original_out = nullptr);
+
+    template<typename F>
+    void hook(size_t index, F* replacement, F** original_out = nullptr)
+    {
+        hook(index, reinterpret_cast<void*>(replacement), reinterpret_cast<void**>(original_out));
+    }
+
+    // Builds a shadow vtable from the object's current vtable and swaps its vptr. Installing on an object that already
+    // uses this set is a no-op. Installing on another object leaves the previous one hooked.
+    bool install(void* instance);
+
+    // Restores the vptr of the object passed to the last install. The object must still be alive.
+    void remove();
+
+    [[nodiscard]] bool is_installed_on(const void* instance) const;
+
+private:
+    // Slots before the vtable start (RTTI locator in MSVC ABI, offset-to-top and typeinfo in Itanium ABI)
+    static constexpr size_t num_prefix_slots = 2;
+
+    struct Hook
+    {
+        size_t index;
+        void* replacement;
+        void** original_out;
+    };
+
+    struct Shadow
+    {
+        std::unique_ptr<void*[]> slots;
+        void** original_vtable;
+    };
+
+    size_t m_num_slots;
+    std::vector<Hook> m_hooks;
+    // Shadows are never freed because objects hooked earlier may still use them
+    std::vector<Shadow> m_shadows;
+    void* m_instance = nullptr;
+
+    [[nodiscard]] void** shadow_vtable(const Shadow& shadow) const
+    {
+        return shadow.slots.get() + num_prefix_slots;
+    }
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// Helpers for the host benchmarks. Started with --quick a benchmark runs a small fraction of its iterations, ctest
+// does that so the benchmarks are kept working without slowing the test run down.
+
+namespace bench
+{
+    inline bool g_quick = false;
+
+    inline void init(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--quick") == 0) {
+                g_quick = true;
+            }
+        }
+    }
+
+    inline size_t iterations(size_t full)
+    {
+        return g_quick ? std::max<size_t>(full / 1000, 1) : full;
+    }
+
+    // Returns wall time of fn() in nanoseconds
+    template<typename F>
+    double time_ns(F&& fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    inline void report(const char* name, double total_ns, size_t num_ops)
+    {
+        std::printf("%-48s %12.1f ns/op %10zu ops\n", name, total_ns / static_cast<double>(num_ops), num_ops);
+    }
+
+    // Keeps the compiler from removing a computation whose result is otherwise unused
+    template<typename T>
+    void do_not_optimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+}
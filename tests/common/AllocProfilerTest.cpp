@@ -0,0 +1,226 @@
+#include "../test.h"
+#include <common/utils/alloc-profiler.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    AllocCallsite make_callsite(uintptr_t caller)
+    {
+        AllocCallsite callsite;
+        callsite.frames[0] = caller;
+        callsite.frames[1] = 0x401000;
+        return callsite;
+    }
+
+    AllocEvent alloc_event(uintptr_t ptr, uint32_t size, uint32_t frame, uintptr_t caller)
+    {
+        AllocEvent event;
+        event.type = AllocEventType::alloc;
+        event.size = size;
+        event.frame = frame;
+        event.ptr = ptr;
+        event.callsite = make_callsite(caller);
+        return event;
+    }
+
+    AllocEvent free_event(uintptr_t ptr, uint32_t frame)
+    {
+        AllocEvent event;
+        event.type = AllocEventType::free;
+        event.frame = frame;
+        event.ptr = ptr;
+        return event;
+    }
+
+    const AllocCallsiteStats* find_callsite(const std::vector<AllocCallsiteStats>& stats, uintptr_t caller)
+    {
+        auto it = std::find_if(stats.begin(), stats.end(), [&](const AllocCallsiteStats& s) {
+            return s.callsite == make_callsite(caller);
+        });
+        return it != stats.end() ? &*it : nullptr;
+    }
+
+    std::vector<uintptr_t> top_callers(const AllocProfile& profile, size_t n, AllocSortKey key)
+    {
+        std::vector<uintptr_t> callers;
+        for (const auto& stats : profile.top(n, key)) {
+            callers.push_back(stats.callsite.frames[0]);
+        }
+        return callers;
+    }
+}
+
+TEST_CASE(buffer_keeps_per_producer_order_with_concurrent_drain)
+{
+    constexpr int num_producers = 4;
+    constexpr uint32_t events_per_producer = 20'000;
+    AllocEventBuffer buffer{1024};
+    std::atomic<int> running{num_producers};
+    std::vector<std::thread> producers;
+    std::vector<uint64_t> pushed(num_producers);
+    for (int t = 0; t < num_producers; ++t) {
+        producers.emplace_back([&, t] {
+            for (uint32_t i = 0; i < events_per_producer; ++i) {
+                // Producer in ptr, sequence in size
+                pushed[t] += buffer.push(alloc_event(static_cast<uintptr_t>(t), i, 0, 0x402000)) ? 1 : 0;
+            }
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    std::vector<int64_t> last_seen(num_producers, -1);
+    std::vector<uint64_t> received(num_producers);
+    bool in_order = true;
+    auto consume = [&](const AllocEvent& event) {
+        auto t = static_cast<size_t>(event.ptr);
+        if (t >= num_producers || static_cast<int64_t>(event.size) <= last_seen[t]) {
+            in_order = false;
+            return;
+        }
+        last_seen[t] = event.size;
+        ++received[t];
+    };
+    while (running.load(std::memory_order_acquire)) {
+        buffer.drain(consume);
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    buffer.drain(consume);
+
+    CHECK(in_order);
+    uint64_t total_pushed = 0;
+    for (int t = 0; t < num_producers; ++t) {
+        CHECK(received[t] == pushed[t]);
+        total_pushed += pushed[t];
+    }
+    CHECK(total_pushed + buffer.num_dropped() == num_producers * events_per_producer);
+}
+
+TEST_CASE(buffer_drops_and_counts_events_that_do_not_fit)
+{
+    // Capacity is rounded up to a power of two
+    AllocEventBuffer buffer{6};
+    for (uint32_t i = 0; i < 8; ++i) {
+        CHECK(buffer.push(alloc_event(0x1000, i, 0, 0x402000)));
+    }
+    CHECK(!buffer.push(alloc_event(0x1000, 8, 0, 0x402000)));
+    CHECK(!buffer.push(alloc_event(0x1000, 9, 0, 0x402000)));
+    CHECK(buffer.num_dropped() == 2);
+
+    std::vector<uint32_t> sizes;
+    CHECK(buffer.drain([&](const AllocEvent& event) { sizes.push_back(event.size); }) == 8);
+    CHECK(sizes == (std::vector<uint32_t>{0, 1, 2, 3, 4, 5, 6, 7}));
+
+    // Drained cells are reused
+    CHECK(buffer.push(alloc_event(0x1000, 10, 0, 0x402000)));
+    CHECK(buffer.drain([](const AllocEvent&) {}) == 1);
+    CHECK(buffer.num_dropped() == 2);
+}
+
+TEST_CASE(profile_tracks_allocs_bytes_and_live_blocks_per_callsite)
+{
+    AllocProfile profile;
+    profile.reset(0);
+    profile.add(alloc_event(0x1000, 100, 0, 0x402000));
+    profile.add(alloc_event(0x2000, 50, 0, 0x402000));
+    profile.add(alloc_event(0x3000, 400, 1, 0x403000));
+    profile.add(free_event(0x1000, 3));
+    profile.add(free_event(0x3000, 1));
+
+    auto stats = profile.top(10, AllocSortKey::count);
+    REQUIRE(stats.size() == 2);
+    const auto* a = find_callsite(stats, 0x402000);
+    const auto* b = find_callsite(stats, 0x403000);
+    REQUIRE(a && b);
+    CHECK(a->allocs == 2 && a->bytes == 150 && a->frees == 1);
+    CHECK(a->live_blocks == 1 && a->live_bytes == 50);
+    CHECK(a->lifetimes[AllocProfile::lifetime_bucket(3)] == 1);
+    CHECK(b->allocs == 1 && b->bytes == 400 && b->frees == 1);
+    CHECK(b->live_blocks == 0 && b->live_bytes == 0);
+    CHECK(b->lifetimes[0] == 1);
+
+    profile.add(free_event(0x9000, 4));
+    CHECK(profile.num_untracked_frees() == 1);
+}
+
+TEST_CASE(alloc_at_a_live_address_retires_the_previous_block)
+{
+    AllocProfile profile;
+    profile.reset(0);
+    profile.add(alloc_event(0x1000, 100, 0, 0x402000));
+    // The free of the first block was dropped before the address got reused
+    profile.add(alloc_event(0x1000, 30, 1, 0x403000));
+
+    auto stats = profile.top(10, AllocSortKey::count);
+    const auto* a = find_callsite(stats, 0x402000);
+    const auto* b = find_callsite(stats, 0x403000);
+    REQUIRE(a && b);
+    CHECK(a->allocs == 1 && a->live_blocks == 0 && a->live_bytes == 0 && a->frees == 0);
+    CHECK(b->live_blocks == 1 && b->live_bytes == 30);
+    CHECK(profile.num_untracked_frees() == 1);
+
+    // The free is charged to the block that now owns the address
+    profile.add(free_event(0x1000, 2));
+    stats = profile.top(10, AllocSortKey::count);
+    b = find_callsite(stats, 0x403000);
+    REQUIRE(b);
+    CHECK(b->frees == 1 && b->live_blocks == 0 && b->lifetimes[1] == 1);
+    CHECK(find_callsite(stats, 0x402000)->frees == 0);
+}
+
+TEST_CASE(lifetime_buckets_double_in_size)
+{
+    CHECK(AllocProfile::lifetime_bucket(0) == 0);
+    CHECK(AllocProfile::lifetime_bucket(1) == 1);
+    CHECK(AllocProfile::lifetime_bucket(2) == 2);
+    CHECK(AllocProfile::lifetime_bucket(3) == 2);
+    CHECK(AllocProfile::lifetime_bucket(4) == 3);
+    CHECK(AllocProfile::lifetime_bucket(1023) == num_alloc_lifetime_buckets - 2);
+    CHECK(AllocProfile::lifetime_bucket(1024) == num_alloc_lifetime_buckets - 1);
+    CHECK(AllocProfile::lifetime_bucket(UINT32_MAX) == num_alloc_lifetime_buckets - 1);
+}
+
+TEST_CASE(top_sorts_by_each_key)
+{
+    AllocProfile profile;
+    profile.reset(0);
+    // 0x402000: most allocs, 0x403000: most bytes, 0x404000: most live bytes
+    for (uintptr_t i = 0; i < 5; ++i) {
+        profile.add(alloc_event(0x10000 + i * 0x100, 10, 0, 0x402000));
+        profile.add(free_event(0x10000 + i * 0x100, 1));
+    }
+    for (uintptr_t i = 0; i < 2; ++i) {
+        profile.add(alloc_event(0x20000 + i * 0x1000, 1000, 0, 0x403000));
+        profile.add(free_event(0x20000 + i * 0x1000, 1));
+    }
+    profile.add(alloc_event(0x30000, 500, 0, 0x404000));
+
+    CHECK(top_callers(profile, 3, AllocSortKey::count) == (std::vector<uintptr_t>{0x402000, 0x403000, 0x404000}));
+    CHECK(top_callers(profile, 3, AllocSortKey::bytes) == (std::vector<uintptr_t>{0x403000, 0x404000, 0x402000}));
+    CHECK(top_callers(profile, 1, AllocSortKey::live) == (std::vector<uintptr_t>{0x404000}));
+    CHECK(profile.top(10, AllocSortKey::count).size() == 3);
+}
+
+TEST_CASE(reset_ignores_frees_of_older_blocks)
+{
+    AllocProfile profile;
+    profile.reset(0);
+    profile.add(alloc_event(0x1000, 100, 0, 0x402000));
+    profile.reset(10);
+    CHECK(profile.top(10, AllocSortKey::count).empty());
+
+    profile.add(free_event(0x1000, 11));
+    CHECK(profile.top(10, AllocSortKey::count).empty());
+    CHECK(profile.num_untracked_frees() == 1);
+
+    profile.add(alloc_event(0x1000, 20, 12, 0x403000));
+    auto stats = profile.top(10, AllocSortKey::count);
+    REQUIRE(stats.size() == 1);
+    CHECK(stats[0].allocs == 1 && stats[0].live_bytes == 20);
+    CHECK(profile.num_untracked_frees() == 1);
+}
@@ -0,0 +1,121 @@
+#include "../test.h"
+#include <common/utils/hitch-detector.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t threshold_us = 50'000;
+
+    StackSymbolizer make_symbolizer()
+    {
+        SymbolMap symbols;
+        symbols.add(0x1000, "main");
+        symbols.add(0x2000, "load_level");
+        symbols.add(0x3000, "read_file");
+        symbols.add_section(0x1000, 0x3000);
+        return StackSymbolizer{{{"rf2.exe", 0x400000, 0x10000}}, "rf2.exe", std::move(symbols)};
+    }
+
+    void add_sample(HitchDetector& detector, std::vector<uintptr_t> frames)
+    {
+        detector.add_sample(frames.data(), static_cast<int>(frames.size()));
+    }
+}
+
+TEST_CASE(poll_follows_threshold_and_heartbeat)
+{
+    HitchDetector detector{threshold_us};
+    // Nothing to measure before the first frame
+    CHECK(detector.poll(1'000'000) == HitchDetector::PollResult::idle);
+
+    detector.beat(1'000);
+    CHECK(detector.poll(1'000 + threshold_us - 1) == HitchDetector::PollResult::idle);
+    // A heartbeat newer than the poll time is not a stall
+    CHECK(detector.poll(500) == HitchDetector::PollResult::idle);
+    CHECK(detector.poll(1'000 + threshold_us) == HitchDetector::PollResult::stall_started);
+    CHECK(detector.poll(1'000 + 2 * threshold_us) == HitchDetector::PollResult::stalled);
+
+    detector.beat(200'000);
+    CHECK(detector.poll(200'100) == HitchDetector::PollResult::stall_ended);
+    CHECK(detector.stall_us() == 199'000);
+    CHECK(detector.poll(200'200) == HitchDetector::PollResult::idle);
+
+    // Disabled detection ignores old heartbeats, and re-enabling it picks them up again
+    detector.set_threshold_us(0);
+    CHECK(detector.poll(1'000'000) == HitchDetector::PollResult::idle);
+    detector.set_threshold_us(threshold_us);
+    CHECK(detector.poll(1'000'000) == HitchDetector::PollResult::stall_started);
+    detector.cancel_stall();
+    CHECK(detector.poll(1'000'000) == HitchDetector::PollResult::stall_started);
+}
+
+TEST_CASE(samples_are_capped_and_reset_by_a_new_stall)
+{
+    HitchDetector detector{threshold_us};
+    detector.beat(1'000);
+    REQUIRE(detector.poll(1'000 + threshold_us) == HitchDetector::PollResult::stall_started);
+
+    uintptr_t frames[max_sampled_stack_depth + 8] = {};
+    for (int i = 0; i < HitchDetector::max_samples; ++i) {
+        CHECK(detector.add_sample(frames, static_cast<int>(std::size(frames))));
+    }
+    CHECK(!detector.add_sample(frames, 1));
+    CHECK(detector.num_samples() == HitchDetector::max_samples);
+
+    detector.beat(100'000);
+    REQUIRE(detector.poll(100'100) == HitchDetector::PollResult::stall_ended);
+    REQUIRE(detector.poll(100'000 + threshold_us) == HitchDetector::PollResult::stall_started);
+    CHECK(detector.num_samples() == 0);
+}
+
+TEST_CASE(report_attributes_the_stall_to_the_longest_phase)
+{
+    HitchDetector detector{threshold_us};
+    // Previous frame
+    detector.beat(1'000);
+    detector.mark_phase("update", 1'000);
+    detector.mark_phase("render", 5'000);
+    // Stalled frame
+    detector.beat(10'000);
+    detector.mark_phase("update", 10'000);
+    REQUIRE(detector.poll(10'000 + threshold_us) == HitchDetector::PollResult::stall_started);
+    add_sample(detector, {0x402000, 0x401000});
+    add_sample(detector, {0x403000, 0x402000, 0x401000});
+    add_sample(detector, {0x402000, 0x401000});
+    detector.mark_phase("load_level", 12'000);
+    detector.mark_phase("render", 90'000);
+    detector.beat(100'000);
+    // The next frame has started by the time the monitor notices and must not show up in the report
+    detector.mark_phase("update", 100'000);
+    REQUIRE(detector.poll(100'500) == HitchDetector::PollResult::stall_ended);
+
+    auto lines = detector.format_report(make_symbolizer());
+    REQUIRE(lines.size() == 4);
+    CHECK(lines[0] == "Hitch: frame took 90.0 ms (threshold 50.0 ms), 78.0 ms in load_level");
+    CHECK(lines[1] == "Phases (ms): update 4.0, render 5.0 | update 2.0, load_level 78.0, render 10.0");
+    CHECK(lines[2] == "Stack 2/3: load_level <- main");
+    CHECK(lines[3] == "Stack 1/3: read_file <- load_level <- main");
+}
+
+TEST_CASE(report_keeps_only_the_newest_marks_after_the_ring_wraps)
+{
+    HitchDetector detector{threshold_us};
+    detector.beat(1'000);
+    REQUIRE(detector.poll(1'000 + threshold_us) == HitchDetector::PollResult::stall_started);
+    // One more mark than the ring holds in the stalled frame, so its boundary has been overwritten
+    for (int i = 0; i < HitchDetector::phase_ring_size; ++i) {
+        detector.mark_phase(i % 2 ? "odd" : "even", 2'000 + static_cast<uint64_t>(i) * 1'000);
+    }
+    detector.beat(100'000);
+    REQUIRE(detector.poll(100'100) == HitchDetector::PollResult::stall_ended);
+
+    auto lines = detector.format_report(make_symbolizer());
+    REQUIRE(lines.size() == 3);
+    CHECK(lines[0] == "Hitch: frame took 99.0 ms (threshold 50.0 ms), 35.0 ms in odd");
+    // The report is limited to the newest phases, all of them from the stalled frame
+    CHECK(lines[1].find('|') == std::string::npos);
+    CHECK(lines[1].ends_with(", even 1.0, odd 35.0"));
+    CHECK(lines[2] == "No stack samples");
+}
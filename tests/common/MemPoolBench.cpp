@@ -0,0 +1,128 @@
+#include "../bench.h"
+#include <common/utils/mem-pool.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Compares MemPool and ConcurrentMemPool with new/delete for a 64 byte object: an allocation freed right away, a batch
+// freed in random order (like particles or sounds expiring out of order) and allocations on several threads freed by
+// another thread.
+
+namespace
+{
+    struct Object
+    {
+        uint64_t fields[8];
+
+        explicit Object(uint64_t value)
+        {
+            std::fill(std::begin(fields), std::end(fields), value);
+        }
+    };
+
+    constexpr size_t page_slots = 1024;
+    constexpr size_t batch_size = 4096;
+
+    struct NewDelete
+    {
+        using Pointer = std::unique_ptr<Object>;
+
+        Pointer alloc(uint64_t value)
+        {
+            return std::make_unique<Object>(value);
+        }
+    };
+
+    template<typename Allocator>
+    void run_single_thread(const char* label, Allocator& allocator, size_t n)
+    {
+        char name[64];
+
+        std::snprintf(name, sizeof(name), "%s: alloc + free", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                auto p = allocator.alloc(i);
+                bench::do_not_optimize(p->fields[0]);
+            }
+        }), n);
+
+        // Same shuffled order for every allocator
+        std::vector<size_t> order(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937{42});
+        std::vector<typename Allocator::Pointer> live;
+        live.reserve(batch_size);
+        const size_t rounds = std::max<size_t>(n / batch_size, 1);
+
+        std::snprintf(name, sizeof(name), "%s: batch, random free order", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < batch_size; ++i) {
+                    live.push_back(allocator.alloc(i));
+                }
+                for (size_t i : order) {
+                    live[i].reset();
+                }
+                live.clear();
+            }
+        }), rounds * batch_size);
+    }
+
+    // Producers allocate, the main thread frees, like work items handed to another thread
+    template<typename Allocator>
+    void run_cross_thread(const char* label, Allocator& allocator, size_t n, int num_threads)
+    {
+        const size_t per_thread = std::max<size_t>(n / static_cast<size_t>(num_threads) / batch_size, 1) * batch_size;
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s: %d threads, freed by another", label, num_threads);
+        bench::report(name, bench::time_ns([&] {
+            std::vector<std::vector<typename Allocator::Pointer>> batches(static_cast<size_t>(num_threads));
+            for (size_t done = 0; done < per_thread; done += batch_size) {
+                std::vector<std::thread> threads;
+                for (int t = 0; t < num_threads; ++t) {
+                    threads.emplace_back([&, t] {
+                        auto& batch = batches[static_cast<size_t>(t)];
+                        for (size_t i = 0; i < batch_size; ++i) {
+                            batch.push_back(allocator.alloc(i));
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                for (auto& batch : batches) {
+                    batch.clear();
+                }
+            }
+        }), per_thread * static_cast<size_t>(num_threads));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(4'000'000);
+
+    NewDelete new_delete;
+    MemPool<Object, page_slots> pool;
+    auto concurrent_pool = std::make_unique<ConcurrentMemPool<Object, page_slots, 64>>();
+
+    run_single_thread("new/delete", new_delete, n);
+    run_single_thread("MemPool", pool, n);
+    run_single_thread("ConcurrentMemPool", *concurrent_pool, n);
+    std::printf("\n");
+
+    run_cross_thread("new/delete", new_delete, n, 4);
+    run_cross_thread("ConcurrentMemPool", *concurrent_pool, n, 4);
+
+    auto stats = concurrent_pool->stats();
+    std::printf("ConcurrentMemPool: %zu slots, high water %zu, %zu in use\n", stats.capacity, stats.high_water,
+        stats.in_use);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "../bench.h"
+#include <common/utils/perf-trace.h>
+#include <common/utils/perf-utils.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Overhead of a PERF_ZONE around an almost empty body: alone, nested, on several threads at once and while a trace is
+// recording. The loop without a zone is the baseline.
+
+namespace
+{
+    uint64_t g_sink = 0;
+
+    void work(uint64_t i)
+    {
+        g_sink += i;
+        bench::do_not_optimize(g_sink);
+    }
+
+    void zoned_work(uint64_t i)
+    {
+        PERF_ZONE("bench_zone");
+        work(i);
+    }
+
+    void nested_zoned_work(uint64_t i)
+    {
+        PERF_ZONE("bench_outer_zone");
+        zoned_work(i);
+    }
+
+    double run_loop(size_t n, void (*fn)(uint64_t))
+    {
+        return bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                fn(i);
+            }
+        });
+    }
+
+    double run_threads(size_t n, int num_threads)
+    {
+        return bench::time_ns([&] {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; ++t) {
+                threads.emplace_back([n] {
+                    for (size_t i = 0; i < n; ++i) {
+                        PERF_ZONE("bench_thread_zone");
+                        bench::do_not_optimize(i);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(20'000'000);
+
+    // First record registers the thread, keep it out of the measurement
+    zoned_work(0);
+    nested_zoned_work(0);
+
+    const double baseline_ns = run_loop(n, work);
+    bench::report("no zone", baseline_ns, n);
+    const double zone_ns = run_loop(n, zoned_work);
+    bench::report("zone", zone_ns, n);
+    bench::report("nested zones (2 per call)", run_loop(n, nested_zoned_work), n);
+
+    constexpr int num_threads = 4;
+    bench::report("zone on 4 threads (per zone, wall time)", run_threads(n, num_threads), n * num_threads);
+
+    // Rings fill up quickly when nothing is slow enough to drain them, so this also covers the drop path
+    const std::string trace_path = "perf-zone-bench-trace.json";
+    if (perf_trace_start(trace_path)) {
+        bench::report("zone with trace recording", run_loop(n, zoned_work), n);
+        PerfTraceResult result;
+        perf_trace_stop(&result);
+        std::printf("trace: %llu event(s) written, %llu dropped\n",
+            static_cast<unsigned long long>(result.events_written),
+            static_cast<unsigned long long>(result.events_dropped));
+        std::remove(trace_path.c_str());
+    }
+
+    perf_end_frame();
+    PerfReport report = perf_get_report();
+    std::printf("zone overhead: %.1f ns per zone, %u zone(s) registered\n",
+        (zone_ns - baseline_ns) / static_cast<double>(n), static_cast<unsigned>(report.zones.size()));
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "../bench.h"
+#include <common/utils/sha.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// Throughput of SHA-1 and SHA-256 with the portable code and the CPU extensions, then hashing a file by mapping it
+// compared with reading it in 16 KiB pieces like the launcher did before.
+
+namespace
+{
+    void report_throughput(const char* label, double ns, size_t bytes)
+    {
+        std::printf("%-48s %9.0f MB/s\n", label, static_cast<double>(bytes) * 1e3 / ns);
+    }
+
+    void run_memory(const char* label, ShaAlgorithm algorithm, bool allow_cpu_extensions,
+        const std::vector<uint8_t>& data)
+    {
+        ShaHasher hasher{algorithm, allow_cpu_extensions};
+        double ns = bench::time_ns([&] {
+            hasher.reset();
+            hasher.update(data.data(), data.size());
+            bench::do_not_optimize(hasher.finish());
+        });
+        report_throughput(label, ns, data.size());
+    }
+
+    std::vector<uint8_t> hash_file_with_reads(const std::filesystem::path& path, ShaAlgorithm algorithm)
+    {
+        ShaHasher hasher{algorithm};
+        std::ifstream file{path, std::ios::binary};
+        auto buf = std::make_unique<char[]>(16 * 1024);
+        while (file.read(buf.get(), 16 * 1024) || file.gcount()) {
+            hasher.update(buf.get(), static_cast<size_t>(file.gcount()));
+        }
+        return hasher.finish();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    // Roughly the size of rf2.exe and its data in the full run
+    const size_t size = std::max<size_t>(bench::iterations(80'000'000), 1024 * 1024);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+    }
+
+    run_memory("SHA-1, portable", ShaAlgorithm::sha1, false, data);
+    run_memory("SHA-256, portable", ShaAlgorithm::sha256, false, data);
+    if (sha_cpu_extensions_supported()) {
+        run_memory("SHA-1, SHA extensions", ShaAlgorithm::sha1, true, data);
+        run_memory("SHA-256, SHA extensions", ShaAlgorithm::sha256, true, data);
+    }
+    else {
+        std::printf("SHA extensions not supported by this CPU\n");
+    }
+    std::printf("\n");
+
+    auto path = std::filesystem::temp_directory_path() / "sopot-sha-bench.bin";
+    std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char*>(data.data()),
+        static_cast<std::streamsize>(data.size()));
+    // Warms the page cache so both variants read cached data
+    bench::do_not_optimize(sha_hash_file_hex(path.string(), ShaAlgorithm::sha1));
+    report_throughput("SHA-1 file, mapped", bench::time_ns([&] {
+        bench::do_not_optimize(sha_hash_file_hex(path.string(), ShaAlgorithm::sha1));
+    }), size);
+    report_throughput("SHA-1 file, 16 KiB reads", bench::time_ns([&] {
+        bench::do_not_optimize(hash_file_with_reads(path, ShaAlgorithm::sha1));
+    }), size);
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "../test.h"
+#include <common/utils/sha.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct KnownDigest
+    {
+        std::string message;
+        const char* sha1;
+        const char* sha256;
+    };
+
+    // FIPS 180 examples
+    const KnownDigest g_known_digests[] = {
+        {"", "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d",
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {std::string(1'000'000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+    };
+
+    std::string hash_hex(ShaAlgorithm algorithm, bool allow_cpu_extensions, const void* data, size_t size)
+    {
+        ShaHasher hasher{algorithm, allow_cpu_extensions};
+        hasher.update(data, size);
+        return sha_digest_to_hex(hasher.finish());
+    }
+
+    std::vector<uint8_t> random_bytes(size_t size, unsigned seed)
+    {
+        std::mt19937 rng{seed};
+        std::vector<uint8_t> data(size);
+        for (auto& byte : data) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        return data;
+    }
+}
+
+TEST_CASE(known_digests_match_with_and_without_cpu_extensions)
+{
+    for (bool allow_cpu_extensions : {false, true}) {
+        for (const auto& known : g_known_digests) {
+            const auto& m = known.message;
+            CHECK(hash_hex(ShaAlgorithm::sha1, allow_cpu_extensions, m.data(), m.size()) == known.sha1);
+            CHECK(hash_hex(ShaAlgorithm::sha256, allow_cpu_extensions, m.data(), m.size()) == known.sha256);
+        }
+    }
+    CHECK(!ShaHasher{ShaAlgorithm::sha1, false}.uses_cpu_extensions());
+    CHECK(ShaHasher{ShaAlgorithm::sha256, true}.uses_cpu_extensions() == sha_cpu_extensions_supported());
+}
+
+// Every length around the block and padding boundaries, fed in random pieces, gives the same digest on both paths
+TEST_CASE(split_updates_and_both_paths_agree)
+{
+    auto data = random_bytes(1100, 1);
+    std::mt19937 rng{2};
+    for (auto algorithm : {ShaAlgorithm::sha1, ShaAlgorithm::sha256}) {
+        ShaHasher portable{algorithm, false};
+        ShaHasher split{algorithm, true};
+        for (size_t size = 0; size <= data.size(); ++size) {
+            portable.reset();
+            portable.update(data.data(), size);
+            auto expected = portable.finish();
+            REQUIRE(expected.size() == portable.digest_size());
+
+            split.reset();
+            size_t pos = 0;
+            while (pos < size) {
+                size_t piece = std::min<size_t>(rng() % 150, size - pos);
+                split.update(data.data() + pos, piece);
+                pos += piece;
+            }
+            REQUIRE(split.finish() == expected);
+        }
+    }
+}
+
+TEST_CASE(files_are_hashed_across_map_windows)
+{
+    auto dir = std::filesystem::temp_directory_path() / "sopot-sha-test";
+    std::filesystem::create_directories(dir);
+
+    // Bigger than one 32 MiB window and not a multiple of the block size
+    auto data = random_bytes(40 * 1024 * 1024 + 123, 3);
+    auto path = dir / "data.bin";
+    std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char*>(data.data()),
+        static_cast<std::streamsize>(data.size()));
+    for (auto algorithm : {ShaAlgorithm::sha1, ShaAlgorithm::sha256}) {
+        CHECK(sha_hash_file_hex(path.string(), algorithm) == hash_hex(algorithm, false, data.data(), data.size()));
+    }
+
+    auto empty_path = dir / "empty.bin";
+    std::ofstream{empty_path, std::ios::binary};
+    CHECK(sha_hash_file_hex(empty_path.string(), ShaAlgorithm::sha1) == g_known_digests[0].sha1);
+
+    CHECK(!sha_hash_file_hex((dir / "missing.bin").string(), ShaAlgorithm::sha1));
+    std::filesystem::remove_all(dir);
+}
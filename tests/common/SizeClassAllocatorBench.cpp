@@ -0,0 +1,392 @@
+#include "../bench.h"
+#include <common/utils/size-class-allocator.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Compares SizeClassAllocator with malloc/free: random small sizes freed right away and in random order, several
+// threads at once, memory overhead after a fragmenting workload and the replay of an allocation trace.
+//
+// The trace is synthetic unless a file is passed with --trace <path>. Each line of the file is one operation:
+//   a <id> <size>   allocation
+//   r <id> <size>   reallocation
+//   f <id>          free
+// Ids name live blocks and may be reused after a free.
+
+namespace
+{
+    struct Malloc
+    {
+        void* allocate(size_t size)
+        {
+            return std::malloc(size);
+        }
+
+        void deallocate(void* ptr)
+        {
+            std::free(ptr);
+        }
+
+        void* reallocate(void* ptr, size_t size)
+        {
+            return std::realloc(ptr, size);
+        }
+    };
+
+    // Same fallback as the heap hooks: sizes above max_small_size go to the system allocator
+    struct SizeClass
+    {
+        std::unique_ptr<SizeClassAllocator> allocator = std::make_unique<SizeClassAllocator>();
+
+        void* allocate(size_t size)
+        {
+            void* ptr = allocator->allocate(size);
+            return ptr ? ptr : std::malloc(size);
+        }
+
+        void deallocate(void* ptr)
+        {
+            if (allocator->owns(ptr)) {
+                allocator->deallocate(ptr);
+            }
+            else {
+                std::free(ptr);
+            }
+        }
+
+        void* reallocate(void* ptr, size_t size)
+        {
+            if (!ptr || !allocator->owns(ptr)) {
+                return std::realloc(ptr, size);
+            }
+            if (allocator->resize_in_place(ptr, size)) {
+                return ptr;
+            }
+            void* new_ptr = allocate(size);
+            std::memcpy(new_ptr, ptr, std::min(allocator->requested_size(ptr), size));
+            allocator->deallocate(ptr);
+            return new_ptr;
+        }
+    };
+
+    // Mostly small sizes with an occasional large block, like the heap traffic of the game
+    size_t random_size(std::mt19937& rng)
+    {
+        unsigned k = rng() % 10;
+        if (k < 6) {
+            return 1 + rng() % 128;
+        }
+        if (k < 9) {
+            return 129 + rng() % 896;
+        }
+        return 1025 + rng() % (SizeClassAllocator::max_small_size - 1024);
+    }
+
+    std::vector<size_t> random_sizes(size_t n, unsigned seed)
+    {
+        std::mt19937 rng{seed};
+        std::vector<size_t> sizes(n);
+        for (auto& size : sizes) {
+            size = random_size(rng);
+        }
+        return sizes;
+    }
+
+    template<typename Allocator>
+    void run_single_thread(const char* label, Allocator& allocator, size_t n)
+    {
+        char name[64];
+        const auto sizes = random_sizes(4096, 1);
+
+        std::snprintf(name, sizeof(name), "%s: alloc + free", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                void* ptr = allocator.allocate(sizes[i % sizes.size()]);
+                bench::do_not_optimize(ptr);
+                allocator.deallocate(ptr);
+            }
+        }), n);
+
+        std::vector<size_t> order(sizes.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937{2});
+        std::vector<void*> live(sizes.size());
+        const size_t rounds = std::max<size_t>(n / sizes.size(), 1);
+
+        std::snprintf(name, sizeof(name), "%s: batch, random free order", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < sizes.size(); ++i) {
+                    live[i] = allocator.allocate(sizes[i]);
+                }
+                for (size_t i : order) {
+                    allocator.deallocate(live[i]);
+                }
+            }
+        }), rounds * sizes.size());
+    }
+
+    template<typename Allocator>
+    void run_threads(const char* label, Allocator& allocator, size_t n, int num_threads)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s: %d threads, alloc + free", label, num_threads);
+        bench::report(name, bench::time_ns([&] {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; ++t) {
+                threads.emplace_back([&allocator, n, t] {
+                    const auto sizes = random_sizes(1024, static_cast<unsigned>(t + 10));
+                    std::vector<void*> live(64);
+                    for (size_t i = 0; i < n; ++i) {
+                        auto& slot = live[i % live.size()];
+                        if (slot) {
+                            allocator.deallocate(slot);
+                        }
+                        slot = allocator.allocate(sizes[i % sizes.size()]);
+                    }
+                    for (void* ptr : live) {
+                        allocator.deallocate(ptr);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }), n * static_cast<size_t>(num_threads));
+    }
+
+    // Loads a level worth of blocks, frees most of them in random order and loads the next level with a different mix
+    // of sizes. Memory of freed spans stays with their size class so the spans in use grow beyond the live bytes.
+    void run_fragmentation(size_t n)
+    {
+        SizeClassAllocator allocator;
+        std::mt19937 rng{3};
+        std::vector<std::pair<void*, size_t>> live;
+        size_t live_bytes = 0;
+
+        auto load_level = [&](size_t count, size_t min_size, size_t max_size) {
+            for (size_t i = 0; i < count; ++i) {
+                size_t size = min_size + rng() % (max_size - min_size + 1);
+                live.emplace_back(allocator.allocate(size), size);
+                live_bytes += size;
+            }
+        };
+        auto unload_level = [&](unsigned keep_percent) {
+            std::shuffle(live.begin(), live.end(), rng);
+            size_t keep = live.size() * keep_percent / 100;
+            for (size_t i = keep; i < live.size(); ++i) {
+                allocator.deallocate(live[i].first);
+                live_bytes -= live[i].second;
+            }
+            live.resize(keep);
+        };
+        auto report = [&](const char* phase) {
+            size_t span_bytes = allocator.stats().span_bytes;
+            std::printf("fragmentation, %-33s live %8.2f MiB spans %8.2f MiB overhead %5.1f%%\n", phase,
+                static_cast<double>(live_bytes) / (1024 * 1024), static_cast<double>(span_bytes) / (1024 * 1024),
+                live_bytes ? 100.0 * (static_cast<double>(span_bytes) / static_cast<double>(live_bytes) - 1.0) : 0.0);
+        };
+
+        load_level(n, 1, 256);
+        report("level 1 loaded (small blocks)");
+        unload_level(10);
+        report("level 1 unloaded (10% kept)");
+        load_level(n / 32, 512, SizeClassAllocator::max_small_size);
+        report("level 2 loaded (large blocks)");
+        unload_level(10);
+        load_level(n, 1, 256);
+        report("level 3 loaded (small blocks)");
+
+        for (const auto& [ptr, size] : live) {
+            allocator.deallocate(ptr);
+        }
+    }
+
+    struct TraceOp
+    {
+        char kind;
+        uint32_t id;
+        uint32_t size;
+    };
+
+    // Frames allocate temporaries that die within the frame and objects that live for a random number of frames.
+    // Every 500 frames a level load allocates a burst of long lived blocks and frees the ones of the previous level.
+    std::vector<TraceOp> make_synthetic_trace(size_t num_frames)
+    {
+        std::mt19937 rng{4};
+        std::vector<TraceOp> ops;
+        std::vector<uint32_t> free_ids;
+        uint32_t next_id = 0;
+        auto new_id = [&] {
+            if (free_ids.empty()) {
+                return next_id++;
+            }
+            uint32_t id = free_ids.back();
+            free_ids.pop_back();
+            return id;
+        };
+        auto free_id = [&](uint32_t id) {
+            ops.push_back({'f', id, 0});
+            free_ids.push_back(id);
+        };
+
+        std::vector<uint32_t> level_blocks;
+        // Objects expiring at a frame, indexed by frame % size
+        std::vector<std::vector<uint32_t>> expiring(64);
+        std::vector<uint32_t> temporaries;
+        for (size_t frame = 0; frame < num_frames; ++frame) {
+            if (frame % 500 == 0) {
+                for (uint32_t id : level_blocks) {
+                    free_id(id);
+                }
+                level_blocks.clear();
+                for (int i = 0; i < 5000; ++i) {
+                    uint32_t id = new_id();
+                    ops.push_back({'a', id, static_cast<uint32_t>(random_size(rng))});
+                    level_blocks.push_back(id);
+                }
+            }
+            for (int i = 0; i < 40; ++i) {
+                uint32_t id = new_id();
+                ops.push_back({'a', id, static_cast<uint32_t>(1 + rng() % 256)});
+                temporaries.push_back(id);
+            }
+            // Strings and arrays that grow
+            for (int i = 0; i < 4; ++i) {
+                ops.push_back({'r', temporaries[rng() % temporaries.size()], static_cast<uint32_t>(64 + rng() % 1024)});
+            }
+            for (int i = 0; i < 5; ++i) {
+                uint32_t id = new_id();
+                ops.push_back({'a', id, static_cast<uint32_t>(random_size(rng))});
+                expiring[(frame + 1 + rng() % 63) % expiring.size()].push_back(id);
+            }
+            for (uint32_t id : expiring[frame % expiring.size()]) {
+                free_id(id);
+            }
+            expiring[frame % expiring.size()].clear();
+            for (uint32_t id : temporaries) {
+                free_id(id);
+            }
+            temporaries.clear();
+        }
+        for (uint32_t id : level_blocks) {
+            free_id(id);
+        }
+        for (auto& ids : expiring) {
+            for (uint32_t id : ids) {
+                free_id(id);
+            }
+        }
+        return ops;
+    }
+
+    bool load_trace(const char* path, std::vector<TraceOp>& out_ops)
+    {
+        std::ifstream file{path};
+        if (!file) {
+            return false;
+        }
+        std::unordered_map<uint64_t, uint32_t> ids;
+        auto map_id = [&](uint64_t id) {
+            return ids.try_emplace(id, static_cast<uint32_t>(ids.size())).first->second;
+        };
+        char kind = 0;
+        while (file >> kind) {
+            uint64_t id = 0;
+            size_t size = 0;
+            file >> id;
+            if (kind != 'f') {
+                file >> size;
+            }
+            if (!file || (kind != 'a' && kind != 'r' && kind != 'f')) {
+                return false;
+            }
+            out_ops.push_back({kind, map_id(id), static_cast<uint32_t>(size)});
+        }
+        return true;
+    }
+
+    template<typename Allocator>
+    void replay_trace(const char* label, Allocator& allocator, const std::vector<TraceOp>& ops)
+    {
+        uint32_t max_id = 0;
+        for (const auto& op : ops) {
+            max_id = std::max(max_id, op.id);
+        }
+        std::vector<void*> blocks(max_id + 1, nullptr);
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s: trace replay", label);
+        bench::report(name, bench::time_ns([&] {
+            for (const auto& op : ops) {
+                void*& block = blocks[op.id];
+                if (op.kind == 'a') {
+                    block = allocator.allocate(op.size);
+                }
+                else if (op.kind == 'r') {
+                    block = allocator.reallocate(block, op.size);
+                }
+                else {
+                    allocator.deallocate(block);
+                    block = nullptr;
+                }
+            }
+        }), ops.size());
+        // Blocks left live by a trace that was cut off
+        for (void* block : blocks) {
+            if (block) {
+                allocator.deallocate(block);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(4'000'000);
+
+    Malloc malloc_allocator;
+    SizeClass size_class_allocator;
+
+    run_single_thread("malloc/free", malloc_allocator, n);
+    run_single_thread("SizeClassAllocator", size_class_allocator, n);
+    std::printf("\n");
+
+    run_threads("malloc/free", malloc_allocator, n / 4, 4);
+    run_threads("SizeClassAllocator", size_class_allocator, n / 4, 4);
+    std::printf("\n");
+
+    run_fragmentation(bench::iterations(500'000));
+    std::printf("\n");
+
+    std::vector<TraceOp> trace;
+    const char* trace_path = nullptr;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--trace") == 0) {
+            trace_path = argv[i + 1];
+        }
+    }
+    if (trace_path) {
+        if (!load_trace(trace_path, trace)) {
+            std::fprintf(stderr, "Cannot read trace %s\n", trace_path);
+            return 1;
+        }
+    }
+    else {
+        trace = make_synthetic_trace(bench::iterations(20'000));
+    }
+    replay_trace("malloc/free", malloc_allocator, trace);
+    replay_trace("SizeClassAllocator", size_class_allocator, trace);
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include "../test.h"
+#include <common/utils/size-class-allocator.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Block
+    {
+        uint8_t* ptr;
+        size_t size;
+        uint8_t pattern;
+    };
+
+    Block make_block(SizeClassAllocator& allocator, size_t size, uint8_t pattern)
+    {
+        auto* ptr = static_cast<uint8_t*>(allocator.allocate(size));
+        if (ptr) {
+            std::memset(ptr, pattern, size);
+        }
+        return {ptr, size, pattern};
+    }
+
+    bool block_is_intact(const SizeClassAllocator& allocator, const Block& block)
+    {
+        if (allocator.requested_size(block.ptr) != block.size) {
+            return false;
+        }
+        for (size_t i = 0; i < block.size; ++i) {
+            if (block.ptr[i] != block.pattern) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Mostly small sizes like the game's heap traffic with an occasional large block
+    size_t random_size(std::mt19937& rng)
+    {
+        std::uniform_int_distribution<int> kind{0, 9};
+        int k = kind(rng);
+        if (k < 6) {
+            return std::uniform_int_distribution<size_t>{1, 128}(rng);
+        }
+        if (k < 9) {
+            return std::uniform_int_distribution<size_t>{129, 1024}(rng);
+        }
+        return std::uniform_int_distribution<size_t>{1025, SizeClassAllocator::max_small_size}(rng);
+    }
+}
+
+TEST_CASE(size_classes_cover_all_small_sizes)
+{
+    CHECK(SizeClassAllocator::size_class_of(0) == 0);
+    CHECK(SizeClassAllocator::size_class_of(SizeClassAllocator::max_small_size + 1) == -1);
+    CHECK(SizeClassAllocator::size_class_of(SizeClassAllocator::max_small_size) == SizeClassAllocator::num_classes - 1);
+    for (size_t size = 1; size <= SizeClassAllocator::max_small_size; ++size) {
+        int size_class = SizeClassAllocator::size_class_of(size);
+        REQUIRE(size_class >= 0 && size_class < SizeClassAllocator::num_classes);
+        // Smallest class that fits
+        REQUIRE(SizeClassAllocator::class_size(size_class) >= size);
+        REQUIRE(size_class == 0 || SizeClassAllocator::class_size(size_class - 1) < size);
+    }
+    for (int size_class = 0; size_class < SizeClassAllocator::num_classes; ++size_class) {
+        // The requested size table fits after the blocks
+        size_t blocks = SizeClassAllocator::blocks_per_span(size_class);
+        CHECK(blocks >= 1);
+        CHECK(blocks * (SizeClassAllocator::class_size(size_class) + sizeof(uint16_t)) <= SizeClassAllocator::span_size);
+    }
+}
+
+TEST_CASE(blocks_are_owned_and_keep_requested_size)
+{
+    SizeClassAllocator allocator;
+    CHECK(allocator.allocate(SizeClassAllocator::max_small_size + 1) == nullptr);
+
+    std::vector<Block> blocks;
+    for (size_t size : {size_t{0}, size_t{1}, size_t{16}, size_t{17}, size_t{100}, size_t{129}, size_t{5000},
+             SizeClassAllocator::max_small_size}) {
+        Block block = make_block(allocator, size, static_cast<uint8_t>(size));
+        REQUIRE(block.ptr);
+        CHECK(reinterpret_cast<uintptr_t>(block.ptr) % 16 == 0);
+        CHECK(allocator.owns(block.ptr));
+        CHECK(allocator.usable_size(block.ptr) == SizeClassAllocator::class_size(SizeClassAllocator::size_class_of(size)));
+        blocks.push_back(block);
+    }
+    for (const auto& block : blocks) {
+        CHECK(block_is_intact(allocator, block));
+        allocator.deallocate(block.ptr);
+    }
+
+    // Foreign pointers
+    int local = 0;
+    auto heap_block = std::make_unique<int>(0);
+    CHECK(!allocator.owns(&local));
+    CHECK(!allocator.owns(heap_block.get()));
+    CHECK(!allocator.owns(nullptr));
+
+    // Blocks of another instance are not owned even on the same thread
+    SizeClassAllocator other;
+    void* other_ptr = other.allocate(32);
+    CHECK(other.owns(other_ptr));
+    CHECK(!allocator.owns(other_ptr));
+    other.deallocate(other_ptr);
+}
+
+TEST_CASE(full_blocks_do_not_overwrite_requested_sizes)
+{
+    SizeClassAllocator allocator;
+    for (size_t size : {size_t{16}, size_t{48}, size_t{640}, SizeClassAllocator::max_small_size}) {
+        // Fill more than one span so the last block of a span is written up to its end
+        size_t count = SizeClassAllocator::blocks_per_span(SizeClassAllocator::size_class_of(size)) + 8;
+        std::vector<Block> blocks;
+        for (size_t i = 0; i < count; ++i) {
+            auto pattern = static_cast<uint8_t>(i);
+            Block block = make_block(allocator, size, pattern);
+            REQUIRE(block.ptr);
+            blocks.push_back(block);
+        }
+        for (const auto& block : blocks) {
+            CHECK(block_is_intact(allocator, block));
+            allocator.deallocate(block.ptr);
+        }
+    }
+}
+
+TEST_CASE(blocks_are_resized_in_place_within_their_class)
+{
+    SizeClassAllocator allocator;
+    void* ptr = allocator.allocate(20);
+    REQUIRE(ptr);
+    CHECK(allocator.requested_size(ptr) == 20);
+    CHECK(allocator.resize_in_place(ptr, 32));
+    CHECK(allocator.requested_size(ptr) == 32);
+    CHECK(allocator.resize_in_place(ptr, 17));
+    CHECK(allocator.requested_size(ptr) == 17);
+    // Other classes
+    CHECK(!allocator.resize_in_place(ptr, 33));
+    CHECK(!allocator.resize_in_place(ptr, 16));
+    CHECK(!allocator.resize_in_place(ptr, SizeClassAllocator::max_small_size + 1));
+    CHECK(allocator.requested_size(ptr) == 17);
+    allocator.deallocate(ptr);
+}
+
+TEST_CASE(freed_blocks_are_reused_and_counted)
+{
+    SizeClassAllocator allocator;
+    void* first = allocator.allocate(64);
+    allocator.deallocate(first);
+    void* second = allocator.allocate(60);
+    // Thread caches are LIFO
+    CHECK(first == second);
+    allocator.deallocate(second);
+
+    auto stats = allocator.stats();
+    const auto& cls = stats.classes[SizeClassAllocator::size_class_of(64)];
+    CHECK(cls.block_size == 64);
+    CHECK(cls.allocs == 2 && cls.frees == 2);
+    CHECK(cls.spans == 1);
+    CHECK(stats.span_bytes == SizeClassAllocator::span_size);
+    CHECK(stats.num_thread_caches == 1);
+}
+
+// Threads allocate random sizes, free some of their own blocks and hand others over to be freed by another thread.
+// Every block is filled with a pattern that is checked when it is freed.
+TEST_CASE(concurrent_alloc_and_cross_thread_free_keep_blocks_intact)
+{
+    constexpr int num_threads = 4;
+    constexpr size_t ops_per_thread = 200'000;
+    SizeClassAllocator allocator;
+
+    std::mutex handoff_mutex;
+    std::vector<Block> handoff;
+    std::vector<int> corrupted(num_threads, 0);
+
+    auto worker = [&](int thread_index) {
+        std::mt19937 rng{static_cast<unsigned>(thread_index + 1)};
+        std::vector<Block> live;
+        std::vector<Block> received;
+        auto free_block = [&](const Block& block) {
+            if (!block_is_intact(allocator, block)) {
+                ++corrupted[thread_index];
+            }
+            allocator.deallocate(block.ptr);
+        };
+
+        for (size_t op = 0; op < ops_per_thread; ++op) {
+            unsigned action = rng() % 8;
+            if (action < 4 || live.empty()) {
+                Block block = make_block(allocator, random_size(rng), static_cast<uint8_t>(rng()));
+                if (!block.ptr) {
+                    ++corrupted[thread_index];
+                    continue;
+                }
+                live.push_back(block);
+            }
+            else if (action < 6) {
+                size_t index = rng() % live.size();
+                free_block(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else if (action == 6) {
+                std::lock_guard lock{handoff_mutex};
+                handoff.push_back(live.back());
+                live.pop_back();
+            }
+            else {
+                {
+                    std::lock_guard lock{handoff_mutex};
+                    received.swap(handoff);
+                }
+                for (const auto& block : received) {
+                    free_block(block);
+                }
+                received.clear();
+            }
+        }
+        for (const auto& block : live) {
+            free_block(block);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& block : handoff) {
+        CHECK(block_is_intact(allocator, block));
+        allocator.deallocate(block.ptr);
+    }
+
+    for (int t = 0; t < num_threads; ++t) {
+        CHECK(corrupted[t] == 0);
+    }
+    auto stats = allocator.stats();
+    size_t allocs = 0;
+    size_t frees = 0;
+    for (const auto& cls : stats.classes) {
+        allocs += cls.allocs;
+        frees += cls.frees;
+    }
+    CHECK(allocs > 0 && allocs == frees);
+    // Plus one for the main thread if it freed leftover handed over blocks
+    CHECK(stats.num_thread_caches >= num_threads);
+}
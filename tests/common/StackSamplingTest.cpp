@@ -0,0 +1,233 @@
+#include "../test.h"
+#include <common/utils/stack-sampling.h>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uintptr_t module_base = 0x400000;
+
+    // Stack memory with [saved frame pointer, return address] records written at chosen slots
+    struct SyntheticStack
+    {
+        uintptr_t words[64] = {};
+
+        [[nodiscard]] uintptr_t addr(size_t slot) const
+        {
+            return reinterpret_cast<uintptr_t>(&words[slot]);
+        }
+
+        [[nodiscard]] uintptr_t low() const
+        {
+            return addr(0);
+        }
+
+        [[nodiscard]] uintptr_t high() const
+        {
+            return addr(std::size(words));
+        }
+
+        void set_frame(size_t slot, uintptr_t next_fp, uintptr_t ret_addr)
+        {
+            words[slot] = next_fp;
+            words[slot + 1] = ret_addr;
+        }
+    };
+
+    std::vector<uintptr_t> walk(const SyntheticStack& stack, uintptr_t fp, int max_depth = max_sampled_stack_depth)
+    {
+        std::vector<uintptr_t> frames(max_sampled_stack_depth);
+        int depth = walk_frame_pointer_chain(0x401000, fp, stack.low(), stack.high(), frames.data(), max_depth);
+        frames.resize(depth);
+        return frames;
+    }
+
+    StackSymbolizer make_symbolizer()
+    {
+        SymbolMap symbols;
+        symbols.add(0x1000, "main");
+        symbols.add(0x2000, "update", 0x100);
+        symbols.add(0x3000, "render");
+        symbols.add_section(0x1000, 0x3000);
+        return StackSymbolizer{{{"rf2.exe", module_base, 0x10000}}, "RF2.EXE", std::move(symbols)};
+    }
+
+    std::string fold(const StackSampleTable& table)
+    {
+        std::ostringstream out;
+        write_folded_stacks(table, make_symbolizer(), out);
+        return out.str();
+    }
+
+    void add_samples(StackSampleTable& table, std::vector<uintptr_t> frames, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            table.add(frames.data(), static_cast<int>(frames.size()));
+        }
+    }
+}
+
+TEST_CASE(frame_pointer_chain_is_walked_up_the_stack)
+{
+    SyntheticStack stack;
+    stack.set_frame(4, stack.addr(10), 0x401100);
+    stack.set_frame(10, stack.addr(20), 0x401200);
+    // Saved frame pointer of a function built without frame pointers points anywhere
+    stack.set_frame(20, stack.addr(2), 0x401300);
+    CHECK(walk(stack, stack.addr(4)) == std::vector<uintptr_t>{0x401000, 0x401100, 0x401200, 0x401300});
+    CHECK(walk(stack, stack.addr(4), 2) == std::vector<uintptr_t>{0x401000, 0x401100});
+    CHECK(walk(stack, stack.addr(4), 0).empty());
+}
+
+TEST_CASE(frame_pointer_walk_stops_at_invalid_frames)
+{
+    SyntheticStack stack;
+    stack.set_frame(4, stack.addr(10), 0x401100);
+    // Null return address ends the chain
+    stack.set_frame(10, stack.addr(20), 0);
+    CHECK(walk(stack, stack.addr(4)) == std::vector<uintptr_t>{0x401000, 0x401100});
+
+    // Frame pointer outside the stack, misaligned or with a record crossing the top of the stack
+    CHECK(walk(stack, stack.high()) == std::vector<uintptr_t>{0x401000});
+    CHECK(walk(stack, stack.low() - sizeof(uintptr_t)) == std::vector<uintptr_t>{0x401000});
+    CHECK(walk(stack, stack.addr(4) + 1) == std::vector<uintptr_t>{0x401000});
+    CHECK(walk(stack, stack.addr(std::size(stack.words) - 1)) == std::vector<uintptr_t>{0x401000});
+
+    // Chain pointing outside the stack
+    stack.set_frame(10, stack.high() + 0x100, 0x401200);
+    CHECK(walk(stack, stack.addr(4)) == std::vector<uintptr_t>{0x401000, 0x401100, 0x401200});
+}
+
+TEST_CASE(stack_scan_finds_return_addresses_after_calls)
+{
+    uint8_t code[64] = {};
+    // call rel32 at 8, call [disp32] at 20, call eax at 30
+    code[8] = 0xE8;
+    code[20] = 0xFF;
+    code[21] = 0x15;
+    code[30] = 0xFF;
+    code[31] = 0xD0;
+    const auto code_begin = reinterpret_cast<uintptr_t>(code);
+    const auto code_end = code_begin + sizeof(code);
+
+    uintptr_t stack[] = {
+        code_begin + 13,
+        // Not after a call
+        code_begin + 3,
+        0x12345678,
+        code_begin + 26,
+        // Start of the code cannot be a return address
+        code_begin,
+        code_begin + 32,
+        code_begin + 13,
+    };
+    const auto stack_low = reinterpret_cast<uintptr_t>(stack);
+    const auto stack_high = stack_low + sizeof(stack);
+
+    uintptr_t out[8] = {};
+    int depth = scan_stack_for_return_addresses(stack_low, stack_high, code_begin, code_end, out, 8);
+    CHECK(std::vector<uintptr_t>(out, out + depth)
+        == std::vector<uintptr_t>{code_begin + 13, code_begin + 26, code_begin + 32, code_begin + 13});
+
+    // Limits
+    CHECK(scan_stack_for_return_addresses(stack_low, stack_high, code_begin, code_end, out, 2) == 2);
+    CHECK(scan_stack_for_return_addresses(stack_low, stack_high, code_begin, code_end, out, 8, 3) == 1);
+    // Unaligned stack pointer starts at the next word
+    CHECK(scan_stack_for_return_addresses(stack_low + 1, stack_high, code_begin, code_end, out, 8) == 3);
+}
+
+TEST_CASE(sample_table_counts_unique_stacks)
+{
+    StackSampleTable table{4};
+    add_samples(table, {1, 2, 3}, 3);
+    add_samples(table, {1, 2}, 2);
+    add_samples(table, {1, 2, 4}, 1);
+
+    size_t num_stacks = 0;
+    uint32_t total = 0;
+    table.for_each([&](const uintptr_t* frames, int depth, uint32_t count) {
+        ++num_stacks;
+        total += count;
+        if (depth == 2) {
+            CHECK(frames[0] == 1 && frames[1] == 2 && count == 2);
+        }
+    });
+    CHECK(num_stacks == 3);
+    CHECK(total == 6);
+
+    // Table is full after the 4th unique stack
+    add_samples(table, {5}, 1);
+    add_samples(table, {6}, 1);
+    CHECK(table.num_samples() == 8);
+    CHECK(table.num_dropped() == 1);
+}
+
+TEST_CASE(symbol_map_is_loaded_from_text)
+{
+    std::istringstream text{
+        "# rva name [size]\n"
+        "\n"
+        "0x2000 update 100\n"
+        "1000 main\n"
+        "zzz broken\n"
+        "3000 bad_size size\n"
+        "3000 render\n"};
+    SymbolMap symbols;
+    CHECK(symbols.load(text) == 3);
+    CHECK(*symbols.find(0x1000) == "main");
+    CHECK(*symbols.find(0x20FF) == "update");
+    CHECK(*symbols.find(0x3010) == "render");
+    CHECK(symbols.find(0xFFF) == nullptr);
+}
+
+TEST_CASE(symbol_lookups_are_bounded_by_size_and_section)
+{
+    SymbolMap symbols;
+    symbols.add(0x1000, "main");
+    symbols.add(0x2000, "update", 0x100);
+    symbols.add(0x3000, "render");
+
+    // Without sections only the symbol size bounds a lookup
+    CHECK(*symbols.find(0x1FFF) == "main");
+    CHECK(*symbols.find(0x20FF) == "update");
+    CHECK(symbols.find(0x2100) == nullptr);
+    CHECK(*symbols.find(0x7000) == "render");
+
+    symbols.add_section(0x1000, 0x3000);
+    symbols.add_section(0x6000, 0x1000);
+    CHECK(*symbols.find(0x3FFF) == "render");
+    // Past the end of the section and in another section without symbols
+    CHECK(symbols.find(0x4000) == nullptr);
+    CHECK(symbols.find(0x6000) == nullptr);
+}
+
+TEST_CASE(stacks_are_symbolized_and_folded)
+{
+    StackSampleTable table;
+    // Different return addresses in the same functions fold into one line
+    add_samples(table, {module_base + 0x2010, module_base + 0x1050}, 3);
+    add_samples(table, {module_base + 0x2020, module_base + 0x1060}, 2);
+    // Past the end of update, past the end of the code section and outside of any module
+    add_samples(table, {module_base + 0x2200, module_base + 0x1050}, 4);
+    add_samples(table, {module_base + 0x5000}, 2);
+    add_samples(table, {0x900000, module_base + 0x3004}, 1);
+
+    CHECK(fold(table)
+        == "main;update 5\n"
+           "main;rf2.exe+0x2200 4\n"
+           "rf2.exe+0x5000 2\n"
+           "render;0x900000 1\n");
+}
+
+TEST_CASE(symbols_of_other_modules_are_not_used)
+{
+    SymbolMap symbols;
+    symbols.add(0, "rf2_start");
+    StackSymbolizer symbolizer{{{"rf2.exe", module_base, 0x10000}, {"d3d8.dll", 0x10000000, 0x1000}}, "rf2.exe",
+        std::move(symbols)};
+    CHECK(symbolizer.describe(module_base + 0x10) == "rf2_start");
+    CHECK(symbolizer.describe(0x10000010) == "d3d8.dll+0x10");
+    CHECK(symbolizer.describe(0x10001000) == "0x10001000");
+}
@@ -0,0 +1,145 @@
+#include "../test.h"
+#include <common/utils/vm-map.h>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Executable image, its data, a PROT_NONE guard, the heap, a small anonymous mapping and a shared file mapping
+    const char g_maps[] =
+        "00400000-00452000 r-xp 00000000 08:02 173521 /usr/bin/game\n"
+        "00651000-00652000 rw-p 00051000 08:02 173521 /usr/bin/game\n"
+        "00652000-00700000 ---p 00000000 00:00 0\n"
+        "\n"
+        "00800000-00a00000 rw-p 00000000 00:00 0                                  [heap]\n"
+        "00a08000-00a10000 rw-p 00000000 00:00 0 \n"
+        "7f0000000000-7f0000100000 rw-s 00000000 00:05 1234 /dev/shm/game\n";
+
+    bool parse(const std::string& text, std::vector<VmRegion>& regions, uintptr_t min_address = 0x10000)
+    {
+        std::istringstream stream{text};
+        return parse_proc_maps(stream, regions, min_address);
+    }
+
+    struct FreeRange
+    {
+        uintptr_t base;
+        size_t size;
+
+        bool operator==(const FreeRange& other) const = default;
+    };
+
+    std::vector<FreeRange> free_ranges(const std::vector<VmRegion>& regions)
+    {
+        std::vector<FreeRange> ranges;
+        for (const auto& region : regions) {
+            if (region.state == VmRegionState::free) {
+                ranges.push_back({region.base, region.size});
+            }
+        }
+        return ranges;
+    }
+}
+
+TEST_CASE(gaps_between_mappings_become_free_regions)
+{
+    std::vector<VmRegion> regions;
+    REQUIRE(parse(g_maps, regions));
+    CHECK(regions.size() == 11);
+    CHECK(free_ranges(regions) == (std::vector<FreeRange>{
+        {0x10000, 0x3f0000},
+        {0x452000, 0x1ff000},
+        {0x700000, 0x100000},
+        {0xa00000, 0x8000},
+        {0xa10000, 0x7f0000000000 - 0xa10000},
+    }));
+    // Regions are in ascending order without overlaps
+    for (size_t i = 1; i < regions.size(); ++i) {
+        CHECK(regions[i - 1].base + regions[i - 1].size <= regions[i].base);
+    }
+
+    CHECK(regions[1].state == VmRegionState::committed && regions[1].type == VmRegionType::image);
+    CHECK(regions[3].state == VmRegionState::committed && regions[3].type == VmRegionType::mapped);
+    CHECK(regions[4].state == VmRegionState::reserved && regions[4].type == VmRegionType::priv);
+    CHECK(regions[6].type == VmRegionType::priv);
+}
+
+TEST_CASE(summary_counts_regions_and_largest_free_blocks)
+{
+    std::vector<VmRegion> regions;
+    REQUIRE(parse(g_maps, regions));
+    auto summary = summarize_vm_regions(regions);
+    CHECK(summary.num_regions == 11);
+    CHECK(summary.num_free_regions == 5);
+    CHECK(summary.largest_free[0] == 0x7f0000000000 - 0xa10000);
+    CHECK(summary.largest_free[1] == 0x3f0000);
+    CHECK(summary.largest_free[2] == 0x1ff000);
+    CHECK(summary.largest_free[3] == 0x100000);
+    CHECK(summary.total_free == 0x7f0000000000 - 0xa10000 + 0x3f0000 + 0x1ff000 + 0x100000 + 0x8000);
+    // The 32 KiB gap after the heap is too small for a 64 KiB allocation
+    CHECK(summary.num_usable_free_blocks == 4);
+    CHECK(summary.reserved == 0xae000);
+    CHECK(summary.committed == 0x52000 + 0x1000 + 0x200000 + 0x8000 + 0x100000);
+    CHECK(summary.committed_private == 0x200000 + 0x8000);
+    CHECK(summary.image == 0x52000);
+    CHECK(summary.mapped == 0x1000 + 0x100000);
+    CHECK(format_vm_summary(summary).size() == 3);
+}
+
+TEST_CASE(min_address_is_the_start_of_the_first_gap)
+{
+    std::vector<VmRegion> regions;
+    REQUIRE(parse(g_maps, regions, 0));
+    CHECK(free_ranges(regions).front() == (FreeRange{0, 0x400000}));
+
+    // Mappings below the cutoff are kept but no free space is reported under it
+    REQUIRE(parse(g_maps, regions, 0x500000));
+    auto ranges = free_ranges(regions);
+    CHECK(regions.front().base == 0x400000 && regions.front().state == VmRegionState::committed);
+    CHECK(ranges.front() == (FreeRange{0x500000, 0x151000}));
+    CHECK(ranges.size() == 4);
+}
+
+TEST_CASE(malformed_lines_are_rejected)
+{
+    std::vector<VmRegion> regions;
+    CHECK(!parse("garbage\n", regions));
+    CHECK(!parse("00400000 r-xp 00000000 08:02 173521 /usr/bin/game\n", regions));
+    CHECK(!parse("00452000-00400000 r-xp 00000000 08:02 173521 /usr/bin/game\n", regions));
+    CHECK(!parse("00400000-00400000 r-xp 00000000 08:02 173521 /usr/bin/game\n", regions));
+    CHECK(!parse("00400000-00452000 r-xp 00000000\n", regions));
+    // A bad line after good ones fails the whole parse
+    CHECK(!parse(std::string{g_maps} + "7f0000100000-\n", regions));
+
+    CHECK(parse("", regions));
+    CHECK(regions.empty());
+}
+
+TEST_CASE(current_process_map_is_consistent)
+{
+    std::vector<VmRegion> regions;
+    REQUIRE(query_vm_regions(regions));
+    REQUIRE(!regions.empty());
+    for (size_t i = 1; i < regions.size(); ++i) {
+        CHECK(regions[i - 1].base + regions[i - 1].size <= regions[i].base);
+    }
+
+    // The test binary and the stack are mapped
+    auto summary = summarize_vm_regions(regions);
+    CHECK(summary.num_regions == regions.size());
+    CHECK(summary.image > 0);
+    CHECK(summary.committed_private > 0);
+    CHECK(summary.num_free_regions > 0 && summary.largest_free[0] > 0);
+
+    int local = 0;
+    auto addr = reinterpret_cast<uintptr_t>(&local);
+    bool found = false;
+    for (const auto& region : regions) {
+        if (addr >= region.base && addr - region.base < region.size) {
+            found = region.state == VmRegionState::committed;
+        }
+    }
+    CHECK(found);
+}
@@ -0,0 +1,188 @@
+#include "../test.h"
+#include <crash_handler_stub/FlightRecorder.h>
+#include <xlog/AsyncAppender.h>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::string g_logger_name{"test"};
+
+    std::vector<std::string> split_lines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        size_t start = 0;
+        for (size_t end = text.find("\r\n"); end != std::string::npos; end = text.find("\r\n", start)) {
+            lines.push_back(text.substr(start, end - start));
+            start = end + 2;
+        }
+        return lines;
+    }
+
+    std::vector<std::string> dump_lines()
+    {
+        std::string text;
+        FlightRecorderDump([](const char* data, size_t size, void* ctx) {
+            static_cast<std::string*>(ctx)->append(data, size);
+        }, &text);
+        return split_lines(text);
+    }
+
+    // Lines of the log record section without their indentation
+    std::vector<std::string> log_records(const std::vector<std::string>& lines)
+    {
+        std::vector<std::string> records;
+        bool in_records = false;
+        for (const auto& line : lines) {
+            if (line.starts_with("Flight recorder:")) {
+                in_records = line.ends_with(" log records");
+            }
+            else if (in_records && line.starts_with("  ")) {
+                records.push_back(line.substr(2));
+            }
+        }
+        return records;
+    }
+
+    class DiscardingSink : public xlog::Appender
+    {
+    protected:
+        void append([[maybe_unused]] xlog::Level level, [[maybe_unused]] std::string_view formatted_message) override
+        {}
+    };
+
+    int g_dump_fd = -1;
+
+    void dump_on_crash([[maybe_unused]] int signal_number)
+    {
+        FlightRecorderDump([](const char* data, size_t size, [[maybe_unused]] void* ctx) {
+            while (size) {
+                ssize_t written = write(g_dump_fd, data, size);
+                if (written <= 0) {
+                    return;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        }, nullptr);
+        _exit(3);
+    }
+
+    // Runs in a forked child: threads keep logging while the main thread presents frames and then crashes
+    [[noreturn]] void log_and_crash(int dump_fd)
+    {
+        g_dump_fd = dump_fd;
+        struct sigaction action{};
+        action.sa_handler = dump_on_crash;
+        sigaction(SIGSEGV, &action, nullptr);
+
+        std::atomic<int> records{0};
+        for (int t = 0; t < 3; ++t) {
+            std::thread{[&records, t] {
+                char text[64];
+                for (int i = 0;; ++i) {
+                    int len = std::snprintf(text, sizeof(text), "thread %d record %d", t, i);
+                    FlightRecorderAddLogRecord({text, static_cast<size_t>(len)});
+                    records.fetch_add(1, std::memory_order_relaxed);
+                }
+            }}.detach();
+        }
+        for (size_t i = 0; i < flight_recorder_num_frames + 100; ++i) {
+            FlightRecorderAddFrame();
+        }
+        while (records.load(std::memory_order_relaxed) < 100'000) {
+            std::this_thread::yield();
+        }
+        std::raise(SIGSEGV);
+        _exit(1);
+    }
+}
+
+TEST_CASE(records_are_dumped_oldest_first_and_truncated)
+{
+    for (int i = 0; i < 300; ++i) {
+        FlightRecorderAddLogRecord("record " + std::to_string(i));
+    }
+    FlightRecorderAddLogRecord(std::string(400, 'x'));
+
+    auto records = log_records(dump_lines());
+    REQUIRE(records.size() == flight_recorder_num_log_records);
+    for (size_t i = 0; i + 1 < records.size(); ++i) {
+        CHECK(records[i] == "record " + std::to_string(300 - flight_recorder_num_log_records + 1 + i));
+    }
+    CHECK(records.back() == std::string(flight_recorder_max_log_record_len, 'x'));
+}
+
+TEST_CASE(async_appender_tee_records_before_the_writer_runs)
+{
+    xlog::AsyncAppender appender{std::make_unique<DiscardingSink>(), 64, xlog::AsyncOverflowPolicy::drop,
+        std::make_unique<FlightRecorderAppender>()};
+    appender.set_formatter<xlog::SimpleFormatter>(false, true, true, false);
+    static_cast<xlog::Appender&>(appender).append(xlog::Level::warn, g_logger_name, "teed {}", 42);
+
+    auto records = log_records(dump_lines());
+    REQUIRE(!records.empty());
+    CHECK(records.back() == "WARN: test teed 42");
+}
+
+TEST_CASE(dump_from_crash_signal_handler_skips_torn_records)
+{
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        close(fds[0]);
+        log_and_crash(fds[1]);
+    }
+    close(fds[1]);
+    std::string text;
+    char buf[4096];
+    for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) > 0;) {
+        text.append(buf, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 3);
+
+    auto lines = split_lines(text);
+    size_t frames = 0;
+    bool in_frames = false;
+    for (const auto& line : lines) {
+        if (line.starts_with("Flight recorder:")) {
+            in_frames = line.ends_with("duration ms)");
+        }
+        else if (in_frames) {
+            ++frames;
+        }
+    }
+    // Frames come from the crashing thread, so none of them can be torn
+    CHECK(frames == flight_recorder_num_frames);
+
+    // Records still being written when the dump ran are skipped, the rest are whole and in order per thread
+    auto records = log_records(lines);
+    CHECK(records.size() > flight_recorder_num_log_records / 2 && records.size() <= flight_recorder_num_log_records);
+    std::vector<int> last_record(3, -1);
+    bool well_formed = true;
+    for (const auto& record : records) {
+        int t = -1;
+        int i = -1;
+        char extra = 0;
+        if (std::sscanf(record.c_str(), "thread %d record %d%c", &t, &i, &extra) != 2 || t < 0 || t >= 3
+            || i <= last_record[t]) {
+            well_formed = false;
+            continue;
+        }
+        last_record[t] = i;
+    }
+    CHECK(well_formed);
+}
@@ -0,0 +1,171 @@
+#include "../test.h"
+#include "../patch_common/code-test-utils.h"
+#include <core/ftol_sites.h>
+#include <patch_common/AsmWriter.h>
+#include <cstdint>
+#include <vector>
+
+using namespace asm_regs;
+using code_test::Bytes;
+using code_test::le32;
+
+namespace
+{
+    const Bytes ftol_prologue{
+        0x55, 0x8B, 0xEC, 0x83, 0xC4, 0xF4, 0x9B, 0xD9, 0x7D, 0xFE, 0x9B, 0x66, 0x8B, 0x45, 0xFE, 0x80, 0xCC, 0x0C,
+    };
+
+    // Synthetic code section: call sites at the start, a float returning function at 0x700 and __ftol at 0x800
+    struct SyntheticImage
+    {
+        static constexpr size_t float_fn_offset = 0x700;
+        static constexpr size_t ftol_offset = 0x800;
+        static constexpr size_t size = 0x900;
+
+        code_test::CodeBuffer buf;
+        // Offsets of the calls in the order they are emitted, with the kind the classifier should give them
+        std::vector<std::pair<size_t, FtolSiteKind>> expected_sites;
+
+        [[nodiscard]] uintptr_t addr() const
+        {
+            return buf.addr();
+        }
+
+        [[nodiscard]] uintptr_t ftol_addr() const
+        {
+            return buf.addr() + ftol_offset;
+        }
+    };
+
+    void build_image(SyntheticImage& image)
+    {
+        image.buf.fill(0xCC);
+        const auto ftol = static_cast<uint32_t>(image.ftol_addr());
+        const auto float_fn = static_cast<uint32_t>(image.addr() + SyntheticImage::float_fn_offset);
+        AsmWriter a{image.addr()};
+        auto site = [&](FtolSiteKind kind) {
+            image.expected_sites.emplace_back(a.size(), kind);
+            a.call(ftol);
+        };
+
+        a.fld<float>(*(ebp + 8));
+        site(FtolSiteKind::x87_result);
+        // Longest x87 form: opcode + ModRM + SIB + disp32
+        a.fld<double>(*(esp + 0x100 + ecx * 8));
+        site(FtolSiteKind::x87_result);
+        a.fild<int32_t>(*eax);
+        site(FtolSiteKind::x87_result);
+        a.fmul<float>(AsmRegMem(0x12345678u));
+        site(FtolSiteKind::x87_result);
+        a.call(float_fn);
+        site(FtolSiteKind::call_result);
+        // Result of the previous __ftol is not a float
+        site(FtolSiteKind::unknown);
+        a.mov(eax, ecx);
+        site(FtolSiteKind::unknown);
+        // Jump target with the x87 instruction on only one of the paths. The classifier cannot see the jump, which is
+        // why a kind is not enough to enable a site.
+        auto join = a.new_label();
+        a.cmp(eax, ecx).je(join).fld<float>(*esi).bind(join);
+        site(FtolSiteKind::x87_result);
+        a.ret();
+        // Calls of other functions are not sites
+        a.call(float_fn).fld<float>(*esi).call(float_fn);
+        a.finish();
+
+        AsmWriter{image.addr() + SyntheticImage::float_fn_offset}.fld<float>(*(esp + 4)).ret();
+        std::memcpy(image.buf.data() + SyntheticImage::ftol_offset, ftol_prologue.data(), ftol_prologue.size());
+    }
+}
+
+TEST_CASE(ftol_is_found_by_its_prologue)
+{
+    SyntheticImage image;
+    build_image(image);
+    CHECK(find_ftol(image.buf.data(), SyntheticImage::size, image.addr()) == image.ftol_addr());
+
+    // Pattern must match completely
+    CHECK(find_ftol(image.buf.data(), SyntheticImage::ftol_offset + ftol_prologue.size() - 1, image.addr()) == 0);
+    image.buf.data()[SyntheticImage::ftol_offset + 6] = 0x90;
+    CHECK(find_ftol(image.buf.data(), SyntheticImage::size, image.addr()) == 0);
+    CHECK(find_ftol(image.buf.data(), 4, image.addr()) == 0);
+}
+
+TEST_CASE(ftol_sites_are_found_and_classified)
+{
+    SyntheticImage image;
+    build_image(image);
+    code_test::g_num_unknown_opcodes = 0;
+
+    std::vector<FtolSite> sites;
+    find_ftol_sites(image.buf.data(), SyntheticImage::size, image.addr(), image.ftol_addr(), sites);
+    REQUIRE(sites.size() == image.expected_sites.size());
+    for (size_t i = 0; i < sites.size(); ++i) {
+        CHECK(sites[i].addr == image.addr() + image.expected_sites[i].first);
+        CHECK(sites[i].kind == image.expected_sites[i].second);
+        if (sites[i].kind != image.expected_sites[i].second) {
+            std::fprintf(stderr, "site %zu classified as %s\n", i, ftol_site_kind_name(sites[i].kind));
+        }
+        CHECK(!sites[i].enabled && !sites[i].validated && !sites[i].cave);
+    }
+    // Classifier only passes x87 opcodes to the length decoder
+    CHECK(code_test::g_num_unknown_opcodes == 0);
+}
+
+TEST_CASE(ftol_scan_handles_edges_of_the_section)
+{
+    SyntheticImage image;
+    build_image(image);
+    const size_t first_site = image.expected_sites[0].first;
+
+    // Site cut off by the end of the section
+    std::vector<FtolSite> sites;
+    find_ftol_sites(image.buf.data(), first_site + ftol_call_size - 1, image.addr(), image.ftol_addr(), sites);
+    CHECK(sites.empty());
+    find_ftol_sites(image.buf.data(), first_site + ftol_call_size, image.addr(), image.ftol_addr(), sites);
+    CHECK(sites.size() == 1);
+
+    // Section starting at the call has nothing before it to classify
+    sites.clear();
+    find_ftol_sites(image.buf.data() + first_site, ftol_call_size, image.addr() + first_site, image.ftol_addr(), sites);
+    REQUIRE(sites.size() == 1);
+    CHECK(sites[0].kind == FtolSiteKind::unknown);
+}
+
+TEST_CASE(validated_sites_are_matched_by_rva)
+{
+    SyntheticImage image;
+    build_image(image);
+    std::vector<FtolSite> sites;
+    find_ftol_sites(image.buf.data(), SyntheticImage::size, image.addr(), image.ftol_addr(), sites);
+
+    const uint32_t rvas[] = {
+        static_cast<uint32_t>(image.expected_sites[4].first),
+        static_cast<uint32_t>(image.expected_sites[1].first),
+        // Inside a site and past the section, e.g. RVAs of another rf2.exe build
+        static_cast<uint32_t>(image.expected_sites[2].first + 1),
+        0x10000,
+    };
+    std::vector<uint32_t> missing;
+    auto indices = find_ftol_sites_by_rva(sites, image.addr(), rvas, missing);
+    CHECK(indices == std::vector<size_t>{4, 1});
+    CHECK(missing == std::vector<uint32_t>{rvas[2], rvas[3]});
+
+    missing.clear();
+    CHECK(find_ftol_sites_by_rva(sites, image.addr(), {}, missing).empty());
+    CHECK(missing.empty());
+}
+
+TEST_CASE(ftol_cave_truncates_without_touching_control_word)
+{
+    code_test::CodeBuffer buf;
+    const uintptr_t return_addr = buf.addr() + 0x1000;
+
+    // Measured before the cave address is known, so the jump back is counted as rel32
+    AsmWriter measure;
+    emit_ftol_cave(measure, return_addr);
+    CHECK(measure.size() == 13);
+
+    CHECK(code_test::expect_code_at(buf.addr(), [&](AsmWriter& a) { emit_ftol_cave(a, return_addr); },
+        Bytes{0x83, 0xEC, 0x08, 0xDD, 0x0C, 0x24, 0x58, 0x5A, 0xE9} + le32(0x1000 - 13)));
+}
@@ -0,0 +1,534 @@
+#include "../test.h"
+#include "code-test-utils.h"
+#include <patch_common/AsmWriter.h>
+#include <patch_common/MemUtils.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Every encoder is run with every operand form. The length of each generated instruction must match the subhook length
+// decoder (used when hooking code that AsmWriter generated) and, if objdump was found, the reference disassembler,
+// which also has to agree on base, index, scale and displacement of memory operands.
+
+using namespace asm_regs;
+using code_test::Bytes;
+using code_test::le32;
+
+namespace
+{
+    const char* const reg_names[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"};
+
+    const AsmReg32 gp_regs[] = {eax, ecx, edx, ebx, esp, ebp, esi, edi};
+
+    std::string to_hex(int32_t value)
+    {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%s0x%x", value < 0 ? "-" : "+",
+            value < 0 ? -static_cast<uint32_t>(value) : static_cast<uint32_t>(value));
+        return buf;
+    }
+
+    std::string describe(const AsmRegMem& rm)
+    {
+        if (!rm.memory) {
+            return rm.reg_opt->size == 16 ? "xmm" + std::to_string(rm.reg_opt->reg_num) : reg_names[rm.reg_opt->reg_num];
+        }
+        std::string s = "[";
+        if (rm.reg_opt) {
+            s += reg_names[rm.reg_opt->reg_num];
+        }
+        if (rm.index_opt) {
+            s += (rm.reg_opt ? "+" : "") + std::string{reg_names[rm.index_opt->reg_num]} + "*" + std::to_string(rm.scale);
+        }
+        if (!rm.reg_opt && !rm.index_opt) {
+            return s + to_hex(rm.displacement).substr(1) + "]";
+        }
+        s += to_hex(rm.displacement);
+        return s + "]";
+    }
+
+    std::vector<AsmRegMem> memory_operands()
+    {
+        std::vector<AsmRegMem> operands;
+        const int32_t displacements[] = {0, 1, -1, 127, -128, 128, -129, 0x12345678};
+        for (AsmReg32 base : gp_regs) {
+            for (int32_t disp : displacements) {
+                operands.push_back(*(base + disp));
+            }
+        }
+        operands.emplace_back(0x12345678u);
+        operands.emplace_back(0u);
+        for (AsmReg32 index : gp_regs) {
+            if (index == esp) {
+                continue;
+            }
+            for (int scale : {1, 2, 4, 8}) {
+                for (int32_t disp : {0, 8, -8, 0x1000}) {
+                    for (AsmReg32 base : gp_regs) {
+                        operands.push_back(*(base + disp + index * scale));
+                    }
+                    operands.push_back(*(index * scale + disp));
+                }
+            }
+        }
+        return operands;
+    }
+
+    enum class RegForm
+    {
+        none,
+        gp,
+        xmm,
+    };
+
+    struct Encoder
+    {
+        const char* name;
+        RegForm reg_form;
+        std::function<void(AsmWriter&, const AsmRegMem&)> emit;
+    };
+
+    std::vector<Encoder> rm_encoders()
+    {
+        return {
+            {"add rm, r32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.add(rm, edx); }},
+            {"add r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.add(edx, rm); }},
+            {"add rm, imm8", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.add(rm, int8_t{-5}); }},
+            {"add rm, imm32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.add(rm, 0x1234); }},
+            {"sub rm, r32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.sub(rm, edx); }},
+            {"sub r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.sub(edx, rm); }},
+            {"sub rm, imm8", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.sub(rm, int8_t{5}); }},
+            {"sub rm, imm32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.sub(rm, -0x1234); }},
+            {"and rm, r32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.and_(rm, edx); }},
+            {"and r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.and_(edx, rm); }},
+            {"and rm, imm8", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.and_(rm, 0x7F); }},
+            {"and rm, imm32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.and_(rm, 0xFF00); }},
+            {"xor r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.xor_(edx, rm); }},
+            {"cmp rm, r32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.cmp(rm, edx); }},
+            {"cmp r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.cmp(edx, rm); }},
+            {"mov rm, r8", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.mov(rm, dl); }},
+            {"mov rm, r16", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.mov(rm, dx); }},
+            {"mov rm, r32", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.mov(rm, edx); }},
+            {"mov r32, rm", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.mov(edx, rm); }},
+            {"lea", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.lea(edx, rm); }},
+            {"fld float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fld<float>(rm); }},
+            {"fld double", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fld<double>(rm); }},
+            {"fstp float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fstp<float>(rm); }},
+            {"fstp double", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fstp<double>(rm); }},
+            {"fadd float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fadd<float>(rm); }},
+            {"fsub float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fsub<float>(rm); }},
+            {"fmul float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fmul<float>(rm); }},
+            {"fcomp float", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fcomp<float>(rm); }},
+            {"fcomp double", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fcomp<double>(rm); }},
+            {"fild int16", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fild<int16_t>(rm); }},
+            {"fild int32", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fild<int32_t>(rm); }},
+            {"fild int64", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fild<int64_t>(rm); }},
+            {"fistp int16", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fistp<int16_t>(rm); }},
+            {"fistp int32", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fistp<int32_t>(rm); }},
+            {"fistp int64", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fistp<int64_t>(rm); }},
+            {"fisttp int16", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fisttp<int16_t>(rm); }},
+            {"fisttp int32", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fisttp<int32_t>(rm); }},
+            {"fisttp int64", RegForm::none, [](AsmWriter& a, const AsmRegMem& rm) { a.fisttp<int64_t>(rm); }},
+            {"movss xmm, rm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movss(xmm2, rm); }},
+            {"movss rm, xmm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movss(rm, xmm2); }},
+            {"movsd xmm, rm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movsd(xmm2, rm); }},
+            {"movsd rm, xmm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movsd(rm, xmm2); }},
+            {"movaps xmm, rm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movaps(xmm2, rm); }},
+            {"movaps rm, xmm", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.movaps(rm, xmm2); }},
+            {"cvttss2si", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.cvttss2si(edx, rm); }},
+            {"cvtsi2ss", RegForm::gp, [](AsmWriter& a, const AsmRegMem& rm) { a.cvtsi2ss(xmm2, rm); }},
+            {"addss", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.addss(xmm2, rm); }},
+            {"mulss", RegForm::xmm, [](AsmWriter& a, const AsmRegMem& rm) { a.mulss(xmm2, rm); }},
+        };
+    }
+
+    // Encoders without a r/m operand, emitted once per register where they take one
+    std::vector<std::function<void(AsmWriter&, AsmReg32)>> reg_encoders()
+    {
+        return {
+            [](AsmWriter& a, AsmReg32 r) { a.push(r); },
+            [](AsmWriter& a, AsmReg32 r) { a.pop(r); },
+            [](AsmWriter& a, AsmReg32 r) { a.push(AsmReg16(r.reg_num)); },
+            [](AsmWriter& a, AsmReg32 r) { a.pop(AsmReg16(r.reg_num)); },
+            [](AsmWriter& a, AsmReg32 r) { a.dec(r); },
+            [](AsmWriter& a, AsmReg32 r) { a.shl(r, 3); },
+            [](AsmWriter& a, AsmReg32 r) { a.shr(r, 31); },
+            [](AsmWriter& a, AsmReg32 r) { a.shl(AsmReg16(r.reg_num), 1); },
+            [](AsmWriter& a, AsmReg32 r) { a.shr(AsmReg16(r.reg_num), 15); },
+            [](AsmWriter& a, AsmReg32 r) { a.mov(r, 0x12345678); },
+            [](AsmWriter& a, AsmReg32 r) { a.mov(AsmReg16(r.reg_num), int16_t{0x1234}); },
+            [](AsmWriter& a, AsmReg32 r) { a.mov(AsmReg8(r.reg_num), int8_t{-1}); },
+            [](AsmWriter& a, AsmReg32 r) { a.cmp(r, uintptr_t{0x1000}); },
+            [](AsmWriter& a, AsmReg32) { a.push(int32_t{5}); },
+            [](AsmWriter& a, AsmReg32) { a.push(int32_t{0x1000}); },
+            [](AsmWriter& a, AsmReg32) { a.cmp(al, int8_t{0x20}); },
+            [](AsmWriter& a, AsmReg32) { a.cmp_eax_imm(0x1000); },
+            [](AsmWriter& a, AsmReg32) { a.pusha().popa().pushf().popf(); },
+            [](AsmWriter& a, AsmReg32) { a.nop().ret().ret(8); },
+        };
+    }
+
+    // Code generated by one encoder, with the offset of every instruction
+    struct GeneratedCode
+    {
+        std::string name;
+        std::vector<size_t> offsets;
+        std::vector<AsmRegMem> operands;
+        Bytes bytes;
+    };
+
+    template<typename F>
+    GeneratedCode generate(code_test::CodeBuffer& buf, std::string name, F&& emit_all)
+    {
+        GeneratedCode code{std::move(name), {}, {}, {}};
+        AsmWriter writer;
+        emit_all(writer, [&](const AsmRegMem& rm) {
+            code.offsets.push_back(writer.size());
+            code.operands.push_back(rm);
+        });
+        size_t size = writer.size();
+        code.offsets.push_back(size);
+        CHECK(size <= code_test::CodeBuffer::size);
+        if (size <= code_test::CodeBuffer::size) {
+            writer.finish(buf.addr());
+            code.bytes = buf.bytes(size);
+        }
+        return code;
+    }
+
+    std::vector<GeneratedCode> generate_all()
+    {
+        code_test::CodeBuffer buf;
+        if (!buf.data()) {
+            return {};
+        }
+        std::vector<GeneratedCode> all;
+        auto operands = memory_operands();
+        for (const auto& encoder : rm_encoders()) {
+            all.push_back(generate(buf, encoder.name, [&](AsmWriter& a, auto&& begin) {
+                for (const auto& rm : operands) {
+                    begin(rm);
+                    encoder.emit(a, rm);
+                }
+                for (int i = 0; i < 8 && encoder.reg_form != RegForm::none; ++i) {
+                    AsmRegMem rm = encoder.reg_form == RegForm::gp ? AsmRegMem(AsmReg32(i)) : AsmRegMem(AsmXmmReg(i));
+                    begin(rm);
+                    encoder.emit(a, rm);
+                }
+            }));
+        }
+        auto encoders = reg_encoders();
+        all.push_back(generate(buf, "register operand", [&](AsmWriter& a, auto&& begin) {
+            for (const auto& emit : encoders) {
+                for (AsmReg32 reg : gp_regs) {
+                    begin(AsmRegMem(reg));
+                    emit(a, reg);
+                }
+            }
+        }));
+        return all;
+    }
+
+    // Some encoders emit a few instructions at once, offsets only mark the first one
+    bool is_multi_instruction(const GeneratedCode& code, size_t i)
+    {
+        return code.name == "register operand" && (i >= code.offsets.size() - 1 - 16);
+    }
+
+    int g_num_reported = 0;
+
+    // Prints the first few mismatches, one broken encoder usually fails for most operands
+    void report(const GeneratedCode& code, size_t i, const char* what)
+    {
+        if (++g_num_reported > 20) {
+            return;
+        }
+        std::fprintf(stderr, "%s %s: %s\n", code.name.c_str(), describe(code.operands[i]).c_str(), what);
+        code_test::print_bytes("  code", Bytes(code.bytes.begin() + code.offsets[i],
+            code.bytes.begin() + code.offsets[i + 1]));
+    }
+
+    // Reference decoding of a 32-bit ModRM byte with an optional SIB byte (Intel SDM Vol. 2, tables 2-2 and 2-3)
+    size_t mod_rm_len(uint8_t mod_rm, uint8_t sib)
+    {
+        int mod = mod_rm >> 6;
+        int rm = mod_rm & 7;
+        if (mod == 3) {
+            return 1;
+        }
+        size_t len = 1;
+        if (rm == 4) {
+            ++len;
+            if (mod == 0 && (sib & 7) == 5) {
+                return len + 4;
+            }
+        }
+        if (mod == 1) {
+            return len + 1;
+        }
+        if (mod == 2 || (mod == 0 && rm == 5)) {
+            return len + 4;
+        }
+        return len;
+    }
+}
+
+TEST_CASE(generated_code_matches_length_decoder)
+{
+    auto all = generate_all();
+    REQUIRE(!all.empty());
+    size_t num_checked = 0;
+    int num_failed = 0;
+    for (const auto& code : all) {
+        // Decoder may look a few bytes past the instruction
+        Bytes padded = code.bytes + Bytes(16, 0);
+        for (size_t i = 0; i + 1 < code.offsets.size(); ++i) {
+            size_t offset = code.offsets[i];
+            size_t end = code.offsets[i + 1];
+            while (offset < end) {
+                int unknown_before = code_test::g_num_unknown_opcodes;
+                size_t len = get_instruction_len(padded.data() + offset);
+                bool ok = len != 0 && code_test::g_num_unknown_opcodes == unknown_before &&
+                    (offset + len == end || (offset + len < end && is_multi_instruction(code, i)));
+                if (!ok) {
+                    report(code, i, "length decoder disagrees");
+                    ++num_failed;
+                    break;
+                }
+                offset += len;
+                ++num_checked;
+            }
+        }
+    }
+    CHECK(num_failed == 0);
+    std::printf("checked %zu instructions\n", num_checked);
+}
+
+// Exhaustive ModRM/SIB matrix for the opcodes added to the subhook table, including the SIB with EBP base cases that
+// used to count the displacement twice
+TEST_CASE(length_decoder_handles_all_mod_rm_forms)
+{
+    const Bytes opcodes[] = {
+        {0x8B}, {0xD8}, {0xD9}, {0xDA}, {0xDB}, {0xDC}, {0xDD}, {0xDE}, {0xDF},
+        {0xF3, 0x0F, 0x10}, {0xF2, 0x0F, 0x11}, {0x0F, 0x28}, {0x0F, 0x29}, {0xF3, 0x0F, 0x2A}, {0xF3, 0x0F, 0x2C},
+        {0xF3, 0x0F, 0x2D}, {0xF3, 0x0F, 0x58}, {0xF3, 0x0F, 0x59}, {0xF3, 0x0F, 0x5C}, {0xF3, 0x0F, 0x5E},
+    };
+    int num_failed = 0;
+    for (const auto& opcode : opcodes) {
+        for (int mod_rm = 0; mod_rm < 256; ++mod_rm) {
+            bool has_sib = (mod_rm >> 6) != 3 && (mod_rm & 7) == 4;
+            for (int sib = 0; sib < (has_sib ? 256 : 1); ++sib) {
+                Bytes code = opcode + Bytes{static_cast<uint8_t>(mod_rm), static_cast<uint8_t>(sib)} + Bytes(8, 0);
+                size_t expected = opcode.size() + mod_rm_len(mod_rm, sib);
+                size_t len = get_instruction_len(code.data());
+                if (len != expected && ++num_failed <= 10) {
+                    std::fprintf(stderr, "expected length %zu, decoder returned %zu\n", expected, len);
+                    code_test::print_bytes("  code", Bytes(code.begin(), code.begin() + expected));
+                }
+            }
+        }
+    }
+    CHECK(num_failed == 0);
+    CHECK(code_test::g_num_unknown_opcodes == 0);
+}
+
+TEST_CASE(length_decoder_regressions)
+{
+    struct Case
+    {
+        Bytes code;
+        size_t len;
+    };
+    const Case cases[] = {
+        // SIB with EBP base: disp8, disp32 and no base (mod 0)
+        {{0x8B, 0x44, 0x8D, 0x08}, 4},
+        {Bytes{0x8B, 0x84, 0x8D} + le32(0x100), 7},
+        {Bytes{0x8B, 0x04, 0x8D} + le32(0x1000), 7},
+        // ESP base needs a SIB byte
+        {{0x8B, 0x04, 0x24}, 3},
+        {{0x8B, 0x44, 0x24, 0x08}, 4},
+        // x87 memory and register forms
+        {Bytes{0xD9, 0x05} + le32(0x1000), 6},
+        {{0xDD, 0x45, 0x08}, 3},
+        {{0xD8, 0xC1}, 2},
+        {{0xDF, 0x2C, 0x24}, 3},
+        {{0xDB, 0x4C, 0x24, 0x04}, 4},
+        // SSE with mandatory prefixes
+        {{0xF3, 0x0F, 0x10, 0x45, 0x08}, 5},
+        {{0xF2, 0x0F, 0x11, 0x04, 0x24}, 5},
+        {{0x0F, 0x28, 0xC1}, 3},
+        {{0xF3, 0x0F, 0x2C, 0xC0}, 4},
+        // pushad, popad, pushfd, popfd
+        {{0x60}, 1},
+        {{0x61}, 1},
+        {{0x9C}, 1},
+        {{0x9D}, 1},
+    };
+    for (const auto& c : cases) {
+        Bytes padded = c.code + Bytes(8, 0);
+        size_t len = get_instruction_len(padded.data());
+        CHECK(len == c.len);
+        if (len != c.len) {
+            code_test::print_bytes("  code", c.code);
+        }
+    }
+    CHECK(code_test::g_num_unknown_opcodes == 0);
+}
+
+// Memory operands written with an explicit encoding
+TEST_CASE(memory_operand_encodings)
+{
+    // [ebp] has no mod 0 form, a zero disp8 is used
+    CHECK(code_test::expect_code([](AsmWriter& a) { a.mov(eax, *ebp); }, {0x8B, 0x45, 0x00}));
+    CHECK(code_test::expect_code([](AsmWriter& a) { a.mov(eax, *esp); }, {0x8B, 0x04, 0x24}));
+    CHECK(code_test::expect_code([](AsmWriter& a) { a.mov(eax, *(ebp + ecx * 4)); }, {0x8B, 0x44, 0x8D, 0x00}));
+    CHECK(code_test::expect_code([](AsmWriter& a) { a.mov(eax, *(ebp + 8 + ecx * 4)); }, {0x8B, 0x44, 0x8D, 0x08}));
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        a.mov(eax, *(ebp + 0x100 + ecx * 4));
+    }, Bytes{0x8B, 0x84, 0x8D} + le32(0x100)));
+    // No base is a disp32 even if it is zero
+    CHECK(code_test::expect_code([](AsmWriter& a) { a.mov(eax, *(ecx * 4 + 0)); }, Bytes{0x8B, 0x04, 0x8D} + le32(0)));
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        a.mov(eax, AsmRegMem(0x1000u));
+    }, Bytes{0x8B, 0x05} + le32(0x1000)));
+}
+
+#ifdef SOPOT_OBJDUMP
+
+namespace
+{
+    struct DisasmLine
+    {
+        size_t offset;
+        std::string text;
+    };
+
+    std::vector<DisasmLine> disassemble(const Bytes& bytes)
+    {
+        char path[] = "/tmp/asm-writer-test-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            return {};
+        }
+        bool written = write(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size());
+        close(fd);
+        std::vector<DisasmLine> lines;
+        std::string cmd = std::string{SOPOT_OBJDUMP} + " -D -z -b binary -m i386 -M intel --insn-width=16 " + path;
+        FILE* pipe = written ? popen(cmd.c_str(), "r") : nullptr;
+        if (pipe) {
+            char line[512];
+            while (std::fgets(line, sizeof(line), pipe)) {
+                // "   1f:\t8b 44 8d 08    \tmov    eax,DWORD PTR [ebp+ecx*4+0x8]"
+                char* end;
+                size_t offset = std::strtoul(line, &end, 16);
+                if (end != line && end[0] == ':' && end[1] == '\t') {
+                    lines.push_back({offset, end + 2});
+                }
+            }
+            pclose(pipe);
+        }
+        unlink(path);
+        return lines;
+    }
+
+    std::optional<int> parse_reg(const std::string& name)
+    {
+        for (int i = 0; i < 8; ++i) {
+            if (name == reg_names[i]) {
+                return i;
+            }
+        }
+        return {};
+    }
+
+    // Checks the memory operand printed by objdump, e.g. "[ebp+ecx*4+0x8]" or "ds:0x1000"
+    bool memory_operand_matches(const std::string& text, const AsmRegMem& rm)
+    {
+        std::optional<int> base, index;
+        int scale = 1;
+        int64_t disp = 0;
+        std::string operand;
+        if (auto open = text.find('['); open != std::string::npos) {
+            operand = text.substr(open + 1, text.find(']', open) - open - 1);
+        }
+        else if (auto ds = text.find("ds:"); ds != std::string::npos) {
+            operand = text.substr(ds + 3);
+            operand = operand.substr(0, operand.find_first_of(" ,\n"));
+        }
+        else {
+            return false;
+        }
+        size_t pos = 0;
+        while (pos < operand.size()) {
+            bool negative = operand[pos] == '-';
+            if (operand[pos] == '+' || operand[pos] == '-') {
+                ++pos;
+            }
+            size_t next = operand.find_first_of("+-", pos);
+            std::string term = operand.substr(pos, next - pos);
+            pos = next == std::string::npos ? operand.size() : next;
+            if (term.starts_with("0x")) {
+                int64_t value = std::strtoll(term.c_str(), nullptr, 16);
+                disp += negative ? -value : value;
+            }
+            else if (auto star = term.find('*'); star != std::string::npos) {
+                // eiz is objdump's name for "no index"
+                if (term.substr(0, star) != "eiz") {
+                    index = parse_reg(term.substr(0, star));
+                    scale = std::atoi(term.c_str() + star + 1);
+                }
+            }
+            else {
+                base = parse_reg(term);
+            }
+        }
+        std::optional<int> expected_base, expected_index;
+        if (rm.reg_opt) {
+            expected_base = rm.reg_opt->reg_num;
+        }
+        if (rm.index_opt) {
+            expected_index = rm.index_opt->reg_num;
+        }
+        return base == expected_base && index == expected_index && (!index || scale == rm.scale) &&
+            static_cast<int32_t>(disp) == rm.displacement;
+    }
+}
+
+TEST_CASE(generated_code_matches_objdump)
+{
+    auto all = generate_all();
+    REQUIRE(!all.empty());
+    int num_failed = 0;
+    for (const auto& code : all) {
+        auto lines = disassemble(code.bytes);
+        REQUIRE(!lines.empty());
+        size_t line_idx = 0;
+        for (size_t i = 0; i + 1 < code.offsets.size(); ++i) {
+            while (line_idx < lines.size() && lines[line_idx].offset < code.offsets[i]) {
+                ++line_idx;
+            }
+            bool ok = line_idx < lines.size() && lines[line_idx].offset == code.offsets[i] &&
+                lines[line_idx].text.find("(bad)") == std::string::npos;
+            if (ok && !is_multi_instruction(code, i)) {
+                ok = line_idx + 1 < lines.size() ? lines[line_idx + 1].offset == code.offsets[i + 1]
+                                                 : code.offsets[i + 1] == code.bytes.size();
+            }
+            if (ok && code.operands[i].memory) {
+                ok = memory_operand_matches(lines[line_idx].text, code.operands[i]);
+            }
+            if (!ok) {
+                report(code, i, line_idx < lines.size() ? lines[line_idx].text.c_str() : "no instruction");
+                ++num_failed;
+            }
+        }
+    }
+    CHECK(num_failed == 0);
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include "../test.h"
+#include "code-test-utils.h"
+#include <patch_common/AsmWriter.h>
+
+using namespace asm_regs;
+using code_test::Bytes;
+using code_test::le32;
+using code_test::nops;
+
+TEST_CASE(backward_branches_use_rel8_when_in_range)
+{
+    // Self loop
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto loop = a.new_label();
+        a.bind(loop).jmp(loop);
+    }, {0xEB, 0xFE}));
+
+    // Displacement -128 is the last one that fits
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto top = a.new_label();
+        a.bind(top).nop(126).jmp(top);
+    }, nops(126) + Bytes{0xEB, 0x80}));
+
+    // One more byte needs rel32, the longer encoding moves the end of the branch too
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto top = a.new_label();
+        a.bind(top).nop(127).jmp(top);
+    }, nops(127) + Bytes{0xE9} + le32(-132)));
+
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto top = a.new_label();
+        a.bind(top).nop(200).jne(top);
+    }, nops(200) + Bytes{0x0F, 0x85} + le32(-206)));
+}
+
+TEST_CASE(forward_references_are_resolved)
+{
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto skip = a.new_label();
+        a.je(skip).nop(3).bind(skip).ret();
+    }, Bytes{0x74, 0x03} + nops(3) + Bytes{0xC3}));
+
+    // Label bound directly after the branch
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto next = a.new_label();
+        a.jmp(next).bind(next).ret();
+    }, {0xEB, 0x00, 0xC3}));
+
+    // Displacement 127 is the last one that fits
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto end = a.new_label();
+        a.jcc(AsmCond::a, end).nop(127).bind(end);
+    }, Bytes{0x77, 0x7F} + nops(127)));
+
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto end = a.new_label();
+        a.jcc(AsmCond::a, end).nop(128).bind(end);
+    }, Bytes{0x0F, 0x87} + le32(128) + nops(128)));
+
+    // Several branches to one label and a label that is never branched to
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto end = a.new_label();
+        auto unused = a.new_label();
+        a.cmp(eax, ecx).je(end).jl(end).bind(unused).mov(eax, 1).bind(end).ret();
+    }, Bytes{0x39, 0xC8, 0x74, 0x07, 0x7C, 0x05, 0xB8} + le32(1) + Bytes{0xC3}));
+}
+
+TEST_CASE(relaxation_cascades)
+{
+    // The jne fits in rel8 only while the jmp after it is short. The jmp has to be widened to reach its target, which
+    // pushes the jne out of range too.
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto near_end = a.new_label();
+        auto far_end = a.new_label();
+        a.jne(near_end).nop(125).jmp(far_end).bind(near_end).nop(200).bind(far_end).ret();
+    }, Bytes{0x0F, 0x85} + le32(130) + nops(125) + Bytes{0xE9} + le32(200) + nops(200) + Bytes{0xC3}));
+
+    // Backward branch over a forward branch that gets widened
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto top = a.new_label();
+        auto far_end = a.new_label();
+        a.bind(top).nop(60).jmp(far_end).nop(63).jne(top).nop(130).bind(far_end);
+    }, nops(60) + Bytes{0xE9} + le32(63 + 6 + 130) + nops(63) + Bytes{0x0F, 0x85} + le32(-134) + nops(130)));
+
+    // Same code with the forward branch close enough to stay short
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto top = a.new_label();
+        auto far_end = a.new_label();
+        a.bind(top).nop(60).jmp(far_end).nop(63).jne(top).nop(10).bind(far_end);
+    }, nops(60) + Bytes{0xEB, 63 + 2 + 10} + nops(63) + Bytes{0x75, static_cast<u8>(-127)} + nops(10)));
+}
+
+TEST_CASE(forced_branch_sizes)
+{
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto next = a.new_label();
+        a.jmp_long(next).bind(next);
+    }, Bytes{0xE9} + le32(0)));
+
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto fn = a.new_label();
+        auto end = a.new_label();
+        a.call(fn).jmp_short(end).bind(fn).ret().bind(end);
+    }, Bytes{0xE8} + le32(2) + Bytes{0xEB, 0x01, 0xC3}));
+}
+
+TEST_CASE(branches_to_absolute_addresses)
+{
+    code_test::CodeBuffer buf;
+    const uintptr_t base = buf.addr();
+
+    CHECK(code_test::expect_code_at(base, [&](AsmWriter& a) {
+        a.nop().jmp(base);
+    }, {0x90, 0xEB, 0xFD}));
+
+    CHECK(code_test::expect_code_at(base, [&](AsmWriter& a) {
+        a.jmp(base + 0x1000);
+    }, Bytes{0xE9} + le32(0x1000 - 5)));
+
+    CHECK(code_test::expect_code_at(base, [&](AsmWriter& a) {
+        a.jcc(AsmCond::b, base + 0x10).jcc(AsmCond::b, base + 0x1000);
+    }, Bytes{0x72, 0x0E, 0x0F, 0x82} + le32(0x1000 - 8)));
+
+    // call and jg are always rel32, jl is always rel8
+    CHECK(code_test::expect_code_at(base, [&](AsmWriter& a) {
+        a.call(static_cast<uint32_t>(base + 0x20)).jg(base).jl(base);
+    }, Bytes{0xE8} + le32(0x20 - 5) + Bytes{0x0F, 0x8F} + le32(-11) + Bytes{0x7C, static_cast<u8>(-13)}));
+}
+
+TEST_CASE(measure_mode_computes_size_before_allocation)
+{
+    auto emit = [](AsmWriter& a, uintptr_t target) {
+        auto loop = a.new_label();
+        auto done = a.new_label();
+        a.mov(ecx, 10).bind(loop).dec(ecx).je(done).nop(130).jmp(loop).bind(done).jmp(target);
+    };
+
+    AsmWriter measure;
+    code_test::CodeBuffer buf;
+    const uintptr_t target = buf.addr() + 0x100;
+    emit(measure, target);
+    // Absolute targets are unknown in measure mode and counted as rel32
+    size_t measured = measure.size();
+    CHECK(measured == 5 + 1 + 6 + 130 + 5 + 5);
+    measure.finish(buf.addr());
+
+    // The real address lets the last jump shrink to rel8
+    auto expected = Bytes{0xB9} + le32(10) + Bytes{0x48 | 1, 0x0F, 0x84} + le32(135) + nops(130) + Bytes{0xE9} +
+        le32(-(6 + 130 + 5 + 1)) + Bytes{0xEB, static_cast<u8>(0x100 - (measured - 3))};
+    CHECK(expected.size() == measured - 3);
+    CHECK(buf.bytes(expected.size()) == expected);
+
+    // With only labels the measured size is exact
+    AsmWriter labels_only;
+    auto skip = labels_only.new_label();
+    labels_only.je(skip).nop(10).bind(skip).ret();
+    CHECK(labels_only.size() == 13);
+    labels_only.finish(buf.addr());
+    CHECK(buf.bytes(13) == Bytes{0x74, 0x0A} + nops(10) + Bytes{0xC3});
+}
+
+TEST_CASE(finish_pads_up_to_end_address)
+{
+    code_test::CodeBuffer buf;
+    buf.fill(0xCC);
+    {
+        AsmWriter a{buf.addr(), buf.addr() + 8};
+        a.push(eax).pop(eax);
+    }
+    CHECK(buf.bytes(9) == (Bytes{0x50, 0x58} + nops(6) + Bytes{0xCC}));
+}
+
+TEST_CASE(instructions_between_branches_keep_their_bytes)
+{
+    // Branch offsets are tracked separately from the instruction bytes around them
+    CHECK(code_test::expect_code([](AsmWriter& a) {
+        auto loop = a.new_label();
+        auto done = a.new_label();
+        a.xor_(eax, eax).mov(ecx, 4).bind(loop).add(eax, *(esi + ecx * 4 - 4)).dec(ecx).jne(loop).bind(done).ret();
+    }, Bytes{0x33, 0xC0, 0xB9} + le32(4) + Bytes{0x03, 0x44, 0x8E, 0xFC, 0x49, 0x75, 0xF9, 0xC3}));
+}
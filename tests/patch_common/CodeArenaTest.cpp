@@ -0,0 +1,260 @@
+#include "../test.h"
+#include <patch_common/CodeArena.h>
+#include <sys/mman.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    size_t distance(uintptr_t a, uintptr_t b)
+    {
+        return a > b ? a - b : b - a;
+    }
+
+    bool fits_rel32(uintptr_t from, uintptr_t to)
+    {
+        auto disp = static_cast<int64_t>(to) - static_cast<int64_t>(from);
+        return disp >= INT32_MIN && disp <= INT32_MAX;
+    }
+
+    // Forwards to the mmap allocator and keeps track of live regions
+    class RecordingAllocator : public CodePageAllocator
+    {
+    public:
+        struct Region
+        {
+            void* ptr;
+            size_t size;
+        };
+
+        std::vector<Region> live;
+        bool fail_near = false;
+
+        [[nodiscard]] size_t granularity() const override
+        {
+            return get_default_code_page_allocator().granularity();
+        }
+
+        void* alloc_near(uintptr_t hint, size_t size, size_t max_distance) override
+        {
+            if (hint && fail_near) {
+                return nullptr;
+            }
+            void* ptr = get_default_code_page_allocator().alloc_near(hint, size, max_distance);
+            if (ptr) {
+                live.push_back({ptr, size});
+            }
+            return ptr;
+        }
+
+        void free(void* ptr, size_t size) override
+        {
+            std::erase_if(live, [=](const Region& region) { return region.ptr == ptr; });
+            get_default_code_page_allocator().free(ptr, size);
+        }
+
+        [[nodiscard]] bool owns(const void* ptr) const
+        {
+            for (const auto& region : live) {
+                auto* base = static_cast<const std::byte*>(region.ptr);
+                if (ptr >= base && ptr < base + region.size) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    bool is_mapped(const void* ptr)
+    {
+        unsigned char vec;
+        auto page = reinterpret_cast<uintptr_t>(ptr) & ~(get_default_code_page_allocator().granularity() - 1);
+        return mincore(reinterpret_cast<void*>(page), 1, &vec) == 0;
+    }
+
+    // mov eax, value; ret
+    int (*emit_return_value(void* ptr, int32_t value))()
+    {
+        auto* code = static_cast<uint8_t*>(ptr);
+        code[0] = 0xB8;
+        std::memcpy(code + 1, &value, sizeof(value));
+        code[5] = 0xC3;
+        return reinterpret_cast<int (*)()>(ptr);
+    }
+
+    int function_in_image()
+    {
+        return 0;
+    }
+}
+
+TEST_CASE(allocator_places_region_near_hint)
+{
+    auto& allocator = get_default_code_page_allocator();
+    const size_t size = 0x10000;
+    // Code of this executable, a heap block and a mapping placed by the kernel are all typical hints
+    static int data_in_image = 0;
+    void* heap_block = std::malloc(64);
+    void* mapping = mmap(nullptr, 0x1000, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uintptr_t hints[] = {
+        reinterpret_cast<uintptr_t>(&function_in_image),
+        reinterpret_cast<uintptr_t>(&data_in_image),
+        reinterpret_cast<uintptr_t>(heap_block),
+        reinterpret_cast<uintptr_t>(mapping),
+    };
+    for (uintptr_t hint : hints) {
+        void* ptr = allocator.alloc_near(hint, size, CodeArena::max_near_distance);
+        REQUIRE(ptr != nullptr);
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        CHECK(addr % allocator.granularity() == 0);
+        CHECK(distance(addr, hint) <= CodeArena::max_near_distance);
+        CHECK(fits_rel32(hint, addr) && fits_rel32(addr + size, hint));
+        // Close means the nearest free gap, not just somewhere within 2 GB
+        CHECK(distance(addr, hint) < 0x10000000);
+        allocator.free(ptr, size);
+    }
+    munmap(mapping, 0x1000);
+    std::free(heap_block);
+}
+
+TEST_CASE(allocator_fails_when_no_free_region_is_near)
+{
+    auto& allocator = get_default_code_page_allocator();
+    // Everything around the hint is taken
+    const size_t reserved_size = 0x400000;
+    void* reserved = mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(reserved != MAP_FAILED);
+    uintptr_t hint = reinterpret_cast<uintptr_t>(reserved) + reserved_size / 2;
+    CHECK(allocator.alloc_near(hint, 0x10000, 0x100000) == nullptr);
+    munmap(reserved, reserved_size);
+}
+
+TEST_CASE(arena_packs_thunks_densely)
+{
+    RecordingAllocator allocator;
+    CodeArena arena{allocator};
+    const auto hint = reinterpret_cast<uintptr_t>(&function_in_image);
+
+    std::vector<uint8_t*> thunks;
+    for (int i = 0; i < 100; ++i) {
+        auto* ptr = static_cast<uint8_t*>(arena.alloc(20, hint));
+        REQUIRE(ptr != nullptr);
+        thunks.push_back(ptr);
+    }
+    CHECK(allocator.live.size() == 1);
+    for (size_t i = 1; i < thunks.size(); ++i) {
+        CHECK(thunks[i] == thunks[i - 1] + 32);
+    }
+    CHECK(reinterpret_cast<uintptr_t>(thunks[0]) % CodeArena::alignment == 0);
+    CHECK(arena.bytes_used() == 100 * 32);
+    CHECK(arena.bytes_reserved() == CodeArena::default_chunk_size);
+    CHECK(fits_rel32(hint, reinterpret_cast<uintptr_t>(thunks.back())));
+
+    // Blocks are executable
+    for (size_t i = 0; i < thunks.size(); ++i) {
+        auto fn = emit_return_value(thunks[i], static_cast<int32_t>(i));
+        CHECK(fn() == static_cast<int>(i));
+    }
+}
+
+TEST_CASE(arena_keeps_separate_chunks_for_distant_hints)
+{
+    RecordingAllocator allocator;
+    CodeArena arena{allocator};
+    const auto near_hint = reinterpret_cast<uintptr_t>(&function_in_image);
+    void* far_mapping = mmap(nullptr, 0x1000, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    const auto far_hint = reinterpret_cast<uintptr_t>(far_mapping);
+    if (distance(near_hint, far_hint) <= CodeArena::max_near_distance) {
+        // Without address space layout randomization both hints can be close, nothing to check then
+        munmap(far_mapping, 0x1000);
+        return;
+    }
+
+    void* a = arena.alloc(16, near_hint);
+    void* b = arena.alloc(16, far_hint);
+    void* c = arena.alloc(16, near_hint);
+    CHECK(allocator.live.size() == 2);
+    CHECK(fits_rel32(near_hint, reinterpret_cast<uintptr_t>(a)));
+    CHECK(fits_rel32(far_hint, reinterpret_cast<uintptr_t>(b)));
+    CHECK(static_cast<std::byte*>(c) == static_cast<std::byte*>(a) + 16);
+    munmap(far_mapping, 0x1000);
+}
+
+TEST_CASE(arena_gives_large_blocks_their_own_chunk)
+{
+    RecordingAllocator allocator;
+    CodeArena arena{allocator};
+    void* small = arena.alloc(16);
+    void* large = arena.alloc(CodeArena::default_chunk_size + 1);
+    REQUIRE(small && large);
+    CHECK(allocator.live.size() == 2);
+    CHECK(arena.bytes_reserved() >= 2 * CodeArena::default_chunk_size + 1);
+    // The first chunk still has room
+    void* next = arena.alloc(16);
+    CHECK(static_cast<std::byte*>(next) == static_cast<std::byte*>(small) + 16);
+}
+
+TEST_CASE(arena_frees_by_generation)
+{
+    RecordingAllocator allocator;
+    CodeArena arena{allocator};
+    const auto hint = reinterpret_cast<uintptr_t>(&function_in_image);
+
+    CodeArena::Generation gen0 = arena.current_generation();
+    void* old_thunk = arena.alloc(32, hint);
+    auto old_fn = emit_return_value(old_thunk, 7);
+
+    CodeArena::Generation gen1 = arena.begin_generation();
+    CHECK(gen1 != gen0);
+    CHECK(arena.current_generation() == gen1);
+    std::vector<void*> new_thunks;
+    for (int i = 0; i < 10; ++i) {
+        new_thunks.push_back(arena.alloc(32, hint));
+    }
+    // A new generation never shares a chunk with an older one even if the old chunk has room
+    CHECK(allocator.live.size() == 2);
+    for (void* ptr : new_thunks) {
+        CHECK(ptr != nullptr);
+        CHECK(allocator.live[1].ptr <= ptr);
+    }
+
+    arena.free_generation(gen1);
+    CHECK(allocator.live.size() == 1);
+    CHECK(allocator.owns(old_thunk));
+    CHECK(!is_mapped(new_thunks[0]));
+    CHECK(arena.bytes_used() == 32);
+    // Older generations are untouched and still run
+    CHECK(old_fn() == 7);
+
+    // Allocations keep going to the current generation, which gets a fresh chunk
+    void* after_free = arena.alloc(32, hint);
+    CHECK(allocator.live.size() == 2);
+    arena.free_generation(gen0);
+    CHECK(allocator.live.size() == 1);
+    CHECK(allocator.owns(after_free));
+}
+
+TEST_CASE(arena_falls_back_to_any_address)
+{
+    RecordingAllocator allocator;
+    allocator.fail_near = true;
+    CodeArena arena{allocator};
+    void* ptr = arena.alloc(16, reinterpret_cast<uintptr_t>(&function_in_image));
+    CHECK(ptr != nullptr);
+    CHECK(allocator.live.size() == 1);
+}
+
+TEST_CASE(arena_releases_chunks_on_destruction)
+{
+    RecordingAllocator allocator;
+    {
+        CodeArena arena{allocator};
+        arena.alloc(16);
+        arena.begin_generation();
+        arena.alloc(16);
+        CHECK(allocator.live.size() == 2);
+    }
+    CHECK(allocator.live.empty());
+}
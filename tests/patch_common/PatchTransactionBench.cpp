@@ -0,0 +1,104 @@
+#include "../bench.h"
+#include <patch_common/PatchTransaction.h>
+#include <sys/mman.h>
+#include <cstdint>
+#include <cstdio>
+
+// Compares patching a set of scattered immediates one write at a time (one protection change pair per write, like
+// write_mem) with a single PatchTransaction, and measures rollback of the batch.
+
+namespace
+{
+    class CountingBackend : public MemProtectionBackend
+    {
+    public:
+        size_t num_calls = 0;
+
+        [[nodiscard]] size_t page_size() const override
+        {
+            return get_default_mem_protection_backend().page_size();
+        }
+
+        bool unprotect(uintptr_t addr, size_t size, unsigned& old_protect) override
+        {
+            ++num_calls;
+            return get_default_mem_protection_backend().unprotect(addr, size, old_protect);
+        }
+
+        bool restore(uintptr_t addr, size_t size, unsigned old_protect) override
+        {
+            ++num_calls;
+            return get_default_mem_protection_backend().restore(addr, size, old_protect);
+        }
+
+        void flush_instruction_cache(uintptr_t addr, size_t size) override
+        {
+            get_default_mem_protection_backend().flush_instruction_cache(addr, size);
+        }
+    };
+
+    void run(size_t num_pages, size_t num_writes)
+    {
+        CountingBackend backend;
+        const size_t page_size = backend.page_size();
+        const size_t size = num_pages * page_size;
+        auto* base = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0));
+        if (base == MAP_FAILED) {
+            std::perror("mmap");
+            return;
+        }
+        // Spread the writes over all pages like the FOV and reticle patches are spread over the code section
+        auto write_addr = [&](size_t i) {
+            return reinterpret_cast<uintptr_t>(base) + (i * 4099) % (size - sizeof(uint32_t));
+        };
+        const size_t rounds = bench::iterations(200);
+        char name[64];
+
+        backend.num_calls = 0;
+        double single_ns = bench::time_ns([&] {
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < num_writes; ++i) {
+                    PatchTransaction tx{backend};
+                    tx.write<uint32_t>(write_addr(i), static_cast<uint32_t>(r + i));
+                    tx.commit();
+                }
+            }
+        });
+        size_t single_calls = backend.num_calls / rounds;
+        std::snprintf(name, sizeof(name), "write-by-write (%zu writes, %zu pages)", num_writes, num_pages);
+        bench::report(name, single_ns, rounds * num_writes);
+
+        backend.num_calls = 0;
+        double batch_ns = 0;
+        double rollback_ns = 0;
+        for (size_t r = 0; r < rounds; ++r) {
+            PatchTransaction tx{backend};
+            batch_ns += bench::time_ns([&] {
+                for (size_t i = 0; i < num_writes; ++i) {
+                    tx.write<uint32_t>(write_addr(i), static_cast<uint32_t>(r + i));
+                }
+                tx.commit();
+            });
+            rollback_ns += bench::time_ns([&] { tx.rollback(); });
+        }
+        size_t batch_calls = backend.num_calls / rounds;
+        std::snprintf(name, sizeof(name), "transaction (%zu writes, %zu pages)", num_writes, num_pages);
+        bench::report(name, batch_ns, rounds * num_writes);
+        std::snprintf(name, sizeof(name), "rollback (%zu writes, %zu pages)", num_writes, num_pages);
+        bench::report(name, rollback_ns, rounds * num_writes);
+        std::printf("protection changes per batch: write-by-write %zu, transaction %zu (+%zu for rollback)\n\n",
+            single_calls, batch_calls / 2, batch_calls / 2);
+
+        munmap(base, size);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    run(4, 64);
+    run(40, 500);
+    run(200, 2000);
+    return 0;
+}
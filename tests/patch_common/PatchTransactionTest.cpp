@@ -0,0 +1,268 @@
+#include "../test.h"
+#include <patch_common/PatchTransaction.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Forwards to the mprotect backend and records what the transaction asked for
+    class RecordingBackend : public MemProtectionBackend
+    {
+    public:
+        std::vector<uintptr_t> unprotected;
+        std::vector<uintptr_t> restored;
+        std::vector<uintptr_t> flushed;
+        uintptr_t fail_page = 0;
+
+        [[nodiscard]] size_t page_size() const override
+        {
+            return get_default_mem_protection_backend().page_size();
+        }
+
+        bool unprotect(uintptr_t addr, size_t size, unsigned& old_protect) override
+        {
+            if (addr == fail_page) {
+                return false;
+            }
+            unprotected.push_back(addr);
+            return get_default_mem_protection_backend().unprotect(addr, size, old_protect);
+        }
+
+        bool restore(uintptr_t addr, size_t size, unsigned old_protect) override
+        {
+            restored.push_back(addr);
+            return get_default_mem_protection_backend().restore(addr, size, old_protect);
+        }
+
+        void flush_instruction_cache(uintptr_t addr, size_t size) override
+        {
+            flushed.push_back(addr);
+            get_default_mem_protection_backend().flush_instruction_cache(addr, size);
+        }
+    };
+
+    // Read-only pages filled with a byte pattern
+    class ReadOnlyPages
+    {
+    public:
+        static constexpr size_t num_pages = 4;
+
+        ReadOnlyPages()
+        {
+            m_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            void* ptr = mmap(nullptr, size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            m_base = static_cast<uint8_t*>(ptr);
+            for (size_t i = 0; i < size(); ++i) {
+                m_base[i] = static_cast<uint8_t>(i);
+            }
+            mprotect(m_base, size(), PROT_READ);
+        }
+
+        ~ReadOnlyPages()
+        {
+            munmap(m_base, size());
+        }
+
+        [[nodiscard]] size_t size() const
+        {
+            return num_pages * m_page_size;
+        }
+
+        [[nodiscard]] size_t page_size() const
+        {
+            return m_page_size;
+        }
+
+        [[nodiscard]] uintptr_t addr(size_t offset) const
+        {
+            return reinterpret_cast<uintptr_t>(m_base) + offset;
+        }
+
+        [[nodiscard]] uint8_t at(size_t offset) const
+        {
+            return m_base[offset];
+        }
+
+        [[nodiscard]] bool is_unchanged() const
+        {
+            for (size_t i = 0; i < size(); ++i) {
+                if (m_base[i] != static_cast<uint8_t>(i)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        uint8_t* m_base;
+        size_t m_page_size;
+    };
+
+    // Permissions of the mapping containing addr as listed in /proc/self/maps, e.g. "r--p"
+    std::string get_mapping_perms(uintptr_t addr)
+    {
+        std::FILE* maps = std::fopen("/proc/self/maps", "r");
+        char line[512];
+        std::string result;
+        while (maps && std::fgets(line, sizeof(line), maps)) {
+            uintptr_t begin, end;
+            char perms[5];
+            if (std::sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s", &begin, &end, perms) == 3 &&
+                addr >= begin && addr < end) {
+                result = perms;
+                break;
+            }
+        }
+        if (maps) {
+            std::fclose(maps);
+        }
+        return result;
+    }
+}
+
+TEST_CASE(commit_unprotects_each_page_once)
+{
+    ReadOnlyPages pages;
+    RecordingBackend backend;
+    const size_t page = pages.page_size();
+
+    PatchTransaction tx{backend};
+    tx.write<uint8_t>(pages.addr(1), 0xAA);
+    tx.write<uint32_t>(pages.addr(16), 0x11223344);
+    tx.write<uint8_t>(pages.addr(2 * page + 5), 0xBB);
+    // Crosses the boundary between page 0 and page 1
+    tx.write<uint32_t>(pages.addr(page - 2), 0xDDCCBBAA);
+    REQUIRE(tx.commit());
+
+    CHECK(tx.is_committed());
+    CHECK(backend.unprotected.size() == 3);
+    CHECK(backend.unprotected == (std::vector{pages.addr(0), pages.addr(page), pages.addr(2 * page)}));
+    CHECK(backend.restored == backend.unprotected);
+    CHECK(backend.flushed == backend.unprotected);
+
+    CHECK(pages.at(1) == 0xAA);
+    uint32_t value;
+    std::memcpy(&value, reinterpret_cast<void*>(pages.addr(16)), sizeof(value));
+    CHECK(value == 0x11223344);
+    CHECK(pages.at(2 * page + 5) == 0xBB);
+    CHECK(pages.at(page - 2) == 0xAA);
+    CHECK(pages.at(page + 1) == 0xDD);
+    // Bytes around the writes are left alone
+    CHECK(pages.at(0) == 0);
+    CHECK(pages.at(2) == 2);
+    CHECK(pages.at(2 * page + 4) == 4);
+
+    // Protection of every page is back to what it was
+    for (size_t i = 0; i < ReadOnlyPages::num_pages; ++i) {
+        CHECK(get_mapping_perms(pages.addr(i * page)) == "r--p");
+    }
+}
+
+TEST_CASE(rollback_restores_original_bytes)
+{
+    ReadOnlyPages pages;
+    RecordingBackend backend;
+    const size_t page = pages.page_size();
+
+    PatchTransaction tx{backend};
+    tx.write<uint32_t>(pages.addr(100), 0xFFFFFFFF);
+    // Overlaps the first write, rollback must still end with the original bytes
+    tx.write<uint16_t>(pages.addr(102), 0x1234);
+    tx.write<uint64_t>(pages.addr(3 * page - 4), 0x0102030405060708);
+    REQUIRE(tx.commit());
+    CHECK(!pages.is_unchanged());
+
+    REQUIRE(tx.rollback());
+    CHECK(!tx.is_committed());
+    CHECK(pages.is_unchanged());
+    CHECK(backend.unprotected.size() == 6);
+    CHECK(get_mapping_perms(pages.addr(0)) == "r--p");
+
+    // The same staged writes can be applied again
+    REQUIRE(tx.commit());
+    CHECK(pages.at(102) == 0x34);
+    CHECK(pages.at(103) == 0x12);
+}
+
+TEST_CASE(failed_unprotect_writes_nothing)
+{
+    ReadOnlyPages pages;
+    RecordingBackend backend;
+    const size_t page = pages.page_size();
+    backend.fail_page = pages.addr(2 * page);
+
+    PatchTransaction tx{backend};
+    tx.write<uint8_t>(pages.addr(0), 0xAA);
+    tx.write<uint8_t>(pages.addr(page), 0xBB);
+    tx.write<uint8_t>(pages.addr(2 * page), 0xCC);
+    tx.write<uint8_t>(pages.addr(3 * page), 0xDD);
+    CHECK(!tx.commit());
+    CHECK(!tx.is_committed());
+    CHECK(pages.is_unchanged());
+    // Pages unprotected before the failure get their protection back
+    CHECK(backend.restored == (std::vector{pages.addr(0), pages.addr(page)}));
+    CHECK(get_mapping_perms(pages.addr(0)) == "r--p");
+    CHECK(get_mapping_perms(pages.addr(page)) == "r--p");
+}
+
+TEST_CASE(unmapped_page_aborts_commit)
+{
+    ReadOnlyPages pages;
+    const size_t page = pages.page_size();
+    // Punch a hole in the middle of the mapping
+    munmap(reinterpret_cast<void*>(pages.addr(page)), page);
+
+    PatchTransaction tx;
+    tx.write<uint8_t>(pages.addr(0), 0xAA);
+    tx.write<uint8_t>(pages.addr(page + 10), 0xBB);
+    CHECK(!tx.commit());
+    CHECK(pages.at(0) == 0);
+}
+
+TEST_CASE(commit_and_rollback_state_checks)
+{
+    ReadOnlyPages pages;
+    PatchTransaction tx;
+    CHECK(!tx.rollback());
+    CHECK(tx.commit());
+    CHECK(!tx.is_committed());
+
+    tx.write<uint8_t>(pages.addr(7), 0x77);
+    CHECK(tx.num_writes() == 1);
+    CHECK(tx.commit());
+    CHECK(!tx.commit());
+    CHECK(pages.at(7) == 0x77);
+
+    // Clearing forgets the writes without reverting them
+    tx.clear();
+    CHECK(tx.num_writes() == 0);
+    CHECK(!tx.is_committed());
+    CHECK(pages.at(7) == 0x77);
+}
+
+TEST_CASE(patched_code_is_executable)
+{
+    const size_t page = get_default_mem_protection_backend().page_size();
+    void* ptr = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(ptr != MAP_FAILED);
+    // mov eax, 1; ret
+    const uint8_t code[] = {0xB8, 0x01, 0x00, 0x00, 0x00, 0xC3};
+    std::memcpy(ptr, code, sizeof(code));
+    REQUIRE(mprotect(ptr, page, PROT_READ | PROT_EXEC) == 0);
+    auto fn = reinterpret_cast<int (*)()>(ptr);
+    CHECK(fn() == 1);
+
+    PatchTransaction tx;
+    tx.write<int32_t>(reinterpret_cast<uintptr_t>(ptr) + 1, 42);
+    REQUIRE(tx.commit());
+    CHECK(fn() == 42);
+    CHECK(get_mapping_perms(reinterpret_cast<uintptr_t>(ptr)) == "r-xp");
+    REQUIRE(tx.rollback());
+    CHECK(fn() == 1);
+    munmap(ptr, page);
+}
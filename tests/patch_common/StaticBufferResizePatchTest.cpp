@@ -0,0 +1,244 @@
+#include "../test.h"
+#include "code-test-utils.h"
+#include <patch_common/PeRelocations.h>
+#include <patch_common/StaticBufferResizePatch.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using Patch = StaticBufferResizePatch<int32_t>;
+
+    constexpr size_t old_num_elements = 4;
+    constexpr size_t new_num_elements = 16;
+
+    // Minimal PE32 image with a relocation table. Code at 0x1000 references a buffer of 4 ints at 0x3000 followed by
+    // another variable at 0x3010.
+    class SyntheticImage
+    {
+    public:
+        static constexpr uint32_t code_rva = 0x1000;
+        static constexpr uint32_t reloc_rva = 0x2000;
+        static constexpr uint32_t buf_rva = 0x3000;
+        static constexpr uint32_t buf_end_rva = buf_rva + old_num_elements * sizeof(int32_t);
+        static constexpr uint32_t other_rva = 0x3100;
+
+        // mov eax, [buf + 4]
+        static constexpr uint32_t load_rva = code_rva;
+        // lea ecx, [buf]
+        static constexpr uint32_t lea_rva = code_rva + 5;
+        // cmp esi, buf_end
+        static constexpr uint32_t cmp_end_rva = code_rva + 11;
+        // mov eax, [other]
+        static constexpr uint32_t load_other_rva = code_rva + 17;
+        // pointer to buf + 8 stored in data
+        static constexpr uint32_t data_ptr_rva = code_rva + 0x100;
+
+        code_test::CodeBuffer buf;
+
+        SyntheticImage()
+        {
+            buf.fill(0xCC);
+            put<uint16_t>(0, 0x5A4D); // MZ
+            put<uint32_t>(0x3C, 0x80);
+            put<uint32_t>(0x80, 0x00004550); // PE\0\0
+            const uint32_t optional_header = 0x80 + 4 + 20;
+            put<uint16_t>(optional_header, 0x10B);
+            put<uint32_t>(optional_header + 92, 16);
+            for (uint32_t i = 0; i < 16; ++i) {
+                put<uint64_t>(optional_header + 96 + i * 8, 0);
+            }
+
+            put_insn(load_rva, {0xA1}, buf_rva + 4);
+            put_insn(lea_rva, {0x8D, 0x0D}, buf_rva);
+            put_insn(cmp_end_rva, {0x81, 0xFE}, buf_end_rva);
+            put_insn(load_other_rva, {0xA1}, other_rva);
+            put<uint32_t>(data_ptr_rva, static_cast<uint32_t>(addr() + buf_rva + 8));
+
+            const uint16_t highlow = 3 << 12;
+            const std::vector<uint16_t> entries{
+                static_cast<uint16_t>(highlow | (load_rva + 1 - code_rva)),
+                static_cast<uint16_t>(highlow | (lea_rva + 2 - code_rva)),
+                static_cast<uint16_t>(highlow | (cmp_end_rva + 2 - code_rva)),
+                static_cast<uint16_t>(highlow | (load_other_rva + 1 - code_rva)),
+                static_cast<uint16_t>(highlow | (data_ptr_rva - code_rva)),
+                0, // IMAGE_REL_BASED_ABSOLUTE padding
+            };
+            const auto block_size = static_cast<uint32_t>(8 + entries.size() * sizeof(uint16_t));
+            put<uint32_t>(reloc_rva, code_rva);
+            put<uint32_t>(reloc_rva + 4, block_size);
+            std::memcpy(buf.data() + reloc_rva + 8, entries.data(), entries.size() * sizeof(uint16_t));
+            put<uint32_t>(optional_header + 96 + 5 * 8, reloc_rva);
+            put<uint32_t>(optional_header + 96 + 5 * 8 + 4, block_size);
+
+            for (uint32_t i = 0; i < old_num_elements; ++i) {
+                put<int32_t>(buf_rva + i * 4, static_cast<int32_t>(100 + i));
+            }
+        }
+
+        [[nodiscard]] uintptr_t addr() const
+        {
+            return buf.addr();
+        }
+
+        template<typename T>
+        void put(uint32_t rva, T value)
+        {
+            std::memcpy(buf.data() + rva, &value, sizeof(value));
+        }
+
+        template<typename T>
+        [[nodiscard]] T get(uint32_t rva) const
+        {
+            T value;
+            std::memcpy(&value, buf.data() + rva, sizeof(value));
+            return value;
+        }
+
+        // Pointer operand of the instruction at rva
+        [[nodiscard]] uint32_t operand(uint32_t rva) const
+        {
+            uint8_t opcode = buf.data()[rva];
+            return get<uint32_t>(rva + (opcode == 0xA1 ? 1 : 2));
+        }
+
+    private:
+        void put_insn(uint32_t rva, code_test::Bytes opcode, uint32_t target_rva)
+        {
+            std::memcpy(buf.data() + rva, opcode.data(), opcode.size());
+            put<uint32_t>(rva + static_cast<uint32_t>(opcode.size()), static_cast<uint32_t>(addr() + target_rva));
+        }
+    };
+
+    // New buffer has to be below 4 GB like everything in a 32-bit process
+    struct NewBuffer
+    {
+        code_test::CodeBuffer mem;
+        int32_t (&elements)[new_num_elements] = *reinterpret_cast<int32_t(*)[new_num_elements]>(mem.data());
+
+        [[nodiscard]] uint32_t addr(size_t index) const
+        {
+            return static_cast<uint32_t>(mem.addr() + index * sizeof(int32_t));
+        }
+    };
+}
+
+TEST_CASE(relocations_are_parsed_from_synthetic_image)
+{
+    SyntheticImage image;
+    std::vector<uintptr_t> relocs;
+    REQUIRE(get_image_relocations(image.addr(), relocs));
+    // Padding entry is skipped
+    CHECK(relocs == std::vector<uintptr_t>{
+        image.addr() + SyntheticImage::load_rva + 1,
+        image.addr() + SyntheticImage::lea_rva + 2,
+        image.addr() + SyntheticImage::cmp_end_rva + 2,
+        image.addr() + SyntheticImage::load_other_rva + 1,
+        image.addr() + SyntheticImage::data_ptr_rva,
+    });
+
+    auto refs = find_relocated_refs(relocs, image.addr() + SyntheticImage::buf_rva,
+        image.addr() + SyntheticImage::buf_end_rva);
+    CHECK(refs.size() == 3);
+
+    // Not a PE image
+    relocs.clear();
+    image.put<uint16_t>(0, 0);
+    CHECK(!get_image_relocations(image.addr(), relocs));
+    CHECK(relocs.empty());
+}
+
+TEST_CASE(references_inside_buffer_are_remapped)
+{
+    SyntheticImage image;
+    // Without the end reference every discovered reference points inside the buffer
+    image.put<uint32_t>(SyntheticImage::cmp_end_rva + 2, static_cast<uint32_t>(image.addr() + SyntheticImage::other_rva));
+    std::vector<uintptr_t> relocs;
+    REQUIRE(get_image_relocations(image.addr(), relocs));
+
+    NewBuffer new_buf;
+    Patch patch{image.addr() + SyntheticImage::buf_rva, old_num_elements, new_buf.elements};
+    patch.set_relocations(relocs);
+    patch.install();
+    REQUIRE(patch.is_installed());
+    CHECK(image.operand(SyntheticImage::load_rva) == new_buf.addr(1));
+    CHECK(image.operand(SyntheticImage::lea_rva) == new_buf.addr(0));
+    CHECK(image.get<uint32_t>(SyntheticImage::data_ptr_rva) == new_buf.addr(2));
+    CHECK(image.operand(SyntheticImage::load_other_rva) == image.addr() + SyntheticImage::other_rva);
+    // Old contents are moved, the rest is zero
+    CHECK(patch[0] == 100 && patch[3] == 103 && patch[4] == 0 && patch[15] == 0);
+}
+
+TEST_CASE(unconfirmed_end_reference_blocks_resize)
+{
+    SyntheticImage image;
+    std::vector<uintptr_t> relocs;
+    REQUIRE(get_image_relocations(image.addr(), relocs));
+    const auto code_before = image.buf.bytes(0x200, SyntheticImage::code_rva);
+
+    NewBuffer new_buf;
+    // The cmp could just as well be a reference to the variable that follows the buffer
+    Patch patch{image.addr() + SyntheticImage::buf_rva, old_num_elements, new_buf.elements};
+    patch.set_relocations(relocs);
+    patch.install();
+    CHECK(!patch.is_installed());
+    CHECK(image.buf.bytes(0x200, SyntheticImage::code_rva) == code_before);
+    CHECK(new_buf.elements[0] == 0);
+
+    // Confirming another instruction does not help
+    Patch wrong_patch{image.addr() + SyntheticImage::buf_rva, old_num_elements,
+        new_buf.elements, Patch::ConfirmedEndRefs{{image.addr() + SyntheticImage::load_rva}}};
+    wrong_patch.set_relocations(relocs);
+    wrong_patch.install();
+    CHECK(!wrong_patch.is_installed());
+    CHECK(image.buf.bytes(0x200, SyntheticImage::code_rva) == code_before);
+}
+
+TEST_CASE(confirmed_end_reference_is_remapped_to_new_end)
+{
+    SyntheticImage image;
+    std::vector<uintptr_t> relocs;
+    REQUIRE(get_image_relocations(image.addr(), relocs));
+
+    NewBuffer new_buf;
+    Patch patch{image.addr() + SyntheticImage::buf_rva, old_num_elements, new_buf.elements,
+        Patch::ConfirmedEndRefs{{image.addr() + SyntheticImage::cmp_end_rva}}};
+    patch.set_relocations(relocs);
+    patch.install();
+    REQUIRE(patch.is_installed());
+    CHECK(image.operand(SyntheticImage::cmp_end_rva) == new_buf.addr(new_num_elements));
+    CHECK(image.operand(SyntheticImage::load_rva) == new_buf.addr(1));
+    CHECK(image.operand(SyntheticImage::load_other_rva) == image.addr() + SyntheticImage::other_rva);
+}
+
+TEST_CASE(buffer_without_references_is_not_moved)
+{
+    SyntheticImage image;
+    std::vector<uintptr_t> relocs;
+    REQUIRE(get_image_relocations(image.addr(), relocs));
+
+    NewBuffer new_buf;
+    Patch patch{image.addr() + 0x4000, old_num_elements, new_buf.elements};
+    patch.set_relocations(relocs);
+    patch.install();
+    CHECK(!patch.is_installed());
+}
+
+TEST_CASE(listed_references_are_remapped)
+{
+    SyntheticImage image;
+    NewBuffer new_buf;
+    // Listed refs work without relocations and the end reference is confirmed by listing it
+    Patch patch{image.addr() + SyntheticImage::buf_rva, old_num_elements, new_buf.elements,
+        {
+            {image.addr() + SyntheticImage::lea_rva},
+            {image.addr() + SyntheticImage::cmp_end_rva, true},
+        }};
+    patch.install();
+    REQUIRE(patch.is_installed());
+    CHECK(image.operand(SyntheticImage::lea_rva) == new_buf.addr(0));
+    CHECK(image.operand(SyntheticImage::cmp_end_rva) == new_buf.addr(new_num_elements));
+    // Listed refs have to point at the first element or right after the last one
+    CHECK(image.operand(SyntheticImage::load_rva) == image.addr() + SyntheticImage::buf_rva + 4);
+}
@@ -0,0 +1,151 @@
+#include "../test.h"
+#include <patch_common/VtableHookSet.h>
+#include <typeinfo>
+
+// Outside of the anonymous namespace so the compiler cannot see every subclass and devirtualize the calls.
+// No virtual destructor so the vtable holds exactly the two methods (Itanium ABI emits two destructor slots).
+class Shape
+{
+public:
+    virtual int sides() const = 0;
+    virtual int scaled(int factor) const = 0;
+
+protected:
+    ~Shape() = default;
+};
+
+class Square final : public Shape
+{
+public:
+    explicit Square(int size) :
+        m_size(size)
+    {}
+
+    int sides() const override
+    {
+        return 4;
+    }
+
+    int scaled(int factor) const override
+    {
+        return m_size * factor;
+    }
+
+private:
+    int m_size;
+};
+
+namespace
+{
+    constexpr size_t num_shape_slots = 2;
+    constexpr size_t sides_slot = 0;
+    constexpr size_t scaled_slot = 1;
+
+    // Calls go through the vtable: noipa keeps the compiler from specializing them for the known dynamic type
+    [[gnu::noipa]] int call_sides(const Shape& shape)
+    {
+        return shape.sides();
+    }
+
+    [[gnu::noipa]] int call_scaled(const Shape& shape, int factor)
+    {
+        return shape.scaled(factor);
+    }
+
+    void** vptr_of(const void* instance)
+    {
+        return *static_cast<void** const*>(instance);
+    }
+
+    using ScaledFn = int(const Shape* self, int factor);
+    ScaledFn* g_scaled_original = nullptr;
+
+    int sides_hook([[maybe_unused]] const Shape* self)
+    {
+        return 5;
+    }
+
+    int scaled_hook(const Shape* self, int factor)
+    {
+        return g_scaled_original(self, factor) + 1000;
+    }
+}
+
+TEST_CASE(hook_applies_only_to_the_hooked_instance)
+{
+    Square hooked{3};
+    Square other{3};
+    VtableHookSet hooks{num_shape_slots};
+    hooks.hook(sides_slot, sides_hook);
+    REQUIRE(hooks.install(&hooked));
+
+    CHECK(call_sides(hooked) == 5);
+    CHECK(call_sides(other) == 4);
+    CHECK(call_scaled(hooked, 2) == 6);
+    CHECK(hooks.is_installed_on(&hooked));
+    CHECK(!hooks.is_installed_on(&other));
+    CHECK(vptr_of(&hooked) != vptr_of(&other));
+
+    // Installing again on the same object keeps the current shadow
+    void** shadow = vptr_of(&hooked);
+    CHECK(hooks.install(&hooked));
+    CHECK(vptr_of(&hooked) == shadow);
+    hooks.remove();
+}
+
+TEST_CASE(original_out_calls_the_real_method)
+{
+    Square hooked{7};
+    VtableHookSet hooks{num_shape_slots};
+    hooks.hook(scaled_slot, scaled_hook, &g_scaled_original);
+    REQUIRE(hooks.install(&hooked));
+    REQUIRE(g_scaled_original != nullptr);
+
+    CHECK(g_scaled_original(&hooked, 3) == 21);
+    CHECK(call_scaled(hooked, 3) == 1021);
+    CHECK(call_sides(hooked) == 4);
+    hooks.remove();
+}
+
+TEST_CASE(prefix_slots_are_copied)
+{
+    Square hooked{1};
+    Square other{1};
+    VtableHookSet hooks{num_shape_slots};
+    hooks.hook(sides_slot, sides_hook);
+    REQUIRE(hooks.install(&hooked));
+
+    // Offset-to-top and typeinfo sit right before the first method slot
+    void** shadow = vptr_of(&hooked);
+    void** original = vptr_of(&other);
+    CHECK(shadow[-2] == original[-2]);
+    CHECK(shadow[-1] == original[-1]);
+    CHECK(shadow[scaled_slot] == original[scaled_slot]);
+
+    // RTTI reads the typeinfo slot of the shadow
+    const Shape& shape = hooked;
+    CHECK(typeid(shape) == typeid(Square));
+    CHECK(dynamic_cast<const Square*>(&shape) == &hooked);
+    hooks.remove();
+}
+
+TEST_CASE(remove_restores_the_original_vptr)
+{
+    Square hooked{2};
+    void** original = vptr_of(&hooked);
+    VtableHookSet hooks{num_shape_slots};
+    hooks.hook(sides_slot, sides_hook);
+    // Out of range slots are rejected and do not touch the shadow
+    hooks.hook(num_shape_slots, sides_hook);
+    REQUIRE(hooks.install(&hooked));
+    CHECK(vptr_of(&hooked) != original);
+
+    hooks.remove();
+    CHECK(vptr_of(&hooked) == original);
+    CHECK(!hooks.is_installed_on(&hooked));
+    CHECK(call_sides(hooked) == 4);
+
+    // Removing twice is harmless
+    hooks.remove();
+    CHECK(vptr_of(&hooked) == original);
+}
@@ -0,0 +1,8 @@
+#include "code-test-utils.h"
+
+// Called by the subhook length decoder, the game patch logs it
+extern "C" void subhook_unk_opcode_handler(uint8_t* opcode)
+{
+    code_test::g_num_unknown_opcodes++;
+    std::fprintf(stderr, "subhook: unknown opcode 0x%02X\n", *opcode);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <patch_common/AsmWriter.h>
+#include <sys/mman.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Helpers for tests of generated code
+
+namespace code_test
+{
+    // Number of times the subhook length decoder hit an opcode it does not know
+    inline int g_num_unknown_opcodes = 0;
+
+    struct Bytes : std::vector<uint8_t>
+    {
+        using vector::vector;
+    };
+
+    inline Bytes operator+(Bytes a, const Bytes& b)
+    {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    }
+
+    inline Bytes le32(int32_t value)
+    {
+        Bytes bytes(4);
+        std::memcpy(bytes.data(), &value, sizeof(value));
+        return bytes;
+    }
+
+    inline Bytes nops(size_t n)
+    {
+        return Bytes(n, 0x90);
+    }
+
+    inline void print_bytes(const char* label, const std::vector<uint8_t>& bytes)
+    {
+        std::fprintf(stderr, "%s (%zu):", label, bytes.size());
+        for (uint8_t b : bytes) {
+            std::fprintf(stderr, " %02X", b);
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+    // Writable memory below 4 GB. AsmWriter and write_mem take 32-bit addresses.
+    class CodeBuffer
+    {
+    public:
+        static constexpr size_t size = 0x10000;
+
+        CodeBuffer()
+        {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+            m_ptr = ptr != MAP_FAILED ? static_cast<uint8_t*>(ptr) : nullptr;
+        }
+
+        ~CodeBuffer()
+        {
+            if (m_ptr) {
+                munmap(m_ptr, size);
+            }
+        }
+
+        [[nodiscard]] uintptr_t addr() const
+        {
+            return reinterpret_cast<uintptr_t>(m_ptr);
+        }
+
+        [[nodiscard]] uint8_t* data() const
+        {
+            return m_ptr;
+        }
+
+        void fill(uint8_t value)
+        {
+            std::memset(m_ptr, value, size);
+        }
+
+        [[nodiscard]] Bytes bytes(size_t n, size_t offset = 0) const
+        {
+            return Bytes(m_ptr + offset, m_ptr + offset + n);
+        }
+
+    private:
+        uint8_t* m_ptr;
+    };
+
+    // Assembles code at base and returns the bytes written by AsmWriter::finish
+    template<typename F>
+    Bytes assemble_at(uintptr_t base, F&& emit)
+    {
+        AsmWriter writer{base};
+        emit(writer);
+        size_t size = writer.size();
+        writer.finish();
+        auto* ptr = reinterpret_cast<const uint8_t*>(base);
+        return Bytes(ptr, ptr + size);
+    }
+
+    template<typename F>
+    bool expect_code_at(uintptr_t base, F&& emit, const Bytes& expected)
+    {
+        Bytes actual = assemble_at(base, emit);
+        if (actual != expected) {
+            print_bytes("expected", expected);
+            print_bytes("actual  ", actual);
+            return false;
+        }
+        return true;
+    }
+
+    template<typename F>
+    bool expect_code(F&& emit, const Bytes& expected)
+    {
+        CodeBuffer buf;
+        return expect_code_at(buf.addr(), emit, expected);
+    }
+}
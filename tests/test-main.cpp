@@ -0,0 +1,57 @@
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        test::TestFn fn;
+    };
+
+    std::vector<TestCase>& get_tests()
+    {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    int g_num_failures = 0;
+}
+
+void test::register_test(const char* name, TestFn fn)
+{
+    get_tests().push_back({name, fn});
+}
+
+void test::report_failure(const char* file, int line, const char* expr)
+{
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    ++g_num_failures;
+}
+
+// Runs all test cases or only the ones whose names are passed on the command line
+int main(int argc, char** argv)
+{
+    int num_run = 0;
+    int num_failed = 0;
+    for (const auto& test_case : get_tests()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], test_case.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        int failures_before = g_num_failures;
+        test_case.fn();
+        ++num_run;
+        if (g_num_failures != failures_before) {
+            std::fprintf(stderr, "FAILED: %s\n", test_case.name);
+            ++num_failed;
+        }
+    }
+    std::printf("%d test cases, %d failed\n", num_run, num_failed);
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Minimal test framework for the host tests. TEST_CASE registers a function that test-main.cpp runs. A failed CHECK
+// is reported with its location and makes the executable exit with a non-zero code.
+
+namespace test
+{
+    using TestFn = void (*)();
+
+    void register_test(const char* name, TestFn fn);
+    void report_failure(const char* file, int line, const char* expr);
+
+    struct Registrar
+    {
+        Registrar(const char* name, TestFn fn)
+        {
+            register_test(name, fn);
+        }
+    };
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static test::Registrar name##_registrar{#name, name}; \
+    static void name()
+
+// Variadic so expressions with unparenthesized commas (e.g. braced initializers) can be passed
+#define CHECK(...) \
+    do { \
+        if (!(__VA_ARGS__)) { \
+            test::report_failure(__FILE__, __LINE__, #__VA_ARGS__); \
+        } \
+    } while (false)
+
+// Like CHECK but leaves the test case if the check fails
+#define REQUIRE(...) \
+    do { \
+        if (!(__VA_ARGS__)) { \
+            test::report_failure(__FILE__, __LINE__, #__VA_ARGS__); \
+            return; \
+        } \
+    } while (false)
@@ -0,0 +1,162 @@
+#include "../bench.h"
+#include <xlog/AsyncAppender.h>
+#include <xlog/FileAppender.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cost of a log call for the calling thread when messages go to a file directly and through AsyncAppender, with a
+// normal file and with a sink that stalls now and then like a disk under load. Then throughput of several threads
+// logging through AsyncAppender with both overflow policies.
+
+namespace
+{
+    const std::string g_logger_name{"bench"};
+
+    std::filesystem::path temp_log_path()
+    {
+        return std::filesystem::temp_directory_path() / "sopot-async-appender-bench.log";
+    }
+
+    // Writes messages to a file and sleeps on every stall_every-th one
+    class StallingFileSink : public xlog::Appender
+    {
+    public:
+        StallingFileSink(size_t stall_every, std::chrono::microseconds stall) :
+            file_(temp_log_path(), std::ios_base::out | std::ios_base::trunc), stall_every_(stall_every), stall_(stall)
+        {}
+
+        void flush() override
+        {
+            file_.flush();
+        }
+
+    protected:
+        void append([[maybe_unused]] xlog::Level level, std::string_view formatted_message) override
+        {
+            if (++count_ % stall_every_ == 0) {
+                std::this_thread::sleep_for(stall_);
+            }
+            file_ << formatted_message << '\n';
+        }
+
+    private:
+        std::ofstream file_;
+        size_t stall_every_;
+        std::chrono::microseconds stall_;
+        size_t count_ = 0;
+    };
+
+    std::unique_ptr<xlog::Appender> make_file_sink()
+    {
+        auto sink = std::make_unique<xlog::FileAppender>(temp_log_path().string(), false, false);
+        sink->set_formatter<xlog::SimpleFormatter>(false, false, false, false);
+        return sink;
+    }
+
+    std::unique_ptr<xlog::Appender> make_stalling_sink()
+    {
+        return std::make_unique<StallingFileSink>(1024, std::chrono::microseconds{2000});
+    }
+
+    std::unique_ptr<xlog::Appender> make_async(std::unique_ptr<xlog::Appender> sink,
+        xlog::AsyncOverflowPolicy policy = xlog::AsyncOverflowPolicy::drop)
+    {
+        return std::make_unique<xlog::AsyncAppender>(std::move(sink), 4096, policy);
+    }
+
+    void log_message(xlog::Appender& appender, size_t i)
+    {
+        appender.append(xlog::Level::info, g_logger_name, "frame {} took {:.2f} ms, {} draw calls", i,
+            static_cast<double>(i % 100) * 0.25, i % 3000);
+    }
+
+    // Messages are logged in bursts with a pause in between, like a game logging a few lines per frame
+    void run_latency(const char* label, xlog::Appender& appender, size_t n)
+    {
+        constexpr size_t burst = 16;
+        std::vector<double> latencies;
+        latencies.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            double ns = bench::time_ns([&] { log_message(appender, i); });
+            latencies.push_back(ns);
+            if (i % burst == burst - 1) {
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+        }
+        appender.flush();
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())))];
+        };
+        std::printf("%-48s p50 %9.0f ns  p99 %9.0f ns  max %9.0f ns\n", label, percentile(0.5), percentile(0.99),
+            latencies.back());
+    }
+
+    void run_throughput(const char* label, xlog::AsyncOverflowPolicy policy, size_t n, int num_threads)
+    {
+        auto sink = make_file_sink();
+        auto async = make_async(std::move(sink), policy);
+        double ns = bench::time_ns([&] {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; ++t) {
+                threads.emplace_back([&] {
+                    for (size_t i = 0; i < n; ++i) {
+                        log_message(*async, i);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            async->flush();
+        });
+        const size_t total = n * static_cast<size_t>(num_threads);
+        const auto dropped = static_cast<xlog::AsyncAppender&>(*async).num_dropped();
+        char name[80];
+        std::snprintf(name, sizeof(name), "%s, %d threads", label, num_threads);
+        bench::report(name, ns, total);
+        std::printf("%-48s %12.0f msg/s %10llu dropped\n", "", static_cast<double>(total - dropped) * 1e9 / ns,
+            static_cast<unsigned long long>(dropped));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(200'000);
+
+    {
+        auto file = make_file_sink();
+        run_latency("FileAppender: caller latency", *file, n);
+    }
+    {
+        auto async = make_async(make_file_sink());
+        run_latency("AsyncAppender: caller latency", *async, n);
+    }
+    {
+        auto stalling = make_stalling_sink();
+        run_latency("stalling FileAppender: caller latency", *stalling, n);
+    }
+    {
+        auto async = make_async(make_stalling_sink());
+        run_latency("AsyncAppender, stalling sink: caller latency", *async, n);
+        std::printf("%-48s %10llu dropped\n", "",
+            static_cast<unsigned long long>(static_cast<xlog::AsyncAppender&>(*async).num_dropped()));
+    }
+    std::printf("\n");
+
+    run_throughput("AsyncAppender, block", xlog::AsyncOverflowPolicy::block, n * 5, 1);
+    run_throughput("AsyncAppender, block", xlog::AsyncOverflowPolicy::block, n * 5 / 4, 4);
+    run_throughput("AsyncAppender, drop", xlog::AsyncOverflowPolicy::drop, n * 5 / 4, 4);
+
+    std::filesystem::remove(temp_log_path());
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include "../test.h"
+#include <xlog/BinaryLog.h>
+#include <xlog/Logger.h>
+#include <xlog/LoggerConfig.h>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    xlog::Logger g_logger{"bin_log_test", xlog::Level::info};
+
+    // Keeps the text of messages passed to the loggers
+    class CapturingAppender : public xlog::Appender
+    {
+    public:
+        static inline std::mutex mutex;
+        static inline std::vector<std::string> lines;
+
+    protected:
+        void append([[maybe_unused]] xlog::Level level, std::string_view formatted_message) override
+        {
+            std::lock_guard lock{mutex};
+            lines.emplace_back(formatted_message);
+        }
+    };
+
+    std::vector<xlog::BinLogEntry> drain()
+    {
+        std::vector<xlog::BinLogEntry> entries;
+        xlog::drain_bin_log(entries);
+        return entries;
+    }
+
+    // Text of the only record written since the last drain
+    std::string drain_one()
+    {
+        auto entries = drain();
+        return entries.size() == 1 ? entries[0].text : "(" + std::to_string(entries.size()) + " records)";
+    }
+}
+
+TEST_CASE(arguments_are_decoded_with_format_specs)
+{
+    drain();
+    const char* name = "rf2.exe";
+    const char* null_name = nullptr;
+    std::string text{"text"};
+    XLOG_BIN(g_logger, xlog::Level::info, "{} {} {} {} {}", -5, 7u, int64_t{-1} << 40, ~uint64_t{0}, true);
+    CHECK(drain_one() == "-5 7 -1099511627776 18446744073709551615 true");
+    XLOG_BIN(g_logger, xlog::Level::info, "0x{:08X} {:.2f} {:>6}|{:<3}| {}", 0xBEEFu, 3.14159, name, 'c', text);
+    CHECK(drain_one() == "0x0000BEEF 3.14 rf2.exe|c  | text");
+    XLOG_BIN(g_logger, xlog::Level::info, "{{literal}} {1} {0}", 1, 2);
+    CHECK(drain_one() == "{literal} 2 1");
+    XLOG_BIN(g_logger, xlog::Level::info, "{}", null_name);
+    CHECK(drain_one() == "(null)");
+    XLOG_BIN(g_logger, xlog::Level::info, "no arguments");
+    CHECK(drain_one() == "no arguments");
+}
+
+TEST_CASE(dynamic_width_and_precision_are_decoded)
+{
+    drain();
+    XLOG_BIN(g_logger, xlog::Level::info, "[{:{}}]", 42, 6);
+    CHECK(drain_one() == "[    42]");
+    XLOG_BIN(g_logger, xlog::Level::info, "[{:>{}.{}f}] {}", 2.5, 8, 3, "next");
+    CHECK(drain_one() == "[   2.500] next");
+    XLOG_BIN(g_logger, xlog::Level::info, "[{0:{1}}] [{1}]", 7, 3u);
+    CHECK(drain_one() == "[  7] [3]");
+    XLOG_BIN(g_logger, xlog::Level::info, "[{:<{}}]", "ab", int64_t{4});
+    CHECK(drain_one() == "[ab  ]");
+}
+
+TEST_CASE(long_strings_are_truncated)
+{
+    drain();
+    std::string long_text(200, 'x');
+    XLOG_BIN(g_logger, xlog::Level::info, "{}", long_text);
+    CHECK(drain_one() == std::string(xlog::bin_log_max_string_len, 'x'));
+}
+
+TEST_CASE(malformed_records_are_reported)
+{
+    static xlog::BinLogDescriptor descriptor{g_logger, xlog::Level::info, "value {}", __FILE__, __LINE__};
+    const uint8_t truncated[] = {static_cast<uint8_t>(xlog::BinArgType::i32), 1, 0};
+    CHECK(xlog::decode_bin_log_record(descriptor, truncated, sizeof(truncated), 1).starts_with("(corrupted"));
+    const uint8_t bad_type[] = {200, 0, 0, 0, 0};
+    CHECK(xlog::decode_bin_log_record(descriptor, bad_type, sizeof(bad_type), 1).starts_with("(corrupted"));
+
+    // Dynamic width taken from an argument that is not an integer
+    static xlog::BinLogDescriptor width_descriptor{g_logger, xlog::Level::info, "[{:{}}]", __FILE__, __LINE__};
+    uint8_t args[32];
+    uint8_t* out = args;
+    xlog::detail::put_arg(out, 1);
+    xlog::detail::put_arg(out, 1.5);
+    CHECK(xlog::decode_bin_log_record(width_descriptor, args, static_cast<size_t>(out - args), 2) == "[{?}]");
+    out = args;
+    xlog::detail::put_arg(out, 1);
+    xlog::detail::put_arg(out, -3);
+    CHECK(xlog::decode_bin_log_record(width_descriptor, args, static_cast<size_t>(out - args), 2) == "[{?}]");
+}
+
+TEST_CASE(disabled_levels_are_not_recorded)
+{
+    drain();
+    XLOG_BIN(g_logger, xlog::Level::debug, "debug {}", 1);
+    CHECK(drain().empty());
+}
+
+TEST_CASE(records_of_all_threads_are_drained_in_time_order)
+{
+    drain();
+    constexpr int num_threads = 4;
+    constexpr size_t per_thread = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t] {
+            for (size_t i = 0; i < per_thread; ++i) {
+                XLOG_BIN(g_logger, xlog::Level::info, "thread {} record {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto entries = drain();
+    CHECK(entries.size() == num_threads * per_thread);
+    std::vector<int> next_record(num_threads, 0);
+    bool in_order = true;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        in_order = in_order && (i == 0 || entries[i - 1].timestamp <= entries[i].timestamp);
+        int t = -1;
+        int record = -1;
+        if (std::sscanf(entries[i].text.c_str(), "thread %d record %d", &t, &record) == 2 && t >= 0 && t < num_threads) {
+            // Records of one thread keep their order
+            in_order = in_order && record == next_record[t]++;
+        }
+    }
+    CHECK(in_order);
+}
+
+TEST_CASE(full_buffer_drops_and_counts_records)
+{
+    drain();
+    uint64_t dropped_before = xlog::get_bin_log_num_dropped();
+    std::string text(xlog::bin_log_max_string_len, 'y');
+    // Far more than a 64 KiB thread buffer holds
+    constexpr size_t num_records = 4000;
+    for (size_t i = 0; i < num_records; ++i) {
+        XLOG_BIN(g_logger, xlog::Level::info, "{} {}", i, text);
+    }
+    auto entries = drain();
+    uint64_t dropped = xlog::get_bin_log_num_dropped() - dropped_before;
+    CHECK(dropped > 0);
+    CHECK(entries.size() + dropped == num_records);
+    // Oldest records are kept
+    CHECK(!entries.empty() && entries[0].text.starts_with("0 "));
+
+    // Space is available again after draining
+    XLOG_BIN(g_logger, xlog::Level::info, "after");
+    CHECK(drain_one() == "after");
+}
+
+TEST_CASE(flush_passes_text_to_the_logger)
+{
+    drain();
+    xlog::LoggerConfig::get().add_appender<CapturingAppender>();
+    XLOG_BIN(g_logger, xlog::Level::warn, "flushed {}", 12);
+    xlog::flush_bin_log();
+    std::lock_guard lock{CapturingAppender::mutex};
+    bool found = false;
+    for (const auto& line : CapturingAppender::lines) {
+        found = found || line.find("flushed 12") != std::string::npos;
+    }
+    CHECK(found);
+}
@@ -0,0 +1,92 @@
+#include "../test.h"
+#include <xlog/LoggerConfig.h>
+#include <xlog/RateLimit.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    xlog::Logger g_logger{"rate_limit_test", xlog::Level::info};
+
+    // Keeps the text of messages passed to the loggers
+    class CapturingAppender : public xlog::Appender
+    {
+    public:
+        static inline std::mutex mutex;
+        static inline std::vector<std::string> lines;
+
+    protected:
+        void append([[maybe_unused]] xlog::Level level, std::string_view formatted_message) override
+        {
+            std::lock_guard lock{mutex};
+            lines.emplace_back(formatted_message);
+        }
+    };
+
+    int count_allowed(int calls, auto check)
+    {
+        int allowed = 0;
+        for (int i = 0; i < calls; ++i) {
+            allowed += check() ? 1 : 0;
+        }
+        return allowed;
+    }
+}
+
+TEST_CASE(first_n_and_every_n_count_calls)
+{
+    // Sites are linked into the global summary list, so they must outlive the test
+    static xlog::LogSite first{xlog::Level::info, __FILE__, __LINE__};
+    CHECK(count_allowed(100, [&] { return first.first_n(g_logger, 16); }) == 16);
+    static xlog::LogSite every{xlog::Level::info, __FILE__, __LINE__};
+    CHECK(count_allowed(100, [&] { return every.every_n(g_logger, 10); }) == 10);
+}
+
+TEST_CASE(per_interval_allows_a_burst_then_the_refill_rate)
+{
+    static xlog::LogSite site{xlog::Level::info, __FILE__, __LINE__};
+    CHECK(count_allowed(100, [&] { return site.per_interval(g_logger, 5, 60'000); }) == 5);
+
+    // The bucket refills one message every 100 ms after the burst of 4
+    static xlog::LogSite fast_site{xlog::Level::info, __FILE__, __LINE__};
+    CHECK(count_allowed(100, [&] { return fast_site.per_interval(g_logger, 4, 400); }) == 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds{120});
+    int allowed = count_allowed(100, [&] { return fast_site.per_interval(g_logger, 4, 400); });
+    CHECK(allowed >= 1 && allowed < 4);
+}
+
+TEST_CASE(per_interval_is_exact_under_contention)
+{
+    static xlog::LogSite site{xlog::Level::info, __FILE__, __LINE__};
+    std::atomic<int> allowed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            allowed += count_allowed(10'000, [&] { return site.per_interval(g_logger, 100, 60'000); });
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(allowed == 100);
+}
+
+TEST_CASE(suppressed_messages_are_summarized)
+{
+    xlog::LoggerConfig::get().add_appender<CapturingAppender>();
+    xlog::log_rate_limit_summaries();
+    for (int i = 0; i < 10; ++i) {
+        XLOG_FIRST_N(g_logger, xlog::Level::info, 3, "message {}", i);
+    }
+    xlog::log_rate_limit_summaries();
+    std::lock_guard lock{CapturingAppender::mutex};
+    size_t summaries = 0;
+    for (const auto& line : CapturingAppender::lines) {
+        summaries += line.find("7 message(s) suppressed at RateLimitTest.cpp") != std::string::npos ? 1 : 0;
+    }
+    CHECK(summaries == 1);
+}
@@ -0,0 +1,63 @@
+#include "../bench.h"
+#include <xlog/FileAppender.h>
+#include <xlog/RotatingFileAppender.h>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Cost of writing a 100 byte line with RotatingFileAppender and FileAppender without and with flushing every line.
+
+namespace
+{
+    const std::string g_logger_name{"bench"};
+    const std::string g_text(80, 'x');
+
+    std::filesystem::path temp_log_path()
+    {
+        return std::filesystem::temp_directory_path() / "sopot-rotating-file-appender-bench.log";
+    }
+
+    void run(const char* label, xlog::Appender& appender, size_t n)
+    {
+        appender.set_formatter<xlog::SimpleFormatter>(false, false, false, false);
+        bench::report(label, bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                appender.append(xlog::Level::info, g_logger_name, "{:010} {}", i, g_text);
+            }
+            appender.flush();
+        }), n);
+    }
+
+    void remove_logs()
+    {
+        auto path = temp_log_path();
+        for (unsigned i = 1; i < 4; ++i) {
+            std::filesystem::remove(path.parent_path() / (path.stem().string() + '.' + std::to_string(i) + ".log"));
+        }
+        std::filesystem::remove(path);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(1'000'000);
+
+    remove_logs();
+    {
+        xlog::RotatingFileAppender appender{temp_log_path().string(), 8 * 1024 * 1024, 4};
+        run("RotatingFileAppender", appender, n);
+    }
+    remove_logs();
+    {
+        xlog::FileAppender appender{temp_log_path().string(), false, false};
+        run("FileAppender", appender, n);
+    }
+    {
+        xlog::FileAppender appender{temp_log_path().string(), false, true};
+        run("FileAppender, flush every line", appender, n / 4);
+    }
+    remove_logs();
+    return 0;
+}
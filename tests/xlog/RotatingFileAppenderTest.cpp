@@ -0,0 +1,122 @@
+#include "../test.h"
+#include <xlog/RotatingFileAppender.h>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::string g_logger_name{"test"};
+
+    // Fresh directory for the log files of one test
+    std::filesystem::path make_log_dir(const char* name)
+    {
+        auto dir = std::filesystem::temp_directory_path() / "sopot-rotating-file-appender-test" / name;
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    size_t count_lines(const std::filesystem::path& path)
+    {
+        std::ifstream file{path};
+        size_t lines = 0;
+        for (std::string line; std::getline(file, line);) {
+            ++lines;
+        }
+        return lines;
+    }
+
+    std::unique_ptr<xlog::RotatingFileAppender> make_appender(const std::filesystem::path& path, size_t max_file_size,
+        unsigned max_files)
+    {
+        auto appender = std::make_unique<xlog::RotatingFileAppender>(path.string(), max_file_size, max_files, 4096);
+        appender->set_formatter<xlog::SimpleFormatter>(false, false, false, false);
+        return appender;
+    }
+
+    // About 20 bytes per line
+    void log_line(xlog::Appender& appender, xlog::Level level, int i)
+    {
+        appender.append(level, g_logger_name, "line {:014}", i);
+    }
+
+    xlog::RotatingFileAppender* g_abort_appender = nullptr;
+
+    void flush_on_abort([[maybe_unused]] int signal_number)
+    {
+        g_abort_appender->flush();
+    }
+}
+
+TEST_CASE(lines_are_buffered_until_flush)
+{
+    auto dir = make_log_dir("flush");
+    auto appender = make_appender(dir / "test.log", 1024 * 1024, 4);
+    for (int i = 0; i < 10; ++i) {
+        log_line(*appender, xlog::Level::info, i);
+    }
+    CHECK(count_lines(dir / "test.log") == 0);
+    appender->flush();
+    CHECK(count_lines(dir / "test.log") == 10);
+
+    // Errors are written right away
+    log_line(*appender, xlog::Level::error, 10);
+    CHECK(count_lines(dir / "test.log") == 11);
+}
+
+TEST_CASE(rotation_keeps_max_files_and_no_lines_are_lost)
+{
+    auto dir = make_log_dir("rotation");
+    constexpr size_t max_file_size = 4096;
+    constexpr unsigned max_files = 3;
+    {
+        auto appender = make_appender(dir / "test.log", max_file_size, max_files);
+        // Enough for two rotations but not a third
+        for (int i = 0; i < 500; ++i) {
+            log_line(*appender, xlog::Level::info, i);
+        }
+    }
+    size_t files = 0;
+    size_t lines = 0;
+    for (const auto& entry : std::filesystem::directory_iterator{dir}) {
+        ++files;
+        lines += count_lines(entry.path());
+        CHECK(entry.file_size() <= max_file_size);
+    }
+    CHECK(files == max_files);
+    CHECK(lines == 500);
+    CHECK(std::filesystem::exists(dir / "test.1.log") && std::filesystem::exists(dir / "test.2.log"));
+
+    // The next run keeps the previous log as test.1.log
+    make_appender(dir / "test.log", max_file_size, max_files);
+    CHECK(count_lines(dir / "test.log") == 0);
+    CHECK(count_lines(dir / "test.1.log") > 0);
+    CHECK(!std::filesystem::exists(dir / "test.3.log"));
+}
+
+TEST_CASE(flush_from_abort_handler_keeps_all_lines)
+{
+    auto dir = make_log_dir("abort");
+    auto path = dir / "test.log";
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        auto appender = make_appender(path, 1024 * 1024, 2);
+        g_abort_appender = appender.get();
+        std::signal(SIGABRT, flush_on_abort);
+        for (int i = 0; i < 1000; ++i) {
+            log_line(*appender, xlog::Level::info, i);
+        }
+        std::abort();
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    CHECK(count_lines(path) == 1000);
+}
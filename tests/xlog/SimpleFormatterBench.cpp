@@ -0,0 +1,82 @@
+#include "../bench.h"
+#include <xlog/SimpleFormatter.h>
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <string>
+
+// Cost of formatting a record with SimpleFormatter into a FormatBuffer, compared with the previous formatter that built
+// the prefix with std::format and appended everything to a std::string. A short record with a few arguments and a
+// message longer than the fixed buffer.
+
+namespace
+{
+    const std::string g_logger_name{"bench"};
+    const std::string g_long_text(3000, 'x');
+
+    // Copy of the formatter before records went into a fixed buffer, with GetTickCount replaced by steady_clock
+    class PreviousFormatter
+    {
+    public:
+        template<typename... Args>
+        void format_to(std::string& buf, xlog::Level level, const std::string& logger_name,
+            std::format_string<Args...> fmt, Args&&... args) const
+        {
+            buf.clear();
+            prepare_to(buf, level, logger_name);
+            std::format_to(std::back_inserter(buf), fmt, std::forward<Args>(args)...);
+        }
+
+    private:
+        static void prepare_to(std::string& buf, xlog::Level level, const std::string& logger_name)
+        {
+            static const auto start_time = std::chrono::steady_clock::now();
+            std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start_time;
+            std::format_to(std::back_inserter(buf), "[{:7.2f}] ", elapsed.count());
+            static const char* level_prefix[] = {"ERROR: ", "WARN: ", "INFO: ", "DEBUG: ", "TRACE: "};
+            buf += level_prefix[static_cast<int>(level)];
+            if (!logger_name.empty()) {
+                buf += logger_name;
+                buf += ' ';
+            }
+        }
+    };
+
+    template<typename Formatter, typename Buffer>
+    void run(const char* label, const Formatter& formatter, Buffer& buf, size_t n)
+    {
+        char name[80];
+        std::snprintf(name, sizeof(name), "%s: short record", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                formatter.format_to(buf, xlog::Level::info, g_logger_name, "frame {} took {:.2f} ms, {} draw calls", i,
+                    static_cast<double>(i % 100) * 0.25, i % 3000);
+                bench::do_not_optimize(buf);
+            }
+        }), n);
+
+        std::snprintf(name, sizeof(name), "%s: 3000 char message", label);
+        bench::report(name, bench::time_ns([&] {
+            for (size_t i = 0; i < n; ++i) {
+                formatter.format_to(buf, xlog::Level::info, g_logger_name, "{} {}", i, g_long_text);
+                bench::do_not_optimize(buf);
+            }
+        }), n);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::init(argc, argv);
+    const size_t n = bench::iterations(1'000'000);
+
+    PreviousFormatter previous;
+    std::string previous_buf;
+    run("previous formatter", previous, previous_buf, n);
+
+    xlog::FormatBuffer buf;
+    run("SimpleFormatter", xlog::SimpleFormatter{}, buf, n);
+    run("SimpleFormatter, no tid", xlog::SimpleFormatter{true, true, true, false}, buf, n);
+    return 0;
+}
@@ -10,6 +10,15 @@ namespace xlog
 {
 
 class Logger;
+class AsyncAppender;
+
+// Messages are formatted into a fixed buffer owned by the calling thread so formatting does not allocate.
+// Note: appenders must not log from append() because the nested message would overwrite the buffer.
+inline FormatBuffer& thread_format_buffer()
+{
+    thread_local FormatBuffer buf;
+    return buf;
+}
 
 class Appender
 {
@@ -21,8 +30,9 @@ public:
     void append(Level level, const std::string& logger_name, std::format_string<Args...> fmt, Args&&... args)
     {
         if (level <= level_) {
-            auto formatted = formatter_->format(level, logger_name, fmt, std::forward<Args>(args)...);
-            append(level, formatted);
+            auto& formatted = thread_format_buffer();
+            formatter_->format_to(formatted, level, logger_name, fmt, std::forward<Args>(args)...);
+            append(level, formatted.view());
         }
     }
 
@@ -51,7 +61,11 @@ public:
     virtual ~Appender() = default;
 
 protected:
-    virtual void append(Level level, const std::string& formatted_message) = 0;
+    // formatted_message is only valid during the call
+    virtual void append(Level level, std::string_view formatted_message) = 0;
+
+    // Writes messages that AsyncAppender has already formatted
+    friend class AsyncAppender;
 
 private:
     std::unique_ptr<Formatter> formatter_;
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <xlog/Appender.h>
+
+namespace xlog
+{
+
+enum class AsyncOverflowPolicy
+{
+    // Message is thrown away and counted, the writer logs the count later
+    drop,
+    // Caller waits until the writer makes room
+    block,
+};
+
+// Hands formatted messages to a writer thread that passes them to the sink appender in batches. The sink is flushed
+// after errors, when the writer has been idle for a while and when flush() is called (crash handlers call it), so
+// the sink itself should be created without flushing every line.
+// Messages are formatted once with this appender's formatter; the sink's formatter is not used.
+// The optional tee gets the same formatted text on the calling thread before it is queued, for cheap in-memory
+// appenders that must not miss messages (like a crash flight recorder). Neither its formatter nor its level is used.
+class AsyncAppender : public Appender
+{
+public:
+    AsyncAppender(
+        std::unique_ptr<Appender> sink,
+        size_t queue_capacity = 1024,
+        AsyncOverflowPolicy overflow_policy = AsyncOverflowPolicy::drop,
+        std::unique_ptr<Appender> tee = nullptr);
+    ~AsyncAppender() override;
+
+    // Writes all queued messages on the calling thread and flushes the sink
+    void flush() override;
+
+    [[nodiscard]] uint64_t num_dropped() const;
+
+protected:
+    void append(Level level, std::string_view formatted_message) override;
+
+private:
+    // Shared with the writer thread so the thread can outlive the appender if it is detached at process exit
+    struct State;
+
+    static void writer_thread_proc(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state_;
+    std::unique_ptr<Appender> tee_;
+    std::thread writer_thread_;
+};
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <xlog/Level.h>
+
+// Deferred formatting for hot paths. Every call site has a static descriptor holding the level and format string that
+// is registered once. A log call only copies its raw arguments into a ring buffer owned by the calling thread, the
+// text is produced later by decode_bin_log_record() on the thread that drains the buffers.
+//
+//     XLOG_BIN(g_logger, xlog::Level::info, "Clamping Sleep from {}ms at 0x{:X}", ms, caller);
+//
+// The logger's level is checked before anything is encoded and the decoded text is passed to that logger.
+//
+// Supported arguments are integers, bools, characters, floating point numbers, void pointers and strings (copied,
+// truncated to bin_log_max_string_len bytes). Format specs of the replacement fields are applied when decoding, nested
+// fields for dynamic width and precision take the value of their (integer) argument.
+
+namespace xlog
+{
+
+class Logger;
+
+constexpr int bin_log_max_args = 8;
+constexpr size_t bin_log_max_string_len = 63;
+constexpr size_t bin_log_max_record_size = 544;
+
+struct BinLogDescriptor
+{
+    Logger* logger;
+    Level level;
+    const char* format;
+    const char* file;
+    int line;
+    // 0 until registered
+    std::atomic<uint32_t> id{0};
+
+    BinLogDescriptor(Logger& logger, Level level, const char* format, const char* file, int line) :
+        logger(&logger), level(level), format(format), file(file), line(line)
+    {}
+};
+
+enum class BinArgType : uint8_t
+{
+    boolean,
+    i32,
+    u32,
+    i64,
+    u64,
+    f64,
+    ptr,
+    str,
+};
+
+// Fixed part of a record. It is followed by the arguments, each one a BinArgType byte and its value (strings are
+// stored as a length byte followed by the characters).
+struct BinRecordHeader
+{
+    uint32_t descriptor_id;
+    uint16_t size;
+    uint8_t num_args;
+    uint8_t reserved;
+    int64_t timestamp;
+};
+
+// Returns the id of the descriptor, registering it on first use
+uint32_t register_bin_log_descriptor(BinLogDescriptor& descriptor);
+
+// Returns nullptr for unknown ids
+const BinLogDescriptor* find_bin_log_descriptor(uint32_t id);
+
+// Copies a complete record into the ring buffer of the calling thread. Returns false if it does not fit.
+bool write_bin_log_record(const void* record, size_t size);
+
+// Formats the arguments of a record (the bytes following its header) with the descriptor's format string
+std::string decode_bin_log_record(const BinLogDescriptor& descriptor, const uint8_t* args, size_t size, int num_args);
+
+struct BinLogEntry
+{
+    int64_t timestamp;
+    const BinLogDescriptor* descriptor;
+    std::string text;
+};
+
+// Takes all complete records from the buffers of all threads and decodes them, oldest first. Only one thread may
+// drain at a time.
+void drain_bin_log(std::vector<BinLogEntry>& out_entries);
+
+// Records that did not fit into ring buffers so far
+uint64_t get_bin_log_num_dropped();
+
+// Drains the buffers on the calling thread and passes the text to the loggers of the call sites. Used by crash
+// handlers, records written by other threads meanwhile are picked up by the writer thread. Decoding allocates, so a
+// crash handler should flush the loggers before calling this and again after it.
+void flush_bin_log();
+
+// Starts a thread that drains the buffers every interval_ms milliseconds and passes the text to the loggers. The
+// thread also reports rate limited log sites (see RateLimit.h).
+void start_bin_log_writer(unsigned interval_ms = 50);
+void stop_bin_log_writer();
+
+namespace detail
+{
+    template<typename T>
+    inline void put(uint8_t*& out, const T& value)
+    {
+        std::memcpy(out, &value, sizeof(value));
+        out += sizeof(value);
+    }
+
+    inline void put_string(uint8_t*& out, std::string_view value)
+    {
+        size_t len = value.size() < bin_log_max_string_len ? value.size() : bin_log_max_string_len;
+        *out++ = static_cast<uint8_t>(BinArgType::str);
+        *out++ = static_cast<uint8_t>(len);
+        std::memcpy(out, value.data(), len);
+        out += len;
+    }
+
+    template<typename T>
+    inline void put_arg(uint8_t*& out, const T& value)
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            *out++ = static_cast<uint8_t>(BinArgType::boolean);
+            *out++ = value ? 1 : 0;
+        }
+        else if constexpr (std::is_same_v<U, char>) {
+            put_string(out, std::string_view{&value, 1});
+        }
+        else if constexpr (std::is_integral_v<U> && std::is_signed_v<U> && sizeof(U) <= 4) {
+            *out++ = static_cast<uint8_t>(BinArgType::i32);
+            put(out, static_cast<int32_t>(value));
+        }
+        else if constexpr (std::is_integral_v<U> && sizeof(U) <= 4) {
+            *out++ = static_cast<uint8_t>(BinArgType::u32);
+            put(out, static_cast<uint32_t>(value));
+        }
+        else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            *out++ = static_cast<uint8_t>(BinArgType::i64);
+            put(out, static_cast<int64_t>(value));
+        }
+        else if constexpr (std::is_integral_v<U>) {
+            *out++ = static_cast<uint8_t>(BinArgType::u64);
+            put(out, static_cast<uint64_t>(value));
+        }
+        else if constexpr (std::is_floating_point_v<U>) {
+            *out++ = static_cast<uint8_t>(BinArgType::f64);
+            put(out, static_cast<double>(value));
+        }
+        else if constexpr (std::is_array_v<T>) {
+            put_string(out, std::string_view{value});
+        }
+        else if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>) {
+            put_string(out, value ? std::string_view{value} : std::string_view{"(null)"});
+        }
+        else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+            put_string(out, std::string_view{value});
+        }
+        else if constexpr (std::is_pointer_v<U>) {
+            *out++ = static_cast<uint8_t>(BinArgType::ptr);
+            put(out, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+        }
+        else {
+            static_assert(!sizeof(U), "Unsupported binary log argument type");
+        }
+    }
+
+    int64_t bin_log_timestamp();
+}
+
+// The format string parameter only checks the arguments at compile time, the descriptor provides the text
+template<typename... Args>
+void bin_log(BinLogDescriptor& descriptor, [[maybe_unused]] std::format_string<const Args&...> fmt, const Args&... args)
+{
+    static_assert(sizeof...(Args) <= bin_log_max_args, "Too many binary log arguments");
+    static_assert(
+        sizeof(BinRecordHeader) + sizeof...(Args) * (2 + bin_log_max_string_len) <= bin_log_max_record_size,
+        "Binary log record too big");
+
+    uint32_t id = descriptor.id.load(std::memory_order_acquire);
+    if (!id) {
+        id = register_bin_log_descriptor(descriptor);
+    }
+    alignas(8) uint8_t record[bin_log_max_record_size];
+    uint8_t* out = record + sizeof(BinRecordHeader);
+    (detail::put_arg(out, args), ...);
+
+    BinRecordHeader header;
+    header.descriptor_id = id;
+    header.size = static_cast<uint16_t>(out - record);
+    header.num_args = static_cast<uint8_t>(sizeof...(Args));
+    header.reserved = 0;
+    header.timestamp = detail::bin_log_timestamp();
+    std::memcpy(record, &header, sizeof(header));
+    write_bin_log_record(record, header.size);
+}
+
+}
+
+#define XLOG_BIN(logger, level, fmt, ...) \
+    do { \
+        if ((logger).is_enabled(level)) { \
+            static xlog::BinLogDescriptor xlog_bin_descriptor_{logger, level, fmt, __FILE__, __LINE__}; \
+            xlog::bin_log(xlog_bin_descriptor_, fmt, ##__VA_ARGS__); \
+        } \
+    } while (false)
@@ -14,7 +14,7 @@ public:
         max_stderr_level_(max_stderr_level) {}
 
 protected:
-    void append(Level level, const std::string& formatted_message) override
+    void append(Level level, std::string_view formatted_message) override
     {
 #ifndef XLOG_SINGLE_THREADED
         std::lock_guard<std::mutex> lock(mutex_);
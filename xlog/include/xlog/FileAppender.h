@@ -13,7 +13,7 @@ public:
     FileAppender(const std::string& filename, bool append = true, bool flush = true);
 
 protected:
-    void append(Level level, const std::string& formatted_message) override;
+    void append(Level level, std::string_view formatted_message) override;
     void flush() override;
 
 private:
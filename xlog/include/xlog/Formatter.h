@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <format>
 #include <xlog/Level.h>
 
@@ -13,6 +16,23 @@ namespace xlog
 
 class Logger;
 
+// Output of one record. The text goes into the fixed array; a message that does not fit is formatted again into
+// overflow, which keeps its capacity for later oversized messages.
+struct FormatBuffer
+{
+    static constexpr size_t capacity = 1024;
+
+    char data[capacity];
+    size_t size = 0;
+    std::string overflow;
+    bool overflowed = false;
+
+    [[nodiscard]] std::string_view view() const
+    {
+        return overflowed ? std::string_view{overflow} : std::string_view{data, size};
+    }
+};
+
 class Formatter
 {
 public:
@@ -26,6 +46,23 @@ public:
         return buf;
     }
 
+    // Same as format() but writes into buf without allocating unless the message is too long for it
+    template<typename... Args>
+    void format_to(FormatBuffer& buf, Level level, const std::string& logger_name, std::format_string<Args...> fmt, Args&&... args) const
+    {
+        size_t prefix_size = prepare_to(buf.data, FormatBuffer::capacity, level, logger_name);
+        size_t space = FormatBuffer::capacity - prefix_size;
+        // Formatting only reads the arguments, so forwarding them a second time below is safe
+        auto result = std::format_to_n(buf.data + prefix_size, space, fmt, std::forward<Args>(args)...);
+        buf.overflowed = static_cast<size_t>(result.size) > space;
+        if (!buf.overflowed) {
+            buf.size = prefix_size + result.size;
+            return;
+        }
+        buf.overflow.assign(buf.data, prefix_size);
+        std::format_to(std::back_inserter(buf.overflow), fmt, std::forward<Args>(args)...);
+    }
+
 #ifdef XLOG_PRINTF
     std::string vformat(Level level, const std::string& logger_name, const char* fmt, std::va_list args) const
     {
@@ -39,6 +76,16 @@ public:
 
 protected:
     virtual std::string prepare(Level level, const std::string& logger_name) const = 0;
+
+    // Writes the prefix to out (truncated to size bytes) and returns its length. Override it to avoid the temporary
+    // string made by the default implementation.
+    virtual size_t prepare_to(char* out, size_t size, Level level, const std::string& logger_name) const
+    {
+        std::string prefix = prepare(level, logger_name);
+        size_t len = std::min(prefix.size(), size);
+        std::memcpy(out, prefix.data(), len);
+        return len;
+    }
 };
 
 }
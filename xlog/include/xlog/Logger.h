@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <string_view>
+#include <vector>
 #include <xlog/Level.h>
 #include <xlog/LoggerConfig.h>
 #ifdef XLOG_STREAMS
@@ -9,15 +12,33 @@
 
 namespace xlog
 {
+    // Loggers form a tree. A logger created with a parent uses the parent's level until set_level() is called on it;
+    // changing a level updates every logger that inherits it. The effective level is kept in an atomic so checking
+    // it costs a single relaxed load, see XLOG_LOG below.
     class Logger
     {
         std::string name_;
-        Level level_;
+        std::atomic<Level> level_;
+        Logger* parent_ = nullptr;
+        bool has_own_level_ = true;
 
     public:
         Logger(std::string name, Level level = Level::trace) :
             name_(std::move(name)), level_(level)
-        {}
+        {
+            register_logger();
+        }
+
+        Logger(std::string name, Logger& parent) :
+            name_(std::move(name)), level_(parent.level()), parent_(&parent), has_own_level_(false)
+        {
+            register_logger();
+        }
+
+        ~Logger();
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
 
         static Logger& root()
         {
@@ -25,10 +46,21 @@ namespace xlog
             return root_logger;
         }
 
+        // Returns nullptr if no logger has this name
+        static Logger* find(std::string_view name);
+
+        // All loggers that currently exist, parents before their children
+        static std::vector<Logger*> get_all();
+
+        [[nodiscard]] bool is_enabled(Level level) const
+        {
+            return level <= level_.load(std::memory_order_relaxed);
+        }
+
         template<typename... Args>
         void log(Level level, std::format_string<Args...> fmt, Args&&... args)
         {
-            if (level <= level_) {
+            if (is_enabled(level)) {
                 for (const auto& appender : LoggerConfig::get().get_appenders()) {
                     appender->append(level, name_, fmt, std::forward<Args>(args)...);
                 }
@@ -46,7 +78,7 @@ namespace xlog
 
         void vlogf(Level level, const char* format, va_list args)
         {
-            if (level <= level_) {
+            if (is_enabled(level)) {
                 for (const auto& appender : LoggerConfig::get().get_appenders()) {
                     appender->vappendf(level, name_, format, args);
                 }
@@ -57,7 +89,7 @@ namespace xlog
 #ifdef XLOG_STREAMS
         LogStream log(Level level)
         {
-            return LogStream(level, name_, level_);
+            return LogStream(level, name_, this->level());
         }
 #endif
 
@@ -138,9 +170,50 @@ namespace xlog
             return name_;
         }
 
-        void set_level(Level level)
+        [[nodiscard]] Level level() const
         {
-            level_ = level;
+            return level_.load(std::memory_order_relaxed);
         }
+
+        [[nodiscard]] Logger* parent() const
+        {
+            return parent_;
+        }
+
+        // False if the level is inherited from the parent
+        [[nodiscard]] bool has_own_level() const
+        {
+            return has_own_level_;
+        }
+
+        void set_level(Level level);
+
+        // Makes the logger use its parent's level again. Does nothing for loggers without a parent.
+        void reset_level();
+
+    private:
+        void register_logger();
+        // Caller must hold the registry mutex
+        static void update_inherited_levels(const std::vector<Logger*>& loggers);
     };
 }
+
+// Checks the level before the arguments are evaluated, so a disabled statement costs one relaxed load and a branch:
+//
+//     XLOG_DEBUG(g_logger, "Video mode {}x{}", get_width(), get_height());
+#define XLOG_LOG(logger, level, ...) \
+    do { \
+        if ((logger).is_enabled(level)) { \
+            (logger).log(level, __VA_ARGS__); \
+        } \
+    } while (false)
+
+#define XLOG_ERROR(logger, ...) XLOG_LOG(logger, xlog::Level::error, __VA_ARGS__)
+#define XLOG_WARN(logger, ...) XLOG_LOG(logger, xlog::Level::warn, __VA_ARGS__)
+#define XLOG_INFO(logger, ...) XLOG_LOG(logger, xlog::Level::info, __VA_ARGS__)
+#define XLOG_DEBUG(logger, ...) XLOG_LOG(logger, xlog::Level::debug, __VA_ARGS__)
+#ifndef XLOG_DISCARD_TRACE
+#define XLOG_TRACE(logger, ...) XLOG_LOG(logger, xlog::Level::trace, __VA_ARGS__)
+#else
+#define XLOG_TRACE(logger, ...) do {} while (false)
+#endif
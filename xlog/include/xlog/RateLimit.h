@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <xlog/BinaryLog.h>
+#include <xlog/Level.h>
+#include <xlog/xlog.h>
+
+// Per call site throttling for log statements in code that can run very often. Every site has a static LogSite that
+// counts the messages it holds back; the counts are not lost but reported by log_rate_limit_summaries(), which the
+// binary log writer thread calls periodically:
+//
+//     XLOG_FIRST_N(g_logger, xlog::Level::info, 16, "Video mode request {}x{}", w, h);
+//     XLOG_EVERY_N(g_logger, xlog::Level::debug, 100, "Frame {}", frame);
+//     XLOG_BIN_PER_INTERVAL(g_logger, xlog::Level::info, 1, 10000, "Clamping Sleep at 0x{:X}", caller);
+//
+// Messages below the logger's level are neither counted nor reported. The checks only use relaxed atomics (and a clock
+// read for the per-interval variants), so they can be called from any thread. The first-n limit is approximate under
+// contention.
+
+namespace xlog
+{
+
+namespace detail
+{
+    int64_t rate_limit_now_us();
+}
+
+class LogSite
+{
+public:
+    constexpr LogSite(Level level, const char* file, int line) : level_(level), file_(file), line_(line) {}
+
+    // Allows the first n messages
+    bool first_n(Logger& logger, uint32_t n)
+    {
+        // Stop counting once saturated so the counter cannot wrap around
+        if (count_.load(std::memory_order_relaxed) < n && count_.fetch_add(1, std::memory_order_relaxed) < n) {
+            return true;
+        }
+        suppress(logger);
+        return false;
+    }
+
+    // Allows the first message and every n-th after it
+    bool every_n(Logger& logger, uint32_t n)
+    {
+        if (count_.fetch_add(1, std::memory_order_relaxed) % n == 0) {
+            return true;
+        }
+        suppress(logger);
+        return false;
+    }
+
+    // Token bucket holding max_count messages that refills at max_count per interval_ms: a burst of up to max_count
+    // messages is allowed, after that one message every interval_ms / max_count. Any interval_ms long window can see a
+    // full burst plus the refill, so up to twice max_count, but the long-run rate never exceeds max_count per interval.
+    bool per_interval(Logger& logger, uint32_t max_count, uint32_t interval_ms)
+    {
+        // The bucket is kept as the time when it is full again (generic cell rate algorithm)
+        const int64_t interval_us = int64_t{interval_ms} * 1000;
+        const int64_t refill_us = interval_us / max_count;
+        int64_t now = detail::rate_limit_now_us();
+        int64_t full_at = full_at_us_.load(std::memory_order_relaxed);
+        int64_t start = 0;
+        do {
+            start = full_at > now ? full_at : now;
+            if (start - now > interval_us - refill_us) {
+                suppress(logger);
+                return false;
+            }
+            // Taking a token moves the time when the bucket is full again by one refill period
+        } while (!full_at_us_.compare_exchange_weak(full_at, start + refill_us, std::memory_order_relaxed));
+        return true;
+    }
+
+private:
+    void suppress(Logger& logger)
+    {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        if (!registered_.load(std::memory_order_relaxed) && !registered_.exchange(true)) {
+            register_site(logger);
+        }
+    }
+
+    void register_site(Logger& logger);
+
+    friend void log_rate_limit_summaries();
+
+    Level level_;
+    const char* file_;
+    int line_;
+    // Receives the summary, set on registration
+    Logger* logger_ = nullptr;
+    std::atomic<uint32_t> count_{0};
+    // Used by per_interval
+    std::atomic<int64_t> full_at_us_{INT64_MIN / 2};
+    // Not yet reported
+    std::atomic<uint32_t> suppressed_{0};
+    std::atomic<bool> registered_{false};
+    // Sites are linked into a global list the first time they suppress something
+    LogSite* next_ = nullptr;
+};
+
+// Logs one line for every site that has suppressed messages since the previous call
+void log_rate_limit_summaries();
+
+}
+
+#define XLOG_RATE_LIMITED_(logger, level, check, statement) \
+    do { \
+        static constinit xlog::LogSite xlog_site_{level, __FILE__, __LINE__}; \
+        if ((logger).is_enabled(level) && xlog_site_.check) { \
+            statement; \
+        } \
+    } while (false)
+
+#define XLOG_FIRST_N(logger, level, n, ...) \
+    XLOG_RATE_LIMITED_(logger, level, first_n(logger, n), (logger).log(level, __VA_ARGS__))
+#define XLOG_EVERY_N(logger, level, n, ...) \
+    XLOG_RATE_LIMITED_(logger, level, every_n(logger, n), (logger).log(level, __VA_ARGS__))
+#define XLOG_PER_INTERVAL(logger, level, max_count, interval_ms, ...) \
+    XLOG_RATE_LIMITED_( \
+        logger, level, per_interval(logger, max_count, interval_ms), (logger).log(level, __VA_ARGS__))
+
+#define XLOG_BIN_FIRST_N(logger, level, n, ...) \
+    XLOG_RATE_LIMITED_(logger, level, first_n(logger, n), XLOG_BIN(logger, level, __VA_ARGS__))
+#define XLOG_BIN_EVERY_N(logger, level, n, ...) \
+    XLOG_RATE_LIMITED_(logger, level, every_n(logger, n), XLOG_BIN(logger, level, __VA_ARGS__))
+#define XLOG_BIN_PER_INTERVAL(logger, level, max_count, interval_ms, ...) \
+    XLOG_RATE_LIMITED_( \
+        logger, level, per_interval(logger, max_count, interval_ms), XLOG_BIN(logger, level, __VA_ARGS__))
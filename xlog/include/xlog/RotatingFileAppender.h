@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <xlog/Appender.h>
+
+namespace xlog
+{
+
+// Collects lines in a fixed buffer and writes it to the file in one call when it is full, after an error message,
+// on flush() and when flush_interval has passed since the last write (checked every few lines). Once the file would
+// grow past max_file_size it is renamed to name.1.ext (older files move up to name.<max_files - 1>.ext, the oldest
+// one is deleted) and a new file is started. A non-empty file left by the previous run is rotated the same way on
+// construction.
+// flush() does not allocate and gives up after a second if another thread holds the lock, so crash handlers can use it.
+class RotatingFileAppender : public Appender
+{
+public:
+    RotatingFileAppender(
+        std::string filename,
+        size_t max_file_size = 8 * 1024 * 1024,
+        unsigned max_files = 4,
+        size_t buffer_size = 64 * 1024,
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds{1000});
+    ~RotatingFileAppender() override;
+
+    void flush() override;
+
+protected:
+    void append(Level level, std::string_view formatted_message) override;
+
+private:
+    // Caller must hold mutex_
+    void write_buffer();
+    void write_to_file(const char* data, size_t size);
+    void rotate();
+    [[nodiscard]] std::string rotated_filename(unsigned index) const;
+
+    std::string filename_;
+    size_t max_file_size_;
+    unsigned max_files_;
+    std::unique_ptr<char[]> buffer_;
+    size_t buffer_size_;
+    size_t buffer_used_ = 0;
+    std::FILE* file_ = nullptr;
+    size_t file_size_ = 0;
+    std::chrono::steady_clock::duration flush_interval_;
+    std::chrono::steady_clock::time_point last_write_;
+    unsigned appends_since_time_check_ = 0;
+#ifndef XLOG_SINGLE_THREADED
+    std::timed_mutex mutex_;
+#endif
+};
+
+}
@@ -9,13 +9,23 @@ namespace xlog
         bool include_time_;
         bool include_level_;
         bool include_logger_name_;
+        bool include_thread_id_;
 
     public:
-        SimpleFormatter(bool include_time = true, bool include_level = true, bool include_logger_name = true) :
-            include_time_(include_time), include_level_(include_level), include_logger_name_(include_logger_name)
+        // The time is printed in seconds with microsecond resolution since the first record
+        SimpleFormatter(
+            bool include_time = true,
+            bool include_level = true,
+            bool include_logger_name = true,
+            bool include_thread_id = true) :
+            include_time_(include_time),
+            include_level_(include_level),
+            include_logger_name_(include_logger_name),
+            include_thread_id_(include_thread_id)
         {}
 
     protected:
         std::string prepare(Level level, const std::string& logger_name) const override;
+        size_t prepare_to(char* out, size_t size, Level level, const std::string& logger_name) const override;
     };
 }
@@ -7,7 +7,7 @@ namespace xlog
 
 class Win32Appender : public Appender
 {
-    void append(Level level, const std::string& formatted_message) override;
+    void append(Level level, std::string_view formatted_message) override;
 };
 
 }
@@ -0,0 +1,204 @@
+#include <xlog/AsyncAppender.h>
+#include <chrono>
+
+// Sink is flushed when the writer has had unflushed messages for this long
+static constexpr std::chrono::milliseconds idle_flush_interval{1000};
+// Pooled buffers that grew bigger than this are released after use
+static constexpr size_t max_pooled_buffer_capacity = 4096;
+
+struct xlog::AsyncAppender::State
+{
+    // Bounded multi-producer single-consumer queue. A cell is free for position pos when its sequence equals pos and
+    // holds a message when it equals pos + 1. Buffers of cells keep their capacity, so they form a message pool.
+    struct Cell
+    {
+        std::atomic<size_t> sequence{0};
+        Level level = Level::info;
+        std::string message;
+    };
+
+    std::unique_ptr<Appender> sink;
+    AsyncOverflowPolicy overflow_policy;
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    std::atomic<size_t> write_pos{0};
+    // Advanced by whoever holds write_mutex
+    std::atomic<size_t> read_pos{0};
+    std::timed_mutex write_mutex;
+    bool unflushed = false;
+    std::chrono::steady_clock::time_point last_flush;
+    uint64_t reported_dropped = 0;
+    std::atomic<uint64_t> num_dropped{0};
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::atomic<bool> writer_waiting{false};
+    std::atomic<bool> stop{false};
+
+    State(std::unique_ptr<Appender> sink, size_t capacity, AsyncOverflowPolicy overflow_policy) :
+        sink(std::move(sink)), overflow_policy(overflow_policy)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(Level level, std::string_view message)
+    {
+        size_t pos = write_pos.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<ptrdiff_t>(sequence - pos);
+            if (diff == 0) {
+                if (write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.level = level;
+                    cell.message.assign(message);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = write_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] bool has_pending() const
+    {
+        size_t pos = read_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    void wake_writer()
+    {
+        if (writer_waiting.load()) {
+            // Taking the lock orders the notification after the writer has started waiting
+            std::lock_guard lock{wake_mutex};
+            wake_cv.notify_one();
+        }
+    }
+
+    // Caller must hold write_mutex
+    void write_pending(bool force_flush)
+    {
+        bool flush_now = force_flush;
+        uint64_t dropped = num_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            auto message = std::to_string(dropped - reported_dropped) + " log message(s) dropped (queue full)";
+            sink->append(Level::warn, message);
+            reported_dropped = dropped;
+            unflushed = true;
+        }
+        size_t pos = read_pos.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells[pos & mask];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+            sink->append(cell.level, cell.message);
+            flush_now = flush_now || cell.level == Level::error;
+            unflushed = true;
+            if (cell.message.capacity() > max_pooled_buffer_capacity) {
+                std::string{}.swap(cell.message);
+            }
+            cell.sequence.store(pos + mask + 1, std::memory_order_release);
+            ++pos;
+        }
+        read_pos.store(pos, std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        if (unflushed && (flush_now || now - last_flush >= idle_flush_interval)) {
+            sink->flush();
+            unflushed = false;
+            last_flush = now;
+        }
+    }
+};
+
+void xlog::AsyncAppender::writer_thread_proc(std::shared_ptr<State> state)
+{
+    while (true) {
+        {
+            std::unique_lock lock{state->wake_mutex};
+            state->writer_waiting.store(true);
+            if (!state->has_pending() && !state->stop.load()) {
+                state->wake_cv.wait_for(lock, idle_flush_interval);
+            }
+            state->writer_waiting.store(false);
+        }
+        bool stop = state->stop.load();
+        {
+            std::lock_guard lock{state->write_mutex};
+            state->write_pending(stop);
+        }
+        if (stop) {
+            break;
+        }
+    }
+}
+
+xlog::AsyncAppender::AsyncAppender(
+    std::unique_ptr<Appender> sink, size_t queue_capacity, AsyncOverflowPolicy overflow_policy,
+    std::unique_ptr<Appender> tee) :
+    state_(std::make_shared<State>(std::move(sink), queue_capacity, overflow_policy)), tee_(std::move(tee))
+{
+    state_->last_flush = std::chrono::steady_clock::now();
+    writer_thread_ = std::thread{writer_thread_proc, state_};
+}
+
+xlog::AsyncAppender::~AsyncAppender()
+{
+    state_->stop.store(true);
+    {
+        std::lock_guard lock{state_->wake_mutex};
+        state_->wake_cv.notify_one();
+    }
+    // Threads are already gone when static destructors run at process exit, so write the rest on this thread and let
+    // the writer (if it still exists) finish on its own
+    if (writer_thread_.joinable()) {
+        writer_thread_.detach();
+    }
+    std::lock_guard lock{state_->write_mutex};
+    state_->write_pending(true);
+}
+
+void xlog::AsyncAppender::append(Level level, std::string_view formatted_message)
+{
+    if (tee_) {
+        tee_->append(level, formatted_message);
+    }
+    while (!state_->try_push(level, formatted_message)) {
+        if (state_->overflow_policy == AsyncOverflowPolicy::drop) {
+            state_->num_dropped.fetch_add(1, std::memory_order_relaxed);
+            state_->wake_writer();
+            return;
+        }
+        state_->wake_writer();
+        std::this_thread::yield();
+    }
+    // Cheap unless the writer sleeps, so the first message after an idle period starts a new batch
+    state_->wake_writer();
+}
+
+void xlog::AsyncAppender::flush()
+{
+    // Crash handlers call it from any thread, including the writer in the middle of a write, so do not wait forever
+    std::unique_lock lock{state_->write_mutex, std::defer_lock};
+    if (lock.try_lock_for(std::chrono::seconds{1})) {
+        state_->write_pending(true);
+    }
+}
+
+uint64_t xlog::AsyncAppender::num_dropped() const
+{
+    return state_->num_dropped.load(std::memory_order_relaxed);
+}
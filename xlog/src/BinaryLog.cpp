@@ -0,0 +1,446 @@
+#include <xlog/BinaryLog.h>
+#include <xlog/Logger.h>
+#include <xlog/RateLimit.h>
+#include <common/utils/detach-on-exit-thread.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <mutex>
+
+namespace
+{
+    constexpr uint32_t thread_buffer_capacity = 64 * 1024;
+
+    // Single-producer single-consumer byte ring owned by one thread. Buffers of exited threads are never freed, RF2
+    // creates few threads.
+    struct ThreadBuffer
+    {
+        uint8_t data[thread_buffer_capacity];
+        // Free running byte counters, the difference is the number of bytes in use
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+        ThreadBuffer* next = nullptr;
+
+        void copy_in(uint32_t pos, const uint8_t* src, size_t size)
+        {
+            uint32_t offset = pos % thread_buffer_capacity;
+            size_t first = std::min<size_t>(size, thread_buffer_capacity - offset);
+            std::memcpy(data + offset, src, first);
+            std::memcpy(data, src + first, size - first);
+        }
+
+        void copy_out(uint32_t pos, uint8_t* dst, size_t size) const
+        {
+            uint32_t offset = pos % thread_buffer_capacity;
+            size_t first = std::min<size_t>(size, thread_buffer_capacity - offset);
+            std::memcpy(dst, data + offset, first);
+            std::memcpy(dst + first, data, size - first);
+        }
+    };
+
+    std::atomic<ThreadBuffer*> g_thread_buffers{nullptr};
+    std::atomic<uint64_t> g_num_dropped{0};
+    thread_local ThreadBuffer* t_buffer = nullptr;
+
+    std::mutex g_descriptors_mutex;
+    std::vector<xlog::BinLogDescriptor*> g_descriptors;
+
+    std::mutex g_writer_control_mutex;
+    DetachOnExitThread g_writer_thread;
+    std::atomic<bool> g_writer_running{false};
+
+    ThreadBuffer* create_thread_buffer()
+    {
+        auto* buffer = new ThreadBuffer;
+        ThreadBuffer* head = g_thread_buffers.load(std::memory_order_relaxed);
+        do {
+            buffer->next = head;
+        } while (!g_thread_buffers.compare_exchange_weak(head, buffer, std::memory_order_release));
+        return buffer;
+    }
+
+    struct DecodedArg
+    {
+        xlog::BinArgType type;
+        int64_t i = 0;
+        uint64_t u = 0;
+        double d = 0.0;
+        std::string_view s;
+    };
+
+    bool read_args(const uint8_t* args, size_t size, int num_args, DecodedArg* out)
+    {
+        const uint8_t* p = args;
+        const uint8_t* end = args + size;
+        auto take = [&](void* dst, size_t n) {
+            if (static_cast<size_t>(end - p) < n) {
+                return false;
+            }
+            std::memcpy(dst, p, n);
+            p += n;
+            return true;
+        };
+        for (int i = 0; i < num_args; ++i) {
+            uint8_t type;
+            if (!take(&type, 1)) {
+                return false;
+            }
+            auto& arg = out[i];
+            arg.type = static_cast<xlog::BinArgType>(type);
+            switch (arg.type) {
+            case xlog::BinArgType::boolean: {
+                uint8_t value;
+                if (!take(&value, 1)) {
+                    return false;
+                }
+                arg.u = value;
+                break;
+            }
+            case xlog::BinArgType::i32: {
+                int32_t value;
+                if (!take(&value, sizeof(value))) {
+                    return false;
+                }
+                arg.i = value;
+                break;
+            }
+            case xlog::BinArgType::u32: {
+                uint32_t value;
+                if (!take(&value, sizeof(value))) {
+                    return false;
+                }
+                arg.u = value;
+                break;
+            }
+            case xlog::BinArgType::i64:
+                if (!take(&arg.i, sizeof(arg.i))) {
+                    return false;
+                }
+                break;
+            case xlog::BinArgType::u64:
+            case xlog::BinArgType::ptr:
+                if (!take(&arg.u, sizeof(arg.u))) {
+                    return false;
+                }
+                break;
+            case xlog::BinArgType::f64:
+                if (!take(&arg.d, sizeof(arg.d))) {
+                    return false;
+                }
+                break;
+            case xlog::BinArgType::str: {
+                uint8_t len;
+                if (!take(&len, 1) || static_cast<size_t>(end - p) < len) {
+                    return false;
+                }
+                arg.s = std::string_view{reinterpret_cast<const char*>(p), len};
+                p += len;
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void format_arg(std::string& out, const std::string& field_fmt, const DecodedArg& arg)
+    {
+        auto append = [&](const auto& value) {
+            std::vformat_to(std::back_inserter(out), field_fmt, std::make_format_args(value));
+        };
+        switch (arg.type) {
+        case xlog::BinArgType::boolean: {
+            bool value = arg.u != 0;
+            append(value);
+            break;
+        }
+        case xlog::BinArgType::i32: {
+            auto value = static_cast<int32_t>(arg.i);
+            append(value);
+            break;
+        }
+        case xlog::BinArgType::u32: {
+            auto value = static_cast<uint32_t>(arg.u);
+            append(value);
+            break;
+        }
+        case xlog::BinArgType::i64:
+            append(arg.i);
+            break;
+        case xlog::BinArgType::u64:
+            append(arg.u);
+            break;
+        case xlog::BinArgType::f64:
+            append(arg.d);
+            break;
+        case xlog::BinArgType::ptr: {
+            const void* value = reinterpret_cast<const void*>(static_cast<uintptr_t>(arg.u));
+            append(value);
+            break;
+        }
+        case xlog::BinArgType::str:
+            append(arg.s);
+            break;
+        }
+    }
+
+    // Value of an argument used as dynamic width or precision
+    bool get_dynamic_spec_value(const DecodedArg& arg, uint64_t& out_value)
+    {
+        switch (arg.type) {
+        case xlog::BinArgType::i32:
+        case xlog::BinArgType::i64:
+            if (arg.i < 0) {
+                return false;
+            }
+            out_value = static_cast<uint64_t>(arg.i);
+            return true;
+        case xlog::BinArgType::u32:
+        case xlog::BinArgType::u64:
+            out_value = arg.u;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    int parse_arg_index(std::string_view index, int& next_arg)
+    {
+        if (index.empty()) {
+            return next_arg++;
+        }
+        int value = -1;
+        std::from_chars(index.data(), index.data() + index.size(), value);
+        return value;
+    }
+
+    // How often the writer reports messages held back by rate limited log sites
+    constexpr auto rate_limit_summary_interval = std::chrono::seconds{30};
+
+    // Held while draining, the writer thread and crash handlers can both drain the buffers
+    std::timed_mutex g_drain_mutex;
+    std::vector<xlog::BinLogEntry> g_drained_entries;
+    uint64_t g_reported_dropped = 0;
+
+    // Caller must hold g_drain_mutex
+    void write_drained_entries()
+    {
+        xlog::drain_bin_log(g_drained_entries);
+        for (const auto& entry : g_drained_entries) {
+            entry.descriptor->logger->log(entry.descriptor->level, "{}", entry.text);
+        }
+        uint64_t dropped = xlog::get_bin_log_num_dropped();
+        if (dropped != g_reported_dropped) {
+            xlog::Logger::root().warn("{} binary log record(s) dropped (buffer full)", dropped - g_reported_dropped);
+            g_reported_dropped = dropped;
+        }
+    }
+
+    void writer_thread_proc(unsigned interval_ms)
+    {
+        auto last_summary = std::chrono::steady_clock::now();
+        while (g_writer_running.load(std::memory_order_relaxed)) {
+            {
+                std::lock_guard lock{g_drain_mutex};
+                write_drained_entries();
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_summary >= rate_limit_summary_interval) {
+                xlog::log_rate_limit_summaries();
+                last_summary = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{interval_ms});
+        }
+        {
+            std::lock_guard lock{g_drain_mutex};
+            write_drained_entries();
+        }
+        xlog::log_rate_limit_summaries();
+    }
+}
+
+int64_t xlog::detail::bin_log_timestamp()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+uint32_t xlog::register_bin_log_descriptor(BinLogDescriptor& descriptor)
+{
+    std::lock_guard lock{g_descriptors_mutex};
+    // Another thread may have registered it in the meantime
+    uint32_t id = descriptor.id.load(std::memory_order_relaxed);
+    if (!id) {
+        g_descriptors.push_back(&descriptor);
+        id = static_cast<uint32_t>(g_descriptors.size());
+        descriptor.id.store(id, std::memory_order_release);
+    }
+    return id;
+}
+
+const xlog::BinLogDescriptor* xlog::find_bin_log_descriptor(uint32_t id)
+{
+    std::lock_guard lock{g_descriptors_mutex};
+    if (id == 0 || id > g_descriptors.size()) {
+        return nullptr;
+    }
+    return g_descriptors[id - 1];
+}
+
+bool xlog::write_bin_log_record(const void* record, size_t size)
+{
+    ThreadBuffer* buffer = t_buffer;
+    if (!buffer) {
+        buffer = t_buffer = create_thread_buffer();
+    }
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (thread_buffer_capacity - (head - tail) < size) {
+        g_num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    buffer->copy_in(head, static_cast<const uint8_t*>(record), size);
+    buffer->head.store(head + static_cast<uint32_t>(size), std::memory_order_release);
+    return true;
+}
+
+std::string xlog::decode_bin_log_record(
+    const BinLogDescriptor& descriptor, const uint8_t* args, size_t size, int num_args)
+{
+    DecodedArg decoded[bin_log_max_args];
+    if (num_args > bin_log_max_args || !read_args(args, size, num_args, decoded)) {
+        return std::string{"(corrupted binary log record) "} + descriptor.format;
+    }
+
+    // Replacement fields are formatted one at a time because the argument types are only known at run time
+    std::string out;
+    std::string field_fmt;
+    int next_arg = 0;
+    for (const char* p = descriptor.format; *p; ++p) {
+        if ((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}')) {
+            out += *p++;
+            continue;
+        }
+        if (*p != '{') {
+            out += *p;
+            continue;
+        }
+        // Dynamic width and precision are nested replacement fields, e.g. {:{}.{}f}
+        const char* field_end = p + 1;
+        for (int depth = 1; *field_end; ++field_end) {
+            if (*field_end == '{') {
+                ++depth;
+            }
+            else if (*field_end == '}' && --depth == 0) {
+                break;
+            }
+        }
+        if (!*field_end) {
+            out += p;
+            break;
+        }
+        // Explicit argument indices are supported, the compile time check has validated them
+        std::string_view field{p + 1, static_cast<size_t>(field_end - p - 1)};
+        size_t colon = field.find_first_of(":{");
+        int arg_index = parse_arg_index(field.substr(0, colon), next_arg);
+        // Nested fields are replaced with the values of their arguments
+        bool valid = colon == std::string_view::npos || field[colon] == ':';
+        field_fmt = "{";
+        if (valid && colon != std::string_view::npos) {
+            std::string_view spec = field.substr(colon);
+            while (valid && !spec.empty()) {
+                size_t open = spec.find('{');
+                field_fmt += spec.substr(0, open);
+                if (open == std::string_view::npos) {
+                    break;
+                }
+                size_t close = spec.find('}', open);
+                int spec_arg_index = parse_arg_index(spec.substr(open + 1, close - open - 1), next_arg);
+                uint64_t value = 0;
+                valid = close != std::string_view::npos && spec_arg_index >= 0 && spec_arg_index < num_args
+                    && get_dynamic_spec_value(decoded[spec_arg_index], value);
+                field_fmt += std::to_string(value);
+                spec.remove_prefix(close + 1);
+            }
+        }
+        field_fmt += '}';
+        if (!valid) {
+            out += "{?}";
+        }
+        else if (arg_index >= 0 && arg_index < num_args) {
+            try {
+                format_arg(out, field_fmt, decoded[arg_index]);
+            }
+            catch (const std::format_error&) {
+                out += "{?}";
+            }
+        }
+        p = field_end;
+    }
+    return out;
+}
+
+void xlog::drain_bin_log(std::vector<BinLogEntry>& out_entries)
+{
+    out_entries.clear();
+    alignas(8) uint8_t record[bin_log_max_record_size];
+    for (ThreadBuffer* buffer = g_thread_buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint32_t head = buffer->head.load(std::memory_order_acquire);
+        while (head - tail >= sizeof(BinRecordHeader)) {
+            BinRecordHeader header;
+            buffer->copy_out(tail, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+            if (header.size < sizeof(header) || header.size > bin_log_max_record_size || header.size > head - tail) {
+                // Cannot happen unless memory got corrupted, skip everything written so far
+                tail = head;
+                break;
+            }
+            buffer->copy_out(tail, record, header.size);
+            tail += header.size;
+            if (const auto* descriptor = find_bin_log_descriptor(header.descriptor_id)) {
+                out_entries.push_back({
+                    header.timestamp,
+                    descriptor,
+                    decode_bin_log_record(
+                        *descriptor, record + sizeof(header), header.size - sizeof(header), header.num_args),
+                });
+            }
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+    std::stable_sort(out_entries.begin(), out_entries.end(), [](const auto& a, const auto& b) {
+        return a.timestamp < b.timestamp;
+    });
+}
+
+uint64_t xlog::get_bin_log_num_dropped()
+{
+    return g_num_dropped.load(std::memory_order_relaxed);
+}
+
+void xlog::flush_bin_log()
+{
+    // Do not wait forever if the writer thread was suspended in the middle of a drain
+    std::unique_lock lock{g_drain_mutex, std::defer_lock};
+    if (lock.try_lock_for(std::chrono::seconds{1})) {
+        write_drained_entries();
+    }
+}
+
+void xlog::start_bin_log_writer(unsigned interval_ms)
+{
+    std::lock_guard lock{g_writer_control_mutex};
+    if (!g_writer_running.load(std::memory_order_relaxed)) {
+        g_writer_running.store(true, std::memory_order_relaxed);
+        g_writer_thread = DetachOnExitThread{writer_thread_proc, interval_ms};
+    }
+}
+
+void xlog::stop_bin_log_writer()
+{
+    std::lock_guard lock{g_writer_control_mutex};
+    if (g_writer_running.load(std::memory_order_relaxed)) {
+        g_writer_running.store(false, std::memory_order_relaxed);
+        g_writer_thread.join();
+    }
+}
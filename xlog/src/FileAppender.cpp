@@ -12,7 +12,7 @@ xlog::FileAppender::FileAppender(const std::string& filename, bool append, bool
     file_.open(filename, m);
 }
 
-void xlog::FileAppender::append([[maybe_unused]] xlog::Level level, const std::string& formatted_message)
+void xlog::FileAppender::append([[maybe_unused]] xlog::Level level, std::string_view formatted_message)
 {
 #ifndef XLOG_SINGLE_THREADED
     std::lock_guard<std::mutex> lock(mutex_);
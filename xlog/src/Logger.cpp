@@ -0,0 +1,84 @@
+#include <xlog/Logger.h>
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+    // Loggers in the order they were created. A parent has to exist before its children, so updating levels in this
+    // order always sees the parent's new level.
+    struct LoggerRegistry
+    {
+        std::mutex mutex;
+        std::vector<xlog::Logger*> loggers;
+    };
+
+    LoggerRegistry& get_registry()
+    {
+        static LoggerRegistry registry;
+        return registry;
+    }
+}
+
+xlog::Logger::~Logger()
+{
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    std::erase(registry.loggers, this);
+}
+
+void xlog::Logger::register_logger()
+{
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    registry.loggers.push_back(this);
+    if (!has_own_level_) {
+        // The parent's level may have changed since the constructor read it
+        level_.store(parent_->level(), std::memory_order_relaxed);
+    }
+}
+
+void xlog::Logger::update_inherited_levels(const std::vector<Logger*>& loggers)
+{
+    for (auto* logger : loggers) {
+        if (!logger->has_own_level_) {
+            logger->level_.store(logger->parent_->level(), std::memory_order_relaxed);
+        }
+    }
+}
+
+xlog::Logger* xlog::Logger::find(std::string_view name)
+{
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    auto it = std::find_if(registry.loggers.begin(), registry.loggers.end(), [name](Logger* logger) {
+        return logger->name() == name;
+    });
+    return it != registry.loggers.end() ? *it : nullptr;
+}
+
+std::vector<xlog::Logger*> xlog::Logger::get_all()
+{
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    return registry.loggers;
+}
+
+void xlog::Logger::set_level(Level level)
+{
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    has_own_level_ = true;
+    level_.store(level, std::memory_order_relaxed);
+    update_inherited_levels(registry.loggers);
+}
+
+void xlog::Logger::reset_level()
+{
+    if (!parent_) {
+        return;
+    }
+    auto& registry = get_registry();
+    std::lock_guard lock{registry.mutex};
+    has_own_level_ = false;
+    update_inherited_levels(registry.loggers);
+}
@@ -0,0 +1,44 @@
+#include <xlog/RateLimit.h>
+#include <chrono>
+
+namespace
+{
+    std::atomic<xlog::LogSite*> g_sites{nullptr};
+
+    const char* file_name(const char* path)
+    {
+        const char* name = path;
+        for (const char* p = path; *p; ++p) {
+            if (*p == '/' || *p == '\\') {
+                name = p + 1;
+            }
+        }
+        return name;
+    }
+}
+
+int64_t xlog::detail::rate_limit_now_us()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void xlog::LogSite::register_site(Logger& logger)
+{
+    logger_ = &logger;
+    LogSite* head = g_sites.load(std::memory_order_relaxed);
+    do {
+        next_ = head;
+    } while (!g_sites.compare_exchange_weak(head, this, std::memory_order_release));
+}
+
+void xlog::log_rate_limit_summaries()
+{
+    for (LogSite* site = g_sites.load(std::memory_order_acquire); site; site = site->next_) {
+        uint32_t suppressed = site->suppressed_.exchange(0, std::memory_order_relaxed);
+        if (suppressed) {
+            site->logger_->log(
+                site->level_, "{} message(s) suppressed at {}:{}", suppressed, file_name(site->file_), site->line_);
+        }
+    }
+}
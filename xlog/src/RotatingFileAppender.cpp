@@ -0,0 +1,134 @@
+#include <xlog/RotatingFileAppender.h>
+#include <cstring>
+
+xlog::RotatingFileAppender::RotatingFileAppender(
+    std::string filename,
+    size_t max_file_size,
+    unsigned max_files,
+    size_t buffer_size,
+    std::chrono::milliseconds flush_interval) :
+    filename_(std::move(filename)),
+    max_file_size_(max_file_size),
+    max_files_(max_files),
+    buffer_(new char[buffer_size]),
+    buffer_size_(buffer_size),
+    flush_interval_(flush_interval),
+    last_write_(std::chrono::steady_clock::now())
+{
+    // Keep the log of the previous run
+    if (std::FILE* old_file = std::fopen(filename_.c_str(), "rb")) {
+        bool empty = std::fgetc(old_file) == EOF;
+        std::fclose(old_file);
+        if (!empty) {
+            rotate();
+            return;
+        }
+    }
+    file_ = std::fopen(filename_.c_str(), "wb");
+    if (file_) {
+        // Whole buffers are written at once, a second copy in the stdio buffer would only delay crash flushes
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+    }
+}
+
+xlog::RotatingFileAppender::~RotatingFileAppender()
+{
+    write_buffer();
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+std::string xlog::RotatingFileAppender::rotated_filename(unsigned index) const
+{
+    // logs/SOPOT.log -> logs/SOPOT.1.log
+    size_t dir_end = filename_.find_last_of("/\\");
+    size_t dot = filename_.rfind('.');
+    if (dot == std::string::npos || (dir_end != std::string::npos && dot < dir_end)) {
+        dot = filename_.size();
+    }
+    return filename_.substr(0, dot) + '.' + std::to_string(index) + filename_.substr(dot);
+}
+
+void xlog::RotatingFileAppender::rotate()
+{
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    if (max_files_ > 1) {
+        std::remove(rotated_filename(max_files_ - 1).c_str());
+        for (unsigned i = max_files_ - 1; i > 1; --i) {
+            std::rename(rotated_filename(i - 1).c_str(), rotated_filename(i).c_str());
+        }
+        std::rename(filename_.c_str(), rotated_filename(1).c_str());
+    }
+    file_ = std::fopen(filename_.c_str(), "wb");
+    if (file_) {
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+    }
+    file_size_ = 0;
+}
+
+void xlog::RotatingFileAppender::write_to_file(const char* data, size_t size)
+{
+    if (file_) {
+        file_size_ += std::fwrite(data, 1, size, file_);
+    }
+}
+
+void xlog::RotatingFileAppender::write_buffer()
+{
+    if (buffer_used_) {
+        write_to_file(buffer_.get(), buffer_used_);
+        buffer_used_ = 0;
+    }
+    last_write_ = std::chrono::steady_clock::now();
+}
+
+void xlog::RotatingFileAppender::append(Level level, std::string_view formatted_message)
+{
+#ifndef XLOG_SINGLE_THREADED
+    std::lock_guard lock{mutex_};
+#endif
+    size_t size = formatted_message.size() + 1;
+    if (file_size_ + buffer_used_ > 0 && file_size_ + buffer_used_ + size > max_file_size_) {
+        write_buffer();
+        rotate();
+    }
+    if (buffer_used_ + size > buffer_size_) {
+        write_buffer();
+    }
+    if (size > buffer_size_) {
+        write_to_file(formatted_message.data(), formatted_message.size());
+        write_to_file("\n", 1);
+    }
+    else {
+        std::memcpy(buffer_.get() + buffer_used_, formatted_message.data(), formatted_message.size());
+        buffer_[buffer_used_ + size - 1] = '\n';
+        buffer_used_ += size;
+    }
+    // Reading the clock costs about as much as buffering a line, so only check it now and then. AsyncAppender flushes
+    // its sink regularly anyway.
+    if (level == Level::error) {
+        write_buffer();
+    }
+    else if (++appends_since_time_check_ >= 32) {
+        appends_since_time_check_ = 0;
+        if (std::chrono::steady_clock::now() - last_write_ >= flush_interval_) {
+            write_buffer();
+        }
+    }
+}
+
+void xlog::RotatingFileAppender::flush()
+{
+#ifndef XLOG_SINGLE_THREADED
+    // The lock may be held by a thread that crashed while writing
+    std::unique_lock lock{mutex_, std::defer_lock};
+    if (!lock.try_lock_for(std::chrono::seconds{1})) {
+        return;
+    }
+#endif
+    write_buffer();
+}
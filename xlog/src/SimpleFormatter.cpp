@@ -1,28 +1,95 @@
 #include <xlog/SimpleFormatter.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Writes value right-aligned in a field of width characters
+    char* write_uint(char* out, uint64_t value, int width, char pad)
+    {
+        char digits[20];
+        int num_digits = 0;
+        do {
+            digits[num_digits++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        for (int i = num_digits; i < width; ++i) {
+            *out++ = pad;
+        }
+        while (num_digits) {
+            *out++ = digits[--num_digits];
+        }
+        return out;
+    }
+
+    unsigned current_thread_id()
+    {
+#ifdef _WIN32
+        thread_local unsigned id = GetCurrentThreadId();
+#else
+        thread_local auto id = static_cast<unsigned>(syscall(SYS_gettid));
+#endif
+        return id;
+    }
+}
 
 std::string xlog::SimpleFormatter::prepare(xlog::Level level, const std::string& logger_name) const
 {
-    static auto start_ticks = GetTickCount();
-    std::string buf;
-    buf.reserve(64);
+    char buf[256];
+    size_t len = prepare_to(buf, sizeof(buf), level, logger_name);
+    return std::string{buf, len};
+}
 
+size_t xlog::SimpleFormatter::prepare_to(char* out, size_t size, xlog::Level level, const std::string& logger_name) const
+{
+    // steady_clock uses QueryPerformanceCounter on Windows
+    static const auto start_time = std::chrono::steady_clock::now();
+
+    // Time, thread and level fit into this, only the logger name can be too long for out
+    char fixed[64];
+    char* p = fixed;
     if (include_time_) {
-        auto ticks = (GetTickCount() - start_ticks) / 1000.0f;
-        std::format_to(std::back_inserter(buf), "[{:7.2f}] ", ticks);
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        *p++ = '[';
+        p = write_uint(p, us / 1000000, 4, ' ');
+        *p++ = '.';
+        p = write_uint(p, us % 1000000, 6, '0');
+        *p++ = ']';
+        *p++ = ' ';
     }
 
-    if (include_level_) {
-        static const char* level_prefix[] = {"ERROR: ", "WARN: ", "INFO: ", "DEBUG: ", "TRACE: "};
-        buf += level_prefix[static_cast<int>(level)];
+    if (include_thread_id_) {
+        *p++ = '[';
+        p = write_uint(p, current_thread_id(), 5, ' ');
+        *p++ = ']';
+        *p++ = ' ';
     }
 
-    if (include_logger_name_ && !logger_name.empty()) {
-        buf += logger_name;
-        buf += ' ';
+    if (include_level_) {
+        static constexpr std::string_view level_prefix[] = {"ERROR: ", "WARN: ", "INFO: ", "DEBUG: ", "TRACE: "};
+        auto prefix = level_prefix[static_cast<int>(level)];
+        std::memcpy(p, prefix.data(), prefix.size());
+        p += prefix.size();
     }
 
-    return buf;
+    size_t len = std::min(static_cast<size_t>(p - fixed), size);
+    std::memcpy(out, fixed, len);
+
+    if (include_logger_name_ && !logger_name.empty() && len + logger_name.size() + 1 <= size) {
+        std::memcpy(out + len, logger_name.data(), logger_name.size());
+        len += logger_name.size();
+        out[len++] = ' ';
+    }
+    return len;
 }
@@ -2,8 +2,18 @@
 
 #include <xlog/Win32Appender.h>
 #include <windows.h>
+#include <algorithm>
+#include <cstring>
 
-void xlog::Win32Appender::append([[maybe_unused]] xlog::Level level, const std::string& formatted_message)
+void xlog::Win32Appender::append([[maybe_unused]] xlog::Level level, std::string_view formatted_message)
 {
-    OutputDebugStringA(formatted_message.c_str());
+    // The message is not null-terminated, pass it in pieces through a local buffer
+    char buf[512];
+    do {
+        size_t len = std::min(formatted_message.size(), sizeof(buf) - 1);
+        std::memcpy(buf, formatted_message.data(), len);
+        buf[len] = '\0';
+        OutputDebugStringA(buf);
+        formatted_message.remove_prefix(len);
+    } while (!formatted_message.empty());
 }